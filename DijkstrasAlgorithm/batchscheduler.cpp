@@ -0,0 +1,179 @@
+#include "batchscheduler.h"
+#include <algorithm>
+#include <ctype.h>
+
+/**
+ * Сравнение номеров запросов по начальному, затем по конечному узлу, для объединения запросов в группы.
+ */
+struct QueryLess
+{
+	const std::vector<std::pair<int, int> > * queries;
+
+	QueryLess(const std::vector<std::pair<int, int> > * _queries)
+	{
+		queries = _queries;
+	}
+
+	bool operator()(int first, int second) const
+	{
+		if ((*queries)[first] != (*queries)[second])
+			return (*queries)[first] < (*queries)[second];
+		return first < second;
+	}
+};
+
+BatchScheduler::BatchScheduler(const QueryEngine * _graph, int _threadCount)
+{
+	graph = _graph;
+	threadCount = (_threadCount > 0) ? _threadCount : Thread::processorCount();
+	results = NULL;
+	nextGroup = 0;
+	chunkSize = 1;
+}
+
+void BatchScheduler::worker(void * scheduler)
+{
+	BatchScheduler * self = (BatchScheduler *)scheduler;
+	EngineContext * context = self->graph->createContext();
+	std::vector<PathResult> paths;
+	for (;;)
+	{
+		size_t first, last;
+		{
+			MutexLocker locker(&self->queueMutex);
+			first = self->nextGroup;
+			last = std::min(first + self->chunkSize, self->groups.size());
+			self->nextGroup = last;
+		}
+		if (first == last)
+			break;
+		for (size_t g = first; g < last; g++)
+		{
+			// Каждый запрос пишет только в свою ячейку результатов, поэтому блокировка не нужна.
+			const Group & group = self->groups[g];
+			context->findPaths(group.start, group.ends, &paths);
+			for (size_t i = 0; i < group.queries.size(); i++)
+				(*self->results)[group.queries[i]] = paths[group.targets[i]];
+		}
+	}
+	delete context;
+}
+
+int BatchScheduler::run(const std::vector<std::pair<int, int> > & queries, std::vector<PathResult> * _results)
+{
+	_results->assign(queries.size(), PathResult());
+	std::vector<int> order;
+	for (size_t i = 0; i < queries.size(); i++)
+		if (queries[i].first != -1 && queries[i].second != -1)
+			order.push_back((int)i);
+	std::sort(order.begin(), order.end(), QueryLess(&queries));
+
+	// Группы по начальному узлу идут по возрастанию его индекса, конечные узлы в группе не повторяются.
+	groups.clear();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		const std::pair<int, int> & query = queries[order[i]];
+		if (groups.empty() || groups.back().start != query.first)
+		{
+			groups.push_back(Group());
+			groups.back().start = query.first;
+		}
+		Group & group = groups.back();
+		if (group.ends.empty() || group.ends.back() != query.second)
+			group.ends.push_back(query.second);
+		group.queries.push_back(order[i]);
+		group.targets.push_back((int)group.ends.size() - 1);
+	}
+
+	// Порции небольшие, чтобы потоки заканчивали примерно одновременно, но состоят из соседних групп.
+	results = _results;
+	nextGroup = 0;
+	int workers = std::min(threadCount, (int)groups.size());
+	chunkSize = std::max((size_t)1, groups.size() / (std::max(workers, 1) * 16));
+	if (workers <= 1)
+		worker(this);
+	else
+	{
+		std::vector<Thread *> threads;
+		for (int i = 0; i < workers; i++)
+		{
+			threads.push_back(new Thread());
+			threads.back()->start(&BatchScheduler::worker, this);
+		}
+		for (size_t i = 0; i < threads.size(); i++)
+			delete threads[i];
+	}
+	results = NULL;
+	int searchCount = (int)groups.size();
+	groups.clear();
+	return searchCount;
+}
+
+bool BatchScheduler::readQueries(const char * fileName, const QueryEngine & engine, std::vector<std::pair<int, int> > * queries, std::string * error)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл запросов ") + fileName;
+		return false;
+	}
+	queries->clear();
+	char line[1024];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		// Имена узлов - первые два слова строки.
+		std::vector<std::string> words;
+		char * begin = line;
+		while (words.size() < 2)
+		{
+			while (*begin != '\0' && isspace((unsigned char)*begin))
+				begin++;
+			char * end = begin;
+			while (*end != '\0' && !isspace((unsigned char)*end))
+				end++;
+			if (begin == end)
+				break;
+			words.push_back(std::string(begin, end));
+			begin = end;
+		}
+		if (words.empty())
+			continue;
+		if (words.size() != 2)
+		{
+			*error = "Неверная строка запроса: " + words[0];
+			fclose(file);
+			return false;
+		}
+		std::pair<int, int> query(engine.findNode(words[0]), engine.findNode(words[1]));
+		if (query.first == -1 || query.second == -1)
+		{
+			*error = "Узел " + (query.first == -1 ? words[0] : words[1]) + " отсутствует в графе";
+			fclose(file);
+			return false;
+		}
+		queries->push_back(query);
+	}
+	fclose(file);
+	return true;
+}
+
+bool BatchScheduler::writeResults(const char * fileName, const QueryEngine & engine, const std::vector<std::pair<int, int> > & queries, const std::vector<PathResult> & pathResults)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "w"))
+		return false;
+	for (size_t i = 0; i < queries.size(); i++)
+	{
+		fprintf_s(file, "%s %s", engine.nodeName(queries[i].first).c_str(), engine.nodeName(queries[i].second).c_str());
+		// Длина -1 бывает настоящей (веса графа приведены), поэтому отсутствие пути записывается словом.
+		if (pathResults[i].found())
+			fprintf_s(file, " " INT64_FORMAT, pathResults[i].totalWeight);
+		else
+			fprintf_s(file, " NOPATH");
+		for (size_t k = 0; k < pathResults[i].nodes.size(); k++)
+			fprintf_s(file, " %s", engine.nodeName(pathResults[i].nodes[k]).c_str());
+		fprintf_s(file, "\n");
+	}
+	fclose(file);
+	return true;
+}
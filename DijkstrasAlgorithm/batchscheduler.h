@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+#include "platform.h"
+#include "queryengine.h"
+
+/**
+ * Выполнение пакета запросов кратчайшего пути.
+ * Запросы с одним начальным узлом объединяются в группу, и на группу выполняется один поиск до всех ее конечных узлов
+ * (EngineContext::findPaths), который останавливается, как только все они обработаны.
+ * Группы упорядочены по индексу начального узла: при нумерации с хорошей локальностью (VertexOrder) соседние группы
+ * обходят близкие участки графа, поэтому потоки берут группы подряд идущими порциями из общей очереди.
+ * Результаты возвращаются в порядке запросов пакета и совпадают с ответами findPath для каждой пары.
+ */
+class BatchScheduler
+{
+private:
+	/**
+	 * Группа запросов с одним начальным узлом.
+	 */
+	struct Group
+	{
+		int start;					// Начальный узел.
+		std::vector<int> ends;		// Различные конечные узлы.
+		std::vector<int> queries;	// Номера запросов пакета.
+		std::vector<int> targets;	// Номер конечного узла в ends для каждого запроса.
+	};
+
+	const QueryEngine * graph;		// Граф, к которому выполняются запросы.
+	int threadCount;				// Количество рабочих потоков.
+	std::vector<Group> groups;		// Группы текущего пакета.
+	std::vector<PathResult> * results;	// Результаты текущего пакета.
+	size_t nextGroup;				// Первая группа, еще не взятая потоками.
+	size_t chunkSize;				// Сколько групп поток берет за раз.
+	Mutex queueMutex;				// Защищает nextGroup.
+
+	static void worker(void * scheduler);
+
+	BatchScheduler(const BatchScheduler &);
+	BatchScheduler & operator=(const BatchScheduler &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _graph - граф; должен существовать все время жизни планировщика.
+	 * @param _threadCount - количество рабочих потоков или 0 для числа процессоров.
+	 */
+	BatchScheduler(const QueryEngine * _graph, int _threadCount = 0);
+
+	/**
+	 * Выполнение пакета.
+	 * @param queries - запросы (начальный узел, конечный узел); запросы с узлом -1 не выполняются.
+	 * @param _results - указатель на вектор, в который запишутся результаты в порядке запросов (PathResult::found - найден ли путь).
+	 * @return - количество выполненных поисков (групп).
+	 */
+	int run(const std::vector<std::pair<int, int> > & queries, std::vector<PathResult> * _results);
+
+	/**
+	 * Чтение пакета: в каждой строке имена начального и конечного узлов через пробел, пустые строки пропускаются.
+	 * @param fileName - имя файла запросов.
+	 * @param engine - граф, в котором ищутся узлы.
+	 * @param queries - указатель на вектор, в который запишутся запросы.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если файл прочитан и все узлы найдены, иначе false.
+	 */
+	static bool readQueries(const char * fileName, const QueryEngine & engine, std::vector<std::pair<int, int> > * queries, std::string * error);
+
+	/**
+	 * Запись результатов: для каждого запроса строка "начало конец длина узлы пути..." или "начало конец NOPATH", если пути нет.
+	 * @param fileName - имя файла результатов.
+	 * @param engine - граф.
+	 * @param queries - запросы.
+	 * @param pathResults - результаты в порядке запросов.
+	 * @return - true, если файл записан, иначе false.
+	 */
+	static bool writeResults(const char * fileName, const QueryEngine & engine, const std::vector<std::pair<int, int> > & queries, const std::vector<PathResult> & pathResults);
+};
@@ -0,0 +1,336 @@
+#include "benchmark.h"
+#include <algorithm>
+#include "relaxkernel.h"
+
+Benchmark::Benchmark(unsigned int _seed)
+{
+	seed = _seed;
+}
+
+unsigned int Benchmark::random()
+{
+	// Линейный конгруэнтный генератор: результаты не зависят от реализации rand().
+	seed = seed * 1103515245u + 12345u;
+	return (seed >> 8) & 0xFFFFFF;
+}
+
+void Benchmark::buildGraph(StaticGraph * graph) const
+{
+	graph->build(edges);
+}
+
+void Benchmark::generateGrid(int width, int height)
+{
+	int n = width * height;
+	// Случайная перестановка номеров в именах отрывает порядок имен от порядка узлов в сетке.
+	std::vector<int> numbers(n);
+	for (int i = 0; i < n; i++)
+		numbers[i] = i;
+	for (int i = n - 1; i > 0; i--)
+		std::swap(numbers[i], numbers[random() % (i + 1)]);
+	std::vector<std::string> names(n);
+	char buffer[32];
+	for (int i = 0; i < n; i++)
+	{
+		sprintf_s(buffer, sizeof(buffer), "v%d", numbers[i]);
+		names[i] = buffer;
+	}
+
+	edges.clear();
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			int node = y * width + x;
+			if (x + 1 < width)
+			{
+				edges.push_back(FileListItem(names[node], names[node + 1], 1 + random() % 100));
+				edges.push_back(FileListItem(names[node + 1], names[node], 1 + random() % 100));
+			}
+			if (y + 1 < height)
+			{
+				edges.push_back(FileListItem(names[node], names[node + width], 1 + random() % 100));
+				edges.push_back(FileListItem(names[node + width], names[node], 1 + random() % 100));
+			}
+		}
+
+	StaticGraph graph;
+	buildGraph(&graph);
+	positions.assign(graph.nodeCount(), NodePosition());
+	for (int i = 0; i < n; i++)
+	{
+		NodePosition & position = positions[graph.findNode(names[i])];
+		position.x = i % width;
+		position.y = i / width;
+		position.known = true;
+	}
+}
+
+void Benchmark::generateHubs(int nodeCount, int degree, int hubCount, int hubDegree)
+{
+	std::vector<std::string> names(nodeCount);
+	char buffer[32];
+	for (int i = 0; i < nodeCount; i++)
+	{
+		sprintf_s(buffer, sizeof(buffer), "v%d", i);
+		names[i] = buffer;
+	}
+
+	// Первые hubCount узлов - концентраторы.
+	edges.clear();
+	for (int node = 0; node < nodeCount; node++)
+	{
+		int count = (node < hubCount) ? hubDegree : degree;
+		for (int i = 0; i < count; i++)
+		{
+			int other = random() % nodeCount;
+			if (other == node)
+				continue;
+			edges.push_back(FileListItem(names[node], names[other], 1 + random() % 100));
+			edges.push_back(FileListItem(names[other], names[node], 1 + random() % 100));
+		}
+	}
+	positions.clear();
+}
+
+bool Benchmark::load(const char * fileName, std::string * error)
+{
+	Graph graph(fileName);
+	if (graph.error_exists())
+	{
+		std::vector<int> errors = graph.getErrors();
+		error->clear();
+		for (size_t i = 0; i < errors.size(); i++)
+			*error += std::string(i > 0 ? "; " : "") + Graph::getErrorString(errors[i]);
+		return false;
+	}
+	edges.clear();
+	const std::map<std::string, Node *> & nodes = graph.getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+		for (size_t i = 0; i < iter->second->edges.size(); i++)
+			edges.push_back(FileListItem(iter->first, iter->second->edges[i]->to->name, iter->second->edges[i]->weight));
+	positions.clear();
+	return true;
+}
+
+bool Benchmark::loadCoordinates(const char * fileName)
+{
+	StaticGraph graph;
+	buildGraph(&graph);
+	return VertexOrder::readPositions(fileName, graph, &positions);
+}
+
+void Benchmark::generateQueries(int count)
+{
+	StaticGraph graph;
+	buildGraph(&graph);
+	queries.clear();
+	if (graph.nodeCount() == 0)
+		return;
+	for (int i = 0; i < count; i++)
+	{
+		int start = random() % graph.nodeCount();
+		int end = random() % graph.nodeCount();
+		queries.push_back(std::pair<std::string, std::string>(graph.nodeName(start), graph.nodeName(end)));
+	}
+}
+
+__int64 Benchmark::runQueries(const QueryEngine & graph, int kernel, double * seconds, __int64 * misses) const
+{
+	// Имена переводятся в индексы заранее, чтобы замерялся только поиск.
+	std::vector<std::pair<int, int> > indices(queries.size());
+	for (size_t i = 0; i < queries.size(); i++)
+		indices[i] = std::pair<int, int>(graph.findNode(queries[i].first), graph.findNode(queries[i].second));
+
+	EngineContext * context = graph.createContext();
+	context->setKernel(kernel);
+	PathResult result;
+	CacheMissCounter counter;
+	__int64 checksum = 0;
+	double started = Timer::seconds();
+	counter.start();
+	for (size_t i = 0; i < indices.size(); i++)
+		if (context->findPath(indices[i].first, indices[i].second, &result))
+			checksum += result.totalWeight;
+	*misses = counter.stop();
+	*seconds = Timer::seconds() - started;
+	delete context;
+	return checksum;
+}
+
+__int64 Benchmark::runQueries(const CompressedGraph & graph, double * seconds, __int64 * misses) const
+{
+	std::vector<std::pair<int, int> > indices(queries.size());
+	for (size_t i = 0; i < queries.size(); i++)
+		indices[i] = std::pair<int, int>(graph.findNode(queries[i].first), graph.findNode(queries[i].second));
+
+	CompressedQueryContext context(&graph);
+	PathResult result;
+	CacheMissCounter counter;
+	__int64 checksum = 0;
+	double started = Timer::seconds();
+	counter.start();
+	for (size_t i = 0; i < indices.size(); i++)
+		if (context.findPath(indices[i].first, indices[i].second, &result))
+			checksum += result.totalWeight;
+	*misses = counter.stop();
+	*seconds = Timer::seconds() - started;
+	return checksum;
+}
+
+void Benchmark::compareOrders(FILE * output)
+{
+	const int methods[] = { VertexOrder::ORDER_NAME, VertexOrder::ORDER_BFS, VertexOrder::ORDER_RCM, VertexOrder::ORDER_HILBERT };
+	StaticGraph base;
+	buildGraph(&base);
+	fprintf(output, "Nodes: %d, edges: %d, queries: %d\n", base.nodeCount(), base.edgeCount(), (int)queries.size());
+	fprintf(output, "%-10s %12s %12s %16s %20s\n", "order", "order, s", "queries, s", "cache misses", "checksum");
+
+	for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+	{
+		StaticGraph graph;
+		buildGraph(&graph);
+		double started = Timer::seconds();
+		std::vector<int> order;
+		if (!VertexOrder::compute(graph, methods[i], positions.empty() ? NULL : &positions, &order))
+		{
+			fprintf(output, "%-10s (no coordinates)\n", VertexOrder::name(methods[i]));
+			continue;
+		}
+		graph.renumber(order);
+		double orderSeconds = Timer::seconds() - started;
+
+		// Порядки сравниваются при одинаковых типах.
+		QueryEngine * engine = QueryEngine::create(graph, QueryEngine::WEIGHT_INT64, QueryEngine::INDEX_INT32);
+		double querySeconds;
+		__int64 misses;
+		__int64 checksum = runQueries(*engine, RelaxKernel::best(), &querySeconds, &misses);
+		delete engine;
+		char missesText[32] = "n/a";
+		if (misses != -1)
+			sprintf_s(missesText, sizeof(missesText), INT64_FORMAT, misses);
+		char checksumText[32];
+		sprintf_s(checksumText, sizeof(checksumText), INT64_FORMAT, checksum);
+		fprintf(output, "%-10s %12.3f %12.3f %16s %20s\n", VertexOrder::name(methods[i]), orderSeconds, querySeconds, missesText, checksumText);
+	}
+}
+
+void Benchmark::compareTypes(FILE * output)
+{
+	StaticGraph graph;
+	buildGraph(&graph);
+	fprintf(output, "Narrowest types: %s\n", QueryEngine::typeName(QueryEngine::narrowestWeightType(graph), QueryEngine::narrowestIndexType(graph)).c_str());
+	fprintf(output, "%-14s %12s %14s %12s %16s %20s\n", "types", "edges, KB", "huge pages, KB", "queries, s", "cache misses", "checksum");
+	for (int weightType = QueryEngine::WEIGHT_INT16; weightType <= QueryEngine::WEIGHT_DOUBLE; weightType++)
+		for (int indexType = QueryEngine::INDEX_UINT16; indexType <= QueryEngine::INDEX_INT32; indexType++)
+		{
+			size_t hugeBefore = PageMemory::allocatedBytes(PageMemory::PAGES_TRANSPARENT) + PageMemory::allocatedBytes(PageMemory::PAGES_HUGE);
+			QueryEngine * engine = QueryEngine::create(graph, weightType, indexType);
+			if (engine == NULL)
+				continue;
+			// Сколько массивов графа получили огромные страницы (см. PageMemory::setPages).
+			size_t hugeBytes = PageMemory::allocatedBytes(PageMemory::PAGES_TRANSPARENT) + PageMemory::allocatedBytes(PageMemory::PAGES_HUGE) - hugeBefore;
+			double querySeconds;
+			__int64 misses;
+			__int64 checksum = runQueries(*engine, RelaxKernel::best(), &querySeconds, &misses);
+			char missesText[32] = "n/a";
+			if (misses != -1)
+				sprintf_s(missesText, sizeof(missesText), INT64_FORMAT, misses);
+			char checksumText[32];
+			sprintf_s(checksumText, sizeof(checksumText), INT64_FORMAT, checksum);
+			fprintf(output, "%-14s %12d %14d %12.3f %16s %20s\n", QueryEngine::typeName(weightType, indexType).c_str(), (int)(engine->edgeBytes() / 1024), (int)(hugeBytes / 1024),
+				querySeconds, missesText, checksumText);
+			delete engine;
+		}
+}
+
+void Benchmark::compareKernels(FILE * output)
+{
+	StaticGraph graph;
+	buildGraph(&graph);
+	int maxDegree = 0;
+	for (int node = 0; node < graph.nodeCount(); node++)
+		maxDegree = std::max(maxDegree, graph.edgeEnd(node) - graph.edgeBegin(node));
+	fprintf(output, "Largest degree: %d, kernel used from degree %d\n", maxDegree, RelaxKernel::MIN_DEGREE);
+	fprintf(output, "%-14s %-8s %12s %16s %20s\n", "types", "kernel", "queries, s", "cache misses", "checksum");
+	const int weightTypes[] = { QueryEngine::WEIGHT_INT32, QueryEngine::WEIGHT_INT64 };
+	const int indexTypes[] = { QueryEngine::INDEX_INT32, QueryEngine::INDEX_UINT16 };
+	for (int t = 0; t < 4; t++)
+	{
+		int weightType = weightTypes[t / 2];
+		int indexType = indexTypes[t % 2];
+		QueryEngine * engine = QueryEngine::create(graph, weightType, indexType);
+		if (engine == NULL)
+			continue;
+		for (int kernel = RelaxKernel::KERNEL_SCALAR; kernel <= RelaxKernel::KERNEL_AVX2; kernel++)
+		{
+			// SSE4.1 ядра для __int64 нет, такой прогон совпал бы с обычным.
+			if (!RelaxKernel::available(kernel) || (kernel == RelaxKernel::KERNEL_SSE41 && weightType == QueryEngine::WEIGHT_INT64))
+				continue;
+			double querySeconds;
+			__int64 misses;
+			__int64 checksum = runQueries(*engine, kernel, &querySeconds, &misses);
+			char missesText[32] = "n/a";
+			if (misses != -1)
+				sprintf_s(missesText, sizeof(missesText), INT64_FORMAT, misses);
+			char checksumText[32];
+			sprintf_s(checksumText, sizeof(checksumText), INT64_FORMAT, checksum);
+			fprintf(output, "%-14s %-8s %12.3f %16s %20s\n", QueryEngine::typeName(weightType, indexType).c_str(), RelaxKernel::name(kernel), querySeconds, missesText, checksumText);
+		}
+		delete engine;
+	}
+}
+
+void Benchmark::compareCompression(FILE * output)
+{
+	const int methods[] = { VertexOrder::ORDER_NAME, VertexOrder::ORDER_BFS };
+	fprintf(output, "%-10s %-14s %12s %12s %12s %16s %20s\n", "order", "storage", "edges, KB", "bytes/edge", "queries, s", "cache misses", "checksum");
+	for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+	{
+		StaticGraph graph;
+		buildGraph(&graph);
+		std::vector<int> order;
+		VertexOrder::compute(graph, methods[i], NULL, &order);
+		graph.renumber(order);
+		int edgeCount = std::max(graph.edgeCount(), 1);
+
+		const int weightTypes[] = { QueryEngine::WEIGHT_INT64, QueryEngine::narrowestWeightType(graph) };
+		const int indexTypes[] = { QueryEngine::INDEX_INT32, QueryEngine::narrowestIndexType(graph) };
+		for (int k = 0; k < 3; k++)
+		{
+			std::string storage;
+			size_t bytes;
+			double querySeconds;
+			__int64 misses;
+			__int64 checksum;
+			if (k < 2)
+			{
+				QueryEngine * engine = QueryEngine::create(graph, weightTypes[k], indexTypes[k]);
+				if (engine == NULL)
+					continue;
+				storage = QueryEngine::typeName(weightTypes[k], indexTypes[k]);
+				bytes = engine->edgeBytes();
+				checksum = runQueries(*engine, RelaxKernel::best(), &querySeconds, &misses);
+				delete engine;
+			}
+			else
+			{
+				CompressedGraph compressed;
+				if (!compressed.build(graph))
+				{
+					fprintf(output, "%-10s %-14s (negative weights)\n", VertexOrder::name(methods[i]), "compressed");
+					continue;
+				}
+				storage = "compressed";
+				bytes = compressed.edgeBytes();
+				checksum = runQueries(compressed, &querySeconds, &misses);
+			}
+			char missesText[32] = "n/a";
+			if (misses != -1)
+				sprintf_s(missesText, sizeof(missesText), INT64_FORMAT, misses);
+			char checksumText[32];
+			sprintf_s(checksumText, sizeof(checksumText), INT64_FORMAT, checksum);
+			fprintf(output, "%-10s %-14s %12d %12.2f %12.3f %16s %20s\n", VertexOrder::name(methods[i]), storage.c_str(), (int)(bytes / 1024),
+				(double)bytes / edgeCount, querySeconds, missesText, checksumText);
+		}
+	}
+}
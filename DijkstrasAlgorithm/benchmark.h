@@ -0,0 +1,111 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include "graph.h"
+#include "staticgraph.h"
+#include "vertexorder.h"
+#include "queryengine.h"
+#include "compressedgraph.h"
+
+/**
+ * Замер скорости запросов кратчайшего пути.
+ * Граф либо генерируется (сетка со случайными именами узлов, так что порядок имен не совпадает с геометрией), либо читается из файла.
+ * Для каждого варианта строится свой граф и через EngineContext прогоняется один и тот же набор случайных запросов;
+ * печатаются время и, если доступен счетчик процессора, количество промахов кэша.
+ */
+class Benchmark
+{
+private:
+	std::vector<FileListItem> edges;					// Дуги графа.
+	std::vector<NodePosition> positions;				// Положения узлов по индексам в порядке имен (пустой, если координат нет).
+	std::vector<std::pair<std::string, std::string> > queries;	// Запросы (начальный узел, конечный узел).
+	unsigned int seed;									// Состояние генератора случайных чисел.
+
+	unsigned int random();
+	void buildGraph(StaticGraph * graph) const;
+
+	/**
+	 * Прогон всех запросов.
+	 * @param graph - граф.
+	 * @param kernel - ядро проверки дуг (RelaxKernel::KERNEL_*).
+	 * @param seconds - указатель на переменную, в которую запишется время в секундах.
+	 * @param misses - указатель на переменную, в которую запишется количество промахов кэша или -1.
+	 * @return - сумма длин найденных путей (для проверки, что варианты отвечают одинаково).
+	 */
+	__int64 runQueries(const QueryEngine & graph, int kernel, double * seconds, __int64 * misses) const;
+
+	/**
+	 * Прогон всех запросов по сжатому графу (см. runQueries).
+	 */
+	__int64 runQueries(const CompressedGraph & graph, double * seconds, __int64 * misses) const;
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _seed - начальное значение генератора случайных чисел.
+	 */
+	Benchmark(unsigned int _seed);
+
+	/**
+	 * Генерация сетки width x height с дугами в обе стороны между соседними узлами и случайными весами от 1 до 100.
+	 * Узлы получают случайные имена, положения узлов известны.
+	 */
+	void generateGrid(int width, int height);
+
+	/**
+	 * Генерация графа с узлами-концентраторами: каждый узел связан дугами в обе стороны с degree случайными узлами,
+	 * а каждый из hubCount концентраторов - с hubDegree случайными узлами. Положения узлов неизвестны.
+	 */
+	void generateHubs(int nodeCount, int degree, int hubCount, int hubDegree);
+
+	/**
+	 * Чтение графа из файла в формате командной строки.
+	 * @param fileName - имя файла.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если граф прочитан, иначе false.
+	 */
+	bool load(const char * fileName, std::string * error);
+
+	/**
+	 * Чтение координат узлов (см. VertexOrder::readPositions).
+	 * @return - true, если файл прочитан, иначе false.
+	 */
+	bool loadCoordinates(const char * fileName);
+
+	/**
+	 * Генерация случайных запросов между узлами графа.
+	 * @param count - количество запросов.
+	 */
+	void generateQueries(int count);
+
+	/**
+	 * Сравнение порядков нумерации узлов: время построения перестановки, время запросов и промахи кэша.
+	 * @param output - файл, в который печатается таблица.
+	 */
+	void compareOrders(FILE * output);
+
+	/**
+	 * Сравнение типов веса и индекса (QueryEngine) в порядке имен: объем списков дуг, объем массивов графа на огромных страницах,
+	 * время запросов и промахи кэша.
+	 * Типы, в которые данные графа не помещаются, пропускаются.
+	 * @param output - файл, в который печатается таблица.
+	 */
+	void compareTypes(FILE * output);
+
+	/**
+	 * Сравнение ядер проверки дуг (RelaxKernel) для весов int и __int64 и индексов int и unsigned short (если узлы в них помещаются);
+	 * недоступные на этом процессоре ядра пропускаются.
+	 * @param output - файл, в который печатается таблица.
+	 */
+	void compareKernels(FILE * output);
+
+	/**
+	 * Сравнение хранения дуг: StaticGraph с типами по умолчанию и самыми узкими типами против CompressedGraph,
+	 * в порядке имен и в порядке обхода в ширину (от локальности нумерации зависят разности конечных узлов в сжатом графе).
+	 * Печатаются объем списков дуг, байты на дугу и время запросов.
+	 * @param output - файл, в который печатается таблица.
+	 */
+	void compareCompression(FILE * output);
+};
@@ -0,0 +1,174 @@
+#include "blockcache.h"
+#include <string.h>
+
+IoStatistics::IoStatistics()
+{
+	bytesRead = 0;
+	bytesWritten = 0;
+	hits = 0;
+	misses = 0;
+}
+
+void IoStatistics::add(const IoStatistics & other)
+{
+	bytesRead += other.bytesRead;
+	bytesWritten += other.bytesWritten;
+	hits += other.hits;
+	misses += other.misses;
+}
+
+IoStatistics IoStatistics::since(const IoStatistics & other) const
+{
+	IoStatistics result;
+	result.bytesRead = bytesRead - other.bytesRead;
+	result.bytesWritten = bytesWritten - other.bytesWritten;
+	result.hits = hits - other.hits;
+	result.misses = misses - other.misses;
+	return result;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+BlockCache::BlockCache(FILE * _file, bool _owned, int _blockSize, size_t capacityBytes, int _readahead)
+{
+	file = _file;
+	owned = _owned;
+	blockSize = _blockSize;
+	readahead = _readahead;
+	size_t capacity = capacityBytes / blockSize;
+	if (capacity < (size_t)readahead + 1)
+		capacity = readahead + 1;
+	memory.resize(capacity * blockSize);
+	frameBlocks.assign(capacity, -1);
+	dirty.assign(capacity, false);
+	frameUsage.resize(capacity);
+	for (size_t i = capacity; i > 0; i--)
+		freeFrames.push_back((int)i - 1);
+	fileSize = fileLength(file);
+}
+
+BlockCache::~BlockCache()
+{
+	flush();
+	if (owned)
+		fclose(file);
+}
+
+void BlockCache::writeBack(int index)
+{
+	if (!dirty[index])
+		return;
+	seekFile(file, frameBlocks[index] * blockSize);
+	fwrite(&memory[(size_t)index * blockSize], 1, blockSize, file);
+	statistics.bytesWritten += blockSize;
+	dirty[index] = false;
+	if ((frameBlocks[index] + 1) * blockSize > fileSize)
+		fileSize = (frameBlocks[index] + 1) * blockSize;
+}
+
+int BlockCache::freeFrame()
+{
+	if (!freeFrames.empty())
+	{
+		int index = freeFrames.back();
+		freeFrames.pop_back();
+		return index;
+	}
+	// Свободных ячеек нет: вытесняем давно не использованный блок.
+	int index = usage.back();
+	usage.pop_back();
+	writeBack(index);
+	frames.erase(frameBlocks[index]);
+	frameBlocks[index] = -1;
+	return index;
+}
+
+int BlockCache::frame(__int64 block)
+{
+	std::map<__int64, int>::iterator found = frames.find(block);
+	if (found != frames.end())
+	{
+		statistics.hits++;
+		usage.splice(usage.begin(), usage, frameUsage[found->second]);
+		return found->second;
+	}
+	statistics.misses++;
+
+	// Блок и следующие за ним блоки, которых нет в кэше, читаются одним обращением к файлу.
+	int count = 1;
+	while (count <= readahead && (block + count) * blockSize < fileSize && frames.find(block + count) == frames.end())
+		count++;
+	std::vector<int> loaded;
+	for (int i = 0; i < count; i++)
+		loaded.push_back(freeFrame());
+	std::vector<char> buffer((size_t)count * blockSize, 0);
+	if (block * blockSize < fileSize)
+	{
+		seekFile(file, block * blockSize);
+		size_t bytes = fread(&buffer[0], 1, buffer.size(), file);
+		statistics.bytesRead += bytes;
+	}
+	// Опережающие блоки считаются использованными раньше запрошенного и вытесняются первыми, если не пригодятся.
+	for (int i = count - 1; i >= 0; i--)
+	{
+		int index = loaded[i];
+		memcpy(&memory[(size_t)index * blockSize], &buffer[(size_t)i * blockSize], blockSize);
+		frameBlocks[index] = block + i;
+		dirty[index] = false;
+		frames[block + i] = index;
+		usage.push_front(index);
+		frameUsage[index] = usage.begin();
+	}
+	return loaded[0];
+}
+
+char * BlockCache::blockData(__int64 block, bool write)
+{
+	int index = frame(block);
+	if (write)
+		dirty[index] = true;
+	return &memory[(size_t)index * blockSize];
+}
+
+void BlockCache::read(__int64 offset, size_t size, void * data)
+{
+	char * output = (char *)data;
+	while (size > 0)
+	{
+		__int64 block = offset / blockSize;
+		size_t position = (size_t)(offset % blockSize);
+		size_t part = blockSize - position < size ? blockSize - position : size;
+		memcpy(output, blockData(block, false) + position, part);
+		output += part;
+		offset += part;
+		size -= part;
+	}
+}
+
+void BlockCache::write(__int64 offset, size_t size, const void * data)
+{
+	const char * input = (const char *)data;
+	while (size > 0)
+	{
+		__int64 block = offset / blockSize;
+		size_t position = (size_t)(offset % blockSize);
+		size_t part = blockSize - position < size ? blockSize - position : size;
+		memcpy(blockData(block, true) + position, input, part);
+		input += part;
+		offset += part;
+		size -= part;
+	}
+}
+
+void BlockCache::flush()
+{
+	for (size_t i = 0; i < frameBlocks.size(); i++)
+		if (frameBlocks[i] != -1)
+			writeBack((int)i);
+	fflush(file);
+}
+
+const IoStatistics & BlockCache::getStatistics() const
+{
+	return statistics;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <map>
+#include <list>
+#include <vector>
+#include "platform.h"
+
+/**
+ * Счетчики ввода-вывода внешней памяти.
+ */
+struct IoStatistics
+{
+	__int64 bytesRead;		// Прочитано из файлов.
+	__int64 bytesWritten;	// Записано в файлы.
+	__int64 hits;			// Обращения к блокам, найденным в кэше.
+	__int64 misses;			// Обращения к блокам, которые пришлось читать.
+
+	IoStatistics();
+
+	/**
+	 * Добавление счетчиков.
+	 */
+	void add(const IoStatistics & other);
+
+	/**
+	 * Разность счетчиков (прирост с момента, когда были сняты other).
+	 */
+	IoStatistics since(const IoStatistics & other) const;
+};
+
+/**
+ * Кэш блоков файла ограниченного размера.
+ * Файл читается и пишется блоками фиксированного размера; в памяти хранится не больше capacity блоков,
+ * вытесняются давно не использованные (LRU), измененные блоки перед вытеснением записываются в файл.
+ * При промахе вместе с нужным блоком одним чтением загружаются следующие readahead блоков, которых еще нет в кэше:
+ * списки дуг соседних узлов лежат в файле рядом, и поиск часто читает их подряд.
+ * Блоки за концом файла считаются заполненными нулями, поэтому кэш подходит и для рабочих файлов, которые растут при записи.
+ */
+class BlockCache
+{
+private:
+	FILE * file;				// Файл.
+	bool owned;					// Закрывать ли файл в деструкторе.
+	int blockSize;				// Размер блока в байтах.
+	int readahead;				// Количество блоков, загружаемых вслед за блоком при промахе.
+	__int64 fileSize;			// Размер файла с учетом записанных блоков.
+	std::vector<char> memory;	// Память всех блоков кэша.
+	std::vector<__int64> frameBlocks;	// Блок в каждой ячейке или -1.
+	std::vector<bool> dirty;	// Изменен ли блок ячейки.
+	std::vector<std::list<int>::iterator> frameUsage;	// Положение ячейки в списке использования.
+	std::list<int> usage;		// Занятые ячейки от недавно использованных к давно использованным.
+	std::vector<int> freeFrames;	// Свободные ячейки.
+	std::map<__int64, int> frames;	// Ячейки по номерам блоков.
+	IoStatistics statistics;
+
+	int frame(__int64 block);
+	int freeFrame();
+	void writeBack(int index);
+	char * blockData(__int64 block, bool write);
+
+	BlockCache(const BlockCache &);
+	BlockCache & operator=(const BlockCache &);
+
+public:
+	// Размер блока по умолчанию.
+	static const int DEFAULT_BLOCK_SIZE = 65536;
+	// Количество блоков опережающего чтения по умолчанию.
+	static const int DEFAULT_READAHEAD = 4;
+
+	/**
+	 * Конструктор.
+	 * @param _file - открытый файл (для записи - в режиме "r+b" или "w+b").
+	 * @param _owned - закрывать ли файл в деструкторе.
+	 * @param _blockSize - размер блока в байтах.
+	 * @param capacityBytes - наибольший объем памяти блоков; в кэше всегда помещается хотя бы readahead + 1 блок.
+	 * @param _readahead - количество блоков опережающего чтения.
+	 */
+	BlockCache(FILE * _file, bool _owned, int _blockSize, size_t capacityBytes, int _readahead = DEFAULT_READAHEAD);
+	~BlockCache();
+
+	/**
+	 * Чтение данных, возможно, из нескольких блоков.
+	 * @param offset - позиция в файле.
+	 * @param size - количество байтов.
+	 * @param data - буфер.
+	 */
+	void read(__int64 offset, size_t size, void * data);
+
+	/**
+	 * Запись данных; в файл они попадут при вытеснении блока или вызове flush.
+	 */
+	void write(__int64 offset, size_t size, const void * data);
+
+	/**
+	 * Запись всех измененных блоков в файл.
+	 */
+	void flush();
+
+	/**
+	 * Счетчики ввода-вывода с момента создания кэша.
+	 */
+	const IoStatistics & getStatistics() const;
+};
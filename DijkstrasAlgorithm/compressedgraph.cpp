@@ -0,0 +1,297 @@
+#include "compressedgraph.h"
+#include <algorithm>
+#include <functional>
+
+/**
+ * Сравнение индексов узлов по именам, для упорядочения byName.
+ */
+struct CompressedNameLess
+{
+	const std::vector<std::string> * names;
+
+	CompressedNameLess(const std::vector<std::string> * _names)
+	{
+		names = _names;
+	}
+
+	bool operator()(int node, const std::string & name) const
+	{
+		return (*names)[node] < name;
+	}
+
+	bool operator()(const std::string & name, int node) const
+	{
+		return name < (*names)[node];
+	}
+
+	bool operator()(int first, int second) const
+	{
+		return (*names)[first] < (*names)[second];
+	}
+};
+
+// Запись числа в коде переменной длины: младшие 7 бит в каждом байте, старший бит установлен у всех байтов, кроме последнего.
+static void writeNumber(std::vector<unsigned char, PageAllocator<unsigned char> > * bytes, unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		bytes->push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	bytes->push_back((unsigned char)value);
+}
+
+// Чтение числа в коде переменной длины со сдвигом указателя. Большинство разностей и весов занимают один байт,
+// поэтому он проверяется отдельно от цикла.
+static inline unsigned long long readNumber(const unsigned char *& data)
+{
+	unsigned long long value = *data++;
+	if (value < 0x80)
+		return value;
+	value &= 0x7F;
+	for (int shift = 7; ; shift += 7)
+	{
+		unsigned char byte = *data++;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if (byte < 0x80)
+			return value;
+	}
+}
+
+// Разность со знаком записывается чередованием: 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4..., чтобы малые по модулю разности занимали один байт.
+static unsigned long long encodeSigned(__int64 value)
+{
+	return value >= 0 ? (unsigned long long)value << 1 : ((unsigned long long)(-(value + 1)) << 1) | 1;
+}
+
+static inline __int64 decodeSigned(unsigned long long value)
+{
+	return (value & 1) ? -(__int64)(value >> 1) - 1 : (__int64)(value >> 1);
+}
+
+CompressedGraph::CompressedGraph()
+{
+	clear();
+}
+
+void CompressedGraph::clear()
+{
+	names.clear();
+	byName.clear();
+	positions.assign(1, 0);
+	offsets.assign(1, 0);
+	bytes.clear();
+}
+
+bool CompressedGraph::build(const StaticGraph & graph)
+{
+	// Потенциалы приведенных весов не хранятся, поэтому длины путей по такому графу были бы неверны.
+	if (graph.reweighted())
+	{
+		clear();
+		return false;
+	}
+	int n = graph.nodeCount();
+	names.resize(n);
+	byName.resize(n);
+	for (int node = 0; node < n; node++)
+	{
+		names[node] = graph.nodeName(node);
+		byName[node] = node;
+	}
+	std::sort(byName.begin(), byName.end(), CompressedNameLess(&names));
+
+	positions.clear();
+	offsets.clear();
+	bytes.clear();
+	positions.reserve(n + 1);
+	offsets.reserve(n + 1);
+	std::vector<std::pair<int, __int64> > arcs;
+	for (int node = 0; node < n; node++)
+	{
+		positions.push_back((unsigned int)bytes.size());
+		offsets.push_back(graph.edgeBegin(node));
+		arcs.clear();
+		for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+			arcs.push_back(std::pair<int, __int64>(graph.edgeTarget(edge), graph.edgeWeight(edge)));
+		std::sort(arcs.begin(), arcs.end());
+		for (size_t i = 0; i < arcs.size(); i++)
+		{
+			if (arcs[i].second < 0)
+			{
+				clear();
+				return false;
+			}
+			if (i == 0)
+				writeNumber(&bytes, encodeSigned((__int64)arcs[i].first - node));
+			else
+				writeNumber(&bytes, (unsigned long long)(arcs[i].first - arcs[i - 1].first));
+			writeNumber(&bytes, (unsigned long long)arcs[i].second);
+		}
+	}
+	// Начала списков хранятся 32-битными, чтобы не удваивать их объем; больший поток не поддерживается.
+	if (bytes.size() > 0xFFFFFFFFu)
+	{
+		clear();
+		return false;
+	}
+	positions.push_back((unsigned int)bytes.size());
+	offsets.push_back(graph.edgeCount());
+	// Поток не дописывается после построения, поэтому лишняя емкость вектора освобождается.
+	std::vector<unsigned char, PageAllocator<unsigned char> >(bytes).swap(bytes);
+	return true;
+}
+
+int CompressedGraph::nodeCount() const
+{
+	return (int)names.size();
+}
+
+int CompressedGraph::edgeCount() const
+{
+	return offsets.back();
+}
+
+int CompressedGraph::findNode(const std::string & name) const
+{
+	std::vector<int>::const_iterator iter = std::lower_bound(byName.begin(), byName.end(), name, CompressedNameLess(&names));
+	if (iter == byName.end() || names[*iter] != name)
+		return -1;
+	return *iter;
+}
+
+const std::string & CompressedGraph::nodeName(int node) const
+{
+	return names[node];
+}
+
+int CompressedGraph::edgeBegin(int node) const
+{
+	return offsets[node];
+}
+
+int CompressedGraph::edgeEnd(int node) const
+{
+	return offsets[node + 1];
+}
+
+void CompressedGraph::decode(int node, std::vector<int> * nodeTargets, std::vector<__int64> * nodeWeights) const
+{
+	nodeTargets->clear();
+	nodeWeights->clear();
+	if (offsets[node] == offsets[node + 1])
+		return;
+	const unsigned char * data = &bytes[positions[node]];
+	int target = node;
+	for (int edge = offsets[node]; edge < offsets[node + 1]; edge++)
+	{
+		unsigned long long gap = readNumber(data);
+		target = (edge == offsets[node]) ? (int)(node + decodeSigned(gap)) : target + (int)gap;
+		nodeTargets->push_back(target);
+		nodeWeights->push_back((__int64)readNumber(data));
+	}
+}
+
+size_t CompressedGraph::edgeBytes() const
+{
+	return bytes.size() + positions.size() * sizeof(unsigned int) + offsets.size() * sizeof(int);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+CompressedQueryContext::CompressedQueryContext(const CompressedGraph * _graph)
+{
+	graph = _graph;
+	int n = graph->nodeCount();
+	labels.resize(n);
+	hops.resize(n);
+	parentEdges.resize(n);
+	parentNodes.resize(n);
+	stamps.assign(n, 0);
+	stamp = 0;
+}
+
+bool CompressedQueryContext::findPath(int start, int end, PathResult * result)
+{
+	result->totalWeight = -1;
+	result->nodes.clear();
+	result->edges.clear();
+
+	// Новый номер запроса делает недействительными все метки предыдущего; при переполнении номера метки сбрасываются явно.
+	if (++stamp == 0)
+	{
+		std::fill(stamps.begin(), stamps.end(), 0);
+		stamp = 1;
+	}
+	heap.clear();
+	labels[start] = 0;
+	hops[start] = 0;
+	parentEdges[start] = -1;
+	parentNodes[start] = -1;
+	stamps[start] = stamp;
+	heap.push_back(HeapItem(0, 0, start));
+
+	const std::vector<unsigned int, PageAllocator<unsigned int> > & positions = graph->positions;
+	const std::vector<int, PageAllocator<int> > & offsets = graph->offsets;
+	bool found = false;
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+		HeapItem current = heap.back();
+		heap.pop_back();
+		int node = current.node;
+		// Устаревшие элементы кучи пропускаются.
+		if (current.weight != labels[node] || current.hops != hops[node])
+			continue;
+		if (node == end)
+		{
+			found = true;
+			break;
+		}
+		int first = offsets[node];
+		int last = offsets[node + 1];
+		if (first == last)
+			continue;
+
+		// Дуги раскодируются по одной прямо в цикле проверки, без промежуточного массива.
+		const unsigned char * data = &graph->bytes[positions[node]];
+		int target = node;
+		int count = current.hops + 1;
+		for (int edge = first; edge < last; edge++)
+		{
+			unsigned long long gap = readNumber(data);
+			target = (edge == first) ? (int)(node + decodeSigned(gap)) : target + (int)gap;
+			__int64 weight = current.weight + (__int64)readNumber(data);
+			if (stamps[target] != stamp || labels[target] > weight || (labels[target] == weight && hops[target] > count))
+			{
+				stamps[target] = stamp;
+				labels[target] = weight;
+				hops[target] = count;
+				parentEdges[target] = edge;
+				parentNodes[target] = node;
+				heap.push_back(HeapItem(weight, count, target));
+				std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+			}
+			else if (labels[target] == weight && hops[target] == count && edge < parentEdges[target])
+			{
+				// Путь той же длины и с тем же числом дуг: оставляем последнюю дугу с меньшим индексом.
+				parentEdges[target] = edge;
+				parentNodes[target] = node;
+			}
+		}
+	}
+	if (!found)
+		return false;
+
+	// Восстанавливаем путь от конечного узла к начальному.
+	result->totalWeight = labels[end];
+	for (int node = end; node != -1; node = parentNodes[node])
+	{
+		result->nodes.push_back(node);
+		if (parentEdges[node] != -1)
+			result->edges.push_back(parentEdges[node]);
+	}
+	std::reverse(result->nodes.begin(), result->nodes.end());
+	std::reverse(result->edges.begin(), result->edges.end());
+	return true;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "staticgraph.h"
+
+/**
+ * Сжатое представление графа для больших графов, которые только читаются.
+ * Дуги каждого узла упорядочены по конечному узлу (при равных - по весу) и записаны в поток байтов:
+ * для каждой дуги - разность с конечным узлом предыдущей дуги (у первой дуги - разность с самим узлом со знаком) и вес,
+ * оба числа в коде переменной длины (по 7 бит в байте, старший бит - признак продолжения).
+ * При нумерации с хорошей локальностью (VertexOrder) разности малы, и дуга занимает 2-3 байта вместо 12 в StaticGraph.
+ *
+ * Дуги нумеруются в порядке потока, поэтому их индексы отличаются от индексов исходного графа. Веса должны быть неотрицательными.
+ * Произвольный доступ к дуге невозможен - списки дуг читаются только целиком (decode) или во время поиска (CompressedQueryContext).
+ */
+class CompressedGraph
+{
+private:
+	friend class CompressedQueryContext;
+
+	std::vector<std::string> names;		// Имена узлов.
+	std::vector<int> byName;			// Индексы узлов, упорядоченные по именам.
+	std::vector<unsigned int, PageAllocator<unsigned int> > positions;	// Начало списка дуг каждого узла в потоке; последний элемент равен длине потока.
+	std::vector<int, PageAllocator<int> > offsets;				// Индекс первой дуги каждого узла; последний элемент равен количеству дуг.
+	std::vector<unsigned char, PageAllocator<unsigned char> > bytes;	// Поток закодированных дуг.
+
+	void clear();
+	CompressedGraph(const CompressedGraph &);
+	CompressedGraph & operator=(const CompressedGraph &);
+
+public:
+	CompressedGraph();
+
+	/**
+	 * Построение по графу с сохранением его нумерации узлов.
+	 * @param graph - исходный граф; после построения может быть удален.
+	 * @return - false, если у графа есть дуги отрицательного веса, веса приведены (StaticGraph::reweight)
+	 *           или поток не помещается в 4 ГБ (граф тогда пуст).
+	 */
+	bool build(const StaticGraph & graph);
+
+	/**
+	 * Количество узлов.
+	 */
+	int nodeCount() const;
+
+	/**
+	 * Количество дуг.
+	 */
+	int edgeCount() const;
+
+	/**
+	 * Поиск узла по имени.
+	 * @return - индекс узла или -1, если узла нет в графе.
+	 */
+	int findNode(const std::string & name) const;
+
+	/**
+	 * Имя узла.
+	 */
+	const std::string & nodeName(int node) const;
+
+	/**
+	 * Индекс первой дуги, выходящей из узла.
+	 */
+	int edgeBegin(int node) const;
+
+	/**
+	 * Индекс, следующий за последней дугой, выходящей из узла.
+	 */
+	int edgeEnd(int node) const;
+
+	/**
+	 * Раскодирование списка дуг узла.
+	 * @param node - индекс узла.
+	 * @param nodeTargets - указатель на вектор, в который запишутся конечные узлы дуг.
+	 * @param nodeWeights - указатель на вектор, в который запишутся веса дуг.
+	 */
+	void decode(int node, std::vector<int> * nodeTargets, std::vector<__int64> * nodeWeights) const;
+
+	/**
+	 * Объем памяти, занимаемый списками дуг, в байтах (поток и начала списков, для сравнения с BasicStaticGraph::edgeBytes).
+	 */
+	size_t edgeBytes() const;
+};
+
+/**
+ * Рабочая память запросов к сжатому графу; принадлежит одному потоку.
+ * Поиск - алгоритм Дейкстры, в котором дуги узла раскодируются прямо в цикле проверки. Как и BasicQueryContext,
+ * среди кратчайших путей выбирается путь с наименьшим числом дуг, а при равенстве - путь с меньшим индексом последней дуги,
+ * поэтому длина и число дуг пути совпадают с ответом QueryContext для того же графа.
+ */
+class CompressedQueryContext
+{
+private:
+	/**
+	 * Элемент кучи: метка узла на момент добавления и индекс узла.
+	 */
+	struct HeapItem
+	{
+		__int64 weight;
+		int hops;
+		int node;
+
+		HeapItem(__int64 _weight, int _hops, int _node)
+		{
+			weight = _weight;
+			hops = _hops;
+			node = _node;
+		}
+
+		bool operator>(const HeapItem & other) const
+		{
+			if (weight != other.weight)
+				return weight > other.weight;
+			if (hops != other.hops)
+				return hops > other.hops;
+			return node > other.node;
+		}
+	};
+
+	const CompressedGraph * graph;		// Граф, к которому выполняются запросы.
+	std::vector<__int64, PageAllocator<__int64> > labels;		// Длины путей до узлов.
+	std::vector<int, PageAllocator<int> > hops;					// Число дуг путей до узлов.
+	std::vector<int, PageAllocator<int> > parentEdges;			// Последняя дуга кратчайшего пути до узла.
+	std::vector<int, PageAllocator<int> > parentNodes;			// Предыдущий узел кратчайшего пути.
+	std::vector<unsigned int, PageAllocator<unsigned int> > stamps;	// Номер запроса, в котором узел достигнут.
+	unsigned int stamp;					// Номер текущего запроса.
+	std::vector<HeapItem> heap;			// Двоичная куча узлов с неокончательными метками.
+
+	CompressedQueryContext(const CompressedQueryContext &);
+	CompressedQueryContext & operator=(const CompressedQueryContext &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _graph - граф; должен существовать все время жизни контекста.
+	 */
+	CompressedQueryContext(const CompressedGraph * _graph);
+
+	/**
+	 * Поиск кратчайшего пути.
+	 * @param start - начальный узел.
+	 * @param end - конечный узел.
+	 * @param result - указатель на результат; индексы дуг - индексы сжатого графа.
+	 * @return - true, если путь найден, иначе false.
+	 */
+	bool findPath(int start, int end, PathResult * result);
+};
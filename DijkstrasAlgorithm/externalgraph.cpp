@@ -0,0 +1,704 @@
+#include "externalgraph.h"
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+static const char EXTERNAL_MAGIC[8] = { 'D', 'J', 'K', 'B', 'L', 'K', '0', '1' };
+
+/**
+ * Дуга при внешней сортировке; sequence - номер дуги в исходном файле, сохраняющий порядок дуг узла.
+ */
+struct RunEdge
+{
+	int source;
+	int target;
+	__int64 weight;
+	__int64 sequence;
+
+	bool operator<(const RunEdge & other) const
+	{
+		if (source != other.source)
+			return source < other.source;
+		return sequence < other.sequence;
+	}
+};
+
+/**
+ * Чтение отсортированной порции дуг из временного файла через буфер.
+ */
+struct RunReader
+{
+	FILE * file;
+	std::vector<RunEdge> buffer;
+	size_t position;
+	size_t count;
+
+	bool next(RunEdge * edge)
+	{
+		if (position == count)
+		{
+			count = fread(&buffer[0], sizeof(RunEdge), buffer.size(), file);
+			position = 0;
+			if (count == 0)
+				return false;
+		}
+		*edge = buffer[position++];
+		return true;
+	}
+};
+
+// Чтение заголовка файла графа; false, если формат нарушен.
+static bool readGraphHeader(FILE * file, __int64 * edgeCount)
+{
+	char start[256] = "", end[256] = "";
+	return fscanf_s(file, INT64_FORMAT, edgeCount) == 1 && fscanf_s(file, "%s", start) == 1 && fscanf_s(file, "%s", end) == 1 && *edgeCount >= 0;
+}
+
+static bool readGraphEdge(FILE * file, char * from, char * to, __int64 * weight)
+{
+	return fscanf_s(file, "%s", from) == 1 && fscanf_s(file, "%s", to) == 1 && fscanf_s(file, INT64_FORMAT, weight) == 1;
+}
+
+// Сортировка имен с удалением повторов.
+static void compactNames(std::vector<std::string> * names)
+{
+	std::sort(names->begin(), names->end());
+	names->erase(std::unique(names->begin(), names->end()), names->end());
+}
+
+static int nodeIndex(const std::vector<std::string> & names, const char * name)
+{
+	return (int)(std::lower_bound(names.begin(), names.end(), std::string(name)) - names.begin());
+}
+
+// Сортировка порции и запись ее во временный файл.
+static FILE * writeRun(std::vector<RunEdge> * run)
+{
+	std::sort(run->begin(), run->end());
+	FILE * file = tmpfile();
+	if (file == NULL)
+		return NULL;
+	fwrite(&(*run)[0], sizeof(RunEdge), run->size(), file);
+	rewind(file);
+	run->clear();
+	return file;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+bool ExternalGraph::convert(const char * inputFileName, const char * outputFileName, size_t memoryBudget, std::string * error, int blockSize)
+{
+	// Первый проход: имена узлов.
+	FILE * input;
+	if (fopen_s(&input, inputFileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл ") + inputFileName;
+		return false;
+	}
+	__int64 edgeCount = 0;
+	char from[256] = "", to[256] = "";
+	__int64 weight = 0, maxWeight = 0;
+	// Имена копятся в одном векторе, который сжимается, как только повторов становится столько же, сколько разных имен.
+	std::vector<std::string> names;
+	size_t distinct = 0;
+	bool valid = readGraphHeader(input, &edgeCount);
+	for (__int64 i = 0; valid && i < edgeCount; i++)
+	{
+		valid = readGraphEdge(input, from, to, &weight) && weight >= 0;
+		names.push_back(from);
+		names.push_back(to);
+		maxWeight = std::max(maxWeight, weight);
+		if (names.size() >= 2 * distinct + 1024)
+		{
+			compactNames(&names);
+			distinct = names.size();
+		}
+	}
+	fclose(input);
+	if (!valid || edgeCount > 0x7FFFFFFF)
+	{
+		*error = "Неверный формат файла или отрицательный вес дуги";
+		return false;
+	}
+	compactNames(&names);
+	int nodeCount = (int)names.size();
+
+	// Второй проход: порции дуг сортируются по начальным узлам и сбрасываются во временные файлы.
+	std::vector<RunEdge> run;
+	size_t runCapacity = std::max(memoryBudget / sizeof(RunEdge), (size_t)64);
+	std::vector<FILE *> runs;
+	fopen_s(&input, inputFileName, "r");
+	readGraphHeader(input, &edgeCount);
+	for (__int64 i = 0; i < edgeCount && valid; i++)
+	{
+		readGraphEdge(input, from, to, &weight);
+		RunEdge edge;
+		edge.source = nodeIndex(names, from);
+		edge.target = nodeIndex(names, to);
+		edge.weight = weight;
+		edge.sequence = i;
+		run.push_back(edge);
+		if (run.size() == runCapacity || i + 1 == edgeCount)
+		{
+			runs.push_back(writeRun(&run));
+			valid = runs.back() != NULL;
+		}
+	}
+	fclose(input);
+
+	FILE * output = NULL;
+	if (!valid || fopen_s(&output, outputFileName, "wb"))
+	{
+		*error = std::string("Не удалось записать файл ") + outputFileName;
+		for (size_t i = 0; i < runs.size(); i++)
+			if (runs[i] != NULL)
+				fclose(runs[i]);
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, EXTERNAL_MAGIC, sizeof(header.magic));
+	header.nodeCount = nodeCount;
+	header.edgeCount = edgeCount;
+	header.maxWeight = maxWeight;
+	header.blockSize = blockSize;
+	header.edgesStart = sizeof(Header);
+	fwrite(&header, sizeof(header), 1, output);
+
+	// Слияние порций: дуги записываются по возрастанию начального узла, а дуги одного узла - в исходном порядке.
+	std::vector<RunReader> readers(runs.size());
+	// Элемент слияния: ключ первой дуги порции и номер порции.
+	typedef std::pair<std::pair<int, __int64>, int> MergeItem;
+	std::vector<MergeItem> merge;
+	std::vector<RunEdge> heads(runs.size());
+	size_t readerBuffer = std::max(runCapacity / (runs.size() + 1), (size_t)16);
+	for (size_t i = 0; i < runs.size(); i++)
+	{
+		readers[i].file = runs[i];
+		readers[i].buffer.resize(readerBuffer);
+		readers[i].position = readers[i].count = 0;
+		if (readers[i].next(&heads[i]))
+			merge.push_back(std::make_pair(std::make_pair(heads[i].source, heads[i].sequence), (int)i));
+	}
+	std::greater<MergeItem> later;
+	std::make_heap(merge.begin(), merge.end(), later);
+	std::vector<__int64> offsets(nodeCount + 1, 0);
+	char record[EDGE_RECORD_SIZE];
+	while (!merge.empty())
+	{
+		std::pop_heap(merge.begin(), merge.end(), later);
+		int index = merge.back().second;
+		merge.pop_back();
+		const RunEdge & edge = heads[index];
+		memcpy(record, &edge.target, 4);
+		memcpy(record + 4, &edge.weight, 8);
+		fwrite(record, 1, EDGE_RECORD_SIZE, output);
+		offsets[edge.source + 1]++;
+		if (readers[index].next(&heads[index]))
+		{
+			merge.push_back(std::make_pair(std::make_pair(heads[index].source, heads[index].sequence), index));
+			std::push_heap(merge.begin(), merge.end(), later);
+		}
+	}
+	for (size_t i = 0; i < runs.size(); i++)
+		fclose(runs[i]);
+
+	// Номера первых дуг узлов, затем смещения имен и сами имена.
+	for (int node = 0; node < nodeCount; node++)
+		offsets[node + 1] += offsets[node];
+	header.offsetsStart = header.edgesStart + edgeCount * EDGE_RECORD_SIZE;
+	fwrite(&offsets[0], sizeof(__int64), offsets.size(), output);
+	header.namesStart = header.offsetsStart + (__int64)offsets.size() * sizeof(__int64);
+	offsets[0] = 0;
+	for (int node = 0; node < nodeCount; node++)
+		offsets[node + 1] = offsets[node] + (__int64)names[node].size();
+	fwrite(&offsets[0], sizeof(__int64), offsets.size(), output);
+	header.textStart = header.namesStart + (__int64)offsets.size() * sizeof(__int64);
+	for (int node = 0; node < nodeCount; node++)
+		fwrite(names[node].data(), 1, names[node].size(), output);
+
+	seekFile(output, 0);
+	fwrite(&header, sizeof(header), 1, output);
+	valid = !ferror(output);
+	fclose(output);
+	if (!valid)
+		*error = std::string("Не удалось записать файл ") + outputFileName;
+	return valid;
+}
+
+ExternalGraph::ExternalGraph()
+{
+	memset(&header, 0, sizeof(header));
+	cache = NULL;
+}
+
+ExternalGraph::~ExternalGraph()
+{
+	delete cache;
+}
+
+bool ExternalGraph::open(const char * fileName, size_t cacheBytes, std::string * error)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "rb"))
+	{
+		*error = std::string("Не удалось открыть файл ") + fileName;
+		return false;
+	}
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, EXTERNAL_MAGIC, sizeof(header.magic)) != 0 || header.blockSize <= 0)
+	{
+		*error = std::string("Файл ") + fileName + " не является файлом внешнего графа";
+		fclose(file);
+		return false;
+	}
+	delete cache;
+	cache = new BlockCache(file, true, header.blockSize, cacheBytes);
+	return true;
+}
+
+int ExternalGraph::nodeCount() const
+{
+	return (int)header.nodeCount;
+}
+
+int ExternalGraph::edgeCount() const
+{
+	return (int)header.edgeCount;
+}
+
+__int64 ExternalGraph::maxWeight() const
+{
+	return header.maxWeight;
+}
+
+std::string ExternalGraph::nodeName(int node)
+{
+	__int64 bounds[2];
+	cache->read(header.namesStart + (__int64)node * sizeof(__int64), sizeof(bounds), bounds);
+	std::string name((size_t)(bounds[1] - bounds[0]), '\0');
+	if (!name.empty())
+		cache->read(header.textStart + bounds[0], name.size(), &name[0]);
+	return name;
+}
+
+int ExternalGraph::findNode(const std::string & name)
+{
+	// Узлы пронумерованы по возрастанию имен.
+	int low = 0, high = nodeCount() - 1;
+	while (low <= high)
+	{
+		int middle = low + (high - low) / 2;
+		int comparison = nodeName(middle).compare(name);
+		if (comparison == 0)
+			return middle;
+		if (comparison < 0)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+	return -1;
+}
+
+int ExternalGraph::readEdges(int node, std::vector<ExternalEdge> * edges)
+{
+	__int64 bounds[2];
+	cache->read(header.offsetsStart + (__int64)node * sizeof(__int64), sizeof(bounds), bounds);
+	int count = (int)(bounds[1] - bounds[0]);
+	edges->resize(count);
+	if (count > 0)
+	{
+		records.resize((size_t)count * EDGE_RECORD_SIZE);
+		cache->read(header.edgesStart + bounds[0] * EDGE_RECORD_SIZE, records.size(), &records[0]);
+		for (int i = 0; i < count; i++)
+		{
+			memcpy(&(*edges)[i].target, &records[(size_t)i * EDGE_RECORD_SIZE], 4);
+			memcpy(&(*edges)[i].weight, &records[(size_t)i * EDGE_RECORD_SIZE + 4], 8);
+		}
+	}
+	return (int)bounds[0];
+}
+
+const IoStatistics & ExternalGraph::getStatistics() const
+{
+	return cache->getStatistics();
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+/**
+ * Проверка, что элемент меньше границы подкорзины.
+ */
+struct ItemBelow
+{
+	ExternalQueueItem bound;
+
+	ItemBelow(const ExternalQueueItem & _bound)
+	{
+		bound = _bound;
+	}
+
+	bool operator()(const ExternalQueueItem & item) const
+	{
+		return item < bound;
+	}
+};
+
+bool ExternalQueueItem::operator>(const ExternalQueueItem & other) const
+{
+	if (weight != other.weight)
+		return weight > other.weight;
+	if (hops != other.hops)
+		return hops > other.hops;
+	return node > other.node;
+}
+
+bool ExternalQueueItem::operator<(const ExternalQueueItem & other) const
+{
+	return other > *this;
+}
+
+ExternalQueue::ExternalQueue(__int64 _width, size_t memoryBytes)
+{
+	width = std::max(_width, (__int64)1);
+	size_t limit = std::max(memoryBytes / sizeof(ExternalQueueItem), (size_t)16);
+	heapLimit = limit / 2;
+	bufferLimit = limit / 4;
+	pieceSize = limit / 4;
+	heap.reserve(heapLimit + 1);
+	current = -1;
+	buffered = 0;
+	spill = NULL;
+	spillEnd = 0;
+}
+
+ExternalQueue::~ExternalQueue()
+{
+	if (spill != NULL)
+		fclose(spill);
+}
+
+void ExternalQueue::clear()
+{
+	heap.clear();
+	parts.clear();
+	buckets.clear();
+	current = -1;
+	buffered = 0;
+	spillEnd = 0;
+}
+
+// Запись буфера корзины во временный файл; false, если файл не удалось создать.
+bool ExternalQueue::writeChunk(Bucket & bucket)
+{
+	if (spill == NULL)
+		spill = tmpfile();
+	if (spill == NULL)
+		return false;
+	std::vector<ExternalQueueItem> & buffer = bucket.buffer;
+	seekFile(spill, spillEnd);
+	fwrite(&buffer[0], sizeof(ExternalQueueItem), buffer.size(), spill);
+	bucket.chunks.push_back(std::make_pair(spillEnd, (int)buffer.size()));
+	spillEnd += (__int64)buffer.size() * sizeof(ExternalQueueItem);
+	statistics.bytesWritten += (__int64)buffer.size() * sizeof(ExternalQueueItem);
+	buffered -= buffer.size();
+	std::vector<ExternalQueueItem>().swap(buffer);
+	return true;
+}
+
+void ExternalQueue::spillFarthest()
+{
+	// Дальние корзины понадобятся позже всех, поэтому на диск уходят они, а подкорзины текущей - последними.
+	for (std::map<__int64, Bucket>::reverse_iterator iter = buckets.rbegin(); iter != buckets.rend() && buffered > bufferLimit / 2; iter++)
+		if (!iter->second.buffer.empty() && !writeChunk(iter->second))
+			return;
+	for (std::map<ExternalQueueItem, Bucket>::reverse_iterator iter = parts.rbegin(); iter != parts.rend() && buffered > bufferLimit / 2; iter++)
+		if (!iter->second.buffer.empty() && !writeChunk(iter->second))
+			return;
+}
+
+void ExternalQueue::push(const ExternalQueueItem & item)
+{
+	__int64 bucket = item.weight / width;
+	if (bucket <= current)
+	{
+		pushCurrent(item);
+		return;
+	}
+	buckets[bucket].buffer.push_back(item);
+	if (++buffered > bufferLimit)
+		spillFarthest();
+}
+
+// Добавление элемента текущей корзины: в кучу или в подкорзину, в диапазон которой он попадает.
+void ExternalQueue::pushCurrent(const ExternalQueueItem & item)
+{
+	if (parts.empty() || item < parts.begin()->first)
+	{
+		heap.push_back(item);
+		std::push_heap(heap.begin(), heap.end(), std::greater<ExternalQueueItem>());
+		if (heap.size() > heapLimit)
+			splitHeap();
+		return;
+	}
+	std::map<ExternalQueueItem, Bucket>::iterator part = parts.upper_bound(item);
+	(--part)->second.buffer.push_back(item);
+	if (++buffered > bufferLimit)
+		spillFarthest();
+}
+
+// Деление переполненной кучи: большая половина становится новой подкорзиной, которая начинается с ее наименьшего элемента.
+void ExternalQueue::splitHeap()
+{
+	std::vector<ExternalQueueItem>::iterator middle = heap.begin() + heap.size() / 2;
+	std::nth_element(heap.begin(), middle, heap.end());
+	ExternalQueueItem first = *middle;
+	middle = std::partition(heap.begin(), heap.end(), ItemBelow(first));
+	if (middle == heap.begin())
+		return;
+	Bucket & part = parts[first];
+	part.buffer.assign(middle, heap.end());
+	buffered += part.buffer.size();
+	heap.erase(middle, heap.end());
+	std::make_heap(heap.begin(), heap.end(), std::greater<ExternalQueueItem>());
+	if (buffered > bufferLimit)
+		spillFarthest();
+}
+
+// Чтение корзины, ставшей текущей (или первой подкорзины текущей корзины), в кучу.
+void ExternalQueue::load(Bucket & bucket)
+{
+	size_t total = bucket.buffer.size();
+	for (size_t i = 0; i < bucket.chunks.size(); i++)
+		total += bucket.chunks[i].second;
+	if (total <= heapLimit)
+	{
+		// Корзина помещается в кучу: элементы с диска и из буфера собираются в нее целиком.
+		for (size_t i = 0; i < bucket.chunks.size(); i++)
+		{
+			size_t count = bucket.chunks[i].second;
+			size_t first = heap.size();
+			heap.resize(first + count);
+			seekFile(spill, bucket.chunks[i].first);
+			size_t bytes = fread(&heap[first], sizeof(ExternalQueueItem), count, spill) * sizeof(ExternalQueueItem);
+			statistics.bytesRead += bytes;
+		}
+		heap.insert(heap.end(), bucket.buffer.begin(), bucket.buffer.end());
+		buffered -= bucket.buffer.size();
+		std::make_heap(heap.begin(), heap.end(), std::greater<ExternalQueueItem>());
+		return;
+	}
+
+	// Иначе буфер тоже сбрасывается на диск, и элементы читаются частями, по ходу деля кучу на подкорзины.
+	if (!bucket.buffer.empty() && !writeChunk(bucket))
+	{
+		std::vector<ExternalQueueItem> buffer;
+		buffer.swap(bucket.buffer);
+		buffered -= buffer.size();
+		for (size_t i = 0; i < buffer.size(); i++)
+			pushCurrent(buffer[i]);
+	}
+	piece.resize(pieceSize);
+	for (size_t i = 0; i < bucket.chunks.size(); i++)
+		for (size_t done = 0; done < (size_t)bucket.chunks[i].second; )
+		{
+			size_t count = std::min(pieceSize, (size_t)bucket.chunks[i].second - done);
+			seekFile(spill, bucket.chunks[i].first + (__int64)(done * sizeof(ExternalQueueItem)));
+			size_t read = fread(&piece[0], sizeof(ExternalQueueItem), count, spill);
+			statistics.bytesRead += (__int64)(read * sizeof(ExternalQueueItem));
+			if (read == 0)
+				break;
+			done += read;
+			for (size_t j = 0; j < read; j++)
+				pushCurrent(piece[j]);
+		}
+}
+
+bool ExternalQueue::pop(ExternalQueueItem * item)
+{
+	while (heap.empty())
+	{
+		Bucket next;
+		if (!parts.empty())
+		{
+			// Первая подкорзина текущей корзины.
+			next.buffer.swap(parts.begin()->second.buffer);
+			next.chunks.swap(parts.begin()->second.chunks);
+			parts.erase(parts.begin());
+		}
+		else if (!buckets.empty())
+		{
+			// Следующая корзина становится текущей.
+			current = buckets.begin()->first;
+			next.buffer.swap(buckets.begin()->second.buffer);
+			next.chunks.swap(buckets.begin()->second.chunks);
+			buckets.erase(buckets.begin());
+		}
+		else
+			return false;
+		load(next);
+	}
+	std::pop_heap(heap.begin(), heap.end(), std::greater<ExternalQueueItem>());
+	*item = heap.back();
+	heap.pop_back();
+	return true;
+}
+
+const IoStatistics & ExternalQueue::getStatistics() const
+{
+	return statistics;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ExternalSearch::ExternalSearch(ExternalGraph * _graph, size_t _stateBytes, size_t queueBytes) : queue(_graph->maxWeight(), queueBytes)
+{
+	graph = _graph;
+	stateBytes = _stateBytes;
+	states = NULL;
+	stamp = 0;
+	createStates();
+}
+
+ExternalSearch::~ExternalSearch()
+{
+	delete states;
+}
+
+void ExternalSearch::createStates()
+{
+	// Новый пустой временный файл: все метки нулевые, то есть не относятся ни к одному запросу.
+	// Метки читаются вразнобой, поэтому блоки меньше, чем у графа, и без опережающего чтения.
+	delete states;
+	FILE * file = tmpfile();
+	states = (file != NULL) ? new BlockCache(file, true, STATE_BLOCK_SIZE, stateBytes, 0) : NULL;
+}
+
+bool ExternalSearch::ready() const
+{
+	return states != NULL;
+}
+
+IoStatistics ExternalSearch::total() const
+{
+	IoStatistics result = graph->getStatistics();
+	if (states != NULL)
+		result.add(states->getStatistics());
+	result.add(queue.getStatistics());
+	return result;
+}
+
+ExternalSearch::NodeState ExternalSearch::readState(int node)
+{
+	NodeState state;
+	states->read((__int64)node * sizeof(NodeState), sizeof(NodeState), &state);
+	return state;
+}
+
+void ExternalSearch::writeState(int node, const NodeState & state)
+{
+	states->write((__int64)node * sizeof(NodeState), sizeof(NodeState), &state);
+}
+
+bool ExternalSearch::findPath(int start, int end, PathResult * result)
+{
+	IoStatistics before = total();
+	result->totalWeight = -1;
+	result->nodes.clear();
+	result->edges.clear();
+	if (states == NULL)
+	{
+		last = IoStatistics();
+		return false;
+	}
+	if (++stamp == 0)
+	{
+		createStates();
+		if (states == NULL)
+		{
+			last = IoStatistics();
+			return false;
+		}
+		before = total();
+		stamp = 1;
+	}
+	queue.clear();
+
+	NodeState state;
+	memset(&state, 0, sizeof(state));
+	state.parentEdge = -1;
+	state.parentNode = -1;
+	state.stamp = stamp;
+	writeState(start, state);
+	ExternalQueueItem item;
+	item.weight = 0;
+	item.hops = 0;
+	item.node = start;
+	queue.push(item);
+
+	// Алгоритм Дейкстры с теми же правилами выбора пути, что и BasicQueryContext::relax.
+	bool found = false;
+	while (queue.pop(&item))
+	{
+		NodeState current = readState(item.node);
+		if (current.settled == stamp || current.label != item.weight || current.hops != item.hops)
+			continue;
+		current.settled = stamp;
+		writeState(item.node, current);
+		if (item.node == end)
+		{
+			found = true;
+			break;
+		}
+		int first = graph->readEdges(item.node, &edges);
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			int edge = first + (int)i;
+			NodeState target = readState(edges[i].target);
+			__int64 weight = current.label + edges[i].weight;
+			int hops = current.hops + 1;
+			if (target.stamp != stamp || target.label > weight || (target.label == weight && target.hops > hops))
+			{
+				target.stamp = stamp;
+				target.label = weight;
+				target.hops = hops;
+				target.parentEdge = edge;
+				target.parentNode = item.node;
+				writeState(edges[i].target, target);
+				ExternalQueueItem next;
+				next.weight = weight;
+				next.hops = hops;
+				next.node = edges[i].target;
+				queue.push(next);
+			}
+			else if (target.label == weight && target.hops == hops && edge < target.parentEdge)
+			{
+				target.parentEdge = edge;
+				target.parentNode = item.node;
+				writeState(edges[i].target, target);
+			}
+		}
+	}
+
+	if (found)
+	{
+		result->totalWeight = readState(end).label;
+		for (int node = end; node != -1; )
+		{
+			NodeState current = readState(node);
+			result->nodes.push_back(node);
+			if (current.parentEdge != -1)
+				result->edges.push_back(current.parentEdge);
+			node = current.parentNode;
+		}
+		std::reverse(result->nodes.begin(), result->nodes.end());
+		std::reverse(result->edges.begin(), result->edges.end());
+	}
+	last = total().since(before);
+	return found;
+}
+
+const IoStatistics & ExternalSearch::lastStatistics() const
+{
+	return last;
+}
@@ -0,0 +1,269 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "blockcache.h"
+#include "staticgraph.h"
+
+/**
+ * Дуга графа во внешней памяти.
+ */
+struct ExternalEdge
+{
+	int target;			// Конечный узел.
+	__int64 weight;		// Вес.
+};
+
+/**
+ * Граф, который хранится в файле и читается через кэш блоков ограниченного размера (для графов, не помещающихся в память).
+ * Файл строится из файла графа в формате командной строки функцией convert: узлы нумеруются по возрастанию имен,
+ * дуги каждого узла лежат в файле подряд в порядке исходного файла, так что нумерация узлов и дуг совпадает со StaticGraph.
+ * Состав файла: заголовок, дуги (записи по 12 байт: конечный узел и вес), начала списков дуг узлов,
+ * начала имен узлов и сами имена. Дуги читаются с опережением (BlockCache), поэтому обход соседних узлов почти не ждет диска.
+ */
+class ExternalGraph
+{
+public:
+	// Размер записи дуги в файле.
+	static const int EDGE_RECORD_SIZE = 12;
+
+private:
+	/**
+	 * Заголовок файла.
+	 */
+	struct Header
+	{
+		char magic[8];			// Сигнатура формата.
+		__int64 nodeCount;
+		__int64 edgeCount;
+		__int64 edgesStart;		// Начало записей дуг.
+		__int64 offsetsStart;	// Начало массива из nodeCount + 1 номеров первых дуг узлов.
+		__int64 namesStart;		// Начало массива из nodeCount + 1 смещений имен.
+		__int64 textStart;		// Начало имен.
+		__int64 maxWeight;		// Наибольший вес дуги.
+		int blockSize;			// Размер блока кэша, с которым файл читается.
+		int reserved;
+	};
+
+	Header header;
+	BlockCache * cache;			// Кэш блоков файла или NULL, если файл не открыт.
+	std::vector<char> records;	// Буфер записей дуг.
+
+	ExternalGraph(const ExternalGraph &);
+	ExternalGraph & operator=(const ExternalGraph &);
+
+public:
+	ExternalGraph();
+	~ExternalGraph();
+
+	/**
+	 * Построение файла графа из файла в формате командной строки без загрузки дуг в память.
+	 * Дуги сортируются по начальным узлам внешней сортировкой: порции, помещающиеся в memoryBudget, сортируются и сбрасываются
+	 * во временные файлы, после чего сливаются. Кроме memoryBudget, в памяти остаются имена узлов (по одной копии каждого)
+	 * и номера первых дуг (8 байт на узел): граф, имена узлов которого не помещаются в память, преобразовать нельзя.
+	 * Проверяется только формат файла и неотрицательность весов, без остальных проверок Graph.
+	 * @param inputFileName - файл графа.
+	 * @param outputFileName - файл внешнего графа.
+	 * @param memoryBudget - объем памяти для сортировки дуг в байтах.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @param blockSize - размер блока для чтения файла.
+	 * @return - true, если файл построен, иначе false.
+	 */
+	static bool convert(const char * inputFileName, const char * outputFileName, size_t memoryBudget, std::string * error, int blockSize = BlockCache::DEFAULT_BLOCK_SIZE);
+
+	/**
+	 * Открытие файла графа.
+	 * @param fileName - файл, построенный convert.
+	 * @param cacheBytes - объем памяти кэша блоков.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если файл открыт, иначе false.
+	 */
+	bool open(const char * fileName, size_t cacheBytes, std::string * error);
+
+	int nodeCount() const;
+	int edgeCount() const;
+
+	/**
+	 * Наибольший вес дуги.
+	 */
+	__int64 maxWeight() const;
+
+	/**
+	 * Поиск узла по имени (двоичный поиск по именам в файле).
+	 * @return - индекс узла или -1, если узла нет в графе.
+	 */
+	int findNode(const std::string & name);
+
+	/**
+	 * Имя узла.
+	 */
+	std::string nodeName(int node);
+
+	/**
+	 * Чтение дуг узла.
+	 * @param node - индекс узла.
+	 * @param edges - указатель на вектор, в который запишутся дуги.
+	 * @return - индекс первой дуги узла; остальные идут подряд.
+	 */
+	int readEdges(int node, std::vector<ExternalEdge> * edges);
+
+	/**
+	 * Счетчики ввода-вывода файла графа.
+	 */
+	const IoStatistics & getStatistics() const;
+};
+
+/**
+ * Элемент внешней очереди с приоритетами: метка узла (длина, число дуг) и узел.
+ */
+struct ExternalQueueItem
+{
+	__int64 weight;
+	int hops;
+	int node;
+
+	bool operator>(const ExternalQueueItem & other) const;
+	bool operator<(const ExternalQueueItem & other) const;
+};
+
+/**
+ * Очередь с приоритетами, хранящая дальние элементы на диске.
+ * Элементы делятся на корзины по длине: корзина i содержит длины [i * width, (i + 1) * width). В памяти в виде кучи
+ * хранится только текущая корзина, остальные копятся в буферах; когда элементов в памяти больше предела, буферы самых дальних
+ * корзин дописываются во временный файл. Корзина читается с диска один раз - когда становится текущей.
+ * Если текущая корзина не помещается в кучу (широкий разброс весов или целый слой графа с единичными весами), куча делится
+ * пополам: большие элементы уходят в подкорзины текущей корзины, которые, как и остальные корзины, сбрасываются на диск.
+ * Добавляемые элементы не меньше последнего извлеченного (как в алгоритме Дейкстры с неотрицательными весами).
+ */
+class ExternalQueue
+{
+private:
+	/**
+	 * Корзина: элементы в памяти и участки временного файла (начало, количество элементов).
+	 */
+	struct Bucket
+	{
+		std::vector<ExternalQueueItem> buffer;
+		std::vector<std::pair<__int64, int> > chunks;
+	};
+
+	__int64 width;				// Ширина корзины.
+	size_t heapLimit;			// Наибольшее количество элементов в куче.
+	size_t bufferLimit;			// Наибольшее количество элементов в буферах корзин.
+	size_t pieceSize;			// Количество элементов, читаемых с диска за раз.
+	std::vector<ExternalQueueItem> heap;	// Начало текущей корзины: элементы, меньшие начала первой подкорзины.
+	__int64 current;			// Номер текущей корзины или -1.
+	std::map<ExternalQueueItem, Bucket> parts;	// Подкорзины текущей корзины по их наименьшим элементам.
+	std::map<__int64, Bucket> buckets;		// Следующие корзины.
+	size_t buffered;			// Количество элементов в буферах корзин и подкорзин.
+	std::vector<ExternalQueueItem> piece;	// Буфер чтения с диска.
+	FILE * spill;				// Временный файл или NULL, пока он не понадобился.
+	__int64 spillEnd;			// Конец занятой части временного файла.
+	IoStatistics statistics;
+
+	bool writeChunk(Bucket & bucket);
+	void spillFarthest();
+	void pushCurrent(const ExternalQueueItem & item);
+	void splitHeap();
+	void load(Bucket & bucket);
+
+	ExternalQueue(const ExternalQueue &);
+	ExternalQueue & operator=(const ExternalQueue &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _width - ширина корзины; разумно взять наибольший вес дуги, тогда дуга ведет не дальше следующей корзины.
+	 * @param memoryBytes - объем памяти очереди: половина на кучу, по четверти на буферы корзин и на чтение с диска.
+	 */
+	ExternalQueue(__int64 _width, size_t memoryBytes);
+	~ExternalQueue();
+
+	void clear();
+	void push(const ExternalQueueItem & item);
+
+	/**
+	 * Извлечение наименьшего элемента.
+	 * @return - false, если очередь пуста.
+	 */
+	bool pop(ExternalQueueItem * item);
+
+	/**
+	 * Счетчики ввода-вывода временного файла.
+	 */
+	const IoStatistics & getStatistics() const;
+};
+
+/**
+ * Поиск кратчайшего пути во внешнем графе с ограниченной памятью.
+ * Метки узлов хранятся во временном файле и читаются через свой кэш блоков, очередь - ExternalQueue, поэтому объем памяти
+ * поиска определяется размерами кэшей и очереди, а не размером графа. Путь выбирается по тем же правилам, что и в BasicQueryContext.
+ */
+class ExternalSearch
+{
+public:
+	// Размер блока кэша меток.
+	static const int STATE_BLOCK_SIZE = 4096;
+
+private:
+	/**
+	 * Метка узла во временном файле.
+	 */
+	struct NodeState
+	{
+		__int64 label;			// Длина пути.
+		int hops;				// Число дуг пути.
+		int parentEdge;			// Последняя дуга пути.
+		int parentNode;			// Предыдущий узел пути.
+		unsigned int stamp;		// Номер запроса, в котором узел достигнут.
+		unsigned int settled;	// Номер запроса, в котором метка стала окончательной.
+		int reserved;
+	};
+
+	ExternalGraph * graph;
+	BlockCache * states;		// Кэш временного файла меток или NULL, если файл не удалось создать.
+	size_t stateBytes;			// Объем памяти кэша меток.
+	ExternalQueue queue;
+	unsigned int stamp;			// Номер текущего запроса.
+	std::vector<ExternalEdge> edges;	// Дуги обрабатываемого узла.
+	IoStatistics last;			// Ввод-вывод последнего запроса.
+
+	IoStatistics total() const;
+	void createStates();
+	NodeState readState(int node);
+	void writeState(int node, const NodeState & state);
+
+	ExternalSearch(const ExternalSearch &);
+	ExternalSearch & operator=(const ExternalSearch &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _graph - открытый граф; должен существовать все время жизни поиска.
+	 * @param _stateBytes - объем памяти кэша меток.
+	 * @param queueBytes - объем памяти очереди.
+	 */
+	ExternalSearch(ExternalGraph * _graph, size_t _stateBytes, size_t queueBytes);
+	~ExternalSearch();
+
+	/**
+	 * Проверка готовности к поиску.
+	 * @return - false, если не удалось создать временный файл меток.
+	 */
+	bool ready() const;
+
+	/**
+	 * Поиск кратчайшего пути.
+	 * @param start - индекс начального узла.
+	 * @param end - индекс конечного узла.
+	 * @param result - указатель на результат.
+	 * @return - true, если путь найден, иначе false (в том числе если поиск не готов).
+	 */
+	bool findPath(int start, int end, PathResult * result);
+
+	/**
+	 * Ввод-вывод последнего запроса: файл графа, файл меток и временный файл очереди.
+	 */
+	const IoStatistics & lastStatistics() const;
+};
@@ -0,0 +1,62 @@
+#include "facility.h"
+#include <ctype.h>
+
+bool NearestFacility::readSources(const char * fileName, const QueryEngine & engine, std::vector<int> * sources, std::vector<__int64> * offsets, std::string * error)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл источников ") + fileName;
+		return false;
+	}
+	sources->clear();
+	offsets->clear();
+	bool shifted = false;
+	char line[512];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		// Имя узла - первое слово строки, смещение - второе.
+		char * begin = line;
+		while (*begin != '\0' && isspace((unsigned char)*begin))
+			begin++;
+		char * end = begin;
+		while (*end != '\0' && !isspace((unsigned char)*end))
+			end++;
+		if (begin == end)
+			continue;
+		std::string name(begin, end);
+		__int64 offset = 0;
+		if (sscanf_s(end, INT64_FORMAT, &offset) != 1)
+			offset = 0;
+		int node = engine.findNode(name);
+		if (node == -1 || offset < 0)
+		{
+			*error = (node == -1) ? "Источник " + name + " отсутствует в графе" : "Отрицательное смещение источника " + name;
+			fclose(file);
+			return false;
+		}
+		sources->push_back(node);
+		offsets->push_back(offset);
+		shifted = shifted || offset != 0;
+	}
+	fclose(file);
+	// Без смещений поиск может использовать обходы в ширину.
+	if (!shifted)
+		offsets->clear();
+	return true;
+}
+
+bool NearestFacility::writeAssignment(const char * fileName, const QueryEngine & engine, const std::vector<int> & sources, const std::vector<__int64> & labels, const std::vector<int> & nearest, const std::vector<int> & parents)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "w"))
+		return false;
+	for (int node = 0; node < engine.nodeCount(); node++)
+	{
+		const char * source = (nearest[node] != -1) ? engine.nodeName(sources[nearest[node]]).c_str() : "-";
+		const char * parent = (parents[node] != -1) ? engine.nodeName(parents[node]).c_str() : "-";
+		fprintf_s(file, "%s %s " INT64_FORMAT " %s\n", engine.nodeName(node).c_str(), source, labels[node], parent);
+	}
+	fclose(file);
+	return true;
+}
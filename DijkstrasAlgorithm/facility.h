@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "queryengine.h"
+
+/**
+ * Файлы поиска ближайших источников (депо, складов и т.п.).
+ * Файл источников: в каждой строке имя узла и необязательное неотрицательное смещение - расстояние, которое добавляется
+ * ко всем путям от этого источника (например, время подготовки на складе). Пустые строки пропускаются.
+ * Файл разбиения: для каждого узла строка "узел источник расстояние предыдущий_узел"; для недостижимых узлов
+ * и отсутствующего предыдущего узла пишется "-", расстояние тогда равно -1.
+ */
+class NearestFacility
+{
+public:
+	/**
+	 * Чтение источников.
+	 * @param fileName - имя файла источников.
+	 * @param engine - граф, в котором ищутся узлы.
+	 * @param sources - указатель на вектор, в который запишутся индексы узлов-источников.
+	 * @param offsets - указатель на вектор, в который запишутся смещения (пустой, если все смещения нулевые).
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если файл прочитан и все узлы найдены, иначе false.
+	 */
+	static bool readSources(const char * fileName, const QueryEngine & engine, std::vector<int> * sources, std::vector<__int64> * offsets, std::string * error);
+
+	/**
+	 * Запись разбиения графа между источниками (см. EngineContext::computeNearest).
+	 * @param fileName - имя файла разбиения.
+	 * @param engine - граф.
+	 * @param sources - источники.
+	 * @param labels - расстояния от ближайших источников.
+	 * @param nearest - номера ближайших источников в списке sources.
+	 * @param parents - предыдущие узлы путей.
+	 * @return - true, если файл записан, иначе false.
+	 */
+	static bool writeAssignment(const char * fileName, const QueryEngine & engine, const std::vector<int> & sources, const std::vector<__int64> & labels, const std::vector<int> & nearest, const std::vector<int> & parents);
+};
@@ -1,4 +1,8 @@
 #include "graph.h"
+#include "graphpatch.h"
+#include <queue>
+#include <functional>
+#include <algorithm>
 
 FileListItem::FileListItem()
 {
@@ -60,6 +64,17 @@ Node::~Node()
 
 /*----------------------------------------------------------------------------------------------------*/
 
+#ifndef _MSC_VER
+// Вне MSVC статические константы, передаваемые по ссылке, должны быть определены в единице трансляции.
+const int Graph::ERROR_NOT_EXISTS;
+const int Graph::ERROR_NEGATIVE_WEIGHT;
+const int Graph::ERROR_LOOP_EXISTS;
+const int Graph::ERROR_WRONG_PATH_BORDERS;
+const int Graph::ERROR_COULD_NOT_OPEN_FILE;
+const int Graph::ERROR_EDGE_NOT_EXISTS;
+const int Graph::ERROR_NEGATIVE_CYCLE;
+#endif
+
 Graph::Graph()
 {
 	startNode = NULL;
@@ -100,6 +115,11 @@ void Graph::build(std::vector<FileListItem> edges)
 }
 
 void Graph::validate(std::vector<FileListItem> edges, const std::string start, const std::string end)
+{
+	checkEdges(edges, start, end, false, &errors);
+}
+
+void Graph::checkEdges(const std::vector<FileListItem> & edges, const std::string & start, const std::string & end, const bool negativeWeights, std::vector<int> * edgeErrors)
 {
 	bool negativeWeight = false;
 	bool loopExists = false;
@@ -121,64 +141,280 @@ void Graph::validate(std::vector<FileListItem> edges, const std::string start, c
 	}
 
 	// Заполняем вектор ошибок.
-	errors.clear();
-	if (negativeWeight)
-		errors.push_back(Graph::ERROR_NEGATIVE_WEIGHT);
+	edgeErrors->clear();
+	if (negativeWeight && !negativeWeights)
+		edgeErrors->push_back(Graph::ERROR_NEGATIVE_WEIGHT);
 	if (loopExists)
-		errors.push_back(Graph::ERROR_LOOP_EXISTS);
+		edgeErrors->push_back(Graph::ERROR_LOOP_EXISTS);
 	if (!startExists || !endExists)
-		errors.push_back(Graph::ERROR_WRONG_PATH_BORDERS);
+		edgeErrors->push_back(Graph::ERROR_WRONG_PATH_BORDERS);
 }
 
 bool Graph::readFromFile(const char * fileName)
 {
-	__int64 m = 0;				// Число дуг в графе.
-	char buf1[256] = "";		// Буфер для чтения строк.
-	char buf2[256] = "";		// Буфер для чтения строк.
 	std::string pathStart = "";	// Начальная вершина маршрута.
 	std::string pathEnd = "";	// Конечная вершина маршрута.
-
-	FILE * file;
-	if (fopen_s(&file, fileName, "r"))
+	std::vector<FileListItem> edges;
+	if (!readEdges(fileName, &edges, &pathStart, &pathEnd))
 	{
 		errors.clear();
 		errors.push_back(Graph::ERROR_COULD_NOT_OPEN_FILE);
 		return false;
 	}
 
+	// Проверяем считанные данные и строим граф, если все нормально.
+	load(edges, pathStart, pathEnd);
+	return true;
+}
+
+bool Graph::readEdges(const char * fileName, std::vector<FileListItem> * edges, std::string * start, std::string * end)
+{
+	__int64 m = 0;				// Число дуг в графе.
+	char buf1[256] = "";		// Буфер для чтения строк.
+	char buf2[256] = "";		// Буфер для чтения строк.
+
+	FILE * file;
+	if (fopen_s(&file, fileName, "r"))
+		return false;
+
 	// Читаем количество дуг, имена начального и конечного узлов маршрута.
-	fscanf_s(file, "%I64d", &m);
+	fscanf_s(file, INT64_FORMAT, &m);
 	fscanf_s(file, "%s", buf1);
 	fscanf_s(file, "%s", buf2);
-	pathStart = buf1;
-	pathEnd = buf2;
+	*start = buf1;
+	*end = buf2;
 
 	// Оставшаяся часть файла - информация о дугах.
-	std::vector<FileListItem> edges;
+	edges->clear();
 	for (__int64 i = 0; i < m; i++)
 	{
 		__int64 edgeWeight = 0;
 		fscanf_s(file, "%s", buf1);
 		fscanf_s(file, "%s", buf2);
-		fscanf_s(file, "%I64d", &edgeWeight);
-		edges.push_back(FileListItem(buf1, buf2, edgeWeight));
+		fscanf_s(file, INT64_FORMAT, &edgeWeight);
+		edges->push_back(FileListItem(buf1, buf2, edgeWeight));
 	}
 	fclose(file);
+	return true;
+}
 
-	// Проверяем считанные данные и строим граф, если все нормально.
-	validate(edges, pathStart, pathEnd);
+bool Graph::load(const std::vector<FileListItem> & edges, const std::string start, const std::string end)
+{
+	validate(edges, start, end);
 	if (errors.empty())
 	{
 		build(edges);
-		startNode = nodes.find(pathStart)->second;
-		endNode = nodes.find(pathEnd)->second;
+		startNode = nodes.find(start)->second;
+		endNode = nodes.find(end)->second;
 	}
 	else
 	{
 		startNode = NULL;
 		endNode = NULL;
 	}
-	return true;
+	return errors.empty();
+}
+
+/**
+ * Отмена одного изменения пакета.
+ */
+struct PatchUndo
+{
+	int type;			// Вид изменения (GraphPatch::OPERATION_*); для узлов, добавленных вместе с дугой, - OPERATION_ADD_VERTEX.
+	Node * node;		// Добавленный узел или начало дуги.
+	Edge * edge;		// Удаленная или измененная дуга.
+	size_t position;	// Положение удаленной дуги в списке дуг узла.
+	__int64 weight;		// Прежний вес измененной дуги.
+
+	PatchUndo(const int _type, Node * _node, Edge * _edge, const size_t _position, const __int64 _weight)
+	{
+		type = _type;
+		node = _node;
+		edge = _edge;
+		position = _position;
+		weight = _weight;
+	}
+};
+
+bool Graph::patch(const GraphPatch & graphPatch, const bool keep, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights)
+{
+	patchErrors->clear();
+	if (!errors.empty())
+	{
+		*patchErrors = errors;
+		return false;
+	}
+	const std::vector<PatchOperation> & operations = graphPatch.getOperations();
+	std::vector<PatchUndo> undo;
+	std::vector<__int64> weights(operations.size(), -1);
+	for (size_t i = 0; i < operations.size() && patchErrors->empty(); i++)
+	{
+		const PatchOperation & operation = operations[i];
+		if (operation.type == GraphPatch::OPERATION_ADD_EDGE || operation.type == GraphPatch::OPERATION_SET_WEIGHT)
+		{
+			if (operation.weight < 0)
+				patchErrors->push_back(Graph::ERROR_NEGATIVE_WEIGHT);
+			if (operation.from == operation.to)
+				patchErrors->push_back(Graph::ERROR_LOOP_EXISTS);
+			if (!patchErrors->empty())
+				break;
+		}
+
+		if (operation.type == GraphPatch::OPERATION_ADD_VERTEX || operation.type == GraphPatch::OPERATION_ADD_EDGE)
+		{
+			// Добавляем узлы, если их еще нет в графе.
+			Node * endpoints[2] = { NULL, NULL };
+			int endpointCount = (operation.type == GraphPatch::OPERATION_ADD_EDGE) ? 2 : 1;
+			for (int k = 0; k < endpointCount; k++)
+			{
+				const std::string & name = (k == 0) ? operation.from : operation.to;
+				std::map<std::string, Node *>::const_iterator iter = nodes.find(name);
+				if (iter != nodes.end())
+				{
+					endpoints[k] = iter->second;
+					continue;
+				}
+				endpoints[k] = new Node(name);
+				nodes.insert(std::pair<std::string, Node *>(name, endpoints[k]));
+				undo.push_back(PatchUndo(GraphPatch::OPERATION_ADD_VERTEX, endpoints[k], NULL, 0, 0));
+			}
+			if (operation.type == GraphPatch::OPERATION_ADD_EDGE)
+			{
+				endpoints[0]->edges.push_back(new Edge(endpoints[0], endpoints[1], operation.weight));
+				undo.push_back(PatchUndo(GraphPatch::OPERATION_ADD_EDGE, endpoints[0], NULL, 0, 0));
+			}
+			continue;
+		}
+
+		// Удаление и изменение веса относятся к первой дуге между узлами.
+		std::map<std::string, Node *>::const_iterator from = nodes.find(operation.from);
+		size_t position = 0;
+		if (from != nodes.end())
+			while (position < from->second->edges.size() && from->second->edges[position]->to->name != operation.to)
+				position++;
+		if (from == nodes.end() || position == from->second->edges.size())
+		{
+			patchErrors->push_back(Graph::ERROR_EDGE_NOT_EXISTS);
+			break;
+		}
+		Node * node = from->second;
+		Edge * edge = node->edges[position];
+		weights[i] = edge->weight;
+		if (operation.type == GraphPatch::OPERATION_REMOVE_EDGE)
+			node->edges.erase(node->edges.begin() + position);
+		else
+			edge->weight = operation.weight;
+		undo.push_back(PatchUndo(operation.type, node, edge, position, weights[i]));
+	}
+
+	bool rollback = !patchErrors->empty() || !keep;
+	for (size_t i = undo.size(); i-- > 0;)
+	{
+		const PatchUndo & step = undo[i];
+		if (!rollback)
+		{
+			// Удаленные дуги освобождаются только после успешного применения всего пакета.
+			if (step.type == GraphPatch::OPERATION_REMOVE_EDGE)
+				delete step.edge;
+			continue;
+		}
+		switch (step.type)
+		{
+		case GraphPatch::OPERATION_ADD_VERTEX:
+			nodes.erase(step.node->name);
+			delete step.node;
+			break;
+		case GraphPatch::OPERATION_ADD_EDGE:
+			delete step.node->edges.back();
+			step.node->edges.pop_back();
+			break;
+		case GraphPatch::OPERATION_REMOVE_EDGE:
+			step.node->edges.insert(step.node->edges.begin() + step.position, step.edge);
+			break;
+		case GraphPatch::OPERATION_SET_WEIGHT:
+			step.edge->weight = step.weight;
+			break;
+		}
+	}
+	if (previousWeights != NULL && patchErrors->empty())
+		*previousWeights = weights;
+	return patchErrors->empty();
+}
+
+bool Graph::applyPatch(const GraphPatch & graphPatch, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights)
+{
+	return patch(graphPatch, true, patchErrors, previousWeights);
+}
+
+bool Graph::checkPatch(const GraphPatch & graphPatch, std::vector<int> * patchErrors)
+{
+	return patch(graphPatch, false, patchErrors, NULL);
+}
+
+const std::map<std::string, Node *> & Graph::getNodes() const
+{
+	return nodes;
+}
+
+const Node * Graph::getStartNode() const
+{
+	return startNode;
+}
+
+const Node * Graph::getEndNode() const
+{
+	return endNode;
+}
+
+const Node * Graph::findNode(const std::string & name) const
+{
+	std::map<std::string, Node *>::const_iterator iter = nodes.find(name);
+	return (iter != nodes.end()) ? iter->second : NULL;
+}
+
+ExecutionState Graph::findPath(const Node * start, const Node * end) const
+{
+	typedef std::pair<__int64, const Node *> QueueItem;	// Метка узла и сам узел.
+	std::map<const Node *, __int64> labels;				// Текущие метки достигнутых узлов.
+	std::map<const Node *, Edge *> incoming;			// Последняя дуга кратчайшего пути до узла.
+	std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem> > queue;
+
+	// Все состояние поиска локально, поэтому граф только читается.
+	labels[start] = 0;
+	queue.push(QueueItem(0, start));
+	while (!queue.empty())
+	{
+		QueueItem current = queue.top();
+		queue.pop();
+		// Устаревшие элементы очереди пропускаются.
+		if (current.first != labels[current.second])
+			continue;
+		if (current.second == end)
+			break;
+		const std::vector<Edge *> & edges = current.second->edges;
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			__int64 weight = current.first + edges[i]->weight;
+			std::map<const Node *, __int64>::iterator label = labels.find(edges[i]->to);
+			if (label == labels.end() || label->second > weight)
+			{
+				labels[edges[i]->to] = weight;
+				incoming[edges[i]->to] = edges[i];
+				queue.push(QueueItem(weight, edges[i]->to));
+			}
+		}
+	}
+
+	// Восстанавливаем путь от конечной вершины к начальной.
+	ExecutionState result(end);
+	std::map<const Node *, __int64>::const_iterator label = labels.find(end);
+	if (label == labels.end())
+		return result;
+	result.totalWeight = label->second;
+	for (const Node * node = end; node != start; node = incoming[node]->from)
+		result.path.push_back(incoming[node]);
+	std::reverse(result.path.begin(), result.path.end());
+	return result;
 }
 
 bool Graph::error_exists()
@@ -205,12 +441,26 @@ char * Graph::getErrorString(const int errorCode)
 		return "Начальная или конечная вершина не существует в графе";
 	case ERROR_COULD_NOT_OPEN_FILE:
 		return "Не удалось открыть файл";
+	case ERROR_EDGE_NOT_EXISTS:
+		return "Изменяемая дуга не существует в графе";
+	case ERROR_NEGATIVE_CYCLE:
+		return "Найден цикл отрицательной длины";
 	default:
 		return "Неизвестная ошибка";
 	}
 }
 
 ExecutionState Graph::run(const char * fileNamePrefix, std::vector<std::string> * dotFilesGenerated)
+{
+	return execute(fileNamePrefix, dotFilesGenerated, NULL, NULL);
+}
+
+ExecutionState Graph::run(std::vector<ExecutionStep> * steps, ExecutionControl * control)
+{
+	return execute(NULL, NULL, steps, control);
+}
+
+ExecutionState Graph::execute(const char * fileNamePrefix, std::vector<std::string> * dotFilesGenerated, std::vector<ExecutionStep> * steps, ExecutionControl * control)
 {
 	int stepCount = 0;								// Счетчик сгенерированных картинок.
 	std::map<std::string, ExecutionState *> states;	// Каждому узлу в графе ставится в соответствие объект ExecutionState.
@@ -225,14 +475,30 @@ ExecutionState Graph::run(const char * fileNamePrefix, std::vector<std::string>
 		states.insert(std::pair<std::string, ExecutionState *>(newState->node->name, newState));
 	}
 	startState->totalWeight = 0;
+	if (control != NULL)
+	{
+		control->passedCount = 0;
+		control->nodeCount = (long)states.size();
+	}
 
 	// Генерируем файл в начале выполнения алгоритма.
-	dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, NULL));
+	if (dotFilesGenerated != NULL)
+		dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, NULL));
+	if (steps != NULL)
+		steps->push_back(ExecutionStep(NULL, startNode, 0, NULL));
 
 	// Выполняем алгоритм.
 	ExecutionState * currentState = startState;	// Вершина с минимальной меткой.
 	while (currentState != NULL)
 	{
+		// Прерываем выполнение, если запрошена отмена.
+		if (control != NULL && control->cancelled)
+		{
+			for (std::map<std::string, ExecutionState *>::const_iterator iter = states.cbegin(); iter != states.cend(); iter++)
+				delete iter->second;
+			return ExecutionState();
+		}
+
 		// Просматриваем всех соседей текущей вершины.
 		for (size_t i = 0; i < currentState->node->edges.size(); i++)
 		{
@@ -240,19 +506,26 @@ ExecutionState Graph::run(const char * fileNamePrefix, std::vector<std::string>
 			ExecutionState * destState = states[edge->to->name];	// Cостояние, соответствующее конечной вершине ребра.
 
 			// Перезаписываем путь до конечной вершины текущей дуги.
+			bool changed = false;
 			if (currentState->totalWeight != -1 && (destState->totalWeight == -1 || destState->totalWeight > currentState->totalWeight + edge->weight))
 			{
 				destState->path = currentState->path;
 				destState->path.push_back(edge);
 				destState->totalWeight = currentState->totalWeight + edge->weight;
+				changed = true;
 			}
 
 			// Генерируем файл в середине выполнения алгоритма.
-			dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, edge));
-
+			if (dotFilesGenerated != NULL)
+				dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, edge));
+			if (steps != NULL)
+				steps->push_back(ExecutionStep(edge, changed ? destState->node : NULL, destState->totalWeight, NULL));
 		}
 		// Помечаем вершину как пройденную и выбираем новую вершину с минимальной меткой.
 		currentState->passed = true;
+		const Node * passedNode = currentState->node;
+		if (control != NULL)
+			control->passedCount++;
 		currentState = NULL;
 		for (std::map<std::string, ExecutionState *>::const_iterator iter = states.cbegin(); iter != states.cend(); iter++)
 		{
@@ -267,7 +540,10 @@ ExecutionState Graph::run(const char * fileNamePrefix, std::vector<std::string>
 			}
 		}
 		// Генерируем файл после прохождения очередной вершины.
-		dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, NULL));
+		if (dotFilesGenerated != NULL)
+			dotFilesGenerated->push_back(generateDotCodeForStep(fileNamePrefix, &stepCount, &states, NULL));
+		if (steps != NULL)
+			steps->push_back(ExecutionStep(NULL, NULL, -1, passedNode));
 	}
 
 	// Формируем результат.
@@ -277,7 +553,7 @@ ExecutionState Graph::run(const char * fileNamePrefix, std::vector<std::string>
 			result = *iter->second;
 
 	// Генерируем файл, в котором отображается оптимальный путь.
-	if (result.path.size() > 0)
+	if (dotFilesGenerated != NULL && result.path.size() > 0)
 		dotFilesGenerated->push_back(generateDotCodeForResult(fileNamePrefix, &stepCount, &states, &result));
 
 	//  Очищаем выделенную память.
@@ -302,7 +578,7 @@ std::string Graph::generateDotCodeForStep(const char * fileNamePrefix, int * ste
 	for (std::map<std::string, ExecutionState *>::const_iterator iter = states->cbegin(); iter != states->cend(); iter++)
 	{
 		ExecutionState * state = iter->second;
-		sprintf_s(tmp, 256, "\"%s\\n len=%I64d\"", state->node->name.c_str(), state->totalWeight);
+		sprintf_s(tmp, 256, "\"%s\\n len=" INT64_FORMAT "\"", state->node->name.c_str(), state->totalWeight);
 		nodestrings.insert(std::pair<std::string, std::string>(state->node->name.c_str(), std::string(tmp)));
 
 		// Записываем узел в файл, выделяя пройденное состояние пунктиром.
@@ -322,11 +598,11 @@ std::string Graph::generateDotCodeForStep(const char * fileNamePrefix, int * ste
 			std::string wr = nodestrings.find(edges[j]->from->name)->second + " -> " + nodestrings.find(edges[j]->to->name)->second;
 
 			if (edges[j] == currentEdge)
-				sprintf_s(tmp, 256, "[label=\"%I64d\", color=red];", edges[j]->weight);		// Выделяем текущую дугу красным цветом.
+				sprintf_s(tmp, 256, "[label=\"" INT64_FORMAT "\", color=red];", edges[j]->weight);		// Выделяем текущую дугу красным цветом.
 			else if (states->find(edges[j]->from->name)->second->passed)
-				sprintf_s(tmp, 256, "[label=\"%I64d\", color=blue];", edges[j]->weight);	// Выделяем пройденную дугу синим цветом.
+				sprintf_s(tmp, 256, "[label=\"" INT64_FORMAT "\", color=blue];", edges[j]->weight);	// Выделяем пройденную дугу синим цветом.
 			else
-				sprintf_s(tmp, 256, "[label=\"%I64d\"];", edges[j]->weight);				// Остальные дуги никак не выделяем.
+				sprintf_s(tmp, 256, "[label=\"" INT64_FORMAT "\"];", edges[j]->weight);				// Остальные дуги никак не выделяем.
 
 			wr.append(tmp);
 			fprintf_s(file, "%s\n", wr.c_str());
@@ -352,7 +628,7 @@ std::string Graph::generateDotCodeForResult(const char * fileNamePrefix, int * s
 	for (std::map<std::string, ExecutionState *>::const_iterator iter = states->cbegin(); iter != states->cend(); iter++)
 	{
 		ExecutionState * state = iter->second;
-		sprintf_s(tmp, 256, "\"%s\\n len=%I64d\"", state->node->name.c_str(), state->totalWeight);
+		sprintf_s(tmp, 256, "\"%s\\n len=" INT64_FORMAT "\"", state->node->name.c_str(), state->totalWeight);
 		nodestrings.insert(std::pair<std::string, std::string>(state->node->name.c_str(), std::string(tmp)));
 
 		// Записываем узел в файл.
@@ -376,9 +652,9 @@ std::string Graph::generateDotCodeForResult(const char * fileNamePrefix, int * s
 					belongsToResult = true;
 
 			if (belongsToResult)
-				sprintf_s(tmp, 256, "[label=\"%I64d\", color=magenta];", edges[j]->weight);	// Выделяем дугу, принадлежащую пути, зеленым цветом.
+				sprintf_s(tmp, 256, "[label=\"" INT64_FORMAT "\", color=magenta];", edges[j]->weight);	// Выделяем дугу, принадлежащую пути, зеленым цветом.
 			else
-				sprintf_s(tmp, 256, "[label=\"%I64d\"];", edges[j]->weight);
+				sprintf_s(tmp, 256, "[label=\"" INT64_FORMAT "\"];", edges[j]->weight);
 
 			wr.append(tmp);
 			fprintf_s(file, "%s\n", wr.c_str());
@@ -402,4 +678,31 @@ ExecutionState::ExecutionState(const Node * _node)
 	node = const_cast<Node *>(_node);
 	totalWeight = -1;
 	passed = false;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ExecutionStep::ExecutionStep()
+{
+	currentEdge = NULL;
+	changedNode = NULL;
+	totalWeight = -1;
+	passedNode = NULL;
+}
+
+ExecutionStep::ExecutionStep(const Edge * _currentEdge, const Node * _changedNode, const __int64 _totalWeight, const Node * _passedNode)
+{
+	currentEdge = _currentEdge;
+	changedNode = _changedNode;
+	totalWeight = _totalWeight;
+	passedNode = _passedNode;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ExecutionControl::ExecutionControl()
+{
+	cancelled = false;
+	passedCount = 0;
+	nodeCount = 0;
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <map>
 #include <vector>
 #include <string>
+#include "platform.h"
 
 struct Node;
+class GraphPatch;
 
 /**
  * Элемент списка из файла.
@@ -62,6 +64,34 @@ struct ExecutionState
 	ExecutionState(const Node * _node);
 };
 
+/**
+ * Шаг выполнения алгоритма.
+ * Хранит только изменения относительно предыдущего шага, поэтому состояние графа на любом шаге восстанавливается последовательным применением шагов с начала.
+ */
+struct ExecutionStep
+{
+	const Edge * currentEdge;	// Просматриваемая на этом шаге дуга (NULL, если дуга не просматривается).
+	const Node * changedNode;	// Узел, метка которого изменилась на этом шаге (NULL, если метки не менялись).
+	__int64 totalWeight;		// Новое значение метки узла changedNode.
+	const Node * passedNode;	// Узел, помеченный на этом шаге как пройденный (NULL, если таких нет).
+
+	ExecutionStep();
+	ExecutionStep(const Edge * _currentEdge, const Node * _changedNode, const __int64 _totalWeight, const Node * _passedNode);
+};
+
+/**
+ * Управление выполнением алгоритма из другого потока.
+ * Поток, выполняющий алгоритм, периодически обновляет прогресс и проверяет, не запрошена ли отмена.
+ */
+struct ExecutionControl
+{
+	volatile bool cancelled;		// Запрошена ли отмена выполнения.
+	volatile long passedCount;		// Количество пройденных вершин.
+	volatile long nodeCount;		// Общее количество вершин.
+
+	ExecutionControl();
+};
+
 /**
  * Граф.
  */
@@ -77,12 +107,6 @@ private:
 	friend class TestSuite;
 #endif
 
-	/**
-	 * Строит граф из считанных из файла данных.
-	 * @param edges - вектор объектов FileListItem.
-	 */
-	void build(std::vector<FileListItem> edges);
-
 	/**
 	 * Проверяет считанные данные на удовлетворение ограничениям: неотрицательный вес дуг и отсутствие петель.
 	 * Соответствующим образом заполняется поле errors.
@@ -92,6 +116,22 @@ private:
 	 */
 	void validate(std::vector<FileListItem> edges, const std::string start, const std::string end);
 
+	/**
+	 * Выполнение алгоритма Дейкстры с сохранением шагов в виде dot-файлов и/или в памяти.
+	 * @param fileNamePrefix - префикс для имен генерируемых файлов, включая полный путь до них.
+	 * @param dotFilesGenerated - указатель на вектор, в который запишутся имена сгенерированных файлов, или NULL, если файлы генерировать не нужно.
+	 * @param steps - указатель на вектор, в который запишутся шаги алгоритма, или NULL, если шаги сохранять не нужно.
+	 * @param control - указатель на объект управления выполнением или NULL.
+	 * @return - объект ExecutionState, содержащий вектор последовательных переходов из вершины start в вершину end и суммарную длину пути.
+	 */
+	ExecutionState execute(const char * fileNamePrefix, std::vector<std::string> * dotFilesGenerated, std::vector<ExecutionStep> * steps, ExecutionControl * control);
+
+	/**
+	 * Применение пакета изменений с откатом при первой ошибке (см. applyPatch).
+	 * @param keep - оставить ли изменения при успехе; false только проверяет пакет.
+	 */
+	bool patch(const GraphPatch & graphPatch, const bool keep, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights);
+
 public:
 	// Считанный граф удовлетворяет условиям.
 	static const int ERROR_NOT_EXISTS = 0;
@@ -103,6 +143,10 @@ public:
 	static const int ERROR_WRONG_PATH_BORDERS = 3;
 	// Не удалось открыть файл.
 	static const int ERROR_COULD_NOT_OPEN_FILE = 4;
+	// Изменяемая пакетом дуга не существует.
+	static const int ERROR_EDGE_NOT_EXISTS = 5;
+	// В графе с отрицательными весами есть цикл отрицательной длины (см. BasicStaticGraph::reweight).
+	static const int ERROR_NEGATIVE_CYCLE = 6;
 
 	/**
 	 * Конструктор по умолчанию.
@@ -127,6 +171,79 @@ public:
 	 */
 	bool readFromFile(const char * fileName);
 
+	/**
+	 * Считывает список дуг и границы маршрута из файла без проверки ограничений.
+	 * @param fileName - имя файла, с которого считывать.
+	 * @param edges - указатель на вектор, в который запишутся дуги.
+	 * @param start - указатель на строку, в которую запишется начальная вершина маршрута.
+	 * @param end - указатель на строку, в которую запишется конечная вершина маршрута.
+	 * @return - true, если файл открыт, иначе false.
+	 */
+	static bool readEdges(const char * fileName, std::vector<FileListItem> * edges, std::string * start, std::string * end);
+
+	/**
+	 * Проверка списка дуг на ограничения графа: неотрицательный вес дуг, отсутствие петель и существование границ маршрута.
+	 * @param edges - вектор объектов FileListItem.
+	 * @param start - начальная вершина маршрута.
+	 * @param end - конечная вершина маршрута.
+	 * @param negativeWeights - допускаются ли дуги с отрицательным весом (граф для запросов, см. BasicStaticGraph::reweight).
+	 * @param edgeErrors - указатель на вектор, в который запишутся коды ошибок (пустой, если ограничения выполнены).
+	 */
+	static void checkEdges(const std::vector<FileListItem> & edges, const std::string & start, const std::string & end, const bool negativeWeights, std::vector<int> * edgeErrors);
+
+	/**
+	 * Загружает граф из уже разобранного списка дуг: проверяет ограничения и строит граф, если ошибок нет.
+	 * @param edges - вектор объектов FileListItem.
+	 * @param start - начальная вершина маршрута.
+	 * @param end - конечная вершина маршрута.
+	 * @return - true, если граф удовлетворяет условиям и построен, иначе false.
+	 */
+	bool load(const std::vector<FileListItem> & edges, const std::string start, const std::string end);
+
+	/**
+	 * Строит граф из считанных данных без проверки ограничений и без задания маршрута.
+	 * @param edges - вектор объектов FileListItem.
+	 */
+	void build(std::vector<FileListItem> edges);
+
+	/**
+	 * Применение пакета изменений (GraphPatch) за время, пропорциональное размеру пакета и степеням затронутых узлов.
+	 * Проверяются только затронутые дуги: добавляемые и новые веса - на ERROR_NEGATIVE_WEIGHT и ERROR_LOOP_EXISTS,
+	 * удаляемые и изменяемые - на ERROR_EDGE_NOT_EXISTS. Узлы пакетами не удаляются, поэтому границы маршрута остаются верными.
+	 * Пакет применяется целиком: при ошибке уже сделанные изменения отменяются, и граф остается прежним.
+	 * @param graphPatch - пакет.
+	 * @param patchErrors - указатель на вектор, в который запишутся коды ошибок пакета (пустой при успехе); для графа с ошибками - его ошибки.
+	 * @param previousWeights - указатель на вектор, в который запишутся прежние веса удаленных и измененных дуг (-1 для остальных изменений), или NULL.
+	 * @return - true, если пакет применен, иначе false.
+	 */
+	bool applyPatch(const GraphPatch & graphPatch, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights = NULL);
+
+	/**
+	 * Проверка пакета изменений без изменения графа (пакет применяется и сразу откатывается).
+	 * @param graphPatch - пакет.
+	 * @param patchErrors - указатель на вектор, в который запишутся коды ошибок пакета.
+	 * @return - true, если пакет применим, иначе false.
+	 */
+	bool checkPatch(const GraphPatch & graphPatch, std::vector<int> * patchErrors);
+
+	/**
+	 * Получение узлов графа.
+	 * @return - узлы графа, упорядоченные по имени.
+	 */
+	const std::map<std::string, Node *> & getNodes() const;
+
+	/**
+	 * Получение начальной вершины маршрута.
+	 * @return - указатель на узел или NULL, если маршрут не задан.
+	 */
+	const Node * getStartNode() const;
+
+	/**
+	 * Получение конечной вершины маршрута.
+	 * @return - указатель на узел или NULL, если маршрут не задан.
+	 */
+	const Node * getEndNode() const;
+
 	/**
 	 * Удовлетворяет ли граф условиям?
 	 * @return - true, если удовлетворяет, иначе false.
@@ -154,6 +271,30 @@ public:
 	 */
 	ExecutionState run(const char * fileNamePrefix, std::vector<std::string> * dotFilesGenerated);
 
+	/**
+	 * Выполнение алгоритма Дейкстры без генерации файлов: шаги сохраняются в памяти.
+	 * @param steps - указатель на вектор, в который запишутся шаги алгоритма.
+	 * @param control - указатель на объект управления выполнением или NULL. При отмене выполнение прекращается и возвращается пустой результат.
+	 * @return - объект ExecutionState, содержащий вектор последовательных переходов из вершины start в вершину end и суммарную длину пути.
+	 */
+	ExecutionState run(std::vector<ExecutionStep> * steps, ExecutionControl * control = NULL);
+
+	/**
+	 * Поиск кратчайшего пути между произвольными вершинами без генерации файлов и сохранения шагов.
+	 * Метод не изменяет граф, поэтому может одновременно вызываться из нескольких потоков.
+	 * @param start - начальная вершина маршрута.
+	 * @param end - конечная вершина маршрута.
+	 * @return - объект ExecutionState с путем и его длиной; если пути нет, длина равна -1, а путь пуст. Для start == end длина равна 0.
+	 */
+	ExecutionState findPath(const Node * start, const Node * end) const;
+
+	/**
+	 * Поиск узла по имени.
+	 * @param name - имя узла.
+	 * @return - указатель на узел или NULL, если узла нет в графе.
+	 */
+	const Node * findNode(const std::string & name) const;
+
 	/**
 	 * Генерация файла с описанием графа (на каком-то шаге алгоритма) на языке dot.
 	 * Пройденные вершины обозначаются пунктиром, непройденные - сплошной линией.
@@ -164,7 +305,7 @@ public:
 	 * @param currentEdge - текущая дуга графа.
 	 * @return - имя сгенерированного файла.
 	 */
-	std::string Graph::generateDotCodeForStep(const char * fileNamePrefix, int * stepCount, const std::map<std::string, ExecutionState *> * states, const Edge * currentEdge);
+	std::string generateDotCodeForStep(const char * fileNamePrefix, int * stepCount, const std::map<std::string, ExecutionState *> * states, const Edge * currentEdge);
 
 	/**
 	 * Генерация файла с описанием графа (для найденного результата) на языке dot.
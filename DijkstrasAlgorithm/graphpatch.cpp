@@ -0,0 +1,272 @@
+#include "graphpatch.h"
+#include <string.h>
+#include <sstream>
+
+PatchOperation::PatchOperation()
+{
+	type = GraphPatch::OPERATION_ADD_VERTEX;
+	weight = 0;
+}
+
+PatchOperation::PatchOperation(const int _type, const std::string & _from, const std::string & _to, const __int64 _weight)
+{
+	type = _type;
+	from = _from;
+	to = _to;
+	weight = _weight;
+}
+
+bool PatchOperation::operator==(const PatchOperation & other) const
+{
+	return (type == other.type && from == other.from && to == other.to && weight == other.weight);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+#ifndef _MSC_VER
+const int GraphPatch::OPERATION_ADD_EDGE;
+const int GraphPatch::OPERATION_REMOVE_EDGE;
+const int GraphPatch::OPERATION_SET_WEIGHT;
+const int GraphPatch::OPERATION_ADD_VERTEX;
+#endif
+
+void GraphPatch::addEdge(const std::string & from, const std::string & to, const __int64 weight)
+{
+	operations.push_back(PatchOperation(OPERATION_ADD_EDGE, from, to, weight));
+}
+
+void GraphPatch::removeEdge(const std::string & from, const std::string & to)
+{
+	operations.push_back(PatchOperation(OPERATION_REMOVE_EDGE, from, to, 0));
+}
+
+void GraphPatch::setWeight(const std::string & from, const std::string & to, const __int64 weight)
+{
+	operations.push_back(PatchOperation(OPERATION_SET_WEIGHT, from, to, weight));
+}
+
+void GraphPatch::addVertex(const std::string & name)
+{
+	operations.push_back(PatchOperation(OPERATION_ADD_VERTEX, name, "", 0));
+}
+
+void GraphPatch::clear()
+{
+	operations.clear();
+}
+
+const std::vector<PatchOperation> & GraphPatch::getOperations() const
+{
+	return operations;
+}
+
+bool GraphPatch::parseLine(const std::string & line)
+{
+	std::istringstream input(line);
+	std::vector<std::string> tokens;
+	std::string token;
+	while (input >> token)
+		tokens.push_back(token);
+	if (tokens.empty())
+		return true;
+
+	__int64 weight = 0;
+	if (tokens[0] == "v" && tokens.size() == 2)
+		addVertex(tokens[1]);
+	else if (tokens[0] == "-" && tokens.size() == 3)
+		removeEdge(tokens[1], tokens[2]);
+	else if ((tokens[0] == "+" || tokens[0] == "=") && tokens.size() == 4 && sscanf_s(tokens[3].c_str(), INT64_FORMAT, &weight) == 1)
+		operations.push_back(PatchOperation((tokens[0] == "+") ? OPERATION_ADD_EDGE : OPERATION_SET_WEIGHT, tokens[1], tokens[2], weight));
+	else
+		return false;
+	return true;
+}
+
+bool GraphPatch::read(const char * fileName, std::string * error)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл изменений ") + fileName;
+		return false;
+	}
+	operations.clear();
+	char line[1024];
+	int lineNumber = 0;
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lineNumber++;
+		if (!parseLine(line))
+		{
+			std::ostringstream message;
+			message << "Неверная строка " << lineNumber << " в файле изменений " << fileName;
+			*error = message.str();
+			fclose(file);
+			return false;
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+bool GraphPatch::write(FILE * file) const
+{
+	for (size_t i = 0; i < operations.size(); i++)
+	{
+		const PatchOperation & operation = operations[i];
+		int written = 0;
+		switch (operation.type)
+		{
+		case OPERATION_ADD_EDGE:
+			written = fprintf_s(file, "+ %s %s " INT64_FORMAT "\n", operation.from.c_str(), operation.to.c_str(), operation.weight);
+			break;
+		case OPERATION_REMOVE_EDGE:
+			written = fprintf_s(file, "- %s %s\n", operation.from.c_str(), operation.to.c_str());
+			break;
+		case OPERATION_SET_WEIGHT:
+			written = fprintf_s(file, "= %s %s " INT64_FORMAT "\n", operation.from.c_str(), operation.to.c_str(), operation.weight);
+			break;
+		default:
+			written = fprintf_s(file, "v %s\n", operation.from.c_str());
+			break;
+		}
+		if (written < 0)
+			return false;
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+PatchLog::PatchLog()
+{
+	file = NULL;
+	committedLength = 0;
+}
+
+PatchLog::~PatchLog()
+{
+	if (file != NULL)
+		fclose(file);
+}
+
+bool PatchLog::open(const char * _fileName)
+{
+	fileName = _fileName;
+	if (file != NULL)
+		fclose(file);
+	file = NULL;
+
+	// Длина журнала до конца последней полной строки COMMIT; хвост после нее - запись, прерванная сбоем, возможно посреди строки.
+	// Он отбрасывается, чтобы следующий блок начался с новой строки и не склеился с оборванной.
+	__int64 length = 0;
+	committedLength = 0;
+	FILE * existing;
+	if (!fopen_s(&existing, _fileName, "rb"))
+	{
+		char line[1024];
+		bool lineStart = true;
+		while (fgets(line, sizeof(line), existing) != NULL)
+		{
+			size_t size = strlen(line);
+			length += size;
+			bool lineEnd = size > 0 && line[size - 1] == '\n';
+			if (lineStart && lineEnd && strncmp(line, "COMMIT", 6) == 0)
+				committedLength = length;
+			lineStart = lineEnd;
+		}
+		fclose(existing);
+	}
+
+	if (fopen_s(&file, _fileName, "a"))
+	{
+		file = NULL;
+		return false;
+	}
+	if (length > committedLength && truncateFile(file, committedLength) != 0)
+	{
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool PatchLog::commit(Graph * graph, const GraphPatch & patch, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights)
+{
+	// В журнал попадают только применимые пакеты, а граф меняется только после того, как пакет оказался на диске.
+	if (!graph->checkPatch(patch, patchErrors))
+		return false;
+	if (file == NULL)
+		return false;
+	if (fprintf_s(file, "BEGIN %d\n", (int)patch.getOperations().size()) < 0 || !patch.write(file)
+		|| fprintf_s(file, "COMMIT\n") < 0 || syncFile(file) != 0)
+	{
+		// Недописанный блок отрезается, иначе следующий пакет допишется за ним, а replay отбросит пакет, записанный позже.
+		// Файл закрывается и отрезается заново: буфер потока после ошибки мог остаться недописанным.
+		fclose(file);
+		file = NULL;
+		FILE * torn;
+		if (!fopen_s(&torn, fileName.c_str(), "a"))
+		{
+			truncateFile(torn, committedLength);
+			fclose(torn);
+		}
+		return false;
+	}
+	committedLength = fileLength(file);
+	return graph->applyPatch(patch, patchErrors, previousWeights);
+}
+
+bool PatchLog::replay(const char * fileName, Graph * graph, int * batchCount, std::string * error)
+{
+	*batchCount = 0;
+	FILE * log;
+	if (fopen_s(&log, fileName, "r"))
+		return true;
+
+	GraphPatch patch;
+	int expected = -1;		// Количество изменений текущего блока или -1 вне блока.
+	char line[1024];
+	bool result = true;
+	while (result && fgets(line, sizeof(line), log) != NULL)
+	{
+		// Строка без перевода строки оборвана сбоем, даже если похожа на целую: ее блок не завершен.
+		size_t size = strlen(line);
+		if (size == 0 || line[size - 1] != '\n')
+		{
+			expected = -1;
+			continue;
+		}
+		int count = 0;
+		if (sscanf_s(line, "BEGIN %d", &count) == 1)
+		{
+			// Новый блок начинается и после незавершенного: тот был прерван сбоем.
+			patch.clear();
+			expected = count;
+			continue;
+		}
+		if (expected == -1)
+			continue;
+		if (std::string(line).compare(0, 6, "COMMIT") == 0)
+		{
+			std::vector<int> patchErrors;
+			if ((int)patch.getOperations().size() == expected && graph->applyPatch(patch, &patchErrors))
+				(*batchCount)++;
+			else if ((int)patch.getOperations().size() == expected)
+			{
+				std::ostringstream message;
+				message << "Пакет " << *batchCount + 1 << " журнала " << fileName << " не применяется к графу: " << Graph::getErrorString(patchErrors[0]);
+				*error = message.str();
+				result = false;
+			}
+			expected = -1;
+			continue;
+		}
+		// Испорченная строка означает незавершенный блок.
+		if (!patch.parseLine(line))
+			expected = -1;
+	}
+	fclose(log);
+	return result;
+}
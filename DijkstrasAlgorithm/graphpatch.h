@@ -0,0 +1,146 @@
+#pragma once
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "graph.h"
+
+/**
+ * Одно изменение графа.
+ */
+struct PatchOperation
+{
+	int type;			// Вид изменения (GraphPatch::OPERATION_*).
+	std::string from;	// Начало дуги или имя добавляемого узла.
+	std::string to;		// Конец дуги (пусто для добавления узла).
+	__int64 weight;		// Вес дуги (для добавления дуги и изменения веса).
+
+	PatchOperation();
+	PatchOperation(const int _type, const std::string & _from, const std::string & _to, const __int64 _weight);
+	bool operator==(const PatchOperation & other) const;
+};
+
+/**
+ * Пакет изменений графа, применяемый к загруженному графу без перечитывания файла (Graph::applyPatch).
+ * Пакет применяется целиком или не применяется вовсе, а проверяются только затронутые им дуги.
+ * Текстовый формат - по изменению в строке:
+ *   + начало конец вес  - добавление дуги (недостающие узлы добавляются);
+ *   - начало конец      - удаление дуги;
+ *   = начало конец вес  - изменение веса дуги;
+ *   v узел              - добавление узла без дуг.
+ * Если между узлами несколько дуг, удаление и изменение веса относятся к первой из них.
+ */
+class GraphPatch
+{
+private:
+	std::vector<PatchOperation> operations;	// Изменения в порядке применения.
+
+public:
+	// Добавление дуги.
+	static const int OPERATION_ADD_EDGE = 0;
+	// Удаление дуги.
+	static const int OPERATION_REMOVE_EDGE = 1;
+	// Изменение веса дуги.
+	static const int OPERATION_SET_WEIGHT = 2;
+	// Добавление узла.
+	static const int OPERATION_ADD_VERTEX = 3;
+
+	/**
+	 * Добавление дуги.
+	 */
+	void addEdge(const std::string & from, const std::string & to, const __int64 weight);
+
+	/**
+	 * Удаление дуги.
+	 */
+	void removeEdge(const std::string & from, const std::string & to);
+
+	/**
+	 * Изменение веса дуги.
+	 */
+	void setWeight(const std::string & from, const std::string & to, const __int64 weight);
+
+	/**
+	 * Добавление узла без дуг; уже существующий узел не меняется.
+	 */
+	void addVertex(const std::string & name);
+
+	/**
+	 * Удаление всех изменений.
+	 */
+	void clear();
+
+	/**
+	 * Изменения в порядке применения.
+	 */
+	const std::vector<PatchOperation> & getOperations() const;
+
+	/**
+	 * Разбор строки текстового формата.
+	 * @param line - строка; пустые строки пропускаются.
+	 * @return - false, если строка записана неверно (пакет тогда не меняется).
+	 */
+	bool parseLine(const std::string & line);
+
+	/**
+	 * Чтение пакета из файла текстового формата.
+	 * @param fileName - имя файла.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если пакет прочитан, иначе false.
+	 */
+	bool read(const char * fileName, std::string * error);
+
+	/**
+	 * Запись пакета в текстовом формате.
+	 * @return - true, если запись удалась, иначе false.
+	 */
+	bool write(FILE * file) const;
+};
+
+/**
+ * Журнал изменений (write-ahead log) поверх файла графа: после перезапуска граф читается из файла и на него применяются пакеты журнала,
+ * что быстрее повторного создания файла. Пакет записывается в журнал блоком строк "BEGIN <количество>", изменения, "COMMIT"
+ * и сбрасывается на диск до изменения графа в памяти. Блок без COMMIT (запись прервана сбоем) при восстановлении пропускается;
+ * строка без перевода строки в конце считается оборванной. При открытии журнал усекается до конца последнего завершенного блока.
+ */
+class PatchLog
+{
+private:
+	FILE * file;				// Файл журнала, открытый для дописывания, или NULL.
+	std::string fileName;		// Имя файла журнала.
+	__int64 committedLength;	// Длина журнала после последнего записанного пакета.
+
+	PatchLog(const PatchLog &);
+	PatchLog & operator=(const PatchLog &);
+
+public:
+	PatchLog();
+	~PatchLog();
+
+	/**
+	 * Открытие журнала для дописывания; файл создается, если его нет, а незавершенный блок в его конце отбрасывается.
+	 * @return - true, если журнал открыт, иначе false.
+	 */
+	bool open(const char * _fileName);
+
+	/**
+	 * Проверка пакета, запись его в журнал и применение к графу.
+	 * @param graph - граф.
+	 * @param patch - пакет.
+	 * @param patchErrors - указатель на вектор, в который запишутся коды ошибок пакета (как в Graph::applyPatch).
+	 * @param previousWeights - указатель на вектор прежних весов (как в Graph::applyPatch) или NULL.
+	 * Если запись не удалась, недописанный блок отрезается, а журнал закрывается: дальнейшие пакеты записываются только после open.
+	 * @return - true, если пакет записан и применен; false, если пакет неверен (граф и журнал не меняются) или журнал не записан (граф не меняется).
+	 */
+	bool commit(Graph * graph, const GraphPatch & patch, std::vector<int> * patchErrors, std::vector<__int64> * previousWeights = NULL);
+
+	/**
+	 * Применение к графу всех завершенных пакетов журнала.
+	 * @param fileName - имя файла журнала; отсутствующий файл означает пустой журнал.
+	 * @param graph - граф, прочитанный из файла, поверх которого велся журнал.
+	 * @param batchCount - указатель на количество примененных пакетов.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - false, если пакет журнала не применяется к графу (журнал велся для другого графа); примененные до него пакеты остаются.
+	 */
+	static bool replay(const char * fileName, Graph * graph, int * batchCount, std::string * error);
+};
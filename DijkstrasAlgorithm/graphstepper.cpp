@@ -0,0 +1,178 @@
+#include "graphstepper.h"
+#include <algorithm>
+
+#ifndef _MSC_VER
+const int GraphStepper::MAX_CHECKPOINTS;
+const int GraphStepper::INITIAL_INTERVAL;
+#endif
+
+GraphStepper::GraphStepper(const Graph * _graph)
+{
+	graph = _graph;
+	const std::map<std::string, Node *> & graphNodes = graph->getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = graphNodes.begin(); iter != graphNodes.end(); iter++)
+	{
+		indices.insert(std::pair<const Node *, int>(iter->second, (int)nodes.size()));
+		nodes.push_back(iter->second);
+	}
+	restart();
+}
+
+void GraphStepper::restart()
+{
+	// Перед первым шагом метка начального узла уже равна 0, и он выбран текущим.
+	state.position = 0;
+	state.labels.assign(nodes.size(), -1);
+	state.passed.assign(nodes.size(), false);
+	state.parents.assign(nodes.size(), NULL);
+	state.passedCount = 0;
+	state.current = indices.find(graph->getStartNode())->second;
+	state.edge = 0;
+	state.labels[state.current] = 0;
+	checkpoints.clear();
+	checkpoints.push_back(state);
+	interval = INITIAL_INTERVAL;
+	total = -1;
+}
+
+void GraphStepper::saveCheckpoint()
+{
+	checkpoints.push_back(state);
+	if ((int)checkpoints.size() <= MAX_CHECKPOINTS)
+		return;
+	// Оставляем точки с четными номерами: они стоят через удвоенный интервал.
+	size_t kept = 0;
+	for (size_t i = 0; i < checkpoints.size(); i += 2)
+		checkpoints[kept++] = checkpoints[i];
+	checkpoints.resize(kept);
+	interval *= 2;
+}
+
+int GraphStepper::selectCurrent() const
+{
+	// Тот же выбор, что и в Graph::run: первый по имени непройденный узел с наименьшей меткой, недостигнутые узлы - в последнюю очередь.
+	int selected = -1;
+	for (int node = 0; node < (int)nodes.size(); node++)
+	{
+		if (state.passed[node])
+			continue;
+		if (selected == -1 ||
+			(state.labels[node] != -1 && state.labels[selected] > state.labels[node]) ||
+			(state.labels[selected] == -1 && state.labels[node] != -1))
+			selected = node;
+	}
+	return selected;
+}
+
+bool GraphStepper::next(ExecutionStep * step)
+{
+	if (state.current == -1)
+		return false;
+
+	const Node * node = nodes[state.current];
+	if (state.position == 0)
+		*step = ExecutionStep(NULL, node, 0, NULL);
+	else if (state.edge < node->edges.size())
+	{
+		// Просматриваем очередную дугу текущего узла.
+		const Edge * edge = node->edges[state.edge++];
+		int target = indices.find(edge->to)->second;
+		__int64 label = state.labels[state.current];
+		bool changed = false;
+		if (label != -1 && (state.labels[target] == -1 || state.labels[target] > label + edge->weight))
+		{
+			state.labels[target] = label + edge->weight;
+			state.parents[target] = edge;
+			changed = true;
+		}
+		*step = ExecutionStep(edge, changed ? edge->to : NULL, state.labels[target], NULL);
+	}
+	else
+	{
+		// Дуги просмотрены: узел пройден, выбираем следующий.
+		state.passed[state.current] = true;
+		state.passedCount++;
+		*step = ExecutionStep(NULL, NULL, -1, node);
+		state.current = selectCurrent();
+		state.edge = 0;
+	}
+
+	state.position++;
+	if (state.current == -1)
+		finish();
+	else if (state.position % interval == 0 && state.position > checkpoints.back().position)
+		saveCheckpoint();
+	return true;
+}
+
+int GraphStepper::position() const
+{
+	return state.position;
+}
+
+bool GraphStepper::seek(int index)
+{
+	if (index < 0)
+		return false;
+	// Назад или далеко вперед - от ближайшей контрольной точки перед шагом.
+	if (index < state.position || index - state.position > interval)
+	{
+		size_t nearest = 0;
+		while (nearest + 1 < checkpoints.size() && checkpoints[nearest + 1].position <= index)
+			nearest++;
+		if (index < state.position || checkpoints[nearest].position > state.position)
+			state = checkpoints[nearest];
+	}
+	ExecutionStep step;
+	while (state.position < index && next(&step))
+		;
+	return state.position == index && state.current != -1;
+}
+
+bool GraphStepper::runToEnd(ExecutionControl * control)
+{
+	if (control != NULL)
+		control->nodeCount = (long)nodes.size();
+	ExecutionStep step;
+	while (next(&step))
+	{
+		if (control == NULL)
+			continue;
+		control->passedCount = state.passedCount;
+		if (control->cancelled)
+			return false;
+	}
+	return true;
+}
+
+int GraphStepper::stepCount() const
+{
+	return total;
+}
+
+void GraphStepper::finish()
+{
+	total = state.position;
+	finalResult = ExecutionState();
+	// Путь восстанавливается по последним дугам от конечного узла к начальному.
+	const Node * endNode = graph->getEndNode();
+	int end = indices.find(endNode)->second;
+	if (state.parents[end] == NULL)
+		return;
+	finalResult = ExecutionState(endNode);
+	finalResult.totalWeight = state.labels[end];
+	finalResult.passed = true;
+	for (const Edge * edge = state.parents[end]; edge != NULL; edge = state.parents[indices.find(edge->from)->second])
+		finalResult.path.push_back(const_cast<Edge *>(edge));
+	std::reverse(finalResult.path.begin(), finalResult.path.end());
+}
+
+ExecutionState GraphStepper::result() const
+{
+	return finalResult;
+}
+
+int GraphStepper::checkpointCount() const
+{
+	return (int)checkpoints.size();
+}
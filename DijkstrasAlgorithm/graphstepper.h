@@ -0,0 +1,102 @@
+#pragma once
+#include <map>
+#include <vector>
+#include "platform.h"
+#include "graph.h"
+
+/**
+ * Пошаговое выполнение алгоритма Дейкстры для визуализации: шаги (ExecutionStep) выдаются по одному по мере запроса,
+ * в том же порядке и с теми же значениями, что и Graph::run(steps), но без сохранения всех шагов.
+ * Первый шаг доступен сразу после создания объекта.
+ *
+ * Для перехода к произвольному шагу (seek) сохраняются контрольные точки - полные состояния алгоритма через каждые interval шагов.
+ * Точек не больше MAX_CHECKPOINTS: когда их становится больше, каждая вторая удаляется, а интервал удваивается.
+ * Поэтому память - O(MAX_CHECKPOINTS * V) при любом количестве шагов, а переход к шагу воспроизводит не больше interval шагов от ближайшей точки.
+ */
+class GraphStepper
+{
+private:
+	/**
+	 * Состояние алгоритма между шагами.
+	 */
+	struct State
+	{
+		int position;					// Номер следующего шага.
+		std::vector<__int64> labels;	// Метки узлов (-1 - узел не достигнут).
+		std::vector<bool> passed;		// Пройдены ли узлы.
+		std::vector<const Edge *> parents;	// Последние дуги путей до узлов (NULL - нет пути или начальный узел).
+		int passedCount;				// Количество пройденных узлов.
+		int current;					// Текущий узел или -1, если алгоритм завершен.
+		size_t edge;					// Следующая просматриваемая дуга текущего узла.
+	};
+
+	const Graph * graph;						// Граф.
+	std::vector<const Node *> nodes;			// Узлы в порядке имен - в этом порядке их просматривает Graph::run.
+	std::map<const Node *, int> indices;		// Номера узлов.
+	State state;								// Текущее состояние.
+	std::vector<State> checkpoints;				// Контрольные точки по возрастанию номера шага; первая - начало выполнения.
+	int interval;								// Расстояние между контрольными точками в шагах.
+	int total;									// Общее количество шагов или -1, если алгоритм еще не завершен.
+	ExecutionState finalResult;					// Результат, сохраненный на последнем шаге.
+
+	void restart();
+	void saveCheckpoint();
+	int selectCurrent() const;
+	void finish();
+
+	GraphStepper(const GraphStepper &);
+	GraphStepper & operator=(const GraphStepper &);
+
+public:
+	// Наибольшее количество контрольных точек.
+	static const int MAX_CHECKPOINTS = 32;
+	// Начальное расстояние между контрольными точками в шагах.
+	static const int INITIAL_INTERVAL = 64;
+
+	/**
+	 * Конструктор.
+	 * @param _graph - граф, загруженный без ошибок (с начальной вершиной маршрута); не должен изменяться, пока существует объект.
+	 */
+	GraphStepper(const Graph * _graph);
+
+	/**
+	 * Получение следующего шага.
+	 * @param step - указатель на шаг.
+	 * @return - true, если шаг получен; false, если алгоритм завершен.
+	 */
+	bool next(ExecutionStep * step);
+
+	/**
+	 * Номер шага, который вернет следующий вызов next.
+	 */
+	int position() const;
+
+	/**
+	 * Переход к шагу: следующий вызов next вернет шаг с этим номером.
+	 * @param index - номер шага.
+	 * @return - true, если шаг существует; иначе false, и позиция - конец выполнения.
+	 */
+	bool seek(int index);
+
+	/**
+	 * Выполнение оставшихся шагов без их выдачи; после этого известны количество шагов и результат.
+	 * @param control - указатель на объект управления выполнением или NULL.
+	 * @return - false, если выполнение отменено.
+	 */
+	bool runToEnd(ExecutionControl * control = NULL);
+
+	/**
+	 * Общее количество шагов или -1, если алгоритм еще не дошел до конца.
+	 */
+	int stepCount() const;
+
+	/**
+	 * Результат работы алгоритма, как у Graph::run; действителен, когда алгоритм дошел до конца.
+	 */
+	ExecutionState result() const;
+
+	/**
+	 * Количество сохраненных контрольных точек.
+	 */
+	int checkpointCount() const;
+};
@@ -0,0 +1,146 @@
+#include "kshortest.h"
+#include <algorithm>
+
+bool KShortestPaths::Candidate::operator<(const Candidate & other) const
+{
+	if (path.totalWeight != other.path.totalWeight)
+		return path.totalWeight < other.path.totalWeight;
+	if (path.edges.size() != other.path.edges.size())
+		return path.edges.size() < other.path.edges.size();
+	// Как и в BasicQueryContext, среди путей одной длины с одинаковым числом дуг меньше тот, у которого меньше последняя дуга, и так далее к началу.
+	return std::lexicographical_compare(path.edges.rbegin(), path.edges.rend(), other.path.edges.rbegin(), other.path.edges.rend());
+}
+
+KShortestPaths::KShortestPaths(const QueryEngine * _engine, int threadCount)
+{
+	engine = _engine;
+	if (threadCount <= 0)
+		threadCount = Thread::processorCount();
+	for (int i = 0; i < threadCount; i++)
+		contexts.push_back(engine->createContext());
+	end = -1;
+	stopping = false;
+}
+
+KShortestPaths::~KShortestPaths()
+{
+	for (size_t i = 0; i < contexts.size(); i++)
+		delete contexts[i];
+}
+
+void KShortestPaths::searchSpurs(int context, int first, int step)
+{
+	const PathResult & previous = accepted.back().path;
+	int deviation = accepted.back().deviation;
+	std::vector<int> bannedNodes, bannedEdges;
+	for (int i = first; i < (int)spurs.size(); i += step)
+	{
+		int index = deviation + i;
+		// Корень - первые index дуг пути; его узлы, кроме последнего, запрещены, чтобы путь остался простым.
+		bannedNodes.assign(previous.nodes.begin(), previous.nodes.begin() + index);
+		bannedEdges.clear();
+		for (size_t p = 0; p < accepted.size(); p++)
+		{
+			const std::vector<int> & edges = accepted[p].path.edges;
+			if ((int)edges.size() > index && std::equal(edges.begin(), edges.begin() + index, previous.edges.begin()))
+				bannedEdges.push_back(edges[index]);
+		}
+		contexts[context]->setMask(bannedNodes, bannedEdges);
+		spurs[i].found = contexts[context]->findPath(previous.nodes[index], end, &spurs[i].path);
+	}
+	contexts[context]->clearMask();
+}
+
+void KShortestPaths::runSpurJob(void * argument)
+{
+	SpurJob * job = (SpurJob *)argument;
+	for (;;)
+	{
+		job->wake->acquire();
+		if (job->owner->stopping)
+			return;
+		job->owner->searchSpurs(job->first, job->first, job->step);
+		job->owner->finished.release();
+	}
+}
+
+void KShortestPaths::find(int start, int _end, int k, std::vector<PathResult> * paths)
+{
+	paths->clear();
+	accepted.clear();
+	end = _end;
+	if (k <= 0)
+		return;
+	Candidate shortest;
+	shortest.deviation = 0;
+	if (!contexts[0]->findPath(start, end, &shortest.path))
+		return;
+	accepted.push_back(shortest);
+
+	// Поток t обрабатывает отклонения t, t + T, ... в каждом раунде; первый набор - в вызывающем потоке.
+	int threadCount = (int)contexts.size();
+	std::vector<SpurJob> jobs(threadCount);
+	std::vector<Thread *> threads;
+	stopping = false;
+	for (int t = 1; t < threadCount && k > 1; t++)
+	{
+		jobs[t].owner = this;
+		jobs[t].first = t;
+		jobs[t].step = threadCount;
+		jobs[t].wake = new Semaphore();
+		threads.push_back(new Thread());
+		threads.back()->start(&KShortestPaths::runSpurJob, &jobs[t]);
+	}
+
+	// Кандидаты упорядочены, поэтому лучший всегда первый, а повторно найденный путь не добавляется дважды.
+	std::set<Candidate> candidates;
+	while ((int)accepted.size() < k)
+	{
+		const PathResult & previous = accepted.back().path;
+		int deviation = accepted.back().deviation;
+		spurs.assign(previous.edges.size() - deviation, Spur());
+
+		// Будим только потоки, которым достались отклонения.
+		int active = std::min((int)threads.size(), (int)spurs.size() - 1);
+		for (int t = 0; t < active; t++)
+			jobs[t + 1].wake->release();
+		searchSpurs(0, 0, threadCount);
+		for (int t = 0; t < active; t++)
+			finished.acquire();
+
+		// Кандидат - корень пути с найденным отклонением; длина корня складывается из весов его дуг.
+		__int64 rootWeight = 0;
+		for (int index = 0; index < deviation; index++)
+			rootWeight += engine->edgeWeight(previous.edges[index]);
+		for (size_t i = 0; i < spurs.size(); i++)
+		{
+			int index = deviation + (int)i;
+			if (i > 0)
+				rootWeight += engine->edgeWeight(previous.edges[index - 1]);
+			if (!spurs[i].found)
+				continue;
+			Candidate candidate;
+			candidate.deviation = index;
+			candidate.path.totalWeight = rootWeight + spurs[i].path.totalWeight;
+			candidate.path.nodes.assign(previous.nodes.begin(), previous.nodes.begin() + index);
+			candidate.path.nodes.insert(candidate.path.nodes.end(), spurs[i].path.nodes.begin(), spurs[i].path.nodes.end());
+			candidate.path.edges.assign(previous.edges.begin(), previous.edges.begin() + index);
+			candidate.path.edges.insert(candidate.path.edges.end(), spurs[i].path.edges.begin(), spurs[i].path.edges.end());
+			candidates.insert(candidate);
+		}
+		if (candidates.empty())
+			break;
+		accepted.push_back(*candidates.begin());
+		candidates.erase(candidates.begin());
+	}
+
+	stopping = true;
+	for (size_t t = 0; t < threads.size(); t++)
+	{
+		jobs[t + 1].wake->release();
+		delete threads[t];
+		delete jobs[t + 1].wake;
+	}
+	for (size_t i = 0; i < accepted.size(); i++)
+		paths->push_back(accepted[i].path);
+}
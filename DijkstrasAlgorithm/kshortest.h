@@ -0,0 +1,83 @@
+#pragma once
+#include <set>
+#include <vector>
+#include "platform.h"
+#include "queryengine.h"
+
+/**
+ * Поиск k кратчайших простых путей (алгоритм Йена).
+ * Каждый следующий путь - лучший из кандидатов, которые получаются отклонением от уже найденного пути в одном из его узлов:
+ * путь до узла отклонения (корень) сохраняется, а остаток ищется заново (поиск отклонения) без узлов корня и без дуг,
+ * которыми из этого узла уходят найденные пути с тем же корнем. Узлы и дуги запрещаются маской контекста (EngineContext::setMask),
+ * граф не копируется. Как предложил Лаулер, отклонения ищутся только начиная с узла, в котором путь сам отклонился от своего родителя:
+ * кандидаты для более ранних узлов уже получены при обработке родителя.
+ * Поиски отклонений для одного пути независимы и выполняются параллельно, у каждого потока свой контекст; результат от числа потоков не зависит.
+ * Потоки запускаются один раз на запрос и получают поиски отклонений каждого следующего пути как очередной раунд.
+ * Пути упорядочены по длине, затем по числу дуг, затем по последовательности дуг от конца к началу, как в BasicQueryContext.
+ */
+class KShortestPaths
+{
+private:
+	/**
+	 * Найденный путь или кандидат.
+	 */
+	struct Candidate
+	{
+		PathResult path;
+		int deviation;		// Индекс узла, в котором путь отклоняется от родителя.
+
+		bool operator<(const Candidate & other) const;
+	};
+
+	/**
+	 * Результат поиска отклонения в одном узле.
+	 */
+	struct Spur
+	{
+		bool found;
+		PathResult path;	// Путь от узла отклонения до конечного узла.
+	};
+
+	/**
+	 * Задание для потока: поиски отклонений с номерами first, first + step, ... в каждом раунде.
+	 */
+	struct SpurJob
+	{
+		KShortestPaths * owner;
+		int first;
+		int step;
+		Semaphore * wake;	// Сигнал начала раунда.
+	};
+
+	const QueryEngine * engine;				// Граф.
+	std::vector<EngineContext *> contexts;	// Рабочая память каждого потока.
+	std::vector<Candidate> accepted;		// Найденные пути.
+	std::vector<Spur> spurs;				// Результаты поисков отклонений для текущего пути.
+	int end;								// Конечный узел текущего запроса.
+	bool stopping;							// Сигнал завершения рабочим потокам.
+	Semaphore finished;						// Количество потоков, закончивших раунд.
+
+	void searchSpurs(int context, int first, int step);
+	static void runSpurJob(void * argument);
+
+	KShortestPaths(const KShortestPaths &);
+	KShortestPaths & operator=(const KShortestPaths &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _engine - граф; должен существовать все время жизни объекта.
+	 * @param threadCount - количество потоков для поисков отклонений (0 - по числу процессоров).
+	 */
+	KShortestPaths(const QueryEngine * _engine, int threadCount = 0);
+	~KShortestPaths();
+
+	/**
+	 * Поиск k кратчайших простых путей.
+	 * @param start - индекс начального узла.
+	 * @param _end - индекс конечного узла.
+	 * @param k - наибольшее количество путей.
+	 * @param paths - указатель на вектор, в который запишутся пути по возрастанию длины (меньше k, если простых путей меньше).
+	 */
+	void find(int start, int _end, int k, std::vector<PathResult> * paths);
+};
@@ -1,25 +1,596 @@
 #define _CRTDBG_MAP_ALLOC
 
 #include <stdio.h>
-#include <conio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <locale>
-#include <crtdbg.h>
 #include <string>
 #include "graph.h"
+#include "server.h"
+#include "benchmark.h"
+#include "facility.h"
+#include "externalgraph.h"
+#include "shard.h"
+#include "graphpatch.h"
+#include "batchscheduler.h"
+
+#ifdef _MSC_VER
+	#include <conio.h>
+	#include <crtdbg.h>
+#endif
 
 #ifdef _DEBUG
 	#include "testing.h"
 #endif
 
+// Разбор положительного целого аргумента; false, если аргумент - не число или число не больше нуля.
+static bool parsePositive(const char * text, int * value)
+{
+	char * end = NULL;
+	long parsed = strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed <= 0 || parsed > 0x7FFFFFFF)
+		return false;
+	*value = (int)parsed;
+	return true;
+}
+
+/**
+ * Режим сервера: qwe.exe --server [--socket имя] [--threads N] [--cache N] [--pages small|transparent|huge] [--numa] [--writable]
+ *                                  [--order name|bfs|rcm|hilbert] [--coordinates файл] [имя=]файл...
+ * Без --socket запросы читаются из стандартного ввода, ответы пишутся в стандартный вывод.
+ * --order и --coordinates действуют на графы, указанные после них.
+ * --pages выбирает страницы для массивов графов и запросов (PageMemory), --numa копирует графы на каждый узел NUMA.
+ * --writable разрешает изменять графы командой PATCH (см. QueryServer).
+ */
+int runServer(int argc, char *argv[])
+{
+	std::string socketName = "";
+	int threadCount = QueryServer::DEFAULT_THREAD_COUNT;
+	int cacheCapacity = 0;
+	bool replicate = false;
+	bool writable = false;
+	// Емкость кэша, вид страниц, копирование по узлам и изменяемость нужны до загрузки графов.
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+		{
+			if (!parsePositive(argv[i + 1], &cacheCapacity))
+			{
+				fprintf(stderr, "Invalid cache capacity %s\n", argv[i + 1]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc)
+		{
+			int pages;
+			if (!PageMemory::parse(argv[i + 1], &pages))
+			{
+				fprintf(stderr, "Unknown pages %s\n", argv[i + 1]);
+				return 1;
+			}
+			PageMemory::setPages(pages);
+		}
+		else if (strcmp(argv[i], "--numa") == 0)
+			replicate = true;
+		else if (strcmp(argv[i], "--writable") == 0)
+			writable = true;
+	}
+	QueryServer server(cacheCapacity > 0 ? (size_t)cacheCapacity : 0, replicate, writable);
+	int graphCount = 0;
+	int order = VertexOrder::ORDER_NAME;
+	const char * coordinatesFile = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "--cache") == 0 || strcmp(argv[i], "--pages") == 0) && i + 1 < argc)
+			i++;
+		else if (strcmp(argv[i], "--numa") == 0 || strcmp(argv[i], "--writable") == 0)
+			continue;
+		else if (strcmp(argv[i], "--order") == 0 && i + 1 < argc)
+		{
+			if (!VertexOrder::parse(argv[++i], &order))
+			{
+				fprintf(stderr, "Unknown order %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--coordinates") == 0 && i + 1 < argc)
+			coordinatesFile = argv[++i];
+		else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+			socketName = argv[++i];
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			if (!parsePositive(argv[++i], &threadCount))
+			{
+				fprintf(stderr, "Invalid thread count %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else
+		{
+			// Граф задается как имя=файл или просто файлом, тогда имя совпадает с именем файла.
+			std::string arg = argv[i];
+			size_t separator = arg.find('=');
+			std::string name = (separator != std::string::npos) ? arg.substr(0, separator) : arg;
+			std::string fileName = (separator != std::string::npos) ? arg.substr(separator + 1) : arg;
+			std::string error;
+			if (!server.addGraph(name, fileName.c_str(), &error, order, coordinatesFile))
+			{
+				fprintf(stderr, "Could not load graph %s: %s\n", name.c_str(), error.c_str());
+				return 1;
+			}
+			graphCount++;
+		}
+	}
+	if (graphCount == 0)
+	{
+		fprintf(stderr, "No graphs given. Example usage: qwe.exe --server [--socket name] [--threads N] [--cache N] [--order rcm] roads=\"C:\\in.txt\"\n");
+		return 1;
+	}
+
+	if (socketName.empty())
+	{
+		StdChannel channel;
+		QueryServer::Session session;
+		server.serve(&channel, &session);
+		return 0;
+	}
+	// Сервер работает, пока прием соединений не прервет неустранимая ошибка, поэтому возврат из listen - всегда ошибка.
+	server.listen(socketName, threadCount);
+	fprintf(stderr, "Could not accept connections on %s\n", socketName.c_str());
+	return 1;
+}
+
+/**
+ * Режим замера: qwe.exe --benchmark [--grid W H | --hubs N HUBS | файл [--coordinates файл]] [--queries N] [--seed N] [--pages small|transparent|huge]
+ * Сравнивает порядки нумерации узлов, типы веса и индекса, ядра проверки дуг и сжатое хранение дуг на одном наборе запросов.
+ * --hubs строит граф из N узлов степени 4, в котором HUBS узлов связаны с N / 10 узлами каждый.
+ */
+int runBenchmark(int argc, char *argv[])
+{
+	int width = 300, height = 300;
+	int queryCount = 200;
+	unsigned int seed = 1;
+	int hubNodes = 0, hubCount = 0;
+	const char * fileName = NULL;
+	const char * coordinatesFile = NULL;
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--grid") == 0 && i + 2 < argc)
+		{
+			width = atoi(argv[++i]);
+			height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--hubs") == 0 && i + 2 < argc)
+		{
+			hubNodes = atoi(argv[++i]);
+			hubCount = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc)
+			queryCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+			seed = (unsigned int)atoi(argv[++i]);
+		else if (strcmp(argv[i], "--coordinates") == 0 && i + 1 < argc)
+			coordinatesFile = argv[++i];
+		else if (strcmp(argv[i], "--pages") == 0 && i + 1 < argc)
+		{
+			int pages;
+			if (!PageMemory::parse(argv[++i], &pages))
+			{
+				fprintf(stderr, "Unknown pages %s\n", argv[i]);
+				return 1;
+			}
+			PageMemory::setPages(pages);
+		}
+		else
+			fileName = argv[i];
+	}
+
+	Benchmark benchmark(seed);
+	if (fileName != NULL)
+	{
+		std::string error;
+		if (!benchmark.load(fileName, &error))
+		{
+			fprintf(stderr, "Could not load graph %s: %s\n", fileName, error.c_str());
+			return 1;
+		}
+		if (coordinatesFile != NULL && !benchmark.loadCoordinates(coordinatesFile))
+		{
+			fprintf(stderr, "Could not open coordinates file %s\n", coordinatesFile);
+			return 1;
+		}
+	}
+	else if (hubNodes > 0)
+		benchmark.generateHubs(hubNodes, 4, hubCount, hubNodes / 10);
+	else
+		benchmark.generateGrid(width, height);
+	benchmark.generateQueries(queryCount);
+	printf("Pages: %s\n", PageMemory::name(PageMemory::pages()));
+	benchmark.compareOrders(stdout);
+	printf("\n");
+	benchmark.compareTypes(stdout);
+	printf("\n");
+	benchmark.compareKernels(stdout);
+	printf("\n");
+	benchmark.compareCompression(stdout);
+	return 0;
+}
+
+/**
+ * Режим ближайших источников: qwe.exe --nearest граф источники выход [--to узел]
+ * Одним поиском от всех источников (см. NearestFacility) записывает для каждого узла ближайший источник, расстояние и предыдущий узел пути.
+ * С --to дополнительно выводит ближайший к узлу источник и путь от него.
+ */
+int runNearest(int argc, char *argv[])
+{
+	if (argc < 5)
+	{
+		fprintf(stderr, "Too few arguments. Example usage: qwe.exe --nearest \"C:\\in.txt\" \"C:\\depots.txt\" \"C:\\nearest.txt\" [--to node]\n");
+		return 1;
+	}
+	const char * target = NULL;
+	for (int i = 5; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--to") == 0)
+			target = argv[++i];
+
+	Graph graph(argv[2]);
+	if (graph.error_exists())
+	{
+		std::vector<int> errors = graph.getErrors();
+		for (size_t i = 0; i < errors.size(); i++)
+			fprintf(stderr, "%s\n", Graph::getErrorString(errors[i]));
+		return 1;
+	}
+	StaticGraph staticGraph(graph);
+	QueryEngine * engine = QueryEngine::create(staticGraph);
+	std::vector<int> sources;
+	std::vector<__int64> offsets;
+	std::string error;
+	if (!NearestFacility::readSources(argv[3], *engine, &sources, &offsets, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		delete engine;
+		return 1;
+	}
+
+	EngineContext * context = engine->createContext();
+	std::vector<__int64> labels;
+	std::vector<int> nearest, parents;
+	int result = 0;
+	if (!context->computeNearest(sources, offsets, &labels, &nearest, &parents))
+	{
+		fprintf(stderr, "Source offsets are too large for this graph\n");
+		result = 1;
+	}
+	else if (!NearestFacility::writeAssignment(argv[4], *engine, sources, labels, nearest, parents))
+	{
+		fprintf(stderr, "Could not create output file %s\n", argv[4]);
+		result = 1;
+	}
+	else if (target != NULL)
+	{
+		int node = engine->findNode(target);
+		PathResult path;
+		int source = -1;
+		if (node == -1)
+			printf("Node %s not found\n", target);
+		else if (!context->findNearest(sources, offsets, node, &path, &source))
+			printf("No source reaches %s\n", target);
+		else
+		{
+			printf("%s " INT64_FORMAT ":", engine->nodeName(sources[source]).c_str(), path.totalWeight);
+			for (size_t i = 0; i < path.nodes.size(); i++)
+				printf(" %s", engine->nodeName(path.nodes[i]).c_str());
+			printf("\n");
+		}
+	}
+	delete context;
+	delete engine;
+	return result;
+}
+
+/**
+ * Режим внешней памяти:
+ *   qwe.exe --external-convert граф файл.blk [--memory МБ]      - построение файла внешнего графа (ExternalGraph::convert);
+ *   qwe.exe --external файл.blk начало конец [--memory МБ]     - поиск пути с выводом объема ввода-вывода.
+ * --memory ограничивает память сортировки дуг или кэшей и очереди поиска (по умолчанию 64 МБ):
+ * половина отдается кэшу графа, по четверти - кэшу меток и очереди.
+ */
+int runExternal(int argc, char *argv[])
+{
+	bool convert = strcmp(argv[1], "--external-convert") == 0;
+	int required = convert ? 4 : 5;
+	if (argc < required)
+	{
+		fprintf(stderr, "Too few arguments. Example usage: qwe.exe --external-convert \"C:\\in.txt\" \"C:\\in.blk\" [--memory MB] or qwe.exe --external \"C:\\in.blk\" start end [--memory MB]\n");
+		return 1;
+	}
+	size_t memory = (size_t)64 << 20;
+	for (int i = required; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--memory") == 0)
+			memory = (size_t)atoi(argv[++i]) << 20;
+
+	std::string error;
+	if (convert)
+	{
+		if (!ExternalGraph::convert(argv[2], argv[3], memory, &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	ExternalGraph graph;
+	if (!graph.open(argv[2], memory / 2, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	int start = graph.findNode(argv[3]);
+	int end = graph.findNode(argv[4]);
+	if (start == -1 || end == -1)
+	{
+		fprintf(stderr, "Unknown vertex\n");
+		return 1;
+	}
+	ExternalSearch search(&graph, memory / 4, memory / 4);
+	if (!search.ready())
+	{
+		fprintf(stderr, "Cannot create a temporary file\n");
+		return 1;
+	}
+	PathResult result;
+	if (search.findPath(start, end, &result))
+	{
+		printf(INT64_FORMAT ":", result.totalWeight);
+		for (size_t i = 0; i < result.nodes.size(); i++)
+			printf(" %s", graph.nodeName(result.nodes[i]).c_str());
+		printf("\n");
+	}
+	else
+		printf("No path\n");
+	const IoStatistics & io = search.lastStatistics();
+	printf("I/O: read " INT64_FORMAT " bytes, written " INT64_FORMAT " bytes, cache hits " INT64_FORMAT ", misses " INT64_FORMAT "\n", io.bytesRead, io.bytesWritten, io.hits, io.misses);
+	return 0;
+}
+
+/**
+ * Режим шардов:
+ *   qwe.exe --partition граф префикс K                      - разбиение графа на K шардов (ShardPartitioner);
+ *   qwe.exe --sharded префикс K начало конец               - поиск пути: по процессу на шард и координатор в этом процессе;
+ *   qwe.exe --shard-worker граф.graph граф.boundary канал   - процесс одного шарда, обслуживающий одно соединение координатора.
+ */
+int runShards(int argc, char *argv[])
+{
+	std::string error;
+	if (strcmp(argv[1], "--partition") == 0)
+	{
+		if (argc < 5)
+		{
+			fprintf(stderr, "Too few arguments. Example usage: qwe.exe --partition \"C:\\in.txt\" \"C:\\shards\\in\" 4\n");
+			return 1;
+		}
+		if (!ShardPartitioner::partition(argv[2], argv[3], atoi(argv[4]), &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	if (strcmp(argv[1], "--shard-worker") == 0)
+	{
+		if (argc < 5)
+		{
+			fprintf(stderr, "Too few arguments. Example usage: qwe.exe --shard-worker in.0.graph in.0.boundary channel\n");
+			return 1;
+		}
+		ShardWorker worker;
+		LocalListener listener;
+		if (!worker.load(argv[2], argv[3], &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		if (!listener.listen(argv[4]))
+		{
+			fprintf(stderr, "Could not listen on %s\n", argv[4]);
+			return 1;
+		}
+		LocalChannel * channel = listener.accept();
+		if (channel == NULL)
+			return 1;
+		worker.serve(channel);
+		delete channel;
+		return 0;
+	}
+
+	if (argc < 6)
+	{
+		fprintf(stderr, "Too few arguments. Example usage: qwe.exe --sharded \"C:\\shards\\in\" 4 start end\n");
+		return 1;
+	}
+	ShardCoordinator coordinator;
+	if (!coordinator.launch(argv[0], argv[2], atoi(argv[3])))
+	{
+		fprintf(stderr, "Could not start shard processes\n");
+		return 1;
+	}
+	ShardPath path;
+	if (!coordinator.findPath(argv[4], argv[5], &path))
+	{
+		fprintf(stderr, "Shard process failed\n");
+		return 1;
+	}
+	if (path.totalWeight == -1)
+		printf("No path\n");
+	else
+	{
+		printf(INT64_FORMAT ":", path.totalWeight);
+		for (size_t i = 0; i < path.nodes.size(); i++)
+			printf(" %s", path.nodes[i].c_str());
+		printf("\n");
+	}
+	printf("Rounds: %d\n", path.rounds);
+	return 0;
+}
+
+/**
+ * Режим пакета: qwe.exe --batch граф запросы выход [--threads N] [--order name|bfs|rcm|hilbert]
+ * Выполняет запросы из файла (по паре имен узлов в строке) планировщиком BatchScheduler и записывает пути в порядке запросов.
+ * Граф может содержать дуги с отрицательным весом: они один раз приводятся к неотрицательным (StaticGraph::reweight).
+ */
+int runBatch(int argc, char *argv[])
+{
+	if (argc < 5)
+	{
+		fprintf(stderr, "Too few arguments. Example usage: qwe.exe --batch \"C:\\in.txt\" \"C:\\queries.txt\" \"C:\\paths.txt\" [--threads N] [--order rcm]\n");
+		return 1;
+	}
+	int threadCount = 0;
+	int order = VertexOrder::ORDER_NAME;
+	for (int i = 5; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--threads") == 0)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--order") == 0 && !VertexOrder::parse(argv[++i], &order))
+		{
+			fprintf(stderr, "Unknown order %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	StaticGraph staticGraph;
+	std::vector<int> errors;
+	if (!staticGraph.readFromFile(argv[2], &errors))
+	{
+		for (size_t i = 0; i < errors.size(); i++)
+			fprintf(stderr, "%s\n", Graph::getErrorString(errors[i]));
+		return 1;
+	}
+	// Группы идут по индексам начальных узлов, поэтому от нумерации зависит, насколько близки соседние поиски.
+	std::vector<int> permutation;
+	if (order != VertexOrder::ORDER_NAME && VertexOrder::compute(staticGraph, order, NULL, &permutation))
+		staticGraph.renumber(permutation);
+	QueryEngine * engine = QueryEngine::create(staticGraph);
+	std::vector<std::pair<int, int> > queries;
+	std::string error;
+	if (!BatchScheduler::readQueries(argv[3], *engine, &queries, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		delete engine;
+		return 1;
+	}
+
+	BatchScheduler scheduler(engine, threadCount);
+	std::vector<PathResult> results;
+	double started = Timer::seconds();
+	int searchCount = scheduler.run(queries, &results);
+	printf("Queries: %d, searches: %d, time: %.3f s\n", (int)queries.size(), searchCount, Timer::seconds() - started);
+	int result = 0;
+	if (!BatchScheduler::writeResults(argv[4], *engine, queries, results))
+	{
+		fprintf(stderr, "Could not create output file %s\n", argv[4]);
+		result = 1;
+	}
+	delete engine;
+	return result;
+}
+
+/**
+ * Режим изменений: qwe.exe --patch граф журнал [пакет...]
+ * Граф читается из файла, к нему применяется журнал (PatchLog), затем пакеты из файлов по очереди проверяются, дописываются в журнал и применяются.
+ * В конце выводится кратчайший путь маршрута графа.
+ */
+int runPatch(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "Too few arguments. Example usage: qwe.exe --patch \"C:\\in.txt\" \"C:\\in.log\" [\"C:\\changes.txt\"...]\n");
+		return 1;
+	}
+	Graph graph(argv[2]);
+	if (graph.error_exists())
+	{
+		std::vector<int> errors = graph.getErrors();
+		for (size_t i = 0; i < errors.size(); i++)
+			fprintf(stderr, "%s\n", Graph::getErrorString(errors[i]));
+		return 1;
+	}
+	std::string error;
+	int batchCount = 0;
+	if (!PatchLog::replay(argv[3], &graph, &batchCount, &error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+	PatchLog log;
+	if (!log.open(argv[3]))
+	{
+		fprintf(stderr, "Could not open log file %s\n", argv[3]);
+		return 1;
+	}
+	for (int i = 4; i < argc; i++)
+	{
+		GraphPatch patch;
+		std::vector<int> errors;
+		if (!patch.read(argv[i], &error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		if (!log.commit(&graph, patch, &errors))
+		{
+			for (size_t k = 0; k < errors.size(); k++)
+				fprintf(stderr, "%s: %s\n", argv[i], Graph::getErrorString(errors[k]));
+			if (errors.empty())
+				fprintf(stderr, "Could not write log file %s\n", argv[3]);
+			return 1;
+		}
+		batchCount++;
+	}
+
+	ExecutionState result = graph.findPath(graph.getStartNode(), graph.getEndNode());
+	printf("Batches: %d\n", batchCount);
+	if (result.totalWeight == -1)
+		printf("No path\n");
+	else
+	{
+		printf(INT64_FORMAT ": %s", result.totalWeight, graph.getStartNode()->name.c_str());
+		for (size_t i = 0; i < result.path.size(); i++)
+			printf(" %s", result.path[i]->to->name.c_str());
+		printf("\n");
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	setlocale(LC_ALL, "rus");
 
+	if (argc >= 2 && strcmp(argv[1], "--server") == 0)
+		return runServer(argc, argv);
+	if (argc >= 2 && strcmp(argv[1], "--benchmark") == 0)
+		return runBenchmark(argc, argv);
+	if (argc >= 2 && strcmp(argv[1], "--nearest") == 0)
+		return runNearest(argc, argv);
+	if (argc >= 2 && (strcmp(argv[1], "--external") == 0 || strcmp(argv[1], "--external-convert") == 0))
+		return runExternal(argc, argv);
+	if (argc >= 2 && (strcmp(argv[1], "--partition") == 0 || strcmp(argv[1], "--sharded") == 0 || strcmp(argv[1], "--shard-worker") == 0))
+		return runShards(argc, argv);
+	if (argc >= 2 && strcmp(argv[1], "--patch") == 0)
+		return runPatch(argc, argv);
+	if (argc >= 2 && strcmp(argv[1], "--batch") == 0)
+		return runBatch(argc, argv);
+
 #ifdef _DEBUG
 	TestSuite tests;
 	tests.run();
+#ifdef _MSC_VER
 	_getch();
 	_CrtDumpMemoryLeaks();
+#endif
 	return 0;
 #else
 	if (argc < 4)
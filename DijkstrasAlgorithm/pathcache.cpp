@@ -0,0 +1,339 @@
+#include "pathcache.h"
+#include <algorithm>
+#include "graphpatch.h"
+#include "queryengine.h"
+
+/**
+ * Удаление из кэша результатов, которые мог изменить пакет; узлы ищутся по именам в графе, по которому заполнялся кэш.
+ */
+template <class TGraph>
+static void invalidatePatch(PathCache * cache, const GraphPatch & patch, const std::vector<__int64> & previousWeights, const TGraph & graph)
+{
+	const std::vector<PatchOperation> & operations = patch.getOperations();
+	for (size_t i = 0; i < operations.size(); i++)
+	{
+		const PatchOperation & operation = operations[i];
+		int from = graph.findNode(operation.from);
+		int to = (operation.type == GraphPatch::OPERATION_ADD_VERTEX) ? from : graph.findNode(operation.to);
+		if (from == -1 || to == -1)
+		{
+			// Новый узел сдвигает индексы узлов с большими именами.
+			cache->clear();
+			return;
+		}
+		if (operation.type == GraphPatch::OPERATION_REMOVE_EDGE || (operation.type == GraphPatch::OPERATION_SET_WEIGHT && operation.weight > previousWeights[i]))
+			cache->edgeIncreased(from, to);
+		else if (operation.type == GraphPatch::OPERATION_ADD_EDGE || (operation.type == GraphPatch::OPERATION_SET_WEIGHT && operation.weight < previousWeights[i]))
+			cache->edgeDecreased(from, to, operation.weight);
+	}
+}
+
+PathCache::Key::Key(int _source, int _target, int _algorithm)
+{
+	source = _source;
+	target = _target;
+	algorithm = _algorithm;
+}
+
+bool PathCache::Key::operator<(const Key & other) const
+{
+	if (source != other.source)
+		return source < other.source;
+	if (target != other.target)
+		return target < other.target;
+	return algorithm < other.algorithm;
+}
+
+bool PathCache::TreeEntry::reaches(int source, int node) const
+{
+	return node == source || parents[node] != -1;
+}
+
+PathCache::Shard::Shard()
+{
+	hits = 0;
+	misses = 0;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+PathCache::PathCache(size_t capacity, int shardCount, size_t _treeCapacity, int _hotThreshold)
+{
+	if (shardCount < 1)
+		shardCount = 1;
+	for (int i = 0; i < shardCount; i++)
+		shards.push_back(new Shard());
+	shardCapacity = (capacity + shardCount - 1) / shardCount;
+	shardTreeCapacity = (_treeCapacity + shardCount - 1) / shardCount;
+	hotThreshold = _hotThreshold;
+}
+
+PathCache::~PathCache()
+{
+	for (size_t i = 0; i < shards.size(); i++)
+		delete shards[i];
+}
+
+PathCache::Shard * PathCache::shard(const Key & key) const
+{
+	unsigned int hash = (unsigned int)key.source * 2654435761u ^ (unsigned int)key.target * 40503u ^ (unsigned int)key.algorithm;
+	return shards[(hash ^ (hash >> 16)) % shards.size()];
+}
+
+void PathCache::erasePath(Shard * shard, std::map<Key, PathEntry>::iterator iter)
+{
+	shard->usage.erase(iter->second.usage);
+	shard->entries.erase(iter);
+}
+
+void PathCache::eraseTree(Shard * shard, std::map<Key, TreeEntry>::iterator iter)
+{
+	shard->treeUsage.erase(iter->second.usage);
+	shard->trees.erase(iter);
+}
+
+bool PathCache::lookup(int source, int target, int algorithm, PathResult * result)
+{
+	result->edges.clear();
+
+	// Сначала ищем дерево начального узла: оно отвечает на запросы ко всем конечным узлам.
+	Key treeKey(source, -1, algorithm);
+	Shard * treeShard = shard(treeKey);
+	{
+		MutexLocker locker(&treeShard->mutex);
+		std::map<Key, TreeEntry>::iterator tree = treeShard->trees.find(treeKey);
+		if (tree != treeShard->trees.end())
+		{
+			treeShard->treeUsage.splice(treeShard->treeUsage.begin(), treeShard->treeUsage, tree->second.usage);
+			treeShard->hits++;
+			result->totalWeight = tree->second.labels[target];
+			result->nodes.clear();
+			if (tree->second.reaches(source, target))
+			{
+				for (int node = target; node != -1; node = tree->second.parents[node])
+					result->nodes.push_back(node);
+				std::reverse(result->nodes.begin(), result->nodes.end());
+			}
+			return true;
+		}
+		// Считаем запросы из узла, чтобы построить дерево для часто запрашиваемых.
+		if (shardTreeCapacity > 0)
+		{
+			if (treeShard->hotCounts.size() > shardCapacity + 64)
+				treeShard->hotCounts.clear();
+			treeShard->hotCounts[treeKey]++;
+		}
+	}
+
+	Key key(source, target, algorithm);
+	Shard * pathShard = shard(key);
+	MutexLocker locker(&pathShard->mutex);
+	std::map<Key, PathEntry>::iterator iter = pathShard->entries.find(key);
+	if (iter == pathShard->entries.end())
+	{
+		pathShard->misses++;
+		return false;
+	}
+	pathShard->usage.splice(pathShard->usage.begin(), pathShard->usage, iter->second.usage);
+	pathShard->hits++;
+	result->totalWeight = iter->second.totalWeight;
+	result->nodes = iter->second.nodes;
+	return true;
+}
+
+void PathCache::store(int source, int target, int algorithm, const PathResult & result)
+{
+	if (shardCapacity == 0)
+		return;
+	Key key(source, target, algorithm);
+	Shard * pathShard = shard(key);
+	MutexLocker locker(&pathShard->mutex);
+	if (pathShard->entries.find(key) != pathShard->entries.end())
+		return;
+	while (pathShard->entries.size() >= shardCapacity)
+		erasePath(pathShard, pathShard->entries.find(pathShard->usage.back()));
+	pathShard->usage.push_front(key);
+	PathEntry & entry = pathShard->entries[key];
+	entry.totalWeight = result.totalWeight;
+	entry.nodes = result.nodes;
+	entry.usage = pathShard->usage.begin();
+}
+
+bool PathCache::wantsTree(int source, int algorithm)
+{
+	if (shardTreeCapacity == 0)
+		return false;
+	Key treeKey(source, -1, algorithm);
+	Shard * treeShard = shard(treeKey);
+	MutexLocker locker(&treeShard->mutex);
+	std::map<Key, int>::iterator count = treeShard->hotCounts.find(treeKey);
+	if (count == treeShard->hotCounts.end() || count->second < hotThreshold || treeShard->trees.find(treeKey) != treeShard->trees.end())
+		return false;
+	// Сбрасываем счетчик, чтобы дерево строил только один поток.
+	treeShard->hotCounts.erase(count);
+	return true;
+}
+
+void PathCache::storeTree(int source, int algorithm, const std::vector<__int64> & labels, const std::vector<int> & parents)
+{
+	if (shardTreeCapacity == 0)
+		return;
+	Key treeKey(source, -1, algorithm);
+	Shard * treeShard = shard(treeKey);
+	MutexLocker locker(&treeShard->mutex);
+	if (treeShard->trees.find(treeKey) != treeShard->trees.end())
+		return;
+	while (treeShard->trees.size() >= shardTreeCapacity)
+		eraseTree(treeShard, treeShard->trees.find(treeShard->treeUsage.back()));
+	treeShard->treeUsage.push_front(treeKey);
+	TreeEntry & entry = treeShard->trees[treeKey];
+	entry.labels = labels;
+	entry.parents = parents;
+	entry.usage = treeShard->treeUsage.begin();
+}
+
+void PathCache::edgeIncreased(int from, int to)
+{
+	// Путь, не проходящий через дугу, остается кратчайшим: остальные пути могли только удлиниться.
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		Shard * current = shards[i];
+		MutexLocker locker(&current->mutex);
+		for (std::map<Key, TreeEntry>::iterator iter = current->trees.begin(); iter != current->trees.end(); )
+		{
+			std::map<Key, TreeEntry>::iterator next = iter;
+			next++;
+			if (iter->second.parents[to] == from)
+				eraseTree(current, iter);
+			iter = next;
+		}
+		for (std::map<Key, PathEntry>::iterator iter = current->entries.begin(); iter != current->entries.end(); )
+		{
+			std::map<Key, PathEntry>::iterator next = iter;
+			next++;
+			const std::vector<int> & nodes = iter->second.nodes;
+			for (size_t j = 0; j + 1 < nodes.size(); j++)
+				if (nodes[j] == from && nodes[j + 1] == to)
+				{
+					erasePath(current, iter);
+					break;
+				}
+			iter = next;
+		}
+	}
+}
+
+void PathCache::edgeDecreased(int from, int to, __int64 weight)
+{
+	// Расстояния до начала дуги от нее не зависят, поэтому их можно брать из деревьев до удаления устаревших.
+	// Путь той же длины, но с меньшим числом дуг тоже меняет выбранный путь, поэтому сравнение нестрогое.
+	// Для каждого дерева запоминается, достижимо ли начало дуги, и расстояние до него.
+	std::map<Key, std::pair<bool, __int64> > distances;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		Shard * current = shards[i];
+		MutexLocker locker(&current->mutex);
+		for (std::map<Key, TreeEntry>::iterator iter = current->trees.begin(); iter != current->trees.end(); )
+		{
+			std::map<Key, TreeEntry>::iterator next = iter;
+			next++;
+			const TreeEntry & tree = iter->second;
+			bool reached = tree.reaches(iter->first.source, from);
+			distances[iter->first] = std::make_pair(reached, tree.labels[from]);
+			if (reached && (!tree.reaches(iter->first.source, to) || tree.labels[from] + weight <= tree.labels[to]))
+				eraseTree(current, iter);
+			iter = next;
+		}
+	}
+
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		Shard * current = shards[i];
+		MutexLocker locker(&current->mutex);
+		for (std::map<Key, PathEntry>::iterator iter = current->entries.begin(); iter != current->entries.end(); )
+		{
+			std::map<Key, PathEntry>::iterator next = iter;
+			next++;
+			__int64 length = iter->second.totalWeight;
+			bool found = !iter->second.nodes.empty();
+			std::map<Key, std::pair<bool, __int64> >::const_iterator distance = distances.find(Key(iter->first.source, -1, iter->first.algorithm));
+			bool invalid;
+			if (iter->first.source == from)
+				invalid = (!found || weight <= length);
+			else if (distance != distances.end())
+				invalid = distance->second.first && (!found || distance->second.second + weight <= length);
+			else
+				invalid = (!found || weight <= length);
+			if (invalid)
+				erasePath(current, iter);
+			iter = next;
+		}
+	}
+}
+
+void PathCache::patchApplied(const GraphPatch & patch, const std::vector<__int64> & previousWeights, const StaticGraph & graph)
+{
+	invalidatePatch(this, patch, previousWeights, graph);
+}
+
+void PathCache::patchApplied(const GraphPatch & patch, const std::vector<__int64> & previousWeights, const QueryEngine & graph)
+{
+	invalidatePatch(this, patch, previousWeights, graph);
+}
+
+void PathCache::clear()
+{
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		MutexLocker locker(&shards[i]->mutex);
+		shards[i]->entries.clear();
+		shards[i]->usage.clear();
+		shards[i]->trees.clear();
+		shards[i]->treeUsage.clear();
+		shards[i]->hotCounts.clear();
+	}
+}
+
+size_t PathCache::size() const
+{
+	size_t result = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		MutexLocker locker(&shards[i]->mutex);
+		result += shards[i]->entries.size();
+	}
+	return result;
+}
+
+size_t PathCache::treeCount() const
+{
+	size_t result = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		MutexLocker locker(&shards[i]->mutex);
+		result += shards[i]->trees.size();
+	}
+	return result;
+}
+
+long PathCache::hitCount() const
+{
+	long result = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		MutexLocker locker(&shards[i]->mutex);
+		result += shards[i]->hits;
+	}
+	return result;
+}
+
+long PathCache::missCount() const
+{
+	long result = 0;
+	for (size_t i = 0; i < shards.size(); i++)
+	{
+		MutexLocker locker(&shards[i]->mutex);
+		result += shards[i]->misses;
+	}
+	return result;
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <map>
+#include <list>
+#include <vector>
+#include "platform.h"
+#include "staticgraph.h"
+
+class GraphPatch;
+class QueryEngine;
+
+/**
+ * Кэш результатов запросов кратчайшего пути.
+ * Хранит длины и пути для пар (начало, конец, алгоритм), а для часто запрашиваемых начальных узлов - целые деревья кратчайших путей.
+ * Кэш разбит на сегменты со своими мьютексами, поэтому потоки, обращающиеся к разным парам, почти не мешают друг другу.
+ * Емкости делятся между сегментами поровну с округлением вверх.
+ * Вытесняются давно не использованные элементы (LRU).
+ *
+ * При изменении графа вызываются edgeIncreased/edgeDecreased, которые удаляют только те результаты, которые могли измениться:
+ * - увеличение веса или удаление дуги u->v затрагивает только пути и деревья, проходящие через u->v;
+ * - уменьшение веса или добавление дуги u->v веса w затрагивает дерево из s, только если dist(s, u) + w <= dist(s, v),
+ *   и путь s->t длины d, только если через эту дугу можно получить путь не длиннее d (проверяется по дереву из s, если оно есть,
+ *   иначе по условию w <= d): путь той же длины с меньшим числом дуг меняет выбор пути (см. BasicQueryContext).
+ */
+class PathCache
+{
+public:
+	// Алгоритм Дейкстры.
+	static const int ALGORITHM_DIJKSTRA = 0;
+
+	// Количество сегментов по умолчанию.
+	static const int DEFAULT_SHARD_COUNT = 16;
+	// Количество деревьев кратчайших путей по умолчанию.
+	static const int DEFAULT_TREE_CAPACITY = 4;
+	// Количество запросов из одного узла, после которого для него строится дерево.
+	static const int DEFAULT_HOT_THRESHOLD = 8;
+
+private:
+	/**
+	 * Ключ пары.
+	 */
+	struct Key
+	{
+		int source;
+		int target;
+		int algorithm;
+
+		Key(int _source, int _target, int _algorithm);
+		bool operator<(const Key & other) const;
+	};
+
+	/**
+	 * Закэшированный путь: длина и узлы пути.
+	 */
+	struct PathEntry
+	{
+		__int64 totalWeight;			// Длина пути или -1, если пути нет.
+		std::vector<int> nodes;			// Узлы пути; пустой, если пути нет (длина -1 бывает настоящей).
+		std::list<Key>::iterator usage;	// Положение в списке использования.
+	};
+
+	/**
+	 * Закэшированное дерево кратчайших путей.
+	 */
+	struct TreeEntry
+	{
+		std::vector<__int64> labels;	// Длины путей из начального узла.
+		std::vector<int> parents;		// Предыдущие узлы путей.
+		std::list<Key>::iterator usage;	// Положение в списке использования (target ключа не используется).
+
+		// Достижим ли узел из начального; по метке этого не определить, она бывает равна -1 и у достижимого узла.
+		bool reaches(int source, int node) const;
+	};
+
+	/**
+	 * Сегмент кэша. Пары распределяются по сегментам по ключу, деревья и счетчики запросов - по начальному узлу.
+	 */
+	struct Shard
+	{
+		Mutex mutex;
+		std::map<Key, PathEntry> entries;	// Пары.
+		std::list<Key> usage;				// Ключи пар от недавно использованных к давно использованным.
+		std::map<Key, TreeEntry> trees;		// Деревья по ключу (начало, -1, алгоритм).
+		std::list<Key> treeUsage;			// Ключи деревьев от недавно использованных к давно использованным.
+		std::map<Key, int> hotCounts;		// Количество запросов из начальных узлов, для которых еще нет дерева.
+		long hits;							// Количество попаданий.
+		long misses;						// Количество промахов.
+
+		Shard();
+	};
+
+	std::vector<Shard *> shards;			// Сегменты кэша.
+	size_t shardCapacity;					// Количество пар в одном сегменте.
+	size_t shardTreeCapacity;				// Количество деревьев в одном сегменте.
+	int hotThreshold;						// Порог числа запросов для построения дерева.
+
+	Shard * shard(const Key & key) const;
+	static void erasePath(Shard * shard, std::map<Key, PathEntry>::iterator iter);
+	static void eraseTree(Shard * shard, std::map<Key, TreeEntry>::iterator iter);
+
+	PathCache(const PathCache &);
+	PathCache & operator=(const PathCache &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param capacity - максимальное количество закэшированных пар.
+	 * @param shardCount - количество сегментов.
+	 * @param _treeCapacity - максимальное количество закэшированных деревьев (0 - деревья не строятся).
+	 * @param _hotThreshold - количество запросов из одного узла, после которого для него строится дерево.
+	 */
+	PathCache(size_t capacity, int shardCount = DEFAULT_SHARD_COUNT, size_t _treeCapacity = DEFAULT_TREE_CAPACITY, int _hotThreshold = DEFAULT_HOT_THRESHOLD);
+	~PathCache();
+
+	/**
+	 * Поиск результата в кэше: сначала в дереве начального узла, затем среди пар.
+	 * Закэшированный результат содержит только узлы пути, индексы дуг не сохраняются.
+	 * @param source - начальный узел.
+	 * @param target - конечный узел.
+	 * @param algorithm - алгоритм.
+	 * @param result - указатель на результат.
+	 * @return - true, если результат найден в кэше, иначе false.
+	 */
+	bool lookup(int source, int target, int algorithm, PathResult * result);
+
+	/**
+	 * Сохранение результата для пары.
+	 */
+	void store(int source, int target, int algorithm, const PathResult & result);
+
+	/**
+	 * Нужно ли построить дерево для начального узла: узел запрашивался не реже порога, а дерева для него еще нет.
+	 */
+	bool wantsTree(int source, int algorithm);
+
+	/**
+	 * Сохранение дерева кратчайших путей.
+	 * @param source - начальный узел.
+	 * @param algorithm - алгоритм.
+	 * @param labels - длины путей (-1 для недостижимых узлов).
+	 * @param parents - предыдущие узлы путей (-1 для начального и недостижимых узлов; по ним определяется достижимость).
+	 */
+	void storeTree(int source, int algorithm, const std::vector<__int64> & labels, const std::vector<int> & parents);
+
+	/**
+	 * Удаление результатов, которые могли измениться после увеличения веса или удаления дуги.
+	 * @param from - начало дуги.
+	 * @param to - конец дуги.
+	 */
+	void edgeIncreased(int from, int to);
+
+	/**
+	 * Удаление результатов, которые могли измениться после уменьшения веса или добавления дуги.
+	 * @param from - начало дуги.
+	 * @param to - конец дуги.
+	 * @param weight - новый вес дуги.
+	 */
+	void edgeDecreased(int from, int to, __int64 weight);
+
+	/**
+	 * Удаление результатов, которые могли измениться после применения пакета изменений (Graph::applyPatch): для каждого изменения
+	 * вызывается edgeIncreased или edgeDecreased. Добавление узла меняет нумерацию узлов, поэтому в этом случае кэш очищается целиком.
+	 * @param patch - примененный пакет.
+	 * @param previousWeights - прежние веса дуг, возвращенные Graph::applyPatch.
+	 * @param graph - граф, по которому заполнялся кэш (нумерация узлов - до применения пакета).
+	 */
+	void patchApplied(const GraphPatch & patch, const std::vector<__int64> & previousWeights, const StaticGraph & graph);
+
+	/**
+	 * То же для кэша, заполнявшегося по QueryEngine (узлы ищутся в прежней версии графа).
+	 */
+	void patchApplied(const GraphPatch & patch, const std::vector<__int64> & previousWeights, const QueryEngine & graph);
+
+	/**
+	 * Удаление всех результатов.
+	 */
+	void clear();
+
+	/**
+	 * Количество закэшированных пар.
+	 */
+	size_t size() const;
+
+	/**
+	 * Количество закэшированных деревьев.
+	 */
+	size_t treeCount() const;
+
+	/**
+	 * Количество попаданий.
+	 */
+	long hitCount() const;
+
+	/**
+	 * Количество промахов.
+	 */
+	long missCount() const;
+};
@@ -0,0 +1,1024 @@
+#include "platform.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#ifdef _WIN32
+	#include <windows.h>
+	#include <process.h>
+#else
+	#include <errno.h>
+	#include <signal.h>
+	#include <time.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <sys/wait.h>
+#endif
+
+#if defined(PLATFORM_X86) && defined(_MSC_VER)
+	#include <intrin.h>
+#elif defined(PLATFORM_X86)
+	#include <cpuid.h>
+#endif
+
+#ifdef __linux__
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <sched.h>
+	#include <linux/perf_event.h>
+#endif
+
+#ifdef _WIN32
+
+Mutex::Mutex()
+{
+	handle = new CRITICAL_SECTION;
+	InitializeCriticalSection((CRITICAL_SECTION *)handle);
+}
+
+Mutex::~Mutex()
+{
+	DeleteCriticalSection((CRITICAL_SECTION *)handle);
+	delete (CRITICAL_SECTION *)handle;
+}
+
+void Mutex::lock()
+{
+	EnterCriticalSection((CRITICAL_SECTION *)handle);
+}
+
+void Mutex::unlock()
+{
+	LeaveCriticalSection((CRITICAL_SECTION *)handle);
+}
+
+#else
+
+Mutex::Mutex()
+{
+	pthread_mutex_init(&handle, NULL);
+}
+
+Mutex::~Mutex()
+{
+	pthread_mutex_destroy(&handle);
+}
+
+void Mutex::lock()
+{
+	pthread_mutex_lock(&handle);
+}
+
+void Mutex::unlock()
+{
+	pthread_mutex_unlock(&handle);
+}
+
+#endif
+
+/*----------------------------------------------------------------------------------------------------*/
+
+MutexLocker::MutexLocker(Mutex * _mutex)
+{
+	mutex = _mutex;
+	mutex->lock();
+}
+
+MutexLocker::~MutexLocker()
+{
+	mutex->unlock();
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+#ifdef _WIN32
+
+Semaphore::Semaphore(long initialCount)
+{
+	handle = CreateSemaphore(NULL, initialCount, 0x7FFFFFFF, NULL);
+}
+
+Semaphore::~Semaphore()
+{
+	CloseHandle(handle);
+}
+
+void Semaphore::release(long count)
+{
+	ReleaseSemaphore(handle, count, NULL);
+}
+
+void Semaphore::acquire()
+{
+	WaitForSingleObject(handle, INFINITE);
+}
+
+#else
+
+Semaphore::Semaphore(long initialCount)
+{
+	pthread_cond_init(&condition, NULL);
+	count = initialCount;
+}
+
+Semaphore::~Semaphore()
+{
+	pthread_cond_destroy(&condition);
+}
+
+void Semaphore::release(long _count)
+{
+	MutexLocker locker(&mutex);
+	count += _count;
+	pthread_cond_broadcast(&condition);
+}
+
+void Semaphore::acquire()
+{
+	MutexLocker locker(&mutex);
+	while (count <= 0)
+		pthread_cond_wait(&condition, &mutex.handle);
+	count--;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------------------------------*/
+
+Thread::Thread()
+{
+	handle = 0;
+#ifndef _WIN32
+	started = false;
+#endif
+	function = NULL;
+	argument = NULL;
+}
+
+Thread::~Thread()
+{
+	join();
+}
+
+#ifdef _WIN32
+
+unsigned int __stdcall Thread::entry(void * thread)
+{
+	Thread * self = (Thread *)thread;
+	self->function(self->argument);
+	return 0;
+}
+
+bool Thread::start(Function _function, void * _argument)
+{
+	function = _function;
+	argument = _argument;
+	handle = (void *)_beginthreadex(NULL, 0, &Thread::entry, this, 0, NULL);
+	return handle != NULL;
+}
+
+void Thread::join()
+{
+	if (handle == NULL)
+		return;
+	WaitForSingleObject(handle, INFINITE);
+	CloseHandle(handle);
+	handle = NULL;
+}
+
+int Thread::processorCount()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+}
+
+void Thread::sleep(int milliseconds)
+{
+	Sleep((DWORD)milliseconds);
+}
+
+#else
+
+void * Thread::entry(void * thread)
+{
+	Thread * self = (Thread *)thread;
+	self->function(self->argument);
+	return NULL;
+}
+
+bool Thread::start(Function _function, void * _argument)
+{
+	function = _function;
+	argument = _argument;
+	started = (pthread_create(&handle, NULL, &Thread::entry, this) == 0);
+	return started;
+}
+
+void Thread::join()
+{
+	if (!started)
+		return;
+	pthread_join(handle, NULL);
+	started = false;
+}
+
+int Thread::processorCount()
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+void Thread::sleep(int milliseconds)
+{
+	timespec delay;
+	delay.tv_sec = milliseconds / 1000;
+	delay.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+		;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------------------------------*/
+
+#ifdef _WIN32
+
+Process::Process()
+{
+	handle = NULL;
+}
+
+bool Process::start(const std::string & program, const std::vector<std::string> & arguments)
+{
+	// Аргументы собираются в командную строку; кавычки внутри аргументов не поддерживаются.
+	std::string commandLine = "\"" + program + "\"";
+	for (size_t i = 0; i < arguments.size(); i++)
+		commandLine += " \"" + arguments[i] + "\"";
+	std::vector<char> buffer(commandLine.begin(), commandLine.end());
+	buffer.push_back('\0');
+	STARTUPINFOA startup;
+	PROCESS_INFORMATION information;
+	memset(&startup, 0, sizeof(startup));
+	startup.cb = sizeof(startup);
+	if (!CreateProcessA(program.c_str(), &buffer[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup, &information))
+		return false;
+	CloseHandle(information.hThread);
+	handle = information.hProcess;
+	return true;
+}
+
+int Process::wait()
+{
+	if (handle == NULL)
+		return -1;
+	WaitForSingleObject(handle, INFINITE);
+	DWORD code = 0;
+	GetExitCodeProcess(handle, &code);
+	CloseHandle(handle);
+	handle = NULL;
+	return (int)code;
+}
+
+int Process::currentId()
+{
+	return (int)GetCurrentProcessId();
+}
+
+std::string Process::currentProgram()
+{
+	char path[MAX_PATH];
+	DWORD length = GetModuleFileNameA(NULL, path, MAX_PATH);
+	if (length == 0 || length == MAX_PATH)
+		return std::string();
+	return std::string(path, length);
+}
+
+#else
+
+Process::Process()
+{
+	id = -1;
+}
+
+bool Process::start(const std::string & program, const std::vector<std::string> & arguments)
+{
+	std::vector<char *> argv;
+	argv.push_back(const_cast<char *>(program.c_str()));
+	for (size_t i = 0; i < arguments.size(); i++)
+		argv.push_back(const_cast<char *>(arguments[i].c_str()));
+	argv.push_back(NULL);
+	id = fork();
+	if (id == 0)
+	{
+		execv(program.c_str(), &argv[0]);
+		_exit(127);
+	}
+	return id > 0;
+}
+
+int Process::wait()
+{
+	if (id <= 0)
+		return -1;
+	int status = 0;
+	while (waitpid(id, &status, 0) < 0 && errno == EINTR)
+		;
+	id = -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int Process::currentId()
+{
+	return (int)getpid();
+}
+
+std::string Process::currentProgram()
+{
+#ifdef __linux__
+	char path[4096];
+	ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if (length > 0 && length < (ssize_t)sizeof(path))
+		return std::string(path, length);
+#endif
+	return std::string();
+}
+
+#endif
+
+Process::~Process()
+{
+	wait();
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+#ifdef PLATFORM_X86
+
+// Регистры EAX, EBX, ECX, EDX, возвращаемые CPUID для заданного листа (подлист 0).
+static void cpuid(int leaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+	int values[4];
+	__cpuidex(values, leaf, 0);
+	for (int i = 0; i < 4; i++)
+		registers[i] = (unsigned int)values[i];
+#else
+	registers[0] = registers[1] = registers[2] = registers[3] = 0;
+	if ((unsigned int)leaf <= __get_cpuid_max(0, NULL))
+		__cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Сохраняет ли система регистры AVX (XMM и YMM) при переключении потоков.
+static bool avxStateEnabled()
+{
+	unsigned int registers[4];
+	cpuid(1, registers);
+	if (!(registers[2] & (1 << 27)))	// OSXSAVE
+		return false;
+#ifdef _MSC_VER
+	unsigned __int64 mask = _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__ volatile ("xgetbv" : "=a" (low), "=d" (high) : "c" (0));
+	unsigned long long mask = ((unsigned long long)high << 32) | low;
+#endif
+	return (mask & 6) == 6;
+}
+
+bool CpuFeatures::hasSse41()
+{
+	unsigned int registers[4];
+	cpuid(1, registers);
+	return (registers[2] & (1 << 19)) != 0;
+}
+
+bool CpuFeatures::hasAvx2()
+{
+	unsigned int registers[4];
+	cpuid(0, registers);
+	if (registers[0] < 7)
+		return false;
+	cpuid(1, registers);
+	bool avx = (registers[2] & (1 << 28)) != 0;
+	cpuid(7, registers);
+	return avx && (registers[1] & (1 << 5)) != 0 && avxStateEnabled();
+}
+
+#else
+
+bool CpuFeatures::hasSse41()
+{
+	return false;
+}
+
+bool CpuFeatures::hasAvx2()
+{
+	return false;
+}
+
+#endif
+
+/*----------------------------------------------------------------------------------------------------*/
+
+double Timer::seconds()
+{
+#ifdef _WIN32
+	LARGE_INTEGER frequency, counter;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+CacheMissCounter::CacheMissCounter()
+{
+	handle = -1;
+#ifdef __linux__
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.size = sizeof(attributes);
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.disabled = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	handle = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#ifdef __linux__
+	if (handle >= 0)
+		close(handle);
+#endif
+}
+
+bool CacheMissCounter::available() const
+{
+	return handle >= 0;
+}
+
+void CacheMissCounter::start()
+{
+#ifdef __linux__
+	if (handle < 0)
+		return;
+	ioctl(handle, PERF_EVENT_IOC_RESET, 0);
+	ioctl(handle, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+__int64 CacheMissCounter::stop()
+{
+#ifdef __linux__
+	if (handle < 0)
+		return -1;
+	ioctl(handle, PERF_EVENT_IOC_DISABLE, 0);
+	long long count = 0;
+	if (read(handle, &count, sizeof(count)) != sizeof(count))
+		return -1;
+	return count;
+#else
+	return -1;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+/**
+ * Заголовок блока PageMemory, записанный перед данными; занимает PAGE_HEADER_SIZE байт, чтобы данные оставались выровненными.
+ */
+struct PageBlockHeader
+{
+	void * base;		// Начало выделенной памяти.
+	size_t length;		// Длина отображения или 0, если блок выделен malloc.
+	size_t bytes;		// Запрошенный размер.
+	int pages;			// Фактический вид страниц.
+};
+
+static const size_t PAGE_HEADER_SIZE = 64;
+
+static int selectedPages = PageMemory::PAGES_SMALL;
+static size_t allocatedSizes[3] = { 0, 0, 0 };
+static Mutex allocatedMutex;
+
+// Отображение памяти огромными страницами; при неудаче возвращает NULL, и блок выделяется malloc.
+static void * mapPages(size_t bytes, int pages, size_t * length, int * obtained)
+{
+	size_t rounded = (bytes + PageMemory::LARGE_BLOCK - 1) / PageMemory::LARGE_BLOCK * PageMemory::LARGE_BLOCK;
+#if defined(__linux__)
+	void * base = MAP_FAILED;
+	#ifdef MAP_HUGETLB
+	if (pages == PageMemory::PAGES_HUGE)
+	{
+		base = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		*obtained = PageMemory::PAGES_HUGE;
+	}
+	#endif
+	if (base == MAP_FAILED)
+	{
+		// Явные страницы не зарезервированы: обычное отображение с просьбой собрать его из огромных страниц.
+		base = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		*obtained = PageMemory::PAGES_SMALL;
+	#ifdef MADV_HUGEPAGE
+		if (madvise(base, rounded, MADV_HUGEPAGE) == 0)
+			*obtained = PageMemory::PAGES_TRANSPARENT;
+	#endif
+	}
+	*length = rounded;
+	return base;
+#elif defined(_WIN32)
+	// Прозрачных огромных страниц в Windows нет; большие страницы выделяются только при включенной привилегии SeLockMemoryPrivilege.
+	if (pages != PageMemory::PAGES_HUGE)
+		return NULL;
+	static bool privilegeChecked = false;
+	if (!privilegeChecked)
+	{
+		privilegeChecked = true;
+		HANDLE token;
+		if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		{
+			TOKEN_PRIVILEGES privileges;
+			privileges.PrivilegeCount = 1;
+			privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+			if (LookupPrivilegeValueA(NULL, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid))
+				AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+			CloseHandle(token);
+		}
+	}
+	size_t minimum = GetLargePageMinimum();
+	if (minimum == 0)
+		return NULL;
+	rounded = (bytes + minimum - 1) / minimum * minimum;
+	void * base = VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (base == NULL)
+		return NULL;
+	*obtained = PageMemory::PAGES_HUGE;
+	*length = rounded;
+	return base;
+#else
+	return NULL;
+#endif
+}
+
+void PageMemory::setPages(int pages)
+{
+	selectedPages = pages;
+}
+
+int PageMemory::pages()
+{
+	return selectedPages;
+}
+
+bool PageMemory::parse(const std::string & name, int * pages)
+{
+	for (int i = PAGES_SMALL; i <= PAGES_HUGE; i++)
+		if (name == PageMemory::name(i))
+		{
+			*pages = i;
+			return true;
+		}
+	return false;
+}
+
+const char * PageMemory::name(int pages)
+{
+	switch (pages)
+	{
+	case PAGES_SMALL:
+		return "small";
+	case PAGES_TRANSPARENT:
+		return "transparent";
+	case PAGES_HUGE:
+		return "huge";
+	default:
+		return "unknown";
+	}
+}
+
+void * PageMemory::allocate(size_t bytes)
+{
+	int pages = selectedPages;
+	size_t length = 0;
+	int obtained = PAGES_SMALL;
+	char * base = NULL;
+	char * block = NULL;
+	if (pages != PAGES_SMALL && bytes >= LARGE_BLOCK)
+		base = (char *)mapPages(bytes + PAGE_HEADER_SIZE, pages, &length, &obtained);
+	if (base != NULL)
+		block = base + PAGE_HEADER_SIZE;
+	else
+	{
+		// Обычный блок с запасом на выравнивание данных по 64 байтам.
+		base = (char *)malloc(bytes + 2 * PAGE_HEADER_SIZE);
+		if (base == NULL)
+			return NULL;
+		block = base + PAGE_HEADER_SIZE + (PAGE_HEADER_SIZE - (size_t)base % PAGE_HEADER_SIZE) % PAGE_HEADER_SIZE;
+		length = 0;
+		obtained = PAGES_SMALL;
+	}
+	PageBlockHeader * header = (PageBlockHeader *)(block - PAGE_HEADER_SIZE);
+	header->base = base;
+	header->length = length;
+	header->bytes = bytes;
+	header->pages = obtained;
+	if (bytes >= LARGE_BLOCK)
+	{
+		MutexLocker locker(&allocatedMutex);
+		allocatedSizes[obtained] += bytes;
+	}
+	return block;
+}
+
+void PageMemory::release(void * block)
+{
+	if (block == NULL)
+		return;
+	PageBlockHeader * header = (PageBlockHeader *)((char *)block - PAGE_HEADER_SIZE);
+	if (header->bytes >= LARGE_BLOCK)
+	{
+		MutexLocker locker(&allocatedMutex);
+		allocatedSizes[header->pages] -= header->bytes;
+	}
+	if (header->length == 0)
+	{
+		free(header->base);
+		return;
+	}
+#if defined(__linux__)
+	munmap(header->base, header->length);
+#elif defined(_WIN32)
+	VirtualFree(header->base, 0, MEM_RELEASE);
+#endif
+}
+
+size_t PageMemory::allocatedBytes(int pages)
+{
+	MutexLocker locker(&allocatedMutex);
+	return allocatedSizes[pages];
+}
+
+#ifdef __linux__
+// Список процессоров узла NUMA из /sys в виде "0-3,8-11".
+static bool readNodeProcessors(int node, std::vector<int> * processors)
+{
+	char fileName[64];
+	sprintf_s(fileName, sizeof(fileName), "/sys/devices/system/node/node%d/cpulist", node);
+	FILE * file;
+	if (fopen_s(&file, fileName, "r") != 0)
+		return false;
+	processors->clear();
+	int first, last;
+	while (fscanf_s(file, "%d", &first) == 1)
+	{
+		last = first;
+		int separator = fgetc(file);
+		if (separator == '-')
+		{
+			if (fscanf_s(file, "%d", &last) != 1)
+				break;
+			separator = fgetc(file);
+		}
+		for (int processor = first; processor <= last; processor++)
+			processors->push_back(processor);
+		if (separator != ',')
+			break;
+	}
+	fclose(file);
+	return true;
+}
+#endif
+
+int PageMemory::nodeCount()
+{
+#if defined(__linux__)
+	std::vector<int> processors;
+	int count = 0;
+	while (readNodeProcessors(count, &processors))
+		count++;
+	return count > 0 ? count : 1;
+#elif defined(_WIN32)
+	ULONG highest = 0;
+	if (!GetNumaHighestNodeNumber(&highest))
+		return 1;
+	return (int)highest + 1;
+#else
+	return 1;
+#endif
+}
+
+bool PageMemory::bindThread(int node)
+{
+#if defined(__linux__)
+	std::vector<int> processors;
+	if (!readNodeProcessors(node, &processors) || processors.empty())
+		return false;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (size_t i = 0; i < processors.size(); i++)
+		if (processors[i] < CPU_SETSIZE)
+			CPU_SET(processors[i], &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	ULONGLONG mask = 0;
+	if (!GetNumaNodeProcessorMask((UCHAR)node, &mask) || mask == 0)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)mask) != 0;
+#else
+	return false;
+#endif
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+Channel::~Channel()
+{
+}
+
+bool StdChannel::readLine(std::string * line)
+{
+	char buf[4096];
+	line->clear();
+	while (fgets(buf, sizeof(buf), stdin) != NULL)
+	{
+		line->append(buf);
+		if (!line->empty() && (*line)[line->size() - 1] == '\n')
+			break;
+	}
+	if (line->empty())
+		return false;
+	// Убираем перевод строки, в том числе в формате Windows.
+	while (!line->empty() && ((*line)[line->size() - 1] == '\n' || (*line)[line->size() - 1] == '\r'))
+		line->erase(line->size() - 1);
+	return true;
+}
+
+bool StdChannel::writeLine(const std::string & line)
+{
+	if (fputs(line.c_str(), stdout) < 0 || fputc('\n', stdout) == EOF)
+		return false;
+	return fflush(stdout) == 0;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+#ifdef _WIN32
+LocalChannel::LocalChannel(void * _handle)
+#else
+LocalChannel::LocalChannel(int _handle)
+#endif
+{
+	handle = _handle;
+	bufferStart = 0;
+	bufferEnd = 0;
+}
+
+LocalChannel::~LocalChannel()
+{
+#ifdef _WIN32
+	FlushFileBuffers(handle);
+	DisconnectNamedPipe(handle);
+	CloseHandle(handle);
+#else
+	close(handle);
+#endif
+}
+
+bool LocalChannel::readLine(std::string * line)
+{
+	line->clear();
+	for (;;)
+	{
+		// Ищем перевод строки в уже прочитанных данных.
+		for (size_t i = bufferStart; i < bufferEnd; i++)
+			if (buffer[i] == '\n')
+			{
+				line->append(buffer + bufferStart, i - bufferStart);
+				bufferStart = i + 1;
+				if (!line->empty() && (*line)[line->size() - 1] == '\r')
+					line->erase(line->size() - 1);
+				return true;
+			}
+		line->append(buffer + bufferStart, bufferEnd - bufferStart);
+		bufferStart = 0;
+		bufferEnd = 0;
+
+#ifdef _WIN32
+		DWORD count = 0;
+		if (!ReadFile(handle, buffer, sizeof(buffer), &count, NULL))
+			count = 0;
+#else
+		ssize_t count = recv(handle, buffer, sizeof(buffer), 0);
+		if (count < 0 && errno == EINTR)
+			continue;
+#endif
+		if (count <= 0)
+			return !line->empty();	// Последняя строка может быть без перевода строки.
+		bufferEnd = (size_t)count;
+	}
+}
+
+bool LocalChannel::writeLine(const std::string & line)
+{
+	std::string data = line + "\n";
+	size_t written = 0;
+	while (written < data.size())
+	{
+#ifdef _WIN32
+		DWORD count = 0;
+		if (!WriteFile(handle, data.c_str() + written, (DWORD)(data.size() - written), &count, NULL))
+			return false;
+#else
+		ssize_t count = send(handle, data.c_str() + written, data.size() - written, 0);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			return false;
+#endif
+		written += (size_t)count;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+
+LocalChannel * LocalChannel::connect(const std::string & name, int timeoutMilliseconds)
+{
+	const std::string prefix = "\\\\.\\pipe\\";
+	std::string pipeName = (name.compare(0, prefix.size(), prefix) == 0) ? name : prefix + name;
+	// Канал появляется, когда сервер вызывает accept; до этого подключение повторяется.
+	for (int waited = 0; ; waited += 10)
+	{
+		HANDLE pipe = CreateFileA(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+		if (pipe != INVALID_HANDLE_VALUE)
+			return new LocalChannel(pipe);
+		if (waited >= timeoutMilliseconds)
+			return NULL;
+		if (GetLastError() == ERROR_PIPE_BUSY)
+			WaitNamedPipeA(pipeName.c_str(), 10);
+		else
+			Sleep(10);
+	}
+}
+
+#else
+
+LocalChannel * LocalChannel::connect(const std::string & name, int timeoutMilliseconds)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (name.size() >= sizeof(address.sun_path))
+		return NULL;
+	strcpy(address.sun_path, name.c_str());
+	signal(SIGPIPE, SIG_IGN);
+	// Сокет появляется, когда сервер вызывает listen; до этого подключение повторяется.
+	for (int waited = 0; ; waited += 10)
+	{
+		int handle = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (handle < 0)
+			return NULL;
+		if (::connect(handle, (sockaddr *)&address, sizeof(address)) == 0)
+			return new LocalChannel(handle);
+		close(handle);
+		if (waited >= timeoutMilliseconds)
+			return NULL;
+		usleep(10000);
+	}
+}
+
+#endif
+
+/*----------------------------------------------------------------------------------------------------*/
+
+// Пауза перед повторным приемом соединения при нехватке ресурсов (мс): удваивается от первой до последней.
+static const int ACCEPT_MIN_DELAY = 10;
+static const int ACCEPT_MAX_DELAY = 1000;
+
+LocalListener::LocalListener()
+{
+#ifndef _WIN32
+	handle = -1;
+#endif
+}
+
+LocalListener::~LocalListener()
+{
+#ifndef _WIN32
+	if (handle >= 0)
+	{
+		close(handle);
+		unlink(name.c_str());
+	}
+#endif
+}
+
+std::string LocalListener::uniqueName(const std::string & tag)
+{
+	char name[128];
+#ifdef _WIN32
+	sprintf_s(name, sizeof(name), "dijkstra-%d-%s", Process::currentId(), tag.c_str());
+#else
+	sprintf_s(name, sizeof(name), "/tmp/dijkstra-%d-%s.sock", Process::currentId(), tag.c_str());
+#endif
+	return name;
+}
+
+#ifdef _WIN32
+
+bool LocalListener::listen(const std::string & _name)
+{
+	const std::string prefix = "\\\\.\\pipe\\";
+	name = (_name.compare(0, prefix.size(), prefix) == 0) ? _name : prefix + _name;
+	return true;
+}
+
+LocalChannel * LocalListener::accept()
+{
+	int delay = ACCEPT_MIN_DELAY;
+	for (;;)
+	{
+		// Для каждого клиента создается свой экземпляр именованного канала.
+		HANDLE pipe = CreateNamedPipeA(name.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, NULL);
+		if (pipe == INVALID_HANDLE_VALUE)
+		{
+			DWORD error = GetLastError();
+			if (error != ERROR_NO_SYSTEM_RESOURCES && error != ERROR_NOT_ENOUGH_MEMORY && error != ERROR_PIPE_BUSY)
+				return NULL;
+			Thread::sleep(delay);
+			delay = std::min(delay * 2, ACCEPT_MAX_DELAY);
+			continue;
+		}
+		if (ConnectNamedPipe(pipe, NULL) || GetLastError() == ERROR_PIPE_CONNECTED)
+			return new LocalChannel(pipe);
+		// Клиент успел отключиться: ждем следующего.
+		DWORD error = GetLastError();
+		CloseHandle(pipe);
+		if (error != ERROR_NO_DATA)
+			return NULL;
+	}
+}
+
+#else
+
+bool LocalListener::listen(const std::string & _name)
+{
+	name = _name;
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (name.size() >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, name.c_str());
+
+	// Запись в закрытое клиентом соединение не должна завершать сервер.
+	signal(SIGPIPE, SIG_IGN);
+	handle = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (handle < 0)
+		return false;
+	unlink(name.c_str());
+	if (bind(handle, (sockaddr *)&address, sizeof(address)) < 0 || ::listen(handle, 16) < 0)
+	{
+		close(handle);
+		handle = -1;
+		return false;
+	}
+	return true;
+}
+
+LocalChannel * LocalListener::accept()
+{
+	int delay = ACCEPT_MIN_DELAY;
+	for (;;)
+	{
+		int client = ::accept(handle, NULL, NULL);
+		if (client >= 0)
+			return new LocalChannel(client);
+		// Прерванный вызов и клиент, отключившийся до приема, не мешают ждать следующего.
+		if (errno == EINTR || errno == ECONNABORTED || errno == EPROTO)
+			continue;
+		// Дескрипторы или память освободятся, когда закроются другие соединения: соединение ждет в очереди, пока прием повторяется.
+		if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+		{
+			Thread::sleep(delay);
+			delay = std::min(delay * 2, ACCEPT_MAX_DELAY);
+			continue;
+		}
+		return NULL;
+	}
+}
+
+#endif
@@ -0,0 +1,616 @@
+#pragma once
+#include <stdio.h>
+#include <stddef.h>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * Платформенно-зависимые средства: типы и функции CRT, отсутствующие вне MSVC, потоки, синхронизация и локальные соединения.
+ * На Windows используются Win32 API и именованные каналы, на остальных системах - pthreads и сокеты домена Unix.
+ */
+
+#ifdef _MSC_VER
+	#include <io.h>
+
+	// Формат 64-битного целого для printf/scanf.
+	#define INT64_FORMAT "%I64d"
+#else
+	#include <unistd.h>
+	#include <pthread.h>
+
+	typedef long long __int64;
+	#define INT64_FORMAT "%lld"
+
+	inline int fopen_s(FILE ** file, const char * fileName, const char * mode)
+	{
+		*file = fopen(fileName, mode);
+		return (*file == NULL);
+	}
+	#define fscanf_s fscanf
+	#define sscanf_s sscanf
+	#define fprintf_s fprintf
+	#define sprintf_s snprintf
+	#define _unlink unlink
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	// Процессор семейства x86: доступны CPUID и векторные расширения SSE/AVX.
+	#define PLATFORM_X86
+	#include <xmmintrin.h>
+#endif
+
+/**
+ * Предварительная загрузка в кэш данных, которые скоро будут прочитаны.
+ */
+inline void prefetchRead(const void * address)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(address);
+#elif defined(PLATFORM_X86)
+	_mm_prefetch((const char *)address, _MM_HINT_T0);
+#endif
+}
+
+/**
+ * Переход к позиции от начала файла; позиции за 2 ГБ поддерживаются и 32-битными программами.
+ * @return - 0 при успехе.
+ */
+inline int seekFile(FILE * file, __int64 offset)
+{
+#ifdef _MSC_VER
+	return _fseeki64(file, offset, SEEK_SET);
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+/**
+ * Размер открытого файла; позиция в файле после вызова - его конец.
+ */
+inline __int64 fileLength(FILE * file)
+{
+#ifdef _MSC_VER
+	_fseeki64(file, 0, SEEK_END);
+	return _ftelli64(file);
+#else
+	fseeko(file, 0, SEEK_END);
+	return (__int64)ftello(file);
+#endif
+}
+
+/**
+ * Запись буферов файла на диск: после успешного вызова данные переживут сбой питания.
+ * @return - 0 при успехе.
+ */
+inline int syncFile(FILE * file)
+{
+	if (fflush(file) != 0)
+		return -1;
+#ifdef _MSC_VER
+	return _commit(_fileno(file));
+#else
+	return fsync(fileno(file));
+#endif
+}
+
+/**
+ * Усечение открытого файла до заданной длины (данные в буферах предварительно записываются).
+ * @return - 0 при успехе.
+ */
+inline int truncateFile(FILE * file, __int64 length)
+{
+	if (fflush(file) != 0)
+		return -1;
+#ifdef _MSC_VER
+	return _chsize_s(_fileno(file), length);
+#else
+	return ftruncate(fileno(file), (off_t)length);
+#endif
+}
+
+/**
+ * Мьютекс.
+ */
+class Mutex
+{
+private:
+#ifdef _WIN32
+	void * handle;			// CRITICAL_SECTION, выделяемая динамически, чтобы не подключать windows.h в заголовке.
+#else
+	pthread_mutex_t handle;
+#endif
+
+	friend class Semaphore;
+
+	Mutex(const Mutex &);
+	Mutex & operator=(const Mutex &);
+
+public:
+	Mutex();
+	~Mutex();
+	void lock();
+	void unlock();
+};
+
+/**
+ * Захват мьютекса на время жизни объекта.
+ */
+class MutexLocker
+{
+private:
+	Mutex * mutex;
+
+public:
+	MutexLocker(Mutex * _mutex);
+	~MutexLocker();
+};
+
+/**
+ * Семафор со счетчиком.
+ */
+class Semaphore
+{
+private:
+#ifdef _WIN32
+	void * handle;
+#else
+	Mutex mutex;
+	pthread_cond_t condition;
+	long count;
+#endif
+
+	Semaphore(const Semaphore &);
+	Semaphore & operator=(const Semaphore &);
+
+public:
+	Semaphore(long initialCount = 0);
+	~Semaphore();
+
+	/**
+	 * Увеличивает счетчик на count, пробуждая ожидающие потоки.
+	 */
+	void release(long count = 1);
+
+	/**
+	 * Ожидает, пока счетчик станет положительным, и уменьшает его на единицу.
+	 */
+	void acquire();
+};
+
+/**
+ * Поток выполнения.
+ */
+class Thread
+{
+public:
+	typedef void (* Function)(void * argument);
+
+private:
+#ifdef _WIN32
+	void * handle;
+#else
+	pthread_t handle;
+	bool started;
+#endif
+	Function function;		// Функция, выполняемая в потоке.
+	void * argument;		// Аргумент функции.
+
+#ifdef _WIN32
+	static unsigned int __stdcall entry(void * thread);
+#else
+	static void * entry(void * thread);
+#endif
+
+	Thread(const Thread &);
+	Thread & operator=(const Thread &);
+
+public:
+	Thread();
+
+	/**
+	 * Деструктор. Дожидается завершения потока.
+	 */
+	~Thread();
+
+	/**
+	 * Запускает функцию в новом потоке.
+	 * @param _function - функция.
+	 * @param _argument - аргумент функции.
+	 * @return - true, если поток запущен, иначе false.
+	 */
+	bool start(Function _function, void * _argument);
+
+	/**
+	 * Дожидается завершения потока.
+	 */
+	void join();
+
+	/**
+	 * Количество логических процессоров.
+	 */
+	static int processorCount();
+
+	/**
+	 * Приостанавливает текущий поток.
+	 * @param milliseconds - время в миллисекундах.
+	 */
+	static void sleep(int milliseconds);
+};
+
+/**
+ * Дочерний процесс.
+ */
+class Process
+{
+private:
+#ifdef _WIN32
+	void * handle;
+#else
+	int id;
+#endif
+
+	Process(const Process &);
+	Process & operator=(const Process &);
+
+public:
+	Process();
+
+	/**
+	 * Деструктор. Дожидается завершения процесса.
+	 */
+	~Process();
+
+	/**
+	 * Запуск программы.
+	 * @param program - путь к исполняемому файлу.
+	 * @param arguments - аргументы командной строки без имени программы.
+	 * @return - true, если процесс запущен, иначе false.
+	 */
+	bool start(const std::string & program, const std::vector<std::string> & arguments);
+
+	/**
+	 * Дожидается завершения процесса.
+	 * @return - код завершения или -1, если процесс не запущен.
+	 */
+	int wait();
+
+	/**
+	 * Идентификатор текущего процесса.
+	 */
+	static int currentId();
+
+	/**
+	 * Путь к исполняемому файлу текущего процесса.
+	 * @return - полный путь или пустая строка, если его не удалось определить (на POSIX поддерживается только Linux).
+	 */
+	static std::string currentProgram();
+};
+
+/**
+ * Векторные расширения процессора, доступные программе (проверяются и поддержка процессором, и сохранение регистров системой).
+ */
+class CpuFeatures
+{
+public:
+	/**
+	 * Доступен ли SSE4.1.
+	 */
+	static bool hasSse41();
+
+	/**
+	 * Доступен ли AVX2.
+	 */
+	static bool hasAvx2();
+};
+
+/**
+ * Измерение времени.
+ */
+class Timer
+{
+public:
+	/**
+	 * Время в секундах от некоторого момента; используется только для вычисления интервалов.
+	 */
+	static double seconds();
+};
+
+/**
+ * Счетчик промахов кэша процессора в текущем потоке (perf_event_open). На других системах недоступен.
+ */
+class CacheMissCounter
+{
+private:
+	int handle;				// Дескриптор счетчика или -1.
+
+	CacheMissCounter(const CacheMissCounter &);
+	CacheMissCounter & operator=(const CacheMissCounter &);
+
+public:
+	CacheMissCounter();
+	~CacheMissCounter();
+
+	/**
+	 * Доступен ли счетчик.
+	 */
+	bool available() const;
+
+	/**
+	 * Обнуляет счетчик и начинает счет.
+	 */
+	void start();
+
+	/**
+	 * Останавливает счет.
+	 * @return - количество промахов с момента вызова start или -1, если счетчик недоступен.
+	 */
+	__int64 stop();
+};
+
+/**
+ * Память под большие массивы графа и рабочей памяти запросов.
+ * Блоки от LARGE_BLOCK байт могут выделяться огромными страницами, что сокращает промахи TLB при случайных обращениях к меткам и дугам:
+ *   PAGES_TRANSPARENT - отдельное отображение с madvise(MADV_HUGEPAGE), прозрачные огромные страницы Linux;
+ *   PAGES_HUGE - явные огромные страницы (MAP_HUGETLB в Linux, MEM_LARGE_PAGES в Windows), если они зарезервированы
+ *                или у процесса есть привилегия; иначе - как PAGES_TRANSPARENT.
+ * Если нужный вид памяти недоступен, блок выделяется следующим по списку способом, а в конце - обычным malloc, поэтому
+ * выбор способа влияет только на скорость. Меньшие блоки всегда выделяются malloc.
+ *
+ * Память узла NUMA выделяется системой при первой записи в страницу (first touch), поэтому массивы, заполненные потоком,
+ * привязанным к узлу (bindThread), размещаются в памяти этого узла.
+ */
+class PageMemory
+{
+public:
+	// Обычные страницы (malloc); по умолчанию.
+	static const int PAGES_SMALL = 0;
+	// Прозрачные огромные страницы.
+	static const int PAGES_TRANSPARENT = 1;
+	// Явные огромные страницы.
+	static const int PAGES_HUGE = 2;
+
+	// Наименьший блок, для которого используются огромные страницы (размер одной огромной страницы x86).
+	static const size_t LARGE_BLOCK = 2 * 1024 * 1024;
+
+	/**
+	 * Выбор вида страниц для следующих выделений; уже выделенные блоки не меняются.
+	 * Вызывается при запуске, до построения графов.
+	 * @param pages - вид страниц (PAGES_*).
+	 */
+	static void setPages(int pages);
+
+	/**
+	 * Выбранный вид страниц.
+	 */
+	static int pages();
+
+	/**
+	 * Разбор названия вида страниц: small, transparent или huge.
+	 * @return - true, если название известно, иначе false.
+	 */
+	static bool parse(const std::string & name, int * pages);
+
+	/**
+	 * Название вида страниц.
+	 */
+	static const char * name(int pages);
+
+	/**
+	 * Выделение блока.
+	 * @param bytes - размер блока.
+	 * @return - блок, выровненный на 64 байта, или NULL, если памяти нет.
+	 */
+	static void * allocate(size_t bytes);
+
+	/**
+	 * Освобождение блока, выделенного allocate; NULL игнорируется.
+	 */
+	static void release(void * block);
+
+	/**
+	 * Объем выделенных сейчас блоков, фактически получивших заданный вид страниц, в байтах.
+	 * @param pages - вид страниц (PAGES_*).
+	 */
+	static size_t allocatedBytes(int pages);
+
+	/**
+	 * Количество узлов NUMA (1, если система их не сообщает).
+	 */
+	static int nodeCount();
+
+	/**
+	 * Привязка текущего потока к процессорам узла NUMA.
+	 * @param node - номер узла.
+	 * @return - true, если поток привязан, иначе false (поток выполняется на любых процессорах).
+	 */
+	static bool bindThread(int node);
+};
+
+/**
+ * Распределитель памяти для std::vector, выделяющий блоки через PageMemory.
+ */
+template <typename T>
+class PageAllocator
+{
+public:
+	typedef T value_type;
+	typedef T * pointer;
+	typedef const T * const_pointer;
+	typedef T & reference;
+	typedef const T & const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef PageAllocator<U> other;
+	};
+
+	PageAllocator()
+	{
+	}
+
+	template <typename U>
+	PageAllocator(const PageAllocator<U> &)
+	{
+	}
+
+	pointer address(reference value) const
+	{
+		return &value;
+	}
+
+	const_pointer address(const_reference value) const
+	{
+		return &value;
+	}
+
+	pointer allocate(size_type count, const void * = NULL)
+	{
+		void * block = PageMemory::allocate(count * sizeof(T));
+		if (block == NULL)
+			throw std::bad_alloc();
+		return (pointer)block;
+	}
+
+	void deallocate(pointer block, size_type)
+	{
+		PageMemory::release(block);
+	}
+
+	size_type max_size() const
+	{
+		return (size_type)-1 / sizeof(T);
+	}
+
+	void construct(pointer place, const T & value)
+	{
+		new ((void *)place) T(value);
+	}
+
+	void destroy(pointer place)
+	{
+		place->~T();
+	}
+
+	bool operator==(const PageAllocator &) const
+	{
+		return true;
+	}
+
+	bool operator!=(const PageAllocator &) const
+	{
+		return false;
+	}
+};
+
+/**
+ * Двунаправленный построчный канал связи с клиентом.
+ */
+class Channel
+{
+public:
+	virtual ~Channel();
+
+	/**
+	 * Чтение строки без символов перевода строки.
+	 * @param line - указатель на строку, в которую запишется результат.
+	 * @return - true, если строка прочитана, false при закрытии канала.
+	 */
+	virtual bool readLine(std::string * line) = 0;
+
+	/**
+	 * Запись строки; перевод строки добавляется автоматически.
+	 * @param line - строка.
+	 * @return - true, если строка записана, иначе false.
+	 */
+	virtual bool writeLine(const std::string & line) = 0;
+};
+
+/**
+ * Канал через стандартные потоки ввода и вывода.
+ */
+class StdChannel : public Channel
+{
+public:
+	bool readLine(std::string * line);
+	bool writeLine(const std::string & line);
+};
+
+/**
+ * Локальное соединение: именованный канал Windows или сокет домена Unix.
+ */
+class LocalChannel : public Channel
+{
+private:
+#ifdef _WIN32
+	void * handle;
+#else
+	int handle;
+#endif
+	char buffer[4096];		// Буфер чтения.
+	size_t bufferStart;		// Начало непрочитанных данных в буфере.
+	size_t bufferEnd;		// Конец непрочитанных данных в буфере.
+
+	LocalChannel(const LocalChannel &);
+	LocalChannel & operator=(const LocalChannel &);
+
+public:
+#ifdef _WIN32
+	LocalChannel(void * _handle);
+#else
+	LocalChannel(int _handle);
+#endif
+	~LocalChannel();
+
+	/**
+	 * Соединение с LocalListener.
+	 * @param name - имя, переданное LocalListener::listen.
+	 * @param timeoutMilliseconds - сколько ждать, пока слушающий процесс начнет принимать соединения.
+	 * @return - канал или NULL, если соединиться не удалось. Канал удаляет вызывающий.
+	 */
+	static LocalChannel * connect(const std::string & name, int timeoutMilliseconds);
+	bool readLine(std::string * line);
+	bool writeLine(const std::string & line);
+};
+
+/**
+ * Ожидание локальных соединений.
+ */
+class LocalListener
+{
+private:
+	std::string name;		// Имя канала или путь к сокету.
+#ifndef _WIN32
+	int handle;
+#endif
+
+	LocalListener(const LocalListener &);
+	LocalListener & operator=(const LocalListener &);
+
+public:
+	LocalListener();
+	~LocalListener();
+
+	/**
+	 * Начинает ожидание соединений.
+	 * @param _name - имя именованного канала (на Windows префикс \\.\pipe\ добавляется автоматически) или путь к сокету.
+	 * @return - true, если удалось, иначе false.
+	 */
+	bool listen(const std::string & _name);
+
+	/**
+	 * Имя для listen, не занятое другими процессами: имя канала на Windows, путь во временном каталоге на остальных системах.
+	 * @param tag - часть имени, различающая соединения одного процесса.
+	 */
+	static std::string uniqueName(const std::string & tag);
+
+	/**
+	 * Дожидается очередного соединения. Временные ошибки (прерванный вызов, клиент, отключившийся до приема,
+	 * нехватка дескрипторов или памяти) не прерывают ожидание: при нехватке ресурсов прием повторяется с растущей паузой.
+	 * @return - канал нового соединения или NULL при неустранимой ошибке. Канал удаляет вызывающий.
+	 */
+	LocalChannel * accept();
+};
@@ -0,0 +1,396 @@
+#include "queryengine.h"
+#include "reachability.h"
+#include <limits.h>
+#include <algorithm>
+
+// Сумма весов всех дуг - верхняя граница длины любого кратчайшего пути; при переполнении возвращается наибольшее значение __int64.
+static __int64 weightBound(const StaticGraph & graph)
+{
+	const __int64 limit = 0x7FFFFFFFFFFFFFFFLL;
+	__int64 sum = 0;
+	for (int edge = 0; edge < graph.edgeCount(); edge++)
+	{
+		if (graph.edgeWeight(edge) > limit - sum)
+			return limit;
+		sum += graph.edgeWeight(edge);
+	}
+	return sum;
+}
+
+// Наибольшая длина пути, которую точно хранит тип веса.
+static __int64 weightLimit(short)
+{
+	return SHRT_MAX;
+}
+
+static __int64 weightLimit(int)
+{
+	return INT_MAX;
+}
+
+static __int64 weightLimit(__int64)
+{
+	return 0x7FFFFFFFFFFFFFFFLL;
+}
+
+static __int64 weightLimit(double)
+{
+	return 1LL << 53;
+}
+
+/**
+ * Рабочая память запросов к графу с конкретными типами.
+ * Если веса графа приведены (BasicStaticGraph::reweight), поиск идет по приведенным весам, а длины переводятся обратно в исходные.
+ */
+template <typename TWeight, typename TIndex>
+class BasicEngineContext : public EngineContext
+{
+private:
+	BasicQueryContext<TWeight, TIndex> context;
+	const BasicStaticGraph<TWeight, TIndex> * graph;
+	BasicPathResult<TWeight> path;		// Результат в типе графа; переиспользуется между запросами.
+	std::vector<BasicPathResult<TWeight> > paths;	// Результаты поиска до нескольких узлов в типе графа.
+	std::vector<TWeight> labels;
+	std::vector<TWeight> offsets;		// Смещения источников в типе графа.
+	std::vector<__int64> shifted;		// Смещения источников с учетом потенциалов.
+	std::vector<std::pair<__int64, int> > order;	// Расстояния и номера найденных узлов изохроны для сортировки.
+	std::vector<int> found;				// Найденные узлы изохроны в порядке приведенных расстояний.
+	__int64 offsetLimit;				// Наибольшее смещение, при котором длины путей не переполняют тип веса.
+	__int64 potentialRange;				// Разность наибольшего и наименьшего потенциалов узлов (0 без приведения).
+	__int64 maxDistance;				// Ограничение расстояния бюджета в исходных весах (-1 без ограничения или без приведения).
+
+	// Перевод смещений в тип графа; false, если смещений не столько же, сколько источников, или какое-то смещение не подходит.
+	bool convertOffsets(const std::vector<__int64> & source, size_t sourceCount)
+	{
+		if (!source.empty() && source.size() != sourceCount)
+			return false;
+		offsets.resize(source.size());
+		for (size_t i = 0; i < source.size(); i++)
+		{
+			if (source[i] < 0 || source[i] > offsetLimit)
+				return false;
+			offsets[i] = (TWeight)source[i];
+		}
+		return true;
+	}
+
+	// Приведенная длина пути из источника s на p(s) - p(t) больше исходной, поэтому к смещению источника добавляется -p(s) >= 0,
+	// и приведенная длина пути со смещением отличается от исходной только на -p(t). Неверные смещения не меняются и отклоняются convertOffsets.
+	const std::vector<__int64> & shiftOffsets(const std::vector<int> & sources, const std::vector<__int64> & sourceOffsets)
+	{
+		if (!graph->reweighted() || (!sourceOffsets.empty() && sourceOffsets.size() != sources.size()))
+			return sourceOffsets;
+		shifted.resize(sources.size());
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			__int64 offset = sourceOffsets.empty() ? 0 : sourceOffsets[i];
+			shifted[i] = (offset < 0 || offset > offsetLimit) ? offset : offset - graph->potential(sources[i]);
+		}
+		return shifted;
+	}
+
+	// Перевод результата в исходные веса: shift - разность исходной и приведенной длин пути.
+	// Путь длиннее ограничения бюджета считается ненайденным, как и в графе без приведения.
+	bool convertPath(bool pathFound, __int64 shift, BasicPathResult<TWeight> * source, PathResult * result)
+	{
+		result->totalWeight = pathFound ? (__int64)source->totalWeight + shift : -1;
+		if (pathFound && maxDistance >= 0 && result->totalWeight > maxDistance)
+		{
+			pathFound = false;
+			result->totalWeight = -1;
+			source->nodes.clear();
+			source->edges.clear();
+		}
+		result->nodes.swap(source->nodes);
+		result->edges.swap(source->edges);
+		return pathFound;
+	}
+
+	// Перевод меток дерева путей или разбиения в исходные веса: к метке узла v добавляется p(v) и общий для всех узлов сдвиг.
+	// Приведенные метки неотрицательны, поэтому -1 среди них означает недостижимый узел; в исходных весах -1 может быть и расстоянием,
+	// так что недостижимость вызывающий определяет по предыдущему узлу или источнику.
+	void convertLabels(__int64 shift, std::vector<__int64> * result)
+	{
+		result->resize(labels.size());
+		for (size_t i = 0; i < labels.size(); i++)
+			(*result)[i] = (labels[i] == -1) ? -1 : (__int64)labels[i] + shift + graph->potential((int)i);
+	}
+
+public:
+	BasicEngineContext(const BasicStaticGraph<TWeight, TIndex> * _graph, const ReachabilityIndex * reachability, __int64 _offsetLimit, __int64 _potentialRange) : context(_graph)
+	{
+		context.setReachability(reachability);
+		graph = _graph;
+		offsetLimit = _offsetLimit;
+		potentialRange = _potentialRange;
+		maxDistance = -1;
+	}
+
+	bool findPath(int start, int end, PathResult * result)
+	{
+		bool pathFound = context.findPath(start, end, &path);
+		return convertPath(pathFound, graph->potential(end) - graph->potential(start), &path, result);
+	}
+
+	int findPaths(int start, const std::vector<int> & ends, std::vector<PathResult> * results)
+	{
+		context.findPaths(start, ends, &paths);
+		results->resize(paths.size());
+		int foundCount = 0;
+		for (size_t i = 0; i < paths.size(); i++)
+			if (convertPath(paths[i].totalWeight != -1, graph->potential(ends[i]) - graph->potential(start), &paths[i], &(*results)[i]))
+				foundCount++;
+		return foundCount;
+	}
+
+	void computeTree(int start, std::vector<__int64> * treeLabels, std::vector<int> * treeParents)
+	{
+		context.computeTree(start, &labels, treeParents);
+		convertLabels(-graph->potential(start), treeLabels);
+	}
+
+	bool findNearest(const std::vector<int> & sources, const std::vector<__int64> & sourceOffsets, int end, PathResult * result, int * source)
+	{
+		result->totalWeight = -1;
+		result->nodes.clear();
+		result->edges.clear();
+		*source = -1;
+		const std::vector<__int64> & adjusted = shiftOffsets(sources, sourceOffsets);
+		if (!convertOffsets(adjusted, sources.size()))
+			return false;
+		bool pathFound = context.findNearest(sources, adjusted.empty() ? NULL : &offsets, end, &path, source);
+		if (!convertPath(pathFound, graph->potential(end), &path, result))
+		{
+			*source = -1;
+			return false;
+		}
+		return true;
+	}
+
+	bool computeNearest(const std::vector<int> & sources, const std::vector<__int64> & sourceOffsets, std::vector<__int64> * nearestLabels, std::vector<int> * nearestSources, std::vector<int> * nearestParents)
+	{
+		const std::vector<__int64> & adjusted = shiftOffsets(sources, sourceOffsets);
+		if (!convertOffsets(adjusted, sources.size()))
+			return false;
+		context.computeNearest(sources, adjusted.empty() ? NULL : &offsets, &labels, nearestSources, nearestParents);
+		convertLabels(0, nearestLabels);
+		return true;
+	}
+
+	bool computeWithin(int start, __int64 radius, std::vector<int> * nodes, std::vector<__int64> * distances)
+	{
+		if (!graph->reweighted())
+		{
+			bool complete = context.computeWithin(start, radius, nodes, &labels);
+			distances->resize(labels.size());
+			for (size_t i = 0; i < labels.size(); i++)
+				(*distances)[i] = (__int64)labels[i];
+			return complete;
+		}
+
+		// Приведенное расстояние до узла v в радиусе не больше radius + p(start) - p(v) <= radius + p(start) + potentialRange,
+		// поэтому поиск идет в этом радиусе, лишние узлы отбрасываются, а порядок по исходным расстояниям восстанавливается сортировкой.
+		// Лишние узлы не расходуют лимит обработанных узлов: он относится к узлам в радиусе.
+		__int64 reduced = (radius < 0 || radius > 0x7FFFFFFFFFFFFFFFLL - potentialRange) ? -1 : radius + graph->potential(start) + potentialRange;
+		bool complete = context.computeWithin(start, reduced, &found, &labels, (reduced < 0) ? 0x7FFFFFFFFFFFFFFFLL : radius + graph->potential(start));
+		order.clear();
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			__int64 distance = (__int64)labels[i] - graph->potential(start) + graph->potential(found[i]);
+			if (radius < 0 || distance <= radius)
+				order.push_back(std::pair<__int64, int>(distance, (int)i));
+		}
+		std::sort(order.begin(), order.end());
+		nodes->resize(order.size());
+		distances->resize(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			(*nodes)[i] = found[order[i].second];
+			(*distances)[i] = order[i].first;
+		}
+		return complete;
+	}
+
+	void setBudget(const SearchBudget & budget)
+	{
+		// Приведенная длина пути в пределах ограничения расстояния не больше его суммы с potentialRange: поиск ограничивается этой суммой,
+		// а более длинные в исходных весах пути отбрасываются при переводе результатов. Дерево путей и разбиение при этом
+		// могут содержать и часть более далеких узлов - через них могут проходить пути к узлам в пределах ограничения.
+		SearchBudget reduced = budget;
+		maxDistance = -1;
+		if (graph->reweighted() && budget.maxDistance >= 0)
+		{
+			maxDistance = budget.maxDistance;
+			reduced.maxDistance = (budget.maxDistance > 0x7FFFFFFFFFFFFFFFLL - potentialRange) ? -1 : budget.maxDistance + potentialRange;
+		}
+		context.setBudget(reduced);
+	}
+
+	bool budgetExceeded() const
+	{
+		return context.budgetExceeded();
+	}
+
+	void setMask(const std::vector<int> & bannedNodes, const std::vector<int> & bannedEdges)
+	{
+		context.setMask(bannedNodes, bannedEdges);
+	}
+
+	void clearMask()
+	{
+		context.clearMask();
+	}
+
+	bool setKernel(int kernel)
+	{
+		return context.setKernel(kernel);
+	}
+};
+
+/**
+ * Граф с конкретными типами.
+ */
+template <typename TWeight, typename TIndex>
+class BasicQueryEngine : public QueryEngine
+{
+private:
+	BasicStaticGraph<TWeight, TIndex> graph;
+	ReachabilityIndex reachability;
+	__int64 offsetLimit;		// Наибольшее смещение источника при поиске от нескольких источников.
+	__int64 potentialRange;		// Разность наибольшего и наименьшего потенциалов узлов.
+	int weight;
+	int index;
+
+public:
+	BasicQueryEngine(const StaticGraph & source, int _weight, int _index)
+	{
+		graph.build(source);
+		reachability.build(source);
+		// Путь от источника не длиннее суммы весов всех дуг, поэтому смещение должно помещаться в оставшийся запас типа.
+		offsetLimit = weightLimit(TWeight()) - weightBound(source);
+		// Потенциалы не больше 0, и наибольший из них равен 0.
+		potentialRange = 0;
+		for (int node = 0; node < source.nodeCount(); node++)
+			potentialRange = std::max(potentialRange, -source.potential(node));
+		weight = _weight;
+		index = _index;
+	}
+
+	int weightType() const
+	{
+		return weight;
+	}
+
+	int indexType() const
+	{
+		return index;
+	}
+
+	int nodeCount() const
+	{
+		return graph.nodeCount();
+	}
+
+	int edgeCount() const
+	{
+		return graph.edgeCount();
+	}
+
+	int findNode(const std::string & name) const
+	{
+		return graph.findNode(name);
+	}
+
+	const std::string & nodeName(int node) const
+	{
+		return graph.nodeName(node);
+	}
+
+	__int64 edgeWeight(int edge) const
+	{
+		return graph.originalWeight(edge);
+	}
+
+	size_t edgeBytes() const
+	{
+		return graph.edgeBytes();
+	}
+
+	int componentCount() const
+	{
+		return reachability.componentCount();
+	}
+
+	EngineContext * createContext() const
+	{
+		return new BasicEngineContext<TWeight, TIndex>(&graph, &reachability, offsetLimit, potentialRange);
+	}
+};
+
+template <typename TWeight>
+static QueryEngine * createWithIndex(const StaticGraph & graph, int weightType, int indexType)
+{
+	if (indexType == QueryEngine::INDEX_UINT16)
+		return new BasicQueryEngine<TWeight, unsigned short>(graph, weightType, indexType);
+	return new BasicQueryEngine<TWeight, int>(graph, weightType, indexType);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+EngineContext::~EngineContext()
+{
+}
+
+QueryEngine::~QueryEngine()
+{
+}
+
+int QueryEngine::narrowestWeightType(const StaticGraph & graph)
+{
+	__int64 bound = weightBound(graph);
+	if (bound <= SHRT_MAX)
+		return WEIGHT_INT16;
+	if (bound <= INT_MAX)
+		return WEIGHT_INT32;
+	return WEIGHT_INT64;
+}
+
+int QueryEngine::narrowestIndexType(const StaticGraph & graph)
+{
+	return (graph.nodeCount() <= USHRT_MAX + 1) ? INDEX_UINT16 : INDEX_INT32;
+}
+
+QueryEngine * QueryEngine::create(const StaticGraph & graph, int weightType, int indexType)
+{
+	// Тип подходит, если он не уже самого узкого подходящего; double точно хранит целые до 2^53.
+	int narrowest = narrowestWeightType(graph);
+	if (weightType == WEIGHT_DOUBLE ? weightBound(graph) > (1LL << 53) : weightType < narrowest)
+		return NULL;
+	if (indexType < narrowestIndexType(graph))
+		return NULL;
+
+	switch (weightType)
+	{
+	case WEIGHT_INT16:
+		return createWithIndex<short>(graph, weightType, indexType);
+	case WEIGHT_INT32:
+		return createWithIndex<int>(graph, weightType, indexType);
+	case WEIGHT_INT64:
+		return createWithIndex<__int64>(graph, weightType, indexType);
+	case WEIGHT_DOUBLE:
+		return createWithIndex<double>(graph, weightType, indexType);
+	default:
+		return NULL;
+	}
+}
+
+QueryEngine * QueryEngine::create(const StaticGraph & graph)
+{
+	return create(graph, narrowestWeightType(graph), narrowestIndexType(graph));
+}
+
+std::string QueryEngine::typeName(int weightType, int indexType)
+{
+	const char * weightNames[] = { "int16", "int32", "int64", "double" };
+	return std::string(weightNames[weightType]) + "/" + (indexType == INDEX_UINT16 ? "uint16" : "int32");
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "staticgraph.h"
+
+/**
+ * Рабочая память запросов к одному QueryEngine; принадлежит одному потоку.
+ * Длины возвращаются в исходных весах, поэтому в графе с приведенными весами расстояние -1 бывает настоящим: найден ли путь,
+ * определяется по PathResult::found, а достижимость узла в дереве и разбиении - по предыдущему узлу или источнику (-1 у недостижимых).
+ */
+class EngineContext
+{
+public:
+	virtual ~EngineContext();
+
+	/**
+	 * Поиск кратчайшего пути (см. BasicQueryContext::findPath).
+	 */
+	virtual bool findPath(int start, int end, PathResult * result) = 0;
+
+	/**
+	 * Поиск путей из одного узла до нескольких одним поиском (см. BasicQueryContext::findPaths).
+	 */
+	virtual int findPaths(int start, const std::vector<int> & ends, std::vector<PathResult> * results) = 0;
+
+	/**
+	 * Построение дерева кратчайших путей (см. BasicQueryContext::computeTree).
+	 * Узел достижим, если он начальный или у него есть предыдущий узел; метки недостижимых узлов равны -1.
+	 */
+	virtual void computeTree(int start, std::vector<__int64> * treeLabels, std::vector<int> * treeParents) = 0;
+
+	/**
+	 * Поиск ближайшего к узлу источника (см. BasicQueryContext::findNearest).
+	 * @param offsets - смещения источников или пустой вектор, если все смещения нулевые.
+	 * @return - true, если путь найден; false, если пути нет или смещения заданы неверно (их число не равно числу источников,
+	 *           смещение отрицательно или не помещается в тип веса графа).
+	 */
+	virtual bool findNearest(const std::vector<int> & sources, const std::vector<__int64> & offsets, int end, PathResult * result, int * source) = 0;
+
+	/**
+	 * Разбиение графа между источниками (см. BasicQueryContext::computeNearest).
+	 * Узел достижим, если у него есть ближайший источник; метки недостижимых узлов равны -1.
+	 * @param offsets - смещения источников или пустой вектор, если все смещения нулевые.
+	 * @return - false, если смещения заданы неверно, как в findNearest (векторы тогда не меняются).
+	 */
+	virtual bool computeNearest(const std::vector<int> & sources, const std::vector<__int64> & offsets, std::vector<__int64> * nearestLabels, std::vector<int> * nearestSources, std::vector<int> * nearestParents) = 0;
+
+	/**
+	 * Узлы в пределах расстояния от начального (см. BasicQueryContext::computeWithin).
+	 */
+	virtual bool computeWithin(int start, __int64 maxDistance, std::vector<int> * nodes, std::vector<__int64> * distances) = 0;
+
+	/**
+	 * Ограничение следующих поисков (см. BasicQueryContext::setBudget).
+	 */
+	virtual void setBudget(const SearchBudget & budget) = 0;
+
+	/**
+	 * Остановлен ли последний поиск из-за исчерпания бюджета (см. BasicQueryContext::budgetExceeded).
+	 */
+	virtual bool budgetExceeded() const = 0;
+
+	/**
+	 * Запрет узлов и дуг в следующих поисках (см. BasicQueryContext::setMask).
+	 */
+	virtual void setMask(const std::vector<int> & bannedNodes, const std::vector<int> & bannedEdges) = 0;
+
+	/**
+	 * Снятие маски (см. BasicQueryContext::clearMask).
+	 */
+	virtual void clearMask() = 0;
+
+	/**
+	 * Выбор ядра проверки дуг (см. BasicQueryContext::setKernel).
+	 */
+	virtual bool setKernel(int kernel) = 0;
+};
+
+/**
+ * Граф для обработки запросов, скрывающий типы веса и индекса, с которыми он построен.
+ * Сервер и другие пользователи работают с графом только через этот интерфейс,
+ * а поиск внутри выполняется кодом, скомпилированным для конкретных типов (BasicStaticGraph, BasicQueryContext).
+ * Граф с приведенными весами (BasicStaticGraph::reweight) ищет пути по приведенным весам, но все длины и веса дуг возвращает исходными.
+ */
+class QueryEngine
+{
+public:
+	// Веса и длины путей типа short.
+	static const int WEIGHT_INT16 = 0;
+	// Веса и длины путей типа int.
+	static const int WEIGHT_INT32 = 1;
+	// Веса и длины путей типа __int64.
+	static const int WEIGHT_INT64 = 2;
+	// Веса и длины путей типа double; целые длины до 2^53 представляются точно.
+	static const int WEIGHT_DOUBLE = 3;
+
+	// Индексы узлов типа unsigned short.
+	static const int INDEX_UINT16 = 0;
+	// Индексы узлов типа int.
+	static const int INDEX_INT32 = 1;
+
+	virtual ~QueryEngine();
+
+	/**
+	 * Создание графа с заданными типами.
+	 * @param graph - исходный граф; копируется, поэтому после вызова может быть удален.
+	 * @param weightType - тип веса (WEIGHT_*).
+	 * @param indexType - тип индекса (INDEX_*).
+	 * @return - граф или NULL, если длины путей или индексы узлов графа не помещаются в заданные типы.
+	 */
+	static QueryEngine * create(const StaticGraph & graph, int weightType, int indexType);
+
+	/**
+	 * Создание графа с самыми узкими целыми типами, в которые помещаются данные.
+	 * Длины путей не превосходят суммы весов всех дуг, поэтому по ней выбирается тип веса; по количеству узлов - тип индекса.
+	 * @param graph - исходный граф.
+	 */
+	static QueryEngine * create(const StaticGraph & graph);
+
+	/**
+	 * Самый узкий целый тип веса, вмещающий длины путей графа.
+	 */
+	static int narrowestWeightType(const StaticGraph & graph);
+
+	/**
+	 * Самый узкий тип индекса, вмещающий индексы узлов графа.
+	 */
+	static int narrowestIndexType(const StaticGraph & graph);
+
+	/**
+	 * Название типов графа, например "int32/uint16".
+	 */
+	static std::string typeName(int weightType, int indexType);
+
+	/**
+	 * Тип веса (WEIGHT_*).
+	 */
+	virtual int weightType() const = 0;
+
+	/**
+	 * Тип индекса (INDEX_*).
+	 */
+	virtual int indexType() const = 0;
+
+	/**
+	 * Количество узлов.
+	 */
+	virtual int nodeCount() const = 0;
+
+	/**
+	 * Количество дуг.
+	 */
+	virtual int edgeCount() const = 0;
+
+	/**
+	 * Поиск узла по имени.
+	 * @return - индекс узла или -1, если узла нет в графе.
+	 */
+	virtual int findNode(const std::string & name) const = 0;
+
+	/**
+	 * Имя узла.
+	 */
+	virtual const std::string & nodeName(int node) const = 0;
+
+	/**
+	 * Вес дуги (исходный, если веса графа приведены).
+	 */
+	virtual __int64 edgeWeight(int edge) const = 0;
+
+	/**
+	 * Объем памяти, занимаемый списками дуг, в байтах.
+	 */
+	virtual size_t edgeBytes() const = 0;
+
+	/**
+	 * Количество компонент сильной связности (индекс достижимости строится при создании графа).
+	 */
+	virtual int componentCount() const = 0;
+
+	/**
+	 * Создание рабочей памяти запросов для одного потока; удаляется вызывающим.
+	 * Запросы к узлам, до которых пути точно нет, отклоняются по индексу достижимости без поиска.
+	 */
+	virtual EngineContext * createContext() const = 0;
+};
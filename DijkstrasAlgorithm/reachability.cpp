@@ -0,0 +1,174 @@
+#include "reachability.h"
+#include <algorithm>
+
+ReachabilityIndex::ReachabilityIndex()
+{
+	count = 0;
+}
+
+void ReachabilityIndex::computeComponents(const StaticGraph & graph)
+{
+	int n = graph.nodeCount();
+	std::vector<int> order(n, -1);		// Порядковый номер узла в обходе.
+	std::vector<int> lowLinks(n, 0);
+	std::vector<bool> onStack(n, false);
+	std::vector<int> stack;				// Стек Тарьяна: узлы, еще не отнесенные к компонентам.
+	std::vector<std::pair<int, int> > calls;	// Стек вызовов: узел и следующая дуга.
+	components.assign(n, -1);
+	count = 0;
+	int counter = 0;
+
+	for (int root = 0; root < n; root++)
+	{
+		if (order[root] != -1)
+			continue;
+		calls.push_back(std::pair<int, int>(root, graph.edgeBegin(root)));
+		order[root] = lowLinks[root] = counter++;
+		stack.push_back(root);
+		onStack[root] = true;
+		while (!calls.empty())
+		{
+			int node = calls.back().first;
+			int & edge = calls.back().second;
+			if (edge < graph.edgeEnd(node))
+			{
+				int target = graph.edgeTarget(edge++);
+				if (order[target] == -1)
+				{
+					// Спуск в непосещенный узел вместо рекурсивного вызова.
+					order[target] = lowLinks[target] = counter++;
+					stack.push_back(target);
+					onStack[target] = true;
+					calls.push_back(std::pair<int, int>(target, graph.edgeBegin(target)));
+				}
+				else if (onStack[target])
+					lowLinks[node] = std::min(lowLinks[node], order[target]);
+				continue;
+			}
+
+			// Все дуги узла просмотрены: если узел - корень компоненты, снимаем ее со стека.
+			calls.pop_back();
+			if (lowLinks[node] == order[node])
+			{
+				int member;
+				do
+				{
+					member = stack.back();
+					stack.pop_back();
+					onStack[member] = false;
+					components[member] = count;
+				}
+				while (member != node);
+				count++;
+			}
+			if (!calls.empty())
+			{
+				int parent = calls.back().first;
+				lowLinks[parent] = std::min(lowLinks[parent], lowLinks[node]);
+			}
+		}
+	}
+}
+
+void ReachabilityIndex::computeIntervals(const std::vector<int> & offsets, const std::vector<int> & targets, int traversal)
+{
+	// Обход в глубину по графу компонент: номер компоненты - ее позиция в обратном порядке (post-order),
+	// нижняя граница - наименьший такой номер среди достижимых из нее компонент.
+	// Обходы отличаются порядком корней и дочерних компонент, чтобы ложные вложения интервалов реже совпадали.
+	bool reversed = (traversal % 2) == 1;
+	std::vector<int> low(count), rank(count, -1);
+	std::vector<std::pair<int, int> > calls;
+	int counter = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int root = reversed ? i : count - 1 - i;
+		if (rank[root] != -1)
+			continue;
+		rank[root] = -2;	// Компонента в обходе, но еще не завершена.
+		calls.push_back(std::pair<int, int>(root, 0));
+		while (!calls.empty())
+		{
+			int current = calls.back().first;
+			int & next = calls.back().second;
+			int degree = offsets[current + 1] - offsets[current];
+			if (next < degree)
+			{
+				int child = targets[reversed ? offsets[current + 1] - 1 - next : offsets[current] + next];
+				next++;
+				if (rank[child] == -1)
+				{
+					rank[child] = -2;
+					calls.push_back(std::pair<int, int>(child, 0));
+				}
+				continue;
+			}
+			calls.pop_back();
+			rank[current] = counter++;
+			low[current] = rank[current];
+			for (int edge = offsets[current]; edge < offsets[current + 1]; edge++)
+				low[current] = std::min(low[current], low[targets[edge]]);
+		}
+	}
+	for (int c = 0; c < count; c++)
+	{
+		intervals[(c * TRAVERSAL_COUNT + traversal) * 2] = low[c];
+		intervals[(c * TRAVERSAL_COUNT + traversal) * 2 + 1] = rank[c];
+	}
+}
+
+void ReachabilityIndex::build(const StaticGraph & graph)
+{
+	computeComponents(graph);
+
+	// Дуги графа компонент без повторов и петель.
+	std::vector<std::pair<int, int> > arcs;
+	for (int node = 0; node < graph.nodeCount(); node++)
+		for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+		{
+			int target = graph.edgeTarget(edge);
+			if (components[node] != components[target])
+				arcs.push_back(std::pair<int, int>(components[node], components[target]));
+		}
+	std::sort(arcs.begin(), arcs.end());
+	arcs.erase(std::unique(arcs.begin(), arcs.end()), arcs.end());
+	std::vector<int> offsets(count + 1, 0);
+	std::vector<int> targets(arcs.size());
+	for (size_t i = 0; i < arcs.size(); i++)
+	{
+		offsets[arcs[i].first + 1]++;
+		targets[i] = arcs[i].second;
+	}
+	for (int c = 0; c < count; c++)
+		offsets[c + 1] += offsets[c];
+
+	intervals.assign(count * TRAVERSAL_COUNT * 2, 0);
+	for (int traversal = 0; traversal < TRAVERSAL_COUNT; traversal++)
+		computeIntervals(offsets, targets, traversal);
+}
+
+int ReachabilityIndex::componentCount() const
+{
+	return count;
+}
+
+int ReachabilityIndex::component(int node) const
+{
+	return components[node];
+}
+
+bool ReachabilityIndex::mayReach(int from, int to) const
+{
+	int source = components[from];
+	int target = components[to];
+	if (source == target)
+		return true;
+	// Дуги ведут только к компонентам с меньшими номерами.
+	if (source < target)
+		return false;
+	const int * sourceIntervals = &intervals[source * TRAVERSAL_COUNT * 2];
+	const int * targetIntervals = &intervals[target * TRAVERSAL_COUNT * 2];
+	for (int traversal = 0; traversal < TRAVERSAL_COUNT; traversal++)
+		if (targetIntervals[2 * traversal] < sourceIntervals[2 * traversal] || targetIntervals[2 * traversal + 1] > sourceIntervals[2 * traversal + 1])
+			return false;
+	return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "staticgraph.h"
+
+/**
+ * Индекс достижимости для быстрого отказа в запросах к недостижимым узлам.
+ * При построении граф сжимается в ациклический граф компонент сильной связности (алгоритм Тарьяна без рекурсии,
+ * поэтому глубина графа не ограничена стеком). Компоненты нумеруются в порядке завершения, так что дуги между
+ * компонентами всегда ведут от большего номера к меньшему: если номер компоненты конечного узла больше, пути нет.
+ * Дополнительно для каждой компоненты хранятся интервалы GRAIL по нескольким обходам в глубину:
+ * если компонента v достижима из u, интервал v вложен в интервал u в каждом обходе.
+ * Проверка занимает O(TRAVERSAL_COUNT) и может ошибаться только в одну сторону: ответ "путь возможен" требует поиска.
+ */
+class ReachabilityIndex
+{
+private:
+	std::vector<int> components;		// Компонента каждого узла.
+	int count;							// Количество компонент.
+	std::vector<int> intervals;			// Для каждой компоненты и обхода - пара (наименьший номер потомка, номер компоненты в обратном порядке обхода).
+
+	void computeComponents(const StaticGraph & graph);
+	void computeIntervals(const std::vector<int> & offsets, const std::vector<int> & targets, int traversal);
+
+public:
+	// Количество обходов GRAIL.
+	static const int TRAVERSAL_COUNT = 2;
+
+	ReachabilityIndex();
+
+	/**
+	 * Построение индекса.
+	 * @param graph - граф; индекс использует его нумерацию узлов.
+	 */
+	void build(const StaticGraph & graph);
+
+	/**
+	 * Количество компонент сильной связности.
+	 */
+	int componentCount() const;
+
+	/**
+	 * Компонента сильной связности узла.
+	 */
+	int component(int node) const;
+
+	/**
+	 * Может ли существовать путь между узлами.
+	 * @param from - начальный узел.
+	 * @param to - конечный узел.
+	 * @return - false, если пути точно нет; true, если узлы в одной компоненте или путь возможен.
+	 */
+	bool mayReach(int from, int to) const;
+};
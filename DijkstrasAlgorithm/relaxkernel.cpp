@@ -0,0 +1,236 @@
+#include "relaxkernel.h"
+
+// Векторные ядра собираются, только если компилятор знает нужные инструкции: GCC и Clang включают их для отдельных функций,
+// MSVC поддерживает AVX2 начиная с Visual Studio 2012.
+#if defined(PLATFORM_X86) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1700))
+	#define RELAX_KERNEL_SIMD
+	#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+	#define TARGET_SSE41 __attribute__((target("sse4.1")))
+	#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define TARGET_SSE41
+	#define TARGET_AVX2
+#endif
+
+// Обычный цикл: дуга отбирается, если конечный узел не достигнут или путь через дугу не длиннее.
+template <typename TWeight, typename TIndex>
+static int filterScalar(const TIndex * targets, const TWeight * weights, int from, int count, TWeight base, const TWeight * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	int found = 0;
+	for (int i = from; i < count; i++)
+	{
+		if (i + RelaxKernel::PREFETCH_DISTANCE < count)
+			prefetchRead(&labels[targets[i + RelaxKernel::PREFETCH_DISTANCE]]);
+		int target = targets[i];
+		if (stamps[target] != stamp || !(labels[target] < base + weights[i]))
+			candidates[found++] = i;
+	}
+	return found;
+}
+
+// Добавление номеров дуг, отмеченных битами маски.
+static int appendMask(int mask, int first, int * candidates)
+{
+	int found = 0;
+	for (int bit = 0; mask != 0; bit++, mask >>= 1)
+		if (mask & 1)
+			candidates[found++] = first + bit;
+	return found;
+}
+
+#ifdef RELAX_KERNEL_SIMD
+
+// Загрузка 8 индексов конечных узлов в 32-битные элементы; индексы unsigned short расширяются нулями.
+TARGET_AVX2 static inline __m256i loadIndices8(const int * targets)
+{
+	return _mm256_loadu_si256((const __m256i *)targets);
+}
+
+TARGET_AVX2 static inline __m256i loadIndices8(const unsigned short * targets)
+{
+	return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)targets));
+}
+
+// Загрузка 4 индексов конечных узлов в 32-битные элементы.
+TARGET_AVX2 static inline __m128i loadIndices4(const int * targets)
+{
+	return _mm_loadu_si128((const __m128i *)targets);
+}
+
+TARGET_AVX2 static inline __m128i loadIndices4(const unsigned short * targets)
+{
+	return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)targets));
+}
+
+template <typename TIndex>
+TARGET_SSE41 static int filterSse41(const TIndex * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	__m128i bases = _mm_set1_epi32(base);
+	__m128i stampVector = _mm_set1_epi32((int)stamp);
+	int found = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		if (i + 4 + RelaxKernel::PREFETCH_DISTANCE <= count)
+			for (int k = 0; k < 4; k++)
+				prefetchRead(&labels[targets[i + RelaxKernel::PREFETCH_DISTANCE + k]]);
+		__m128i candidate = _mm_add_epi32(bases, _mm_loadu_si128((const __m128i *)(weights + i)));
+		__m128i current = _mm_cvtsi32_si128(labels[targets[i]]);
+		current = _mm_insert_epi32(current, labels[targets[i + 1]], 1);
+		current = _mm_insert_epi32(current, labels[targets[i + 2]], 2);
+		current = _mm_insert_epi32(current, labels[targets[i + 3]], 3);
+		__m128i reached = _mm_cvtsi32_si128((int)stamps[targets[i]]);
+		reached = _mm_insert_epi32(reached, (int)stamps[targets[i + 1]], 1);
+		reached = _mm_insert_epi32(reached, (int)stamps[targets[i + 2]], 2);
+		reached = _mm_insert_epi32(reached, (int)stamps[targets[i + 3]], 3);
+		// Дуга отбрасывается, только если узел уже достигнут (номер запроса совпадает) и его метка меньше.
+		__m128i rejected = _mm_and_si128(_mm_cmpeq_epi32(reached, stampVector), _mm_cmpgt_epi32(candidate, current));
+		found += appendMask(~_mm_movemask_ps(_mm_castsi128_ps(rejected)) & 0xF, i, candidates + found);
+	}
+	int rest = filterScalar(targets, weights, i, count, base, labels, stamps, stamp, candidates + found);
+	return found + rest;
+}
+
+template <typename TIndex>
+TARGET_AVX2 static int filterAvx2(const TIndex * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	__m256i bases = _mm256_set1_epi32(base);
+	__m256i stampVector = _mm256_set1_epi32((int)stamp);
+	int found = 0;
+	int i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		if (i + 8 + RelaxKernel::PREFETCH_DISTANCE <= count)
+			for (int k = 0; k < 8; k++)
+				prefetchRead(&labels[targets[i + RelaxKernel::PREFETCH_DISTANCE + k]]);
+		__m256i indices = loadIndices8(targets + i);
+		__m256i candidate = _mm256_add_epi32(bases, _mm256_loadu_si256((const __m256i *)(weights + i)));
+		__m256i current = _mm256_i32gather_epi32(labels, indices, 4);
+		__m256i reached = _mm256_i32gather_epi32((const int *)stamps, indices, 4);
+		__m256i rejected = _mm256_and_si256(_mm256_cmpeq_epi32(reached, stampVector), _mm256_cmpgt_epi32(candidate, current));
+		found += appendMask(~_mm256_movemask_ps(_mm256_castsi256_ps(rejected)) & 0xFF, i, candidates + found);
+	}
+	int rest = filterScalar(targets, weights, i, count, base, labels, stamps, stamp, candidates + found);
+	return found + rest;
+}
+
+template <typename TIndex>
+TARGET_AVX2 static int filterAvx2(const TIndex * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	__m256i bases = _mm256_set1_epi64x(base);
+	__m128i stampVector = _mm_set1_epi32((int)stamp);
+	int found = 0;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		if (i + 4 + RelaxKernel::PREFETCH_DISTANCE <= count)
+			for (int k = 0; k < 4; k++)
+				prefetchRead(&labels[targets[i + RelaxKernel::PREFETCH_DISTANCE + k]]);
+		__m128i indices = loadIndices4(targets + i);
+		__m256i candidate = _mm256_add_epi64(bases, _mm256_loadu_si256((const __m256i *)(weights + i)));
+		__m256i current = _mm256_i32gather_epi64((const long long *)labels, indices, 8);
+		__m128i reached = _mm_i32gather_epi32((const int *)stamps, indices, 4);
+		int longer = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(candidate, current)));
+		int reachedMask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(reached, stampVector)));
+		found += appendMask(~(longer & reachedMask) & 0xF, i, candidates + found);
+	}
+	int rest = filterScalar(targets, weights, i, count, base, labels, stamps, stamp, candidates + found);
+	return found + rest;
+}
+
+#endif
+
+// Выбор ядра для меток int.
+template <typename TIndex>
+static int filterInt(int kernel, const TIndex * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+#ifdef RELAX_KERNEL_SIMD
+	if (kernel == RelaxKernel::KERNEL_AVX2)
+		return filterAvx2(targets, weights, count, base, labels, stamps, stamp, candidates);
+	if (kernel == RelaxKernel::KERNEL_SSE41)
+		return filterSse41(targets, weights, count, base, labels, stamps, stamp, candidates);
+#endif
+	return filterScalar(targets, weights, 0, count, base, labels, stamps, stamp, candidates);
+}
+
+// Выбор ядра для меток __int64.
+template <typename TIndex>
+static int filterInt64(int kernel, const TIndex * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+#ifdef RELAX_KERNEL_SIMD
+	if (kernel == RelaxKernel::KERNEL_AVX2)
+		return filterAvx2(targets, weights, count, base, labels, stamps, stamp, candidates);
+#endif
+	return filterScalar(targets, weights, 0, count, base, labels, stamps, stamp, candidates);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+// Ядро с наибольшей шириной среди доступных.
+static int detectKernel()
+{
+	if (RelaxKernel::available(RelaxKernel::KERNEL_AVX2))
+		return RelaxKernel::KERNEL_AVX2;
+	return RelaxKernel::available(RelaxKernel::KERNEL_SSE41) ? RelaxKernel::KERNEL_SSE41 : RelaxKernel::KERNEL_SCALAR;
+}
+
+int RelaxKernel::best()
+{
+	static const int kernel = detectKernel();
+	return kernel;
+}
+
+bool RelaxKernel::available(int kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return true;
+#ifdef RELAX_KERNEL_SIMD
+	case KERNEL_SSE41:
+		return CpuFeatures::hasSse41();
+	case KERNEL_AVX2:
+		return CpuFeatures::hasAvx2();
+#endif
+	default:
+		return false;
+	}
+}
+
+const char * RelaxKernel::name(int kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return "scalar";
+	case KERNEL_SSE41:
+		return "sse4.1";
+	case KERNEL_AVX2:
+		return "avx2";
+	default:
+		return "unknown";
+	}
+}
+
+int RelaxKernel::filter(int kernel, const int * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return filterInt(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+int RelaxKernel::filter(int kernel, const unsigned short * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return filterInt(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+int RelaxKernel::filter(int kernel, const int * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return filterInt64(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+int RelaxKernel::filter(int kernel, const unsigned short * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return filterInt64(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
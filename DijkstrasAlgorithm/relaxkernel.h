@@ -0,0 +1,72 @@
+#pragma once
+#include "platform.h"
+
+/**
+ * Векторная проверка дуг узла при поиске кратчайшего пути.
+ * Для дуг узла u с меткой du ядро собирает метки конечных узлов (gather), складывает du с весами и сравнивает,
+ * а на выходе выдает только дуги, которые могут улучшить метку: конечный узел еще не достигнут в этом запросе или его метка не меньше
+ * (при равной длине путь может оказаться короче по числу дуг или сменить последнюю дугу, см. BasicQueryContext).
+ * Сама запись меток выполняется вызывающим по одной дуге с повторной проверкой, поэтому кратные дуги к одному узлу обрабатываются верно.
+ * Ядра есть для меток int и __int64 при индексах int и unsigned short (индексы unsigned short расширяются до 32 бит перед сбором),
+ * то есть для всех типов, которые выбирает QueryEngine, кроме весов short и double; набор инструкций выбирается при запуске по возможностям процессора.
+ */
+class RelaxKernel
+{
+public:
+	// Обычный цикл по дугам.
+	static const int KERNEL_SCALAR = 0;
+	// SSE4.1: сравнение по 4 дуги, метки загружаются по одной (только метки int).
+	static const int KERNEL_SSE41 = 1;
+	// AVX2: сбор меток инструкциями gather, по 8 дуг для меток int и по 4 для __int64.
+	static const int KERNEL_AVX2 = 2;
+
+	// Наименьшая степень узла, для которой используется векторное ядро; на меньших узлах оно не окупается.
+	static const int MIN_DEGREE = 16;
+	// На сколько дуг вперед загружаются в кэш метки конечных узлов.
+	static const int PREFETCH_DISTANCE = 8;
+
+	/**
+	 * Лучшее ядро, доступное на этом процессоре; определяется один раз при первом вызове.
+	 */
+	static int best();
+
+	/**
+	 * Доступно ли ядро на этом процессоре.
+	 */
+	static bool available(int kernel);
+
+	/**
+	 * Название ядра.
+	 */
+	static const char * name(int kernel);
+
+	/**
+	 * Отбор дуг, которые могут улучшить метки конечных узлов или дать путь той же длины.
+	 * @param kernel - ядро; должно быть доступно на этом процессоре (available).
+	 * @param targets - конечные узлы дуг.
+	 * @param weights - веса дуг.
+	 * @param count - количество дуг.
+	 * @param base - метка начального узла дуг.
+	 * @param labels - метки узлов.
+	 * @param stamps - номера запросов, в которых узлы достигнуты.
+	 * @param stamp - номер текущего запроса.
+	 * @param candidates - массив не меньше count элементов, в который запишутся номера отобранных дуг (от 0) по возрастанию.
+	 * @return - количество отобранных дуг.
+	 */
+	static int filter(int kernel, const int * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates);
+
+	/**
+	 * То же для индексов unsigned short.
+	 */
+	static int filter(int kernel, const unsigned short * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates);
+
+	/**
+	 * То же для весов и меток __int64.
+	 */
+	static int filter(int kernel, const int * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates);
+
+	/**
+	 * То же для весов и меток __int64 и индексов unsigned short.
+	 */
+	static int filter(int kernel, const unsigned short * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates);
+};
@@ -0,0 +1,483 @@
+#include "server.h"
+#include <sstream>
+#include "graphpatch.h"
+
+QueryServer::Session::Session(int _node)
+{
+	node = _node;
+}
+
+QueryServer::Session::~Session()
+{
+	for (std::map<std::string, std::pair<unsigned int, EngineContext *> >::const_iterator iter = contexts.cbegin(); iter != contexts.cend(); iter++)
+		delete iter->second.second;
+}
+
+EngineContext * QueryServer::Session::context(const std::string & name, unsigned int version, const QueryEngine * graph)
+{
+	std::map<std::string, std::pair<unsigned int, EngineContext *> >::iterator iter = contexts.find(name);
+	if (iter != contexts.end() && iter->second.first == version)
+		return iter->second.second;
+	// Контекст прежней версии графа больше не нужен: его размеры могли устареть.
+	EngineContext * context = graph->createContext();
+	if (iter != contexts.end())
+	{
+		delete iter->second.second;
+		iter->second = std::make_pair(version, context);
+	}
+	else
+		contexts.insert(std::make_pair(name, std::make_pair(version, context)));
+	return context;
+}
+
+int QueryServer::Session::getNode() const
+{
+	return node;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+/**
+ * Задание на построение копии графа потоком, привязанным к узлу NUMA.
+ */
+struct ReplicaJob
+{
+	const StaticGraph * graph;
+	int node;
+	QueryEngine * engine;
+};
+
+QueryServer::QueryServer(size_t _cacheCapacity, bool replicate, bool _writable)
+{
+	cacheCapacity = _cacheCapacity;
+	replicaCount = replicate ? PageMemory::nodeCount() : 1;
+	startedWorkers = 0;
+	writable = _writable;
+	versionCount = 0;
+}
+
+QueryServer::~QueryServer()
+{
+	for (std::map<std::string, PathCache *>::const_iterator iter = caches.cbegin(); iter != caches.cend(); iter++)
+		delete iter->second;
+	for (std::map<std::string, Version *>::const_iterator iter = graphs.cbegin(); iter != graphs.cend(); iter++)
+		deleteVersion(iter->second);
+	for (std::map<std::string, Graph *>::const_iterator iter = sources.cbegin(); iter != sources.cend(); iter++)
+		delete iter->second;
+}
+
+void QueryServer::buildReplica(void * job)
+{
+	ReplicaJob * replicaJob = (ReplicaJob *)job;
+	// Страницы копии выделяются при первой записи, то есть в памяти узла, к которому привязан поток.
+	PageMemory::bindThread(replicaJob->node);
+	replicaJob->engine = QueryEngine::create(*replicaJob->graph);
+}
+
+QueryServer::Version * QueryServer::createVersion(const StaticGraph & graph)
+{
+	// Граф копируется с самыми узкими подходящими типами, с копиями - потоками, привязанными к узлам NUMA.
+	Version * version = new Version();
+	version->id = ++versionCount;
+	version->users = 0;
+	version->retired = false;
+	if (replicaCount > 1)
+	{
+		std::vector<ReplicaJob> jobs(replicaCount);
+		std::vector<Thread *> threads;
+		for (int node = 0; node < replicaCount; node++)
+		{
+			jobs[node].graph = &graph;
+			jobs[node].node = node;
+			jobs[node].engine = NULL;
+			threads.push_back(new Thread());
+			if (!threads.back()->start(&QueryServer::buildReplica, &jobs[node]))
+				buildReplica(&jobs[node]);
+		}
+		for (int node = 0; node < replicaCount; node++)
+		{
+			delete threads[node];
+			version->engines.push_back(jobs[node].engine);
+		}
+	}
+	else
+		version->engines.push_back(QueryEngine::create(graph));
+	return version;
+}
+
+void QueryServer::deleteVersion(Version * version)
+{
+	for (size_t i = 0; i < version->engines.size(); i++)
+		delete version->engines[i];
+	delete version;
+}
+
+QueryServer::Version * QueryServer::acquire(const std::string & name)
+{
+	// Версии графов неизменяемого сервера не меняются, поэтому выбираются без мьютекса.
+	if (!writable)
+	{
+		std::map<std::string, Version *>::const_iterator iter = graphs.find(name);
+		return (iter != graphs.end()) ? iter->second : NULL;
+	}
+	MutexLocker locker(&versionMutex);
+	std::map<std::string, Version *>::const_iterator iter = graphs.find(name);
+	if (iter == graphs.end())
+		return NULL;
+	iter->second->users++;
+	return iter->second;
+}
+
+void QueryServer::release(Version * version)
+{
+	if (!writable)
+		return;
+	MutexLocker locker(&versionMutex);
+	if (--version->users == 0 && version->retired)
+		version->released.release();
+}
+
+const QueryEngine * QueryServer::replica(const Version * version, const Session * session) const
+{
+	return version->engines[session->getNode() % version->engines.size()];
+}
+
+bool QueryServer::addGraph(const std::string & name, const char * fileName, std::string * error, int order, const char * coordinatesFile)
+{
+	if (graphs.find(name) != graphs.end())
+	{
+		*error = "Граф с таким именем уже загружен";
+		return false;
+	}
+	// Изменяемый граф хранится еще и в Graph, из которого строятся следующие версии; нумерация по именам у них общая.
+	Graph * source = NULL;
+	if (writable)
+	{
+		if (order != VertexOrder::ORDER_NAME)
+		{
+			*error = "Изменяемый граф нумеруется только по именам";
+			return false;
+		}
+		source = new Graph(fileName);
+		if (source->error_exists())
+		{
+			std::vector<int> errors = source->getErrors();
+			error->clear();
+			for (size_t i = 0; i < errors.size(); i++)
+				*error += std::string(i > 0 ? "; " : "") + Graph::getErrorString(errors[i]);
+			delete source;
+			return false;
+		}
+	}
+	// Для запросов граф сразу строится в неизменяемом компактном представлении; отрицательные веса приводятся к неотрицательным.
+	StaticGraph * staticGraph = (source != NULL) ? new StaticGraph(*source) : new StaticGraph();
+	std::vector<int> errors;
+	if (source == NULL && !staticGraph->readFromFile(fileName, &errors))
+	{
+		error->clear();
+		for (size_t i = 0; i < errors.size(); i++)
+			*error += std::string(i > 0 ? "; " : "") + Graph::getErrorString(errors[i]);
+		delete staticGraph;
+		return false;
+	}
+	if (order != VertexOrder::ORDER_NAME)
+	{
+		std::vector<NodePosition> positions;
+		if (coordinatesFile != NULL && !VertexOrder::readPositions(coordinatesFile, *staticGraph, &positions))
+		{
+			*error = std::string("Не удалось открыть файл координат ") + coordinatesFile;
+			delete staticGraph;
+			return false;
+		}
+		std::vector<int> permutation;
+		if (!VertexOrder::compute(*staticGraph, order, coordinatesFile != NULL ? &positions : NULL, &permutation))
+		{
+			*error = std::string("Для порядка ") + VertexOrder::name(order) + " не хватает данных";
+			delete staticGraph;
+			return false;
+		}
+		staticGraph->renumber(permutation);
+	}
+	graphs.insert(std::pair<std::string, Version *>(name, createVersion(*staticGraph)));
+	delete staticGraph;
+	if (source != NULL)
+		sources.insert(std::pair<std::string, Graph *>(name, source));
+	if (cacheCapacity > 0)
+		caches.insert(std::pair<std::string, PathCache *>(name, new PathCache(cacheCapacity)));
+	if (defaultGraph.empty())
+		defaultGraph = name;
+	return true;
+}
+
+std::string QueryServer::handleWithin(const std::vector<std::string> & tokens, const std::string & name, Version * version, Session * session)
+{
+	const QueryEngine * graph = replica(version, session);
+	int start = graph->findNode(tokens[tokens.size() - 3]);
+	if (start == -1)
+		return "ERROR unknown vertex";
+	__int64 radius = -1;
+	int limit = 0;
+	if (sscanf_s(tokens[tokens.size() - 2].c_str(), INT64_FORMAT, &radius) != 1 || sscanf_s(tokens[tokens.size() - 1].c_str(), "%d", &limit) != 1)
+		return "ERROR bad request";
+
+	// Ограничение действует только на этот запрос: контекст потока используется и другими запросами.
+	EngineContext * context = session->context(name, version->id, graph);
+	SearchBudget budget;
+	budget.maxSettled = (limit > 0) ? limit : 0;
+	context->setBudget(budget);
+	std::vector<int> nodes;
+	std::vector<__int64> distances;
+	bool complete = context->computeWithin(start, radius, &nodes, &distances);
+	context->setBudget(SearchBudget());
+
+	std::ostringstream output;
+	output << "OK " << (complete ? 1 : 0) << " " << nodes.size();
+	char distance[32];
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		sprintf_s(distance, 32, INT64_FORMAT, distances[i]);
+		output << " " << graph->nodeName(nodes[i]) << " " << distance;
+	}
+	return output.str();
+}
+
+std::string QueryServer::handlePath(const std::vector<std::string> & tokens, const std::string & name, Version * version, Session * session)
+{
+	const QueryEngine * graph = replica(version, session);
+	int start = graph->findNode(tokens[tokens.size() - 2]);
+	int end = graph->findNode(tokens[tokens.size() - 1]);
+	if (start == -1 || end == -1)
+		return "ERROR unknown vertex";
+
+	PathResult result;
+	std::map<std::string, PathCache *>::const_iterator cacheIter = caches.find(name);
+	PathCache * cache = (cacheIter != caches.end()) ? cacheIter->second : NULL;
+	if (cache == NULL || !cache->lookup(start, end, PathCache::ALGORITHM_DIJKSTRA, &result))
+	{
+		EngineContext * context = session->context(name, version->id, graph);
+		if (cache != NULL && cache->wantsTree(start, PathCache::ALGORITHM_DIJKSTRA))
+		{
+			// Из этого узла часто ищут пути, поэтому строим дерево - оно ответит и на следующие запросы.
+			std::vector<__int64> labels;
+			std::vector<int> parents;
+			context->computeTree(start, &labels, &parents);
+			cache->storeTree(start, PathCache::ALGORITHM_DIJKSTRA, labels, parents);
+			cache->lookup(start, end, PathCache::ALGORITHM_DIJKSTRA, &result);
+		}
+		else
+		{
+			context->findPath(start, end, &result);
+			if (cache != NULL)
+				cache->store(start, end, PathCache::ALGORITHM_DIJKSTRA, result);
+		}
+	}
+	if (!result.found())
+		return "NOPATH";
+	char weight[32];
+	sprintf_s(weight, 32, INT64_FORMAT, result.totalWeight);
+	std::ostringstream output;
+	output << "OK " << weight << " " << result.nodes.size() - 1;
+	for (size_t i = 0; i < result.nodes.size(); i++)
+		output << " " << graph->nodeName(result.nodes[i]);
+	return output.str();
+}
+
+// Сообщение протокола об ошибке пакета.
+static const char * patchErrorMessage(int error)
+{
+	switch (error)
+	{
+	case Graph::ERROR_NEGATIVE_WEIGHT:
+		return "negative weight";
+	case Graph::ERROR_LOOP_EXISTS:
+		return "loop";
+	case Graph::ERROR_EDGE_NOT_EXISTS:
+		return "unknown edge";
+	default:
+		return "patch rejected";
+	}
+}
+
+std::string QueryServer::handlePatch(const std::string & request, const std::vector<std::string> & tokens)
+{
+	if (tokens.size() < 3)
+		return "ERROR bad request";
+	std::map<std::string, Graph *>::iterator source = sources.find(tokens[1]);
+	if (source == sources.end())
+		return (graphs.find(tokens[1]) == graphs.end()) ? "ERROR unknown graph" : "ERROR read-only graph";
+
+	// Изменения идут после имени графа и разделяются точкой с запятой.
+	std::istringstream input(request);
+	std::string word, changes;
+	input >> word >> word;
+	std::getline(input, changes);
+	GraphPatch patch;
+	std::istringstream lines(changes);
+	std::string line;
+	while (std::getline(lines, line, ';'))
+		if (!patch.parseLine(line))
+			return "ERROR bad patch";
+	if (patch.getOperations().empty())
+		return "ERROR bad patch";
+
+	MutexLocker locker(&patchMutex);
+	std::vector<int> patchErrors;
+	std::vector<__int64> previousWeights;
+	if (!source->second->applyPatch(patch, &patchErrors, &previousWeights))
+		return std::string("ERROR ") + patchErrorMessage(patchErrors.empty() ? -1 : patchErrors[0]);
+
+	// Новая версия строится, пока запросы идут к прежней; затем запросы переходят на нее.
+	StaticGraph staticGraph(*source->second);
+	Version * next = createVersion(staticGraph);
+	Version * previous;
+	bool busy;
+	{
+		MutexLocker versionLocker(&versionMutex);
+		std::map<std::string, Version *>::iterator iter = graphs.find(tokens[1]);
+		previous = iter->second;
+		iter->second = next;
+		previous->retired = true;
+		busy = previous->users > 0;
+	}
+	if (busy)
+		previous->released.acquire();
+	// Кэш проверяется, когда запросы к прежней версии завершены, поэтому в нем не остается и результатов, сохраненных ими.
+	std::map<std::string, PathCache *>::const_iterator cache = caches.find(tokens[1]);
+	if (cache != caches.end())
+		cache->second->patchApplied(patch, previousWeights, *previous->engines[0]);
+	deleteVersion(previous);
+
+	std::ostringstream output;
+	output << "OK " << patch.getOperations().size();
+	return output.str();
+}
+
+std::string QueryServer::handle(const std::string & request, Session * session, bool * quit)
+{
+	std::istringstream input(request);
+	std::vector<std::string> tokens;
+	std::string token;
+	while (input >> token)
+		tokens.push_back(token);
+	*quit = false;
+
+	if (tokens.empty())
+		return "ERROR empty request";
+	if (tokens[0] == "PING")
+		return "OK";
+	if (tokens[0] == "QUIT")
+	{
+		*quit = true;
+		return "OK";
+	}
+	if (tokens[0] == "GRAPHS")
+	{
+		std::ostringstream output;
+		output << "OK " << graphs.size();
+		for (std::map<std::string, Version *>::const_iterator iter = graphs.cbegin(); iter != graphs.cend(); iter++)
+			output << " " << iter->first;
+		return output.str();
+	}
+	if (tokens[0] == "STATS")
+	{
+		std::map<std::string, PathCache *>::const_iterator cache = caches.find(tokens.size() > 1 ? tokens[1] : defaultGraph);
+		if (cache == caches.end())
+			return "ERROR no cache";
+		std::ostringstream output;
+		output << "OK " << cache->second->hitCount() << " " << cache->second->missCount() << " " << cache->second->size() << " " << cache->second->treeCount();
+		return output.str();
+	}
+	if (tokens[0] == "PATCH")
+		return handlePatch(request, tokens);
+	bool within = tokens[0] == "WITHIN";
+	if (within ? (tokens.size() < 4 || tokens.size() > 5) : (tokens[0] != "PATH" || tokens.size() < 3 || tokens.size() > 4))
+		return "ERROR bad request";
+
+	// Имя графа можно опустить, если нужен первый загруженный граф.
+	std::string name = (tokens.size() == (within ? 5u : 4u)) ? tokens[1] : defaultGraph;
+	Version * version = acquire(name);
+	if (version == NULL)
+		return "ERROR unknown graph";
+	std::string response = within ? handleWithin(tokens, name, version, session) : handlePath(tokens, name, version, session);
+	release(version);
+	return response;
+}
+
+void QueryServer::serve(Channel * channel, Session * session)
+{
+	std::string line;
+	while (channel->readLine(&line))
+	{
+		bool quit = false;
+		if (!channel->writeLine(handle(line, session, &quit)) || quit)
+			break;
+	}
+}
+
+void QueryServer::worker(void * server)
+{
+	QueryServer * self = (QueryServer *)server;
+	// С копиями графов потоки распределяются по узлам NUMA по очереди.
+	int node = 0;
+	if (self->replicaCount > 1)
+	{
+		{
+			MutexLocker locker(&self->pendingMutex);
+			node = self->startedWorkers++ % self->replicaCount;
+		}
+		PageMemory::bindThread(node);
+	}
+	Session session(node);
+	for (;;)
+	{
+		self->pendingCount.acquire();
+		Channel * channel = NULL;
+		{
+			MutexLocker locker(&self->pendingMutex);
+			channel = self->pending.front();
+			self->pending.pop_front();
+		}
+		// NULL в очереди - сигнал завершения потока.
+		if (channel == NULL)
+			return;
+		self->serve(channel, &session);
+		delete channel;
+	}
+}
+
+bool QueryServer::listen(const std::string & name, int threadCount)
+{
+	LocalListener listener;
+	if (!listener.listen(name))
+		return false;
+	if (threadCount <= 0)
+		threadCount = Thread::processorCount();
+
+	// Каждый рабочий поток обслуживает одного клиента до закрытия соединения.
+	std::vector<Thread *> threads;
+	for (int i = 0; i < threadCount; i++)
+	{
+		threads.push_back(new Thread());
+		threads.back()->start(&QueryServer::worker, this);
+	}
+	for (;;)
+	{
+		Channel * channel = listener.accept();
+		if (channel == NULL)
+			break;
+		MutexLocker locker(&pendingMutex);
+		pending.push_back(channel);
+		pendingCount.release();
+	}
+
+	// Прием соединений прерван неустранимой ошибкой: дообслуживаем клиентов и останавливаем потоки.
+	{
+		MutexLocker locker(&pendingMutex);
+		for (int i = 0; i < threadCount; i++)
+			pending.push_back(NULL);
+	}
+	pendingCount.release(threadCount);
+	for (size_t i = 0; i < threads.size(); i++)
+		delete threads[i];
+	return false;
+}
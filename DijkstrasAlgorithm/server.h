@@ -0,0 +1,155 @@
+#pragma once
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "graph.h"
+#include "staticgraph.h"
+#include "queryengine.h"
+#include "pathcache.h"
+#include "vertexorder.h"
+
+/**
+ * Сервер запросов кратчайшего пути.
+ * Графы загружаются один раз при запуске, после чего сервер отвечает на запросы, не тратя время на запуск процесса и чтение файла.
+ * Протокол построчный, лексемы разделяются пробелами:
+ *   PATH <граф> <начало> <конец>  ->  OK <длина> <число дуг> <вершины пути...> | NOPATH | ERROR <сообщение>
+ *   PATH <начало> <конец>         ->  то же для первого загруженного графа
+ *   WITHIN [<граф>] <начало> <радиус> <узлов>  ->  OK <1 | 0> <количество> <вершина> <расстояние>...
+ *                                 узлы не дальше радиуса (-1 - без ограничения) по возрастанию расстояния; поиск обрабатывает
+ *                                 не больше заданного числа узлов (0 - без ограничения), 0 в ответе означает, что лимит исчерпан
+ *   GRAPHS                        ->  OK <количество> <имена графов...>
+ *   STATS <граф>                  ->  OK <попадания> <промахи> <пары в кэше> <деревья в кэше>
+ *   PATCH <граф> <изменение>[; <изменение>...]  ->  OK <количество изменений> | ERROR <сообщение>
+ *                                 изменения в текстовом формате GraphPatch применяются к графу целиком или не применяются вовсе;
+ *                                 граф меняется только в памяти сервера и только если сервер создан с writable
+ *   PING                          ->  OK
+ *   QUIT                          ->  OK, после чего соединение закрывается
+ * Графы хранятся с самыми узкими типами веса и индекса, в которые помещаются их данные (QueryEngine::create).
+ * Графы после загрузки только читаются, а рабочая память поиска у каждого потока своя (EngineContext),
+ * поэтому клиенты обслуживаются параллельно пулом потоков без блокировок.
+ * Изменяемый сервер (writable) держит для каждого графа еще и Graph, к которому применяются пакеты PATCH. Пакет строит новую версию
+ * графа, запросы переходят на нее, а прежняя удаляется, когда завершатся выполнявшиеся над ней запросы; версии сменяются
+ * под мьютексом, который захватывается на время выбора версии запросом.
+ * Если задана емкость кэша, результаты запросов к каждому графу кэшируются (PathCache); после пакета из кэша удаляются
+ * результаты, которые он мог изменить (PathCache::patchApplied).
+ * На машинах с несколькими узлами NUMA граф можно скопировать на каждый узел: копия строится потоком, привязанным к узлу,
+ * поэтому ее страницы размещаются в его памяти, а рабочие потоки, распределенные по узлам, ищут пути в копии своего узла.
+ */
+class QueryServer
+{
+public:
+	/**
+	 * Рабочая память одного потока: контексты запросов к каждому графу, создаваемые при первом обращении.
+	 * Контекст привязан к версии графа и создается заново, когда граф изменен.
+	 */
+	class Session
+	{
+	private:
+		std::map<std::string, std::pair<unsigned int, EngineContext *> > contexts;	// Номер версии и контекст по именам графов.
+		int node;		// Узел NUMA, к которому привязан поток.
+
+		Session(const Session &);
+		Session & operator=(const Session &);
+
+	public:
+		Session(int _node = 0);
+		~Session();
+		EngineContext * context(const std::string & name, unsigned int version, const QueryEngine * graph);
+		int getNode() const;
+	};
+
+private:
+	/**
+	 * Версия графа: движки запросов (первый - сам граф, остальные - копии по узлам NUMA) и число запросов, выполняющихся над ней.
+	 */
+	struct Version
+	{
+		std::vector<QueryEngine *> engines;
+		unsigned int id;		// Номер версии, уникальный в пределах сервера.
+		int users;				// Количество запросов, выбравших версию (только у изменяемого сервера).
+		bool retired;			// Версия заменена новой.
+		Semaphore released;		// Освобождается последним запросом к замененной версии.
+	};
+
+	std::map<std::string, Version *> graphs;	// Текущие версии графов по именам.
+	std::map<std::string, Graph *> sources;		// Графы, к которым применяются пакеты (только у изменяемого сервера).
+	int replicaCount;						// Количество узлов NUMA, на которые копируются графы (1 - без копий).
+	int startedWorkers;						// Количество запущенных рабочих потоков (для распределения по узлам).
+	std::map<std::string, PathCache *> caches;		// Кэши результатов по именам графов.
+	size_t cacheCapacity;					// Емкость кэша каждого графа (0 - без кэша).
+	bool writable;							// Принимаются ли пакеты PATCH.
+	unsigned int versionCount;				// Количество построенных версий графов.
+	std::string defaultGraph;				// Имя первого загруженного графа.
+	Mutex versionMutex;						// Защищает версии графов и их счетчики запросов.
+	Mutex patchMutex;						// Не дает применять пакеты одновременно.
+	std::deque<Channel *> pending;			// Соединения, ожидающие обработки.
+	Mutex pendingMutex;						// Защищает pending.
+	Semaphore pendingCount;					// Количество соединений в pending.
+
+	static void worker(void * server);
+	static void buildReplica(void * job);
+	Version * createVersion(const StaticGraph & graph);
+	static void deleteVersion(Version * version);
+	Version * acquire(const std::string & name);
+	void release(Version * version);
+	const QueryEngine * replica(const Version * version, const Session * session) const;
+	std::string handlePath(const std::vector<std::string> & tokens, const std::string & name, Version * version, Session * session);
+	std::string handleWithin(const std::vector<std::string> & tokens, const std::string & name, Version * version, Session * session);
+	std::string handlePatch(const std::string & request, const std::vector<std::string> & tokens);
+
+	QueryServer(const QueryServer &);
+	QueryServer & operator=(const QueryServer &);
+
+public:
+	// Количество рабочих потоков по умолчанию (0 - по числу процессоров).
+	static const int DEFAULT_THREAD_COUNT = 0;
+
+	/**
+	 * Конструктор.
+	 * @param _cacheCapacity - количество результатов, кэшируемых для каждого графа, или 0, если кэш не нужен.
+	 * @param replicate - копировать ли графы на каждый узел NUMA; на машине с одним узлом не действует.
+	 * @param _writable - принимать ли пакеты PATCH; тогда графы загружаются еще и в Graph, нумеруются только по именам
+	 *                    и не могут содержать дуг с отрицательным весом.
+	 */
+	QueryServer(size_t _cacheCapacity = 0, bool replicate = false, bool _writable = false);
+	~QueryServer();
+
+	/**
+	 * Загрузка графа из файла в формате командной строки. Дуги с отрицательным весом допускаются (см. StaticGraph::readFromFile),
+	 * если сервер не изменяемый.
+	 * @param name - имя графа в запросах.
+	 * @param fileName - имя файла.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @param order - порядок нумерации узлов (VertexOrder::ORDER_*), улучшающий локальность обращений при поиске.
+	 * @param coordinatesFile - файл с координатами узлов для VertexOrder::ORDER_HILBERT или NULL.
+	 * @return - true, если граф загружен, иначе false.
+	 */
+	bool addGraph(const std::string & name, const char * fileName, std::string * error, int order = VertexOrder::ORDER_NAME, const char * coordinatesFile = NULL);
+
+	/**
+	 * Обработка одного запроса.
+	 * @param request - строка запроса.
+	 * @param session - рабочая память потока, выполняющего запрос.
+	 * @param quit - указатель на флаг, который устанавливается, если клиент завершает сеанс.
+	 * @return - строка ответа.
+	 */
+	std::string handle(const std::string & request, Session * session, bool * quit);
+
+	/**
+	 * Обслуживание одного клиента до закрытия канала или команды QUIT.
+	 * @param channel - канал связи с клиентом.
+	 * @param session - рабочая память потока, обслуживающего клиента.
+	 */
+	void serve(Channel * channel, Session * session);
+
+	/**
+	 * Прием локальных соединений и их обслуживание пулом потоков. Возвращает управление только при неустранимой ошибке
+	 * приема (временные ошибки повторяются, см. LocalListener::accept), дообслужив принятые соединения.
+	 * @param name - имя именованного канала или путь к сокету.
+	 * @param threadCount - количество рабочих потоков или 0 для числа процессоров.
+	 * @return - false: прием соединений не удалось начать или он прерван ошибкой.
+	 */
+	bool listen(const std::string & name, int threadCount);
+};
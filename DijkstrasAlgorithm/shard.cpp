@@ -0,0 +1,433 @@
+#include "shard.h"
+#include <algorithm>
+#include <set>
+#include <sstream>
+#include "graph.h"
+#include "staticgraph.h"
+#include "vertexorder.h"
+
+std::string ShardPartitioner::fileName(const std::string & prefix, int shard, const char * extension)
+{
+	char suffix[32];
+	sprintf_s(suffix, 32, ".%d.", shard);
+	return prefix + suffix + extension;
+}
+
+bool ShardPartitioner::partition(const char * graphFileName, const std::string & prefix, int shardCount, std::string * error)
+{
+	if (shardCount < 1)
+	{
+		*error = "Количество шардов должно быть положительным";
+		return false;
+	}
+	Graph graph(graphFileName);
+	if (graph.error_exists())
+	{
+		*error = Graph::getErrorString(graph.getErrors()[0]);
+		return false;
+	}
+	StaticGraph staticGraph(graph);
+	int n = staticGraph.nodeCount();
+
+	// Шард узла - номер участка порядка обхода в ширину, в котором он стоит.
+	std::vector<int> order;
+	VertexOrder::compute(staticGraph, VertexOrder::ORDER_BFS, NULL, &order);
+	std::vector<int> owners(n);
+	for (int i = 0; i < n; i++)
+		owners[order[i]] = (int)((__int64)i * shardCount / n);
+
+	for (int shard = 0; shard < shardCount; shard++)
+	{
+		std::string graphName = fileName(prefix, shard, "graph");
+		std::string boundaryName = fileName(prefix, shard, "boundary");
+		FILE * graphFile;
+		FILE * boundaryFile;
+		if (fopen_s(&graphFile, graphName.c_str(), "w"))
+		{
+			*error = "Не удалось создать файл " + graphName;
+			return false;
+		}
+		if (fopen_s(&boundaryFile, boundaryName.c_str(), "w"))
+		{
+			fclose(graphFile);
+			*error = "Не удалось создать файл " + boundaryName;
+			return false;
+		}
+
+		int edgeCount = 0;
+		for (int node = 0; node < n; node++)
+			if (owners[node] == shard)
+				edgeCount += staticGraph.edgeEnd(node) - staticGraph.edgeBegin(node);
+		fprintf_s(graphFile, "%d %s %s\n", edgeCount, graph.getStartNode()->name.c_str(), graph.getEndNode()->name.c_str());
+		std::set<int> entries, exits;
+		for (int node = 0; node < n; node++)
+			for (int edge = staticGraph.edgeBegin(node); edge < staticGraph.edgeEnd(node); edge++)
+			{
+				int target = staticGraph.edgeTarget(edge);
+				if (owners[node] == shard)
+				{
+					fprintf_s(graphFile, "%s %s " INT64_FORMAT "\n", staticGraph.nodeName(node).c_str(), staticGraph.nodeName(target).c_str(), staticGraph.edgeWeight(edge));
+					if (owners[target] != shard)
+						exits.insert(target);
+				}
+				else if (owners[target] == shard)
+					entries.insert(target);
+			}
+		for (std::set<int>::const_iterator iter = entries.begin(); iter != entries.end(); iter++)
+			fprintf_s(boundaryFile, "in %s\n", staticGraph.nodeName(*iter).c_str());
+		for (std::set<int>::const_iterator iter = exits.begin(); iter != exits.end(); iter++)
+			fprintf_s(boundaryFile, "out %s %d\n", staticGraph.nodeName(*iter).c_str(), owners[*iter]);
+		fclose(graphFile);
+		fclose(boundaryFile);
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ShardWorker::ShardWorker()
+{
+	engine = NULL;
+	context = NULL;
+}
+
+ShardWorker::~ShardWorker()
+{
+	delete context;
+	delete engine;
+}
+
+bool ShardWorker::load(const char * graphFileName, const char * boundaryFileName, std::string * error)
+{
+	// Дуги читаются без проверок Graph: в шарде может не быть дуг или начального и конечного узлов маршрута.
+	FILE * file;
+	if (fopen_s(&file, graphFileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл ") + graphFileName;
+		return false;
+	}
+	__int64 m = 0;
+	char buf1[256] = "";
+	char buf2[256] = "";
+	fscanf_s(file, INT64_FORMAT, &m);
+	fscanf_s(file, "%s", buf1);
+	fscanf_s(file, "%s", buf2);
+	std::vector<FileListItem> edges;
+	for (__int64 i = 0; i < m; i++)
+	{
+		__int64 weight = 0;
+		if (fscanf_s(file, "%s", buf1) != 1 || fscanf_s(file, "%s", buf2) != 1 || fscanf_s(file, INT64_FORMAT, &weight) != 1 || weight < 0)
+		{
+			fclose(file);
+			*error = std::string("Неверный формат файла ") + graphFileName;
+			return false;
+		}
+		edges.push_back(FileListItem(buf1, buf2, weight));
+	}
+	fclose(file);
+
+	StaticGraph graph;
+	graph.build(edges);
+	delete context;
+	delete engine;
+	engine = QueryEngine::create(graph);
+	context = engine->createContext();
+	owners.assign(engine->nodeCount(), -1);
+
+	if (fopen_s(&file, boundaryFileName, "r"))
+	{
+		*error = std::string("Не удалось открыть файл ") + boundaryFileName;
+		return false;
+	}
+	while (fscanf_s(file, "%s", buf1) == 1)
+	{
+		int owner = -1;
+		if (fscanf_s(file, "%s", buf2) != 1 || (std::string(buf1) == "out" && fscanf_s(file, "%d", &owner) != 1))
+		{
+			fclose(file);
+			*error = std::string("Неверный формат файла ") + boundaryFileName;
+			return false;
+		}
+		int node = engine->findNode(buf2);
+		if (owner != -1 && node != -1)
+			owners[node] = owner;
+	}
+	fclose(file);
+	return true;
+}
+
+std::string ShardWorker::handle(const std::string & request, bool * quit)
+{
+	std::istringstream input(request);
+	std::vector<std::string> tokens;
+	std::string token;
+	while (input >> token)
+		tokens.push_back(token);
+	*quit = false;
+
+	if (tokens.empty())
+		return "ERROR empty request";
+	if (tokens[0] == "QUIT")
+	{
+		*quit = true;
+		return "OK";
+	}
+	if (tokens[0] == "PATH")
+	{
+		if (tokens.size() != 3)
+			return "ERROR bad request";
+		int start = engine->findNode(tokens[1]);
+		int end = engine->findNode(tokens[2]);
+		PathResult result;
+		context->setBudget(SearchBudget());
+		if (start == -1 || end == -1 || !context->findPath(start, end, &result))
+			return "NOPATH";
+		char weight[32];
+		sprintf_s(weight, 32, INT64_FORMAT, result.totalWeight);
+		std::ostringstream output;
+		output << "OK " << weight;
+		for (size_t i = 0; i < result.nodes.size(); i++)
+			output << " " << engine->nodeName(result.nodes[i]);
+		return output.str();
+	}
+	if (tokens[0] != "SEARCH" || tokens.size() < 4)
+		return "ERROR bad request";
+
+	SearchBudget budget;
+	int count = 0;
+	if (sscanf_s(tokens[1].c_str(), INT64_FORMAT, &budget.maxDistance) != 1 || sscanf_s(tokens[3].c_str(), "%d", &count) != 1 || count < 0 || tokens.size() != 4 + 2 * (size_t)count)
+		return "ERROR bad request";
+	int end = engine->findNode(tokens[2]);
+	// Источники без дуг в этом шарде ничего не дают.
+	std::vector<int> sources;
+	std::vector<__int64> offsets;
+	for (int i = 0; i < count; i++)
+	{
+		int node = engine->findNode(tokens[4 + 2 * i]);
+		__int64 offset = 0;
+		if (sscanf_s(tokens[5 + 2 * i].c_str(), INT64_FORMAT, &offset) != 1 || offset < 0)
+			return "ERROR bad request";
+		if (node == -1)
+			continue;
+		sources.push_back(node);
+		offsets.push_back(offset);
+	}
+	if (sources.empty())
+		return "OK 0";
+
+	std::vector<__int64> labels;
+	std::vector<int> nearest, parents;
+	context->setBudget(budget);
+	bool valid = context->computeNearest(sources, offsets, &labels, &nearest, &parents);
+	context->setBudget(SearchBudget());
+	if (!valid)
+		return "ERROR distance overflow";
+
+	// Источники сами себя не сообщают: их расстояния координатору уже известны.
+	std::ostringstream output;
+	int found = 0;
+	char distance[32];
+	for (int node = 0; node < engine->nodeCount(); node++)
+	{
+		if (labels[node] == -1 || parents[node] == -1 || (owners[node] == -1 && node != end))
+			continue;
+		sprintf_s(distance, 32, INT64_FORMAT, labels[node]);
+		output << " " << engine->nodeName(node) << " " << distance << " " << engine->nodeName(sources[nearest[node]]) << " " << ((node == end) ? -1 : owners[node]);
+		found++;
+	}
+	std::ostringstream reply;
+	reply << "OK " << found << output.str();
+	return reply.str();
+}
+
+void ShardWorker::serve(Channel * channel)
+{
+	std::string line;
+	while (channel->readLine(&line))
+	{
+		bool quit = false;
+		if (!channel->writeLine(handle(line, &quit)) || quit)
+			break;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+ShardPath::ShardPath()
+{
+	totalWeight = -1;
+	rounds = 0;
+}
+
+ShardCoordinator::ShardCoordinator()
+{
+}
+
+ShardCoordinator::~ShardCoordinator()
+{
+	std::string reply;
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		if (channels[i]->writeLine("QUIT"))
+			channels[i]->readLine(&reply);
+		delete channels[i];
+	}
+	for (size_t i = 0; i < processes.size(); i++)
+		delete processes[i];
+}
+
+bool ShardCoordinator::connect(const std::vector<std::string> & names)
+{
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		LocalChannel * channel = LocalChannel::connect(names[i], CONNECT_TIMEOUT);
+		if (channel == NULL)
+			return false;
+		channels.push_back(channel);
+	}
+	return true;
+}
+
+bool ShardCoordinator::launch(const std::string & program, const std::string & prefix, int shardCount)
+{
+	std::vector<std::string> names;
+	for (int shard = 0; shard < shardCount; shard++)
+	{
+		char tag[32];
+		sprintf_s(tag, 32, "shard%d", shard);
+		names.push_back(LocalListener::uniqueName(tag));
+		std::vector<std::string> arguments;
+		arguments.push_back("--shard-worker");
+		arguments.push_back(ShardPartitioner::fileName(prefix, shard, "graph"));
+		arguments.push_back(ShardPartitioner::fileName(prefix, shard, "boundary"));
+		arguments.push_back(names.back());
+		Process * process = new Process();
+		processes.push_back(process);
+		if (!process->start(program, arguments))
+			return false;
+	}
+	return connect(names);
+}
+
+bool ShardCoordinator::request(int shard, const std::string & line, std::vector<std::string> * tokens)
+{
+	std::string reply;
+	if (!channels[shard]->writeLine(line) || !channels[shard]->readLine(&reply))
+		return false;
+	std::istringstream input(reply);
+	std::string token;
+	tokens->clear();
+	while (input >> token)
+		tokens->push_back(token);
+	return !tokens->empty() && tokens->front() != "ERROR";
+}
+
+bool ShardCoordinator::findPath(const std::string & start, const std::string & end, ShardPath * result)
+{
+	*result = ShardPath();
+	if (start == end)
+	{
+		result->totalWeight = 0;
+		result->nodes.push_back(start);
+		return true;
+	}
+
+	int shardCount = (int)channels.size();
+	std::map<std::string, __int64> best;								// Лучшие известные расстояния до граничных узлов.
+	std::map<std::string, std::pair<std::string, int> > previous;		// Источник участка пути до узла и шард участка.
+	std::vector<std::map<std::string, __int64> > pending(shardCount);	// Источники следующего поиска каждого шарда.
+	best[start] = 0;
+	// Шард начального узла координатору неизвестен, поэтому первый раунд отправляется всем шардам.
+	for (int shard = 0; shard < shardCount; shard++)
+		pending[shard][start] = 0;
+
+	__int64 bound = -1;
+	char number[32];
+	for (;;)
+	{
+		// Запросы отправляются всем шардам сразу, чтобы они искали одновременно, а ответы читаются после.
+		std::vector<bool> sent(shardCount, false);
+		for (int shard = 0; shard < shardCount; shard++)
+		{
+			if (pending[shard].empty())
+				continue;
+			std::ostringstream line;
+			sprintf_s(number, 32, INT64_FORMAT, bound);
+			line << "SEARCH " << number << " " << end << " " << pending[shard].size();
+			for (std::map<std::string, __int64>::const_iterator iter = pending[shard].begin(); iter != pending[shard].end(); iter++)
+			{
+				sprintf_s(number, 32, INT64_FORMAT, iter->second);
+				line << " " << iter->first << " " << number;
+			}
+			if (!channels[shard]->writeLine(line.str()))
+				return false;
+			sent[shard] = true;
+			pending[shard].clear();
+		}
+		if (std::find(sent.begin(), sent.end(), true) == sent.end())
+			break;
+		result->rounds++;
+
+		for (int shard = 0; shard < shardCount; shard++)
+		{
+			if (!sent[shard])
+				continue;
+			std::string reply;
+			if (!channels[shard]->readLine(&reply))
+				return false;
+			std::istringstream input(reply);
+			std::string status;
+			int count = 0;
+			if (!(input >> status >> count) || status != "OK")
+				return false;
+			for (int i = 0; i < count; i++)
+			{
+				std::string node, distanceText, seed;
+				int owner = -1;
+				__int64 distance = 0;
+				if (!(input >> node >> distanceText >> seed >> owner) || sscanf_s(distanceText.c_str(), INT64_FORMAT, &distance) != 1)
+					return false;
+				std::map<std::string, __int64>::const_iterator known = best.find(node);
+				if ((known != best.end() && known->second <= distance) || (bound != -1 && distance >= bound && node != end))
+					continue;
+				best[node] = distance;
+				previous[node] = std::pair<std::string, int>(seed, shard);
+				if (node == end)
+					bound = distance;
+				else
+					pending[owner][node] = distance;
+			}
+		}
+
+		// Источники не ближе найденного пути до конечного узла его не улучшат.
+		if (bound != -1)
+			for (int shard = 0; shard < shardCount; shard++)
+				for (std::map<std::string, __int64>::iterator iter = pending[shard].begin(); iter != pending[shard].end();)
+				{
+					if (iter->second >= bound)
+						pending[shard].erase(iter++);
+					else
+						iter++;
+				}
+	}
+	if (bound == -1)
+		return true;
+
+	// Путь собирается с конца: каждый участок - путь внутри шарда от источника, давшего расстояние узлу.
+	std::vector<std::vector<std::string> > segments;
+	std::string node = end;
+	while (node != start)
+	{
+		const std::pair<std::string, int> & segment = previous[node];
+		std::vector<std::string> tokens;
+		if (segments.size() > best.size() || !request(segment.second, "PATH " + segment.first + " " + node, &tokens) || tokens[0] != "OK")
+			return false;
+		segments.push_back(std::vector<std::string>(tokens.begin() + 2, tokens.end()));
+		node = segment.first;
+	}
+	result->totalWeight = bound;
+	result->nodes.push_back(start);
+	for (size_t i = segments.size(); i-- > 0;)
+		result->nodes.insert(result->nodes.end(), segments[i].begin() + 1, segments[i].end());
+	return true;
+}
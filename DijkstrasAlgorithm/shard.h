@@ -0,0 +1,149 @@
+#pragma once
+#include <map>
+#include <vector>
+#include <string>
+#include "platform.h"
+#include "queryengine.h"
+
+/**
+ * Разбиение файла графа на K частей (шардов) для поиска несколькими процессами.
+ * Узлы упорядочиваются обходом в ширину (VertexOrder::ORDER_BFS), и каждый шард получает непрерывный участок этого порядка,
+ * так что большая часть дуг остается внутри шардов. Шард k записывается в два файла:
+ *   <префикс>.<k>.graph    - дуги, начинающиеся в узлах шарда, в формате командной строки;
+ *   <префикс>.<k>.boundary - таблица граничных узлов: "in <узел>" для узлов шарда, в которые входят дуги из других шардов,
+ *                            и "out <узел> <шард>" для узлов других шардов, в которые ведут дуги из этого шарда.
+ */
+class ShardPartitioner
+{
+public:
+	/**
+	 * Имя файла шарда.
+	 * @param prefix - префикс файлов.
+	 * @param shard - номер шарда.
+	 * @param extension - "graph" или "boundary".
+	 */
+	static std::string fileName(const std::string & prefix, int shard, const char * extension);
+
+	/**
+	 * Разбиение графа.
+	 * @param graphFileName - файл графа.
+	 * @param prefix - префикс файлов шардов.
+	 * @param shardCount - количество шардов.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если файлы шардов записаны, иначе false.
+	 */
+	static bool partition(const char * graphFileName, const std::string & prefix, int shardCount, std::string * error);
+};
+
+/**
+ * Обработчик запросов к одному шарду; обычно работает в отдельном процессе (qwe.exe --shard-worker).
+ * Протокол построчный, как у QueryServer:
+ *   SEARCH <граница> <конец> <количество> <узел> <расстояние>...  ->  OK <количество> <узел> <расстояние> <источник> <шард>...
+ *       поиск от нескольких источников со смещениями (EngineContext::computeNearest) не дальше границы (-1 - без границы);
+ *       в ответе - достигнутые граничные узлы других шардов и конечный узел (для него шард -1), с ближайшим источником;
+ *   PATH <начало> <конец>  ->  OK <длина> <узлы пути...> | NOPATH - путь внутри шарда;
+ *   QUIT  ->  OK, после чего соединение закрывается.
+ */
+class ShardWorker
+{
+private:
+	QueryEngine * engine;			// Граф шарда.
+	EngineContext * context;		// Рабочая память поиска.
+	std::vector<int> owners;		// Шард узла, если узел принадлежит другому шарду, иначе -1.
+
+	ShardWorker(const ShardWorker &);
+	ShardWorker & operator=(const ShardWorker &);
+
+public:
+	ShardWorker();
+	~ShardWorker();
+
+	/**
+	 * Загрузка шарда.
+	 * @param graphFileName - файл дуг шарда.
+	 * @param boundaryFileName - таблица граничных узлов.
+	 * @param error - указатель на строку, в которую запишется описание ошибки.
+	 * @return - true, если шард загружен, иначе false.
+	 */
+	bool load(const char * graphFileName, const char * boundaryFileName, std::string * error);
+
+	/**
+	 * Обработка одного запроса.
+	 * @param request - строка запроса.
+	 * @param quit - указатель на флаг, который устанавливается при завершении сеанса.
+	 * @return - строка ответа.
+	 */
+	std::string handle(const std::string & request, bool * quit);
+
+	/**
+	 * Обработка запросов из канала до его закрытия или команды QUIT.
+	 */
+	void serve(Channel * channel);
+};
+
+/**
+ * Кратчайший путь, найденный по шардам.
+ */
+struct ShardPath
+{
+	__int64 totalWeight;				// Длина пути или -1, если пути нет.
+	std::vector<std::string> nodes;		// Узлы пути.
+	int rounds;							// Количество раундов обмена расстояниями.
+
+	ShardPath();
+};
+
+/**
+ * Поиск кратчайших путей по шардам.
+ * Поиск идет раундами. В каждом раунде шардам, у которых улучшились расстояния до граничных узлов, одновременно отправляются
+ * эти узлы с расстояниями, и каждый шард выполняет поиск от них сразу. Найденные расстояния до граничных узлов других шардов
+ * становятся источниками следующего раунда, если они меньше известных. Поиск завершается, когда расстояния перестают улучшаться;
+ * расстояния не больше уже найденной длины пути до конечного узла не рассылаются. Путь собирается из участков внутри шардов.
+ */
+class ShardCoordinator
+{
+private:
+	std::vector<Channel *> channels;	// Соединения с шардами.
+	std::vector<Process *> processes;	// Запущенные процессы шардов.
+
+	bool request(int shard, const std::string & line, std::vector<std::string> * tokens);
+
+	ShardCoordinator(const ShardCoordinator &);
+	ShardCoordinator & operator=(const ShardCoordinator &);
+
+public:
+	// Сколько ждать начала работы шарда.
+	static const int CONNECT_TIMEOUT = 60000;
+
+	ShardCoordinator();
+
+	/**
+	 * Деструктор. Завершает сеансы с шардами и дожидается запущенных процессов.
+	 */
+	~ShardCoordinator();
+
+	/**
+	 * Подключение к уже работающим шардам.
+	 * @param names - имена каналов шардов по порядку номеров.
+	 * @return - true, если удалось подключиться ко всем шардам, иначе false.
+	 */
+	bool connect(const std::vector<std::string> & names);
+
+	/**
+	 * Запуск процесса для каждого шарда и подключение к ним.
+	 * @param program - исполняемый файл этой программы.
+	 * @param prefix - префикс файлов шардов (см. ShardPartitioner).
+	 * @param shardCount - количество шардов.
+	 * @return - true, если все шарды запущены и подключены, иначе false.
+	 */
+	bool launch(const std::string & program, const std::string & prefix, int shardCount);
+
+	/**
+	 * Поиск кратчайшего пути.
+	 * @param start - имя начального узла.
+	 * @param end - имя конечного узла.
+	 * @param result - указатель на результат.
+	 * @return - false, если шард не ответил или ответил ошибкой; отсутствие пути ошибкой не является.
+	 */
+	bool findPath(const std::string & start, const std::string & end, ShardPath * result);
+};
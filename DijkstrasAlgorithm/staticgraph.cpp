@@ -0,0 +1,968 @@
+#include "staticgraph.h"
+#include "relaxkernel.h"
+#include "reachability.h"
+#include <algorithm>
+#include <functional>
+
+/**
+ * Сравнение узла с именем по имени узла, для двоичного поиска по byName.
+ */
+struct NodeNameLess
+{
+	const std::vector<std::string> * names;
+
+	NodeNameLess(const std::vector<std::string> * _names)
+	{
+		names = _names;
+	}
+
+	bool operator()(int node, const std::string & name) const
+	{
+		return (*names)[node] < name;
+	}
+
+	// Отладочные проверки упорядоченности в MSVC вызывают сравнение и с другим порядком аргументов.
+	bool operator()(const std::string & name, int node) const
+	{
+		return name < (*names)[node];
+	}
+
+	bool operator()(int first, int second) const
+	{
+		return (*names)[first] < (*names)[second];
+	}
+};
+
+template <typename TWeight, typename TIndex>
+BasicStaticGraph<TWeight, TIndex>::BasicStaticGraph()
+{
+	offsets.push_back(0);
+	computeWeightStatistics();
+}
+
+template <typename TWeight, typename TIndex>
+BasicStaticGraph<TWeight, TIndex>::BasicStaticGraph(const Graph & graph)
+{
+	build(graph);
+}
+
+template <typename TWeight, typename TIndex>
+void BasicStaticGraph<TWeight, TIndex>::build(const Graph & graph)
+{
+	const std::map<std::string, Node *> & nodes = graph.getNodes();
+	names.clear();
+	byName.clear();
+	offsets.clear();
+	targets.clear();
+	weights.clear();
+	potentials.clear();
+
+	// Узлы нумеруются в порядке имен.
+	std::map<const Node *, int> indices;
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		indices.insert(std::pair<const Node *, int>(iter->second, (int)names.size()));
+		byName.push_back((int)names.size());
+		names.push_back(iter->first);
+	}
+	offsets.reserve(names.size() + 1);
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		offsets.push_back((int)targets.size());
+		const std::vector<Edge *> & edges = iter->second->edges;
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			targets.push_back((TIndex)indices.find(edges[i]->to)->second);
+			weights.push_back((TWeight)edges[i]->weight);
+		}
+	}
+	offsets.push_back((int)targets.size());
+	computeWeightStatistics();
+}
+
+template <typename TWeight, typename TIndex>
+void BasicStaticGraph<TWeight, TIndex>::build(const std::vector<FileListItem> & edges)
+{
+	// Узлы нумеруются в порядке имен.
+	names.clear();
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		names.push_back(edges[i].from);
+		names.push_back(edges[i].to);
+	}
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+	byName.resize(names.size());
+	for (size_t i = 0; i < names.size(); i++)
+		byName[i] = (int)i;
+
+	// Подсчитываем количество дуг каждого узла, затем раскладываем дуги по спискам в порядке списка.
+	std::vector<int> from(edges.size());
+	offsets.assign(names.size() + 1, 0);
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		from[i] = findNode(edges[i].from);
+		offsets[from[i] + 1]++;
+	}
+	for (size_t i = 0; i < names.size(); i++)
+		offsets[i + 1] += offsets[i];
+	std::vector<int> position(offsets.begin(), offsets.end() - 1);
+	targets.resize(edges.size());
+	weights.resize(edges.size());
+	for (size_t i = 0; i < edges.size(); i++)
+	{
+		int edge = position[from[i]]++;
+		targets[edge] = (TIndex)findNode(edges[i].to);
+		weights[edge] = (TWeight)edges[i].weight;
+	}
+	potentials.clear();
+	computeWeightStatistics();
+}
+
+template <typename TWeight, typename TIndex>
+void BasicStaticGraph<TWeight, TIndex>::build(const BasicStaticGraph<__int64, int> & source)
+{
+	names = source.names;
+	byName = source.byName;
+	offsets = source.offsets;
+	targets.resize(source.targets.size());
+	weights.resize(source.weights.size());
+	for (size_t i = 0; i < source.targets.size(); i++)
+	{
+		targets[i] = (TIndex)source.targets[i];
+		weights[i] = (TWeight)source.weights[i];
+	}
+	potentials = source.potentials;
+	computeWeightStatistics();
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicStaticGraph<TWeight, TIndex>::readFromFile(const char * fileName, std::vector<int> * errors)
+{
+	std::vector<FileListItem> edges;
+	std::string start, end;
+	errors->clear();
+	if (!Graph::readEdges(fileName, &edges, &start, &end))
+		errors->push_back(Graph::ERROR_COULD_NOT_OPEN_FILE);
+	else
+		Graph::checkEdges(edges, start, end, true, errors);
+	if (errors->empty())
+	{
+		build(edges);
+		if (reweight())
+			return true;
+		errors->push_back(Graph::ERROR_NEGATIVE_CYCLE);
+	}
+	build(std::vector<FileListItem>());
+	return false;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicStaticGraph<TWeight, TIndex>::renumber(const std::vector<int> & order)
+{
+	std::vector<int> newIndex(order.size());
+	for (size_t i = 0; i < order.size(); i++)
+		newIndex[order[i]] = (int)i;
+
+	std::vector<std::string> newNames(names.size());
+	std::vector<int, PageAllocator<int> > newOffsets(1, 0);
+	std::vector<TIndex, PageAllocator<TIndex> > newTargets;
+	std::vector<TWeight, PageAllocator<TWeight> > newWeights;
+	newOffsets.reserve(offsets.size());
+	newTargets.reserve(targets.size());
+	newWeights.reserve(weights.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		int node = order[i];
+		newNames[i].swap(names[node]);
+		for (int edge = offsets[node]; edge < offsets[node + 1]; edge++)
+		{
+			newTargets.push_back((TIndex)newIndex[targets[edge]]);
+			newWeights.push_back(weights[edge]);
+		}
+		newOffsets.push_back((int)newTargets.size());
+	}
+	names.swap(newNames);
+	offsets.swap(newOffsets);
+	targets.swap(newTargets);
+	weights.swap(newWeights);
+	if (!potentials.empty())
+	{
+		std::vector<__int64> newPotentials(potentials.size());
+		for (size_t i = 0; i < order.size(); i++)
+			newPotentials[i] = potentials[order[i]];
+		potentials.swap(newPotentials);
+	}
+	// Порядок по именам не меняется, меняются только индексы.
+	for (size_t i = 0; i < byName.size(); i++)
+		byName[i] = newIndex[byName[i]];
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicStaticGraph<TWeight, TIndex>::reweight()
+{
+	if (minimum >= 0)
+		return true;
+
+	// Вспомогательный узел соединен со всеми, поэтому вначале все потенциалы равны 0 и все узлы стоят в очереди.
+	// Очередь кольцевая: узел находится в ней не более одного раза.
+	int n = nodeCount();
+	std::vector<__int64> values(n, 0);
+	std::vector<int> lengths(n, 0);		// Число дуг графа в пути, которым получен потенциал.
+	std::vector<char> queued(n, 1);
+	std::vector<int> queue(n);
+	for (int node = 0; node < n; node++)
+		queue[node] = node;
+	int head = 0;
+	int count = n;
+	while (count > 0)
+	{
+		int node = queue[head];
+		head = (head + 1) % n;
+		count--;
+		queued[node] = 0;
+		for (int edge = offsets[node]; edge < offsets[node + 1]; edge++)
+		{
+			int target = targets[edge];
+			__int64 value = values[node] + (__int64)weights[edge];
+			if (value >= values[target])
+				continue;
+			values[target] = value;
+			lengths[target] = lengths[node] + 1;
+			// Кратчайший путь содержит не больше n - 1 дуги; путь из n дуг, который все еще укорачивается, проходит по циклу отрицательной длины.
+			if (lengths[target] >= n)
+				return false;
+			if (!queued[target])
+			{
+				queued[target] = 1;
+				queue[(head + count) % n] = target;
+				count++;
+			}
+		}
+	}
+
+	for (int node = 0; node < n; node++)
+		for (int edge = offsets[node]; edge < offsets[node + 1]; edge++)
+			weights[edge] = (TWeight)((__int64)weights[edge] + values[node] - values[targets[edge]]);
+	potentials.swap(values);
+	computeWeightStatistics();
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicStaticGraph<TWeight, TIndex>::reweighted() const
+{
+	return !potentials.empty();
+}
+
+template <typename TWeight, typename TIndex>
+__int64 BasicStaticGraph<TWeight, TIndex>::potential(int node) const
+{
+	return potentials.empty() ? 0 : potentials[node];
+}
+
+template <typename TWeight, typename TIndex>
+__int64 BasicStaticGraph<TWeight, TIndex>::originalWeight(int edge) const
+{
+	if (potentials.empty())
+		return (__int64)weights[edge];
+	// Начало дуги - последний узел, список дуг которого начинается не позже нее.
+	int from = (int)(std::upper_bound(offsets.begin(), offsets.end(), edge) - offsets.begin()) - 1;
+	return (__int64)weights[edge] - potentials[from] + potentials[targets[edge]];
+}
+
+template <typename TWeight, typename TIndex>
+void BasicStaticGraph<TWeight, TIndex>::computeWeightStatistics()
+{
+	// Статистика нужна для выбора алгоритма поиска; перенумерация ее не меняет.
+	std::vector<TWeight> sorted(weights.begin(), weights.end());
+	std::sort(sorted.begin(), sorted.end());
+	minimum = sorted.empty() ? 0 : sorted.front();
+	maximum = sorted.empty() ? 0 : sorted.back();
+	distinctCount = (int)(std::unique(sorted.begin(), sorted.end()) - sorted.begin());
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::nodeCount() const
+{
+	return (int)names.size();
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::edgeCount() const
+{
+	return (int)targets.size();
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::findNode(const std::string & name) const
+{
+	std::vector<int>::const_iterator iter = std::lower_bound(byName.begin(), byName.end(), name, NodeNameLess(&names));
+	return (iter != byName.end() && names[*iter] == name) ? *iter : -1;
+}
+
+template <typename TWeight, typename TIndex>
+const std::string & BasicStaticGraph<TWeight, TIndex>::nodeName(int node) const
+{
+	return names[node];
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::edgeBegin(int node) const
+{
+	return offsets[node];
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::edgeEnd(int node) const
+{
+	return offsets[node + 1];
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::edgeTarget(int edge) const
+{
+	return targets[edge];
+}
+
+template <typename TWeight, typename TIndex>
+TWeight BasicStaticGraph<TWeight, TIndex>::edgeWeight(int edge) const
+{
+	return weights[edge];
+}
+
+template <typename TWeight, typename TIndex>
+const TIndex * BasicStaticGraph<TWeight, TIndex>::edgeTargets() const
+{
+	return targets.empty() ? NULL : &targets[0];
+}
+
+template <typename TWeight, typename TIndex>
+const TWeight * BasicStaticGraph<TWeight, TIndex>::edgeWeights() const
+{
+	return weights.empty() ? NULL : &weights[0];
+}
+
+template <typename TWeight, typename TIndex>
+size_t BasicStaticGraph<TWeight, TIndex>::edgeBytes() const
+{
+	return offsets.size() * sizeof(int) + targets.size() * sizeof(TIndex) + weights.size() * sizeof(TWeight);
+}
+
+template <typename TWeight, typename TIndex>
+TWeight BasicStaticGraph<TWeight, TIndex>::minWeight() const
+{
+	return minimum;
+}
+
+template <typename TWeight, typename TIndex>
+TWeight BasicStaticGraph<TWeight, TIndex>::maxWeight() const
+{
+	return maximum;
+}
+
+template <typename TWeight, typename TIndex>
+int BasicStaticGraph<TWeight, TIndex>::distinctWeightCount() const
+{
+	return distinctCount;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+const char * SearchAlgorithm::name(int algorithm)
+{
+	switch (algorithm)
+	{
+	case ALGORITHM_AUTO:
+		return "auto";
+	case ALGORITHM_DIJKSTRA:
+		return "dijkstra";
+	case ALGORITHM_BFS:
+		return "bfs";
+	case ALGORITHM_ZERO_ONE_BFS:
+		return "0-1 bfs";
+	default:
+		return "unknown";
+	}
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+// Для типов без векторного ядра (веса short и double) отбор не выполняется (-1), и дуги проверяются обычным циклом.
+template <typename TWeight, typename TIndex>
+static int filterEdges(int, const TIndex *, const TWeight *, int, TWeight, const TWeight *, const unsigned int *, unsigned int, int *)
+{
+	return -1;
+}
+
+static int filterEdges(int kernel, const int * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return RelaxKernel::filter(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+static int filterEdges(int kernel, const unsigned short * targets, const int * weights, int count, int base, const int * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return RelaxKernel::filter(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+static int filterEdges(int kernel, const int * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return RelaxKernel::filter(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+static int filterEdges(int kernel, const unsigned short * targets, const __int64 * weights, int count, __int64 base, const __int64 * labels, const unsigned int * stamps, unsigned int stamp, int * candidates)
+{
+	return RelaxKernel::filter(kernel, targets, weights, count, base, labels, stamps, stamp, candidates);
+}
+
+template <typename TWeight, typename TIndex>
+BasicQueryContext<TWeight, TIndex>::BasicQueryContext(const BasicStaticGraph<TWeight, TIndex> * _graph)
+{
+	graph = _graph;
+	labels.resize(graph->nodeCount());
+	hops.resize(graph->nodeCount());
+	parentEdges.resize(graph->nodeCount());
+	parentNodes.resize(graph->nodeCount());
+	stamps.assign(graph->nodeCount(), 0);
+	stamp = 0;
+	kernel = RelaxKernel::best();
+	setAlgorithm(SearchAlgorithm::ALGORITHM_AUTO);
+	reachability = NULL;
+	exceeded = false;
+	countedNodes = 0;
+	countedBound = 0x7FFFFFFFFFFFFFFFLL;
+	startTime = 0;
+	banStamp = 0;
+	masked = false;
+	targetsLeft = 0;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::setKernel(int _kernel)
+{
+	if (!RelaxKernel::available(_kernel))
+		return false;
+	kernel = _kernel;
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::setAlgorithm(int _algorithm)
+{
+	bool equal = graph->distinctWeightCount() <= 1;
+	bool zeroOne = graph->minWeight() >= 0 && graph->maxWeight() <= 1;
+	switch (_algorithm)
+	{
+	case SearchAlgorithm::ALGORITHM_AUTO:
+		algorithm = equal ? SearchAlgorithm::ALGORITHM_BFS : (zeroOne ? SearchAlgorithm::ALGORITHM_ZERO_ONE_BFS : SearchAlgorithm::ALGORITHM_DIJKSTRA);
+		return true;
+	case SearchAlgorithm::ALGORITHM_DIJKSTRA:
+		break;
+	case SearchAlgorithm::ALGORITHM_BFS:
+		if (!equal)
+			return false;
+		break;
+	case SearchAlgorithm::ALGORITHM_ZERO_ONE_BFS:
+		if (!zeroOne)
+			return false;
+		break;
+	default:
+		return false;
+	}
+	algorithm = _algorithm;
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::getAlgorithm() const
+{
+	return algorithm;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::setReachability(const ReachabilityIndex * _reachability)
+{
+	reachability = _reachability;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::setBudget(const SearchBudget & _budget)
+{
+	budget = _budget;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::budgetExceeded() const
+{
+	return exceeded;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::setMask(const std::vector<int> & bannedNodes, const std::vector<int> & bannedEdges)
+{
+	if (nodeBans.empty())
+	{
+		nodeBans.assign(graph->nodeCount(), 0);
+		edgeBans.assign(graph->edgeCount(), 0);
+	}
+	if (++banStamp == 0)
+	{
+		std::fill(nodeBans.begin(), nodeBans.end(), 0);
+		std::fill(edgeBans.begin(), edgeBans.end(), 0);
+		banStamp = 1;
+	}
+	for (size_t i = 0; i < bannedNodes.size(); i++)
+		nodeBans[bannedNodes[i]] = banStamp;
+	for (size_t i = 0; i < bannedEdges.size(); i++)
+		edgeBans[bannedEdges[i]] = banStamp;
+	masked = !bannedNodes.empty() || !bannedEdges.empty();
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::clearMask()
+{
+	masked = false;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::settle(int node, TWeight weight)
+{
+	if (budget.limited())
+	{
+		if (budget.maxDistance >= 0 && weight > budget.maxDistance)
+			return false;
+		// Время проверяется раз в 256 узлов, чтобы не тратить на него больше, чем на сам поиск.
+		bool counted = countedBound == 0x7FFFFFFFFFFFFFFFLL || (__int64)weight + graph->potential(node) <= countedBound;
+		if ((budget.maxSettled > 0 && counted && countedNodes >= budget.maxSettled) ||
+			(budget.maxSeconds > 0 && (settledNodes.size() & 255) == 255 && Timer::seconds() - startTime > budget.maxSeconds))
+		{
+			exceeded = true;
+			return false;
+		}
+		settledNodes.push_back(node);
+		if (counted)
+			countedNodes++;
+	}
+	// Поиск до нескольких узлов останавливается на последнем из них: его метка и дуга пути уже окончательны, как у end.
+	if (targetsLeft > 0 && targetMarks[node] == stamp)
+	{
+		targetMarks[node] = 0;
+		if (--targetsLeft == 0)
+			return false;
+	}
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::relax(int edge, int from)
+{
+	int target = graph->edgeTarget(edge);
+	if (masked && (edgeBans[edge] == banStamp || nodeBans[target] == banStamp))
+		return false;
+	TWeight weight = (TWeight)(labels[from] + graph->edgeWeight(edge));
+	int count = hops[from] + 1;
+	if (stamps[target] != stamp || labels[target] > weight || (labels[target] == weight && hops[target] > count))
+	{
+		stamps[target] = stamp;
+		labels[target] = weight;
+		hops[target] = count;
+		parentEdges[target] = edge;
+		parentNodes[target] = from;
+		return true;
+	}
+	// Путь той же длины и с тем же числом дуг: оставляем последнюю дугу с меньшим индексом, метка не меняется.
+	if (labels[target] == weight && hops[target] == count && edge < parentEdges[target])
+	{
+		parentEdges[target] = edge;
+		parentNodes[target] = from;
+	}
+	return false;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::beginSearch()
+{
+	// Новый номер запроса делает недействительными все метки предыдущего; при переполнении номера метки сбрасываются явно.
+	if (++stamp == 0)
+	{
+		std::fill(stamps.begin(), stamps.end(), 0);
+		std::fill(targetMarks.begin(), targetMarks.end(), 0);
+		stamp = 1;
+	}
+	heap.clear();
+	settledNodes.clear();
+	countedNodes = 0;
+	if (budget.maxSeconds > 0)
+		startTime = Timer::seconds();
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::addSource(int node, TWeight offset)
+{
+	labels[node] = offset;
+	hops[node] = 0;
+	parentEdges[node] = -1;
+	parentNodes[node] = -1;
+	stamps[node] = stamp;
+	heap.push_back(HeapItem(offset, 0, (TIndex)node));
+	std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::runSearch(int end, int searchAlgorithm)
+{
+	switch (searchAlgorithm)
+	{
+	case SearchAlgorithm::ALGORITHM_BFS:
+		return searchBfs(end);
+	case SearchAlgorithm::ALGORITHM_ZERO_ONE_BFS:
+		return searchZeroOne(end);
+	default:
+		return searchDijkstra(end);
+	}
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::search(int start, int end)
+{
+	exceeded = false;
+	// Без индекса недостижимый узел обнаруживается только после обхода всех узлов, достижимых из начального.
+	if (end != -1 && reachability != NULL && !reachability->mayReach(start, end))
+		return -1;
+	beginSearch();
+	addSource(start, 0);
+	return runSearch(end, algorithm);
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::searchNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, int end)
+{
+	exceeded = false;
+	if (end != -1 && reachability != NULL)
+	{
+		bool reachable = false;
+		for (size_t i = 0; i < sources.size() && !reachable; i++)
+			reachable = reachability->mayReach(sources[i], end);
+		if (!reachable)
+			return -1;
+	}
+	if (sourceIndices.size() != labels.size())
+		sourceIndices.resize(labels.size());
+	beginSearch();
+	bool shifted = false;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		int node = sources[i];
+		TWeight offset = (offsets != NULL) ? (*offsets)[i] : 0;
+		if (stamps[node] == stamp && !(offset < labels[node]))
+			continue;
+		shifted = shifted || offset != 0;
+		addSource(node, offset);
+		sourceIndices[node] = (int)i;
+	}
+	// Обходы в ширину верны, только если все начальные узлы имеют одну и ту же метку.
+	return runSearch(end, shifted ? SearchAlgorithm::ALGORITHM_DIJKSTRA : algorithm);
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::searchDijkstra(int end)
+{
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+		HeapItem current = heap.back();
+		heap.pop_back();
+		int node = current.node;
+		// Устаревшие элементы кучи пропускаются.
+		if (current.weight != labels[node] || current.hops != hops[node])
+			continue;
+		if (!settle(node, current.weight))
+			return -1;
+		// Все узлы с меньшей меткой уже обработаны, поэтому и дуга пути до этого узла окончательна.
+		if (node == end)
+			return end;
+		int first = graph->edgeBegin(node);
+		int last = graph->edgeEnd(node);
+		int count = -1;
+		if (kernel != RelaxKernel::KERNEL_SCALAR && last - first >= RelaxKernel::MIN_DEGREE)
+		{
+			// Узел большой степени: векторное ядро отбирает дуги, которые могут улучшить метки, остальные не трогаются.
+			if ((int)candidates.size() < last - first)
+				candidates.resize(last - first);
+			count = filterEdges(kernel, graph->edgeTargets() + first, graph->edgeWeights() + first, last - first, current.weight, &labels[0], &stamps[0], stamp, &candidates[0]);
+		}
+		if (count != -1)
+		{
+			for (int i = 0; i < count; i++)
+				if (relax(first + candidates[i], node))
+				{
+					int target = graph->edgeTarget(first + candidates[i]);
+					heap.push_back(HeapItem(labels[target], hops[target], (TIndex)target));
+					std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+				}
+			continue;
+		}
+		for (int edge = first; edge < last; edge++)
+		{
+			if (edge + RelaxKernel::PREFETCH_DISTANCE < last)
+				prefetchRead(&labels[graph->edgeTarget(edge + RelaxKernel::PREFETCH_DISTANCE)]);
+			if (relax(edge, node))
+			{
+				int target = graph->edgeTarget(edge);
+				heap.push_back(HeapItem(labels[target], hops[target], (TIndex)target));
+				std::push_heap(heap.begin(), heap.end(), std::greater<HeapItem>());
+			}
+		}
+	}
+	return -1;
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::searchBfs(int end)
+{
+	// Все веса равны, поэтому длина пути определяется числом дуг, и узлы обрабатываются в порядке очереди.
+	// Метка узла не меняется после первого достижения, но дуга пути еще может смениться на дугу с меньшим индексом
+	// от узла того же уровня - все они обработаны раньше узлов следующего уровня.
+	for (size_t head = 0; head < heap.size(); head++)
+	{
+		int node = heap[head].node;
+		if (!settle(node, labels[node]))
+			return -1;
+		if (node == end)
+			return end;
+		for (int edge = graph->edgeBegin(node); edge < graph->edgeEnd(node); edge++)
+			if (relax(edge, node))
+			{
+				int target = graph->edgeTarget(edge);
+				heap.push_back(HeapItem(labels[target], hops[target], (TIndex)target));
+			}
+	}
+	return -1;
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::searchZeroOne(int end)
+{
+	// Узлы одного расстояния обрабатываются по возрастанию числа дуг: они приходят из двух очередей, в каждой из которых
+	// число дуг не убывает - heap (достигнутые дугами веса 1 с предыдущего расстояния) и zeroQueue (дугами веса 0 с этого же).
+	zeroQueue.clear();
+	nextQueue.clear();
+	while (!heap.empty())
+	{
+		size_t head = 0, zeroHead = 0;
+		for (;;)
+		{
+			bool fromHeap = head < heap.size() && (zeroHead == zeroQueue.size() || heap[head].hops <= zeroQueue[zeroHead].hops);
+			if (!fromHeap && zeroHead == zeroQueue.size())
+				break;
+			HeapItem current = fromHeap ? heap[head++] : zeroQueue[zeroHead++];
+			int node = current.node;
+			if (current.weight != labels[node] || current.hops != hops[node])
+				continue;
+			if (!settle(node, current.weight))
+				return -1;
+			if (node == end)
+				return end;
+			for (int edge = graph->edgeBegin(node); edge < graph->edgeEnd(node); edge++)
+				if (relax(edge, node))
+				{
+					int target = graph->edgeTarget(edge);
+					HeapItem item(labels[target], hops[target], (TIndex)target);
+					if (graph->edgeWeight(edge) == 0)
+						zeroQueue.push_back(item);
+					else
+						nextQueue.push_back(item);
+				}
+		}
+		heap.swap(nextQueue);
+		nextQueue.clear();
+		zeroQueue.clear();
+	}
+	return -1;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::findPath(int start, int end, BasicPathResult<TWeight> * result)
+{
+	result->totalWeight = -1;
+	result->nodes.clear();
+	result->edges.clear();
+	if (search(start, end) == -1)
+		return false;
+	buildPath(end, result);
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::buildPath(int end, BasicPathResult<TWeight> * result) const
+{
+	// Восстанавливаем путь от конечного узла к начальному.
+	result->totalWeight = labels[end];
+	result->nodes.clear();
+	result->edges.clear();
+	for (int node = end; node != -1; node = parentNodes[node])
+	{
+		result->nodes.push_back(node);
+		if (parentEdges[node] != -1)
+			result->edges.push_back(parentEdges[node]);
+	}
+	std::reverse(result->nodes.begin(), result->nodes.end());
+	std::reverse(result->edges.begin(), result->edges.end());
+}
+
+template <typename TWeight, typename TIndex>
+int BasicQueryContext<TWeight, TIndex>::findPaths(int start, const std::vector<int> & ends, std::vector<BasicPathResult<TWeight> > * results)
+{
+	results->assign(ends.size(), BasicPathResult<TWeight>());
+	exceeded = false;
+	if (targetMarks.size() != labels.size())
+		targetMarks.assign(labels.size(), 0);
+	beginSearch();
+	// Конечные узлы отмечаются номером запроса; недостижимые по индексу не ждем.
+	targetsLeft = 0;
+	for (size_t i = 0; i < ends.size(); i++)
+	{
+		int end = ends[i];
+		if (targetMarks[end] == stamp || (reachability != NULL && !reachability->mayReach(start, end)))
+			continue;
+		targetMarks[end] = stamp;
+		targetsLeft++;
+	}
+	if (targetsLeft == 0)
+		return 0;
+	addSource(start, 0);
+	runSearch(-1, algorithm);
+	targetsLeft = 0;
+
+	// Найдены пути до обработанных конечных узлов: с них снята отметка, а метка действительна в этом запросе.
+	int found = 0;
+	for (size_t i = 0; i < ends.size(); i++)
+	{
+		int end = ends[i];
+		if (stamps[end] != stamp || targetMarks[end] == stamp)
+			continue;
+		buildPath(end, &(*results)[i]);
+		found++;
+	}
+	return found;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::computeTree(int start, std::vector<TWeight> * treeLabels, std::vector<int> * treeParents)
+{
+	// Поиск без конечного узла обходит все достижимые узлы.
+	search(start, -1);
+	treeLabels->assign(graph->nodeCount(), -1);
+	treeParents->assign(graph->nodeCount(), -1);
+	if (budget.limited())
+	{
+		// Метки узлов, до которых ограниченный поиск не дошел, не окончательны.
+		for (size_t i = 0; i < settledNodes.size(); i++)
+		{
+			(*treeLabels)[settledNodes[i]] = labels[settledNodes[i]];
+			(*treeParents)[settledNodes[i]] = parentNodes[settledNodes[i]];
+		}
+		return;
+	}
+	for (int node = 0; node < graph->nodeCount(); node++)
+		if (stamps[node] == stamp)
+		{
+			(*treeLabels)[node] = labels[node];
+			(*treeParents)[node] = parentNodes[node];
+		}
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::computeWithin(int start, __int64 maxDistance, std::vector<int> * nodes, std::vector<TWeight> * distances, __int64 _countedBound)
+{
+	// Обработанные узлы записываются, только если поиск ограничен, поэтому радиус задается всегда - без ограничения он больше любой длины пути.
+	SearchBudget saved = budget;
+	budget.maxDistance = (maxDistance >= 0) ? maxDistance : 0x7FFFFFFFFFFFFFFFLL;
+	countedBound = _countedBound;
+	search(start, -1);
+	budget = saved;
+	countedBound = 0x7FFFFFFFFFFFFFFFLL;
+	nodes->assign(settledNodes.begin(), settledNodes.end());
+	distances->resize(settledNodes.size());
+	for (size_t i = 0; i < settledNodes.size(); i++)
+		(*distances)[i] = labels[settledNodes[i]];
+	return !exceeded;
+}
+
+template <typename TWeight, typename TIndex>
+bool BasicQueryContext<TWeight, TIndex>::findNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, int end, BasicPathResult<TWeight> * result, int * source)
+{
+	result->totalWeight = -1;
+	result->nodes.clear();
+	result->edges.clear();
+	*source = -1;
+	if (searchNearest(sources, offsets, end) == -1)
+		return false;
+
+	result->totalWeight = labels[end];
+	int node = end;
+	for (; parentNodes[node] != -1; node = parentNodes[node])
+	{
+		result->nodes.push_back(node);
+		result->edges.push_back(parentEdges[node]);
+	}
+	result->nodes.push_back(node);
+	*source = sourceIndices[node];
+	std::reverse(result->nodes.begin(), result->nodes.end());
+	std::reverse(result->edges.begin(), result->edges.end());
+	return true;
+}
+
+template <typename TWeight, typename TIndex>
+void BasicQueryContext<TWeight, TIndex>::computeNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, std::vector<TWeight> * nearestLabels, std::vector<int> * nearestSources, std::vector<int> * nearestParents)
+{
+	searchNearest(sources, offsets, -1);
+	int n = graph->nodeCount();
+	nearestLabels->assign(n, -1);
+	nearestSources->assign(n, -1);
+	nearestParents->assign(n, -1);
+	// После ограниченного поиска окончательны метки только обработанных узлов; их предки тоже обработаны.
+	bool limited = budget.limited();
+	int count = limited ? (int)settledNodes.size() : n;
+	for (int i = 0; i < count; i++)
+	{
+		int node = limited ? settledNodes[i] : i;
+		if (stamps[node] != stamp)
+			continue;
+		(*nearestLabels)[node] = labels[node];
+		(*nearestParents)[node] = parentNodes[node];
+		// Источник узла - источник его предка: поднимаемся по дереву до узла с известным источником
+		// и записываем его всем узлам на пути, так что каждый узел проходится один раз.
+		pathNodes.clear();
+		int ancestor = node;
+		while ((*nearestSources)[ancestor] == -1 && parentNodes[ancestor] != -1)
+		{
+			pathNodes.push_back(ancestor);
+			ancestor = parentNodes[ancestor];
+		}
+		if ((*nearestSources)[ancestor] == -1)
+			(*nearestSources)[ancestor] = sourceIndices[ancestor];
+		for (size_t i = 0; i < pathNodes.size(); i++)
+			(*nearestSources)[pathNodes[i]] = (*nearestSources)[ancestor];
+	}
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+template class BasicStaticGraph<short, unsigned short>;
+template class BasicStaticGraph<short, int>;
+template class BasicStaticGraph<int, unsigned short>;
+template class BasicStaticGraph<int, int>;
+template class BasicStaticGraph<__int64, unsigned short>;
+template class BasicStaticGraph<__int64, int>;
+template class BasicStaticGraph<double, unsigned short>;
+template class BasicStaticGraph<double, int>;
+
+template class BasicQueryContext<short, unsigned short>;
+template class BasicQueryContext<short, int>;
+template class BasicQueryContext<int, unsigned short>;
+template class BasicQueryContext<int, int>;
+template class BasicQueryContext<__int64, unsigned short>;
+template class BasicQueryContext<__int64, int>;
+template class BasicQueryContext<double, unsigned short>;
+template class BasicQueryContext<double, int>;
@@ -0,0 +1,477 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <utility>
+#include "platform.h"
+#include "graph.h"
+
+class ReachabilityIndex;
+
+/**
+ * Неизменяемый граф для обработки запросов.
+ * Узлы пронумерованы в порядке имен (или в порядке, заданном renumber), дуги хранятся в сжатом виде (CSR):
+ * дуги узла v занимают индексы [offsets[v], offsets[v + 1]).
+ * После построения объект только читается, поэтому один граф может одновременно использоваться любым количеством потоков.
+ *
+ * Тип веса TWeight служит и типом длин путей, поэтому должен вмещать сумму весов всех дуг; тип индекса TIndex хранит конечные узлы дуг.
+ * Узкие типы уменьшают объем данных, читаемых при поиске; какие типы подходят графу, выбирает QueryEngine::create.
+ * Шаблон явно инстанцируется в staticgraph.cpp для весов short, int, __int64, double и индексов unsigned short, int.
+ */
+template <typename TWeight, typename TIndex>
+class BasicStaticGraph
+{
+private:
+	template <typename, typename> friend class BasicStaticGraph;
+
+	std::vector<std::string> names;		// Имена узлов.
+	std::vector<int> byName;			// Индексы узлов, упорядоченные по именам; по ним ищется узел.
+	std::vector<int, PageAllocator<int> > offsets;			// Начало списка дуг каждого узла; последний элемент равен количеству дуг.
+	std::vector<TIndex, PageAllocator<TIndex> > targets;	// Конечные узлы дуг.
+	std::vector<TWeight, PageAllocator<TWeight> > weights;	// Веса дуг.
+	TWeight minimum;					// Наименьший вес дуги.
+	TWeight maximum;					// Наибольший вес дуги.
+	int distinctCount;					// Количество различных весов.
+	std::vector<__int64> potentials;	// Потенциалы узлов после reweight; пустой, если веса исходные.
+
+	void computeWeightStatistics();
+
+	BasicStaticGraph(const BasicStaticGraph &);
+	BasicStaticGraph & operator=(const BasicStaticGraph &);
+
+public:
+	typedef TWeight Weight;
+	typedef TIndex Index;
+
+	BasicStaticGraph();
+
+	/**
+	 * Конструктор, в котором граф сразу строится по заданному графу.
+	 * @param graph - исходный граф.
+	 */
+	BasicStaticGraph(const Graph & graph);
+
+	/**
+	 * Строит граф по заданному графу. Порядок дуг каждого узла сохраняется.
+	 * @param graph - исходный граф.
+	 */
+	void build(const Graph & graph);
+
+	/**
+	 * Строит граф по списку дуг без проверки ограничений. Дуги каждого узла сохраняют порядок списка, как и в Graph::build.
+	 * @param edges - вектор объектов FileListItem.
+	 */
+	void build(const std::vector<FileListItem> & edges);
+
+	/**
+	 * Строит копию графа с типами веса и индекса этого графа. Веса и индексы должны в них помещаться.
+	 * @param source - исходный граф.
+	 */
+	void build(const BasicStaticGraph<__int64, int> & source);
+
+	/**
+	 * Считывает граф из файла в формате Graph::readFromFile и проверяет ограничения, как Graph, но допускает дуги с отрицательным весом:
+	 * веса таких графов сразу приводятся к неотрицательным (reweight), а вместо ERROR_NEGATIVE_WEIGHT проверяется отсутствие
+	 * цикла отрицательной длины (ERROR_NEGATIVE_CYCLE).
+	 * @param fileName - имя файла, с которого считывать.
+	 * @param errors - указатель на вектор, в который запишутся коды ошибок Graph::ERROR_* (пустой при успехе).
+	 * @return - true, если граф построен, иначе false (граф тогда пуст).
+	 */
+	bool readFromFile(const char * fileName, std::vector<int> * errors);
+
+	/**
+	 * Приведение весов к неотрицательным по Джонсону. Потенциал p(v) - длина кратчайшего пути до v от вспомогательного узла,
+	 * соединенного с каждым узлом дугой веса 0; он вычисляется один раз алгоритмом Беллмана-Форда с очередью (SPFA).
+	 * Вес дуги (u, v) заменяется на w + p(u) - p(v) >= 0, и длина любого пути из s в t меняется на одно и то же p(s) - p(t),
+	 * поэтому кратчайшие пути остаются кратчайшими, и по ним работает обычный поиск. BasicQueryContext возвращает приведенные длины;
+	 * QueryEngine переводит их обратно. У графа без отрицательных весов ничего не меняется.
+	 * @return - false, если в графе есть цикл отрицательной длины (граф тогда не меняется).
+	 */
+	bool reweight();
+
+	/**
+	 * Приведены ли веса графа (reweight).
+	 */
+	bool reweighted() const;
+
+	/**
+	 * Потенциал узла (0, если веса не приведены).
+	 * @param node - индекс узла.
+	 */
+	__int64 potential(int node) const;
+
+	/**
+	 * Вес дуги до приведения (для неприведенного графа совпадает с edgeWeight).
+	 * @param edge - индекс дуги.
+	 */
+	__int64 originalWeight(int edge) const;
+
+	/**
+	 * Перенумерация узлов: узел order[i] получает индекс i, списки дуг переставляются вместе с узлами, имена остаются при своих узлах.
+	 * @param order - перестановка индексов узлов.
+	 */
+	void renumber(const std::vector<int> & order);
+
+	/**
+	 * Количество узлов.
+	 */
+	int nodeCount() const;
+
+	/**
+	 * Количество дуг.
+	 */
+	int edgeCount() const;
+
+	/**
+	 * Поиск узла по имени.
+	 * @param name - имя узла.
+	 * @return - индекс узла или -1, если узла нет в графе.
+	 */
+	int findNode(const std::string & name) const;
+
+	/**
+	 * Имя узла.
+	 * @param node - индекс узла.
+	 */
+	const std::string & nodeName(int node) const;
+
+	/**
+	 * Индекс первой дуги, выходящей из узла.
+	 * @param node - индекс узла.
+	 */
+	int edgeBegin(int node) const;
+
+	/**
+	 * Индекс, следующий за последней дугой, выходящей из узла.
+	 * @param node - индекс узла.
+	 */
+	int edgeEnd(int node) const;
+
+	/**
+	 * Конечный узел дуги.
+	 * @param edge - индекс дуги.
+	 */
+	int edgeTarget(int edge) const;
+
+	/**
+	 * Вес дуги.
+	 * @param edge - индекс дуги.
+	 */
+	TWeight edgeWeight(int edge) const;
+
+	/**
+	 * Конечные узлы всех дуг подряд (для векторной обработки); NULL, если дуг нет.
+	 */
+	const TIndex * edgeTargets() const;
+
+	/**
+	 * Веса всех дуг подряд; NULL, если дуг нет.
+	 */
+	const TWeight * edgeWeights() const;
+
+	/**
+	 * Объем памяти, занимаемый списками дуг, в байтах.
+	 */
+	size_t edgeBytes() const;
+
+	/**
+	 * Наименьший вес дуги (0, если дуг нет).
+	 */
+	TWeight minWeight() const;
+
+	/**
+	 * Наибольший вес дуги (0, если дуг нет).
+	 */
+	TWeight maxWeight() const;
+
+	/**
+	 * Количество различных весов дуг.
+	 */
+	int distinctWeightCount() const;
+};
+
+// Граф с типами по умолчанию, в которые помещается любой граф из файла.
+typedef BasicStaticGraph<__int64, int> StaticGraph;
+
+/**
+ * Результат запроса кратчайшего пути.
+ */
+template <typename TWeight>
+struct BasicPathResult
+{
+	TWeight totalWeight;		// Длина пути или -1, если пути нет (см. found).
+	std::vector<int> nodes;		// Узлы пути от начального до конечного; пустой, если пути нет.
+	std::vector<int> edges;		// Дуги пути.
+
+	BasicPathResult()
+	{
+		totalWeight = -1;
+	}
+
+	/**
+	 * Найден ли путь. По длине этого не определить: в графе с приведенными весами (BasicStaticGraph::reweight)
+	 * длина -1 бывает настоящей, а путь всегда содержит хотя бы начальный узел.
+	 */
+	bool found() const
+	{
+		return !nodes.empty();
+	}
+};
+
+typedef BasicPathResult<__int64> PathResult;
+
+/**
+ * Алгоритмы поиска, между которыми выбирает BasicQueryContext.
+ */
+class SearchAlgorithm
+{
+public:
+	// Выбор по весам дуг графа.
+	static const int ALGORITHM_AUTO = 0;
+	// Алгоритм Дейкстры с двоичной кучей; подходит для любых неотрицательных весов.
+	static const int ALGORITHM_DIJKSTRA = 1;
+	// Обход в ширину; все дуги имеют одинаковый вес.
+	static const int ALGORITHM_BFS = 2;
+	// Обход 0-1: веса дуг только 0 и 1, вместо кучи - очереди текущего и следующего расстояния.
+	static const int ALGORITHM_ZERO_ONE_BFS = 3;
+
+	/**
+	 * Название алгоритма.
+	 */
+	static const char * name(int algorithm);
+};
+
+/**
+ * Ограничения поиска для запросов с предсказуемым временем ответа.
+ * Поиск обрабатывает узлы по возрастанию расстояния и останавливается, дойдя до узла дальше maxDistance
+ * (все более близкие узлы при этом найдены) или исчерпав бюджет работы - число окончательно обработанных узлов или время.
+ */
+struct SearchBudget
+{
+	__int64 maxDistance;	// Наибольшее расстояние до узлов, которые нужно найти, или -1 без ограничения.
+	int maxSettled;			// Наибольшее число обработанных узлов или 0 без ограничения.
+	double maxSeconds;		// Наибольшее время поиска в секундах или 0 без ограничения.
+
+	SearchBudget()
+	{
+		maxDistance = -1;
+		maxSettled = 0;
+		maxSeconds = 0;
+	}
+
+	/**
+	 * Задано ли хотя бы одно ограничение.
+	 */
+	bool limited() const
+	{
+		return maxDistance >= 0 || maxSettled > 0 || maxSeconds > 0;
+	}
+};
+
+/**
+ * Рабочая память запросов к одному графу.
+ * Контекст принадлежит одному потоку и переиспользуется между запросами: массивы меток выделяются один раз,
+ * а вместо их очистки перед каждым запросом увеличивается номер запроса - метка узла действительна, только если его номер совпадает с текущим.
+ * Дуги узлов большой степени сначала проверяются векторным ядром (RelaxKernel), а обновляются только отобранные им.
+ *
+ * Алгоритм выбирается по весам дуг (SearchAlgorithm). Чтобы все алгоритмы возвращали один и тот же путь, среди кратчайших путей
+ * выбирается путь с наименьшим числом дуг, а из нескольких таких - путь, последняя дуга которого имеет наименьший индекс
+ * (и так далее от конца к началу). Для этого метка узла - пара (длина, число дуг), сравниваемая лексикографически.
+ */
+template <typename TWeight, typename TIndex>
+class BasicQueryContext
+{
+private:
+	/**
+	 * Элемент кучи или очереди: метка узла на момент добавления и индекс узла.
+	 */
+	struct HeapItem
+	{
+		TWeight weight;
+		int hops;
+		TIndex node;
+
+		HeapItem(TWeight _weight, int _hops, TIndex _node)
+		{
+			weight = _weight;
+			hops = _hops;
+			node = _node;
+		}
+
+		bool operator>(const HeapItem & other) const
+		{
+			if (weight != other.weight)
+				return weight > other.weight;
+			if (hops != other.hops)
+				return hops > other.hops;
+			return node > other.node;
+		}
+	};
+
+	const BasicStaticGraph<TWeight, TIndex> * graph;	// Граф, к которому выполняются запросы.
+	std::vector<TWeight, PageAllocator<TWeight> > labels;		// Длины путей до узлов.
+	std::vector<int, PageAllocator<int> > hops;					// Число дуг путей до узлов.
+	std::vector<int, PageAllocator<int> > parentEdges;			// Последняя дуга кратчайшего пути до узла.
+	std::vector<int, PageAllocator<int> > parentNodes;			// Предыдущий узел кратчайшего пути.
+	std::vector<unsigned int, PageAllocator<unsigned int> > stamps;	// Номер запроса, в котором узел достигнут.
+	unsigned int stamp;					// Номер текущего запроса.
+	std::vector<HeapItem> heap;			// Двоичная куча узлов с неокончательными метками (в обходах - очередь текущего расстояния).
+	std::vector<HeapItem> zeroQueue;	// Узлы, достигнутые по дугам веса 0 (обход 0-1).
+	std::vector<HeapItem> nextQueue;	// Узлы следующего расстояния (обход 0-1).
+	int kernel;							// Ядро проверки дуг узлов большой степени (RelaxKernel::KERNEL_*).
+	int algorithm;						// Алгоритм поиска (SearchAlgorithm::ALGORITHM_*, кроме ALGORITHM_AUTO).
+	const ReachabilityIndex * reachability;	// Индекс достижимости или NULL.
+	std::vector<int> candidates;		// Дуги, отобранные ядром.
+	std::vector<int> sourceIndices;		// Номер источника в списке для начальных узлов поиска от нескольких источников.
+	std::vector<int> pathNodes;			// Узлы, ожидающие номера ближайшего источника.
+	SearchBudget budget;				// Ограничения поиска.
+	bool exceeded;						// Остановлен ли последний поиск из-за исчерпания бюджета.
+	std::vector<int> settledNodes;		// Обработанные узлы в порядке обработки (только при ограниченном поиске).
+	int countedNodes;					// Обработанные узлы, учитываемые в maxSettled.
+	__int64 countedBound;				// Наибольшая сумма метки и потенциала узла, учитываемого в maxSettled.
+	double startTime;					// Время начала ограниченного по времени поиска.
+	std::vector<unsigned int> nodeBans;	// Номер маски, которой запрещен узел (выделяется при первой маске).
+	std::vector<unsigned int> edgeBans;	// Номер маски, которой запрещена дуга.
+	unsigned int banStamp;				// Номер текущей маски.
+	bool masked;						// Действует ли маска.
+	std::vector<unsigned int> targetMarks;	// Номер запроса, в котором узел - еще не обработанный конечный узел поиска до нескольких узлов.
+	int targetsLeft;					// Количество таких узлов (0 вне поиска до нескольких узлов).
+
+	void beginSearch();
+	void addSource(int node, TWeight offset);
+	int runSearch(int end, int searchAlgorithm);
+	bool settle(int node, TWeight weight);
+	int search(int start, int end);
+	int searchNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, int end);
+	int searchDijkstra(int end);
+	int searchBfs(int end);
+	int searchZeroOne(int end);
+	bool relax(int edge, int from);
+	void buildPath(int end, BasicPathResult<TWeight> * result) const;
+
+	BasicQueryContext(const BasicQueryContext &);
+	BasicQueryContext & operator=(const BasicQueryContext &);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _graph - граф; должен существовать все время жизни контекста.
+	 */
+	BasicQueryContext(const BasicStaticGraph<TWeight, TIndex> * _graph);
+
+	/**
+	 * Выбор ядра проверки дуг (по умолчанию - лучшее доступное). Векторные ядра есть для весов int и __int64
+	 * при индексах int и unsigned short, для весов short и double всегда используется обычный цикл.
+	 * @param _kernel - ядро (RelaxKernel::KERNEL_*).
+	 * @return - true, если ядро доступно на этом процессоре, иначе false (ядро не меняется).
+	 */
+	bool setKernel(int _kernel);
+
+	/**
+	 * Выбор алгоритма поиска; по умолчанию (ALGORITHM_AUTO) - самый быстрый из подходящих весам графа. Все алгоритмы возвращают одинаковые пути.
+	 * @param _algorithm - алгоритм (SearchAlgorithm::ALGORITHM_*).
+	 * @return - true, если алгоритм подходит весам графа, иначе false (алгоритм не меняется).
+	 */
+	bool setAlgorithm(int _algorithm);
+
+	/**
+	 * Используемый алгоритм поиска.
+	 */
+	int getAlgorithm() const;
+
+	/**
+	 * Подключение индекса достижимости: запросы к узлам, до которых пути точно нет, завершаются без поиска.
+	 * @param _reachability - индекс, построенный по графу с той же нумерацией узлов, или NULL; должен существовать все время жизни контекста.
+	 */
+	void setReachability(const ReachabilityIndex * _reachability);
+
+	/**
+	 * Ограничение всех следующих поисков. Если поиск остановлен раньше, чем метка конечного узла стала окончательной,
+	 * путь считается ненайденным, а дерево путей и разбиение между источниками содержат только обработанные узлы.
+	 * @param _budget - ограничения; SearchBudget() снимает их.
+	 */
+	void setBudget(const SearchBudget & _budget);
+
+	/**
+	 * Запрет узлов и дуг во всех следующих поисках (маска), например для поиска альтернативных путей.
+	 * Граф не копируется: запреты хранятся номерами маски, как метки - номерами запросов, поэтому смена маски занимает время,
+	 * пропорциональное числу запрещенных узлов и дуг.
+	 * @param bannedNodes - узлы, через которые не проходят пути (начальный узел запроса запрещать не следует).
+	 * @param bannedEdges - дуги, которые не используются.
+	 */
+	void setMask(const std::vector<int> & bannedNodes, const std::vector<int> & bannedEdges);
+
+	/**
+	 * Снятие маски.
+	 */
+	void clearMask();
+
+	/**
+	 * Остановлен ли последний поиск из-за исчерпания бюджета работы (число узлов или время).
+	 * Остановка на maxDistance исчерпанием не считается: все узлы в этом радиусе найдены.
+	 */
+	bool budgetExceeded() const;
+
+	/**
+	 * Поиск кратчайшего пути. Поиск прекращается, как только метка конечного узла становится окончательной.
+	 * @param start - индекс начального узла.
+	 * @param end - индекс конечного узла.
+	 * @param result - указатель на результат.
+	 * @return - true, если путь найден, иначе false.
+	 */
+	bool findPath(int start, int end, BasicPathResult<TWeight> * result);
+
+	/**
+	 * Поиск кратчайших путей из одного узла до нескольких одним поиском, который прекращается,
+	 * как только окончательными становятся метки всех конечных узлов. Пути совпадают с ответами findPath для каждой пары.
+	 * @param start - индекс начального узла.
+	 * @param ends - индексы конечных узлов (могут повторяться).
+	 * @param results - указатель на вектор, в который запишутся результаты в порядке ends.
+	 * @return - количество найденных путей.
+	 */
+	int findPaths(int start, const std::vector<int> & ends, std::vector<BasicPathResult<TWeight> > * results);
+
+	/**
+	 * Построение дерева кратчайших путей из узла до всех достижимых узлов.
+	 * @param start - индекс начального узла.
+	 * @param treeLabels - указатель на вектор, в который запишутся длины путей (-1 для недостижимых узлов).
+	 * @param treeParents - указатель на вектор, в который запишутся предыдущие узлы путей (-1 для начального и недостижимых узлов).
+	 */
+	void computeTree(int start, std::vector<TWeight> * treeLabels, std::vector<int> * treeParents);
+
+	/**
+	 * Узлы в пределах расстояния от начального (изохрона) с учетом ограничений setBudget.
+	 * @param start - индекс начального узла.
+	 * @param maxDistance - наибольшее расстояние или -1 без ограничения (заменяет maxDistance бюджета на время запроса).
+	 * @param nodes - указатель на вектор, в который запишутся найденные узлы по возрастанию расстояния.
+	 * @param distances - указатель на вектор, в который запишутся расстояния до них.
+	 * @param countedBound - в maxSettled бюджета учитываются только узлы, у которых сумма метки и потенциала не больше этой величины
+	 *                       (в графе с приведенными весами - узлы не дальше countedBound - p(start) в исходных весах).
+	 * @return - true, если найдены все узлы в пределах расстояния; false, если бюджет исчерпан раньше.
+	 */
+	bool computeWithin(int start, __int64 maxDistance, std::vector<int> * nodes, std::vector<TWeight> * distances, __int64 countedBound = 0x7FFFFFFFFFFFFFFFLL);
+
+	/**
+	 * Поиск ближайшего к узлу источника: поиск начинается сразу от всех источников с метками, равными их смещениям.
+	 * Из равноудаленных источников выбирается тот, чей путь меньше по правилу выбора путей (см. описание класса);
+	 * если узел указан в списке несколько раз, действует меньшее смещение, а при равных - первое вхождение.
+	 * Ненулевые смещения требуют алгоритма Дейкстры, поэтому с ними обходы в ширину не используются.
+	 * @param sources - начальные узлы (источники).
+	 * @param offsets - неотрицательные смещения источников или NULL, если все смещения нулевые.
+	 * @param end - индекс конечного узла.
+	 * @param result - указатель на результат; путь начинается в ближайшем источнике, длина включает его смещение.
+	 * @param source - указатель на номер ближайшего источника в списке sources (-1, если путь не найден).
+	 * @return - true, если путь найден, иначе false.
+	 */
+	bool findNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, int end, BasicPathResult<TWeight> * result, int * source);
+
+	/**
+	 * Разбиение графа между источниками (диаграмма Вороного): каждый узел получает ближайший источник за один поиск.
+	 * Параметры sources и offsets и правила выбора источника - как в findNearest.
+	 * @param nearestLabels - указатель на вектор, в который запишутся расстояния от ближайших источников (-1 для недостижимых узлов).
+	 * @param nearestSources - указатель на вектор, в который запишутся номера ближайших источников в списке sources (-1 для недостижимых узлов).
+	 * @param nearestParents - указатель на вектор, в который запишутся предыдущие узлы путей (-1 для источников и недостижимых узлов).
+	 */
+	void computeNearest(const std::vector<int> & sources, const std::vector<TWeight> * offsets, std::vector<TWeight> * nearestLabels, std::vector<int> * nearestSources, std::vector<int> * nearestParents);
+};
+
+typedef BasicQueryContext<__int64, int> QueryContext;
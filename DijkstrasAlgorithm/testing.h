@@ -1,6 +1,23 @@
 #pragma once
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
 #include "graph.h"
+#include "staticgraph.h"
+#include "pathcache.h"
+#include "vertexorder.h"
+#include "queryengine.h"
+#include "relaxkernel.h"
+#include "reachability.h"
+#include "kshortest.h"
+#include "externalgraph.h"
+#include "shard.h"
+#include "graphpatch.h"
+#include "graphstepper.h"
+#include "compressedgraph.h"
+#include "server.h"
+#include "batchscheduler.h"
 
 class TestSuite
 {
@@ -19,6 +36,98 @@ private:
 		}
 	}
 
+	/**
+	 * Задание для потока в тесте параллельных запросов.
+	 */
+	struct QueryJob
+	{
+		const StaticGraph * graph;		// Общий граф.
+		const std::vector<__int64> * expected;	// Ожидаемые длины путей для всех пар узлов.
+		int mismatches;					// Количество неверных ответов.
+	};
+
+	static void runQueries(void * argument)
+	{
+		QueryJob * job = (QueryJob *)argument;
+		QueryContext context(job->graph);
+		PathResult result;
+		int n = job->graph->nodeCount();
+		for (int repeat = 0; repeat < 100; repeat++)
+			for (int i = 0; i < n * n; i++)
+			{
+				context.findPath(i / n, i % n, &result);
+				if (result.totalWeight != (*job->expected)[i])
+					job->mismatches++;
+			}
+	}
+
+	/**
+	 * Дуги графа в порядке узлов и списков дуг узлов.
+	 */
+	static std::vector<FileListItem> graphEdges(const Graph & graph)
+	{
+		std::vector<FileListItem> edges;
+		const std::map<std::string, Node *> & nodes = graph.getNodes();
+		for (std::map<std::string, Node *>::const_iterator iter = nodes.begin(); iter != nodes.end(); iter++)
+			for (size_t i = 0; i < iter->second->edges.size(); i++)
+				edges.push_back(FileListItem(iter->first, iter->second->edges[i]->to->name, iter->second->edges[i]->weight));
+		return edges;
+	}
+
+	/**
+	 * Шард, обслуживающий одно соединение в отдельном потоке.
+	 */
+	struct ShardJob
+	{
+		ShardWorker worker;			// Обработчик запросов шарда.
+		LocalListener listener;		// Канал, к которому подключается координатор.
+	};
+
+	static void serveShard(void * argument)
+	{
+		ShardJob * job = (ShardJob *)argument;
+		LocalChannel * channel = job->listener.accept();
+		if (channel != NULL)
+			job->worker.serve(channel);
+		delete channel;
+	}
+
+	/**
+	 * Полный перебор простых путей в глубину (для проверки KShortestPaths на маленьких графах).
+	 */
+	static void enumeratePaths(const StaticGraph & graph, int node, int end, std::vector<bool> * visited, PathResult * current, std::vector<PathResult> * paths)
+	{
+		if (node == end)
+		{
+			paths->push_back(*current);
+			return;
+		}
+		(*visited)[node] = true;
+		for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+		{
+			int target = graph.edgeTarget(edge);
+			if ((*visited)[target])
+				continue;
+			current->totalWeight += graph.edgeWeight(edge);
+			current->nodes.push_back(target);
+			current->edges.push_back(edge);
+			enumeratePaths(graph, target, end, visited, current, paths);
+			current->totalWeight -= graph.edgeWeight(edge);
+			current->nodes.pop_back();
+			current->edges.pop_back();
+		}
+		(*visited)[node] = false;
+	}
+
+	static bool pathLess(const PathResult & first, const PathResult & second)
+	{
+		if (first.totalWeight != second.totalWeight)
+			return first.totalWeight < second.totalWeight;
+		if (first.edges.size() != second.edges.size())
+			return first.edges.size() < second.edges.size();
+		return std::lexicographical_compare(first.edges.rbegin(), first.edges.rend(), second.edges.rbegin(), second.edges.rend());
+	}
+
 	void cleanUp(std::vector<std::string> dotFilesGenerated)
 	{
 		for (std::vector<std::string>::const_iterator iter = dotFilesGenerated.cbegin(); iter != dotFilesGenerated.cend(); iter++)
@@ -142,12 +251,1684 @@ public:
 		assertTrue(res.path[0]->weight == 1 && res.path[1]->weight == 2 && res.path[2]->weight == 5, "Найдены неправильные переходы (тест № 3)");
 	}
 
+	// Шаги, сохраненные в памяти, совпадают с шагами, записанными в dot-файлы.
+	void test4()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+		std::vector<std::string> dotFilesGenerated;
+		std::vector<ExecutionStep> steps;
+
+		edges.push_back(FileListItem("0", "1", 10));
+		edges.push_back(FileListItem("0", "2", 1));
+		edges.push_back(FileListItem("1", "3", 5));
+		edges.push_back(FileListItem("2", "1", 2));
+		edges.push_back(FileListItem("2", "3", 20));
+
+		assertTrue(G.load(edges, "0", "3"), "Граф не загружен (тест № 4)");
+		ExecutionState expected = G.run("C:\\step", &dotFilesGenerated);
+		cleanUp(dotFilesGenerated);
+		ExecutionState res = G.run(&steps);
+
+		assertTrue(steps.size() + 1 == dotFilesGenerated.size(), "Неверное количество шагов (тест № 4)");
+		assertTrue(res.totalWeight == expected.totalWeight && res.path == expected.path, "Неверный путь (тест № 4)");
+
+		// Восстанавливаем метку конечной вершины по шагам.
+		__int64 endWeight = -1;
+		for (size_t i = 0; i < steps.size(); i++)
+			if (steps[i].changedNode == G.getEndNode())
+				endWeight = steps[i].totalWeight;
+		assertTrue(endWeight == 8, "Неверная метка конечной вершины (тест № 4)");
+	}
+
+	// Поиск между произвольными вершинами (режим сервера) совпадает с основным алгоритмом для всех пар вершин.
+	void test5()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+		std::vector<ExecutionStep> steps;
+
+		edges.push_back(FileListItem("0", "1", 7));
+		edges.push_back(FileListItem("0", "2", 9));
+		edges.push_back(FileListItem("0", "5", 14));
+		edges.push_back(FileListItem("1", "2", 10));
+		edges.push_back(FileListItem("1", "3", 15));
+		edges.push_back(FileListItem("2", "3", 11));
+		edges.push_back(FileListItem("2", "5", 2));
+		edges.push_back(FileListItem("3", "4", 6));
+		G.build(edges);
+
+		bool same = true;
+		for (std::map<std::string, Node *>::const_iterator from = G.nodes.cbegin(); from != G.nodes.cend(); from++)
+			for (std::map<std::string, Node *>::const_iterator to = G.nodes.cbegin(); to != G.nodes.cend(); to++)
+			{
+				if (from == to)
+					continue;
+				G.startNode = from->second;
+				G.endNode = to->second;
+				ExecutionState expected = G.run(&steps);
+				ExecutionState res = G.findPath(from->second, to->second);
+				if (res.totalWeight != expected.totalWeight || res.path.size() != expected.path.size())
+					same = false;
+			}
+		assertTrue(same, "Результаты поиска не совпадают (тест № 5)");
+
+		ExecutionState res = G.findPath(G.findNode("4"), G.findNode("4"));
+		assertTrue(res.totalWeight == 0 && res.path.empty(), "Неверный путь из вершины в себя (тест № 5)");
+		assertTrue(G.findNode("6") == NULL, "Найдена несуществующая вершина (тест № 5)");
+	}
+
+	// Запросы к общему неизменяемому графу из нескольких потоков дают те же результаты, что и исходный граф.
+	void test6()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+
+		edges.push_back(FileListItem("0", "1", 7));
+		edges.push_back(FileListItem("0", "2", 9));
+		edges.push_back(FileListItem("0", "5", 14));
+		edges.push_back(FileListItem("1", "2", 10));
+		edges.push_back(FileListItem("1", "3", 15));
+		edges.push_back(FileListItem("2", "3", 11));
+		edges.push_back(FileListItem("2", "5", 2));
+		edges.push_back(FileListItem("3", "4", 6));
+		edges.push_back(FileListItem("5", "4", 9));
+		G.build(edges);
+		StaticGraph S(G);
+
+		assertTrue(S.nodeCount() == 6 && S.edgeCount() == 9, "Неверный размер графа (тест № 6)");
+		assertTrue(S.findNode("5") == 5 && S.findNode("6") == -1, "Неверный поиск узла (тест № 6)");
+
+		// Ожидаемые длины путей для всех пар узлов.
+		std::vector<__int64> expected;
+		for (int i = 0; i < S.nodeCount(); i++)
+			for (int j = 0; j < S.nodeCount(); j++)
+				expected.push_back(G.findPath(G.findNode(S.nodeName(i)), G.findNode(S.nodeName(j))).totalWeight);
+
+		PathResult res;
+		QueryContext context(&S);
+		assertTrue(context.findPath(S.findNode("0"), S.findNode("4"), &res), "Путь не найден (тест № 6)");
+		assertTrue(res.totalWeight == 20 && res.edges.size() == 3 && res.nodes.size() == 4, "Неверный путь (тест № 6)");
+		assertTrue(S.nodeName(res.nodes[1]) == "2" && S.nodeName(res.nodes[2]) == "5", "Найдены неправильные переходы (тест № 6)");
+		assertTrue(!context.findPath(S.findNode("5"), S.findNode("1"), &res) && res.totalWeight == -1, "Найден несуществующий путь (тест № 6)");
+
+		const int threadCount = 4;
+		QueryJob jobs[threadCount];
+		Thread threads[threadCount];
+		for (int i = 0; i < threadCount; i++)
+		{
+			jobs[i].graph = &S;
+			jobs[i].expected = &expected;
+			jobs[i].mismatches = 0;
+			threads[i].start(&TestSuite::runQueries, &jobs[i]);
+		}
+		int mismatches = 0;
+		for (int i = 0; i < threadCount; i++)
+		{
+			threads[i].join();
+			mismatches += jobs[i].mismatches;
+		}
+		assertTrue(mismatches == 0, "Неверные результаты параллельных запросов (тест № 6)");
+	}
+
+	// Кэш результатов: вытеснение, деревья для частых начальных узлов и удаление только затронутых изменением дуги результатов.
+	void test7()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+
+		edges.push_back(FileListItem("0", "1", 7));
+		edges.push_back(FileListItem("0", "2", 9));
+		edges.push_back(FileListItem("0", "5", 14));
+		edges.push_back(FileListItem("1", "2", 10));
+		edges.push_back(FileListItem("1", "3", 15));
+		edges.push_back(FileListItem("2", "3", 11));
+		edges.push_back(FileListItem("2", "5", 2));
+		edges.push_back(FileListItem("3", "4", 6));
+		G.build(edges);
+		StaticGraph S(G);
+		QueryContext context(&S);
+		PathResult res, cached;
+
+		// Пары: емкость 2, вытесняется давно не использованная.
+		PathCache cache(2, 1, 0);
+		context.findPath(0, 3, &res);
+		cache.store(0, 3, PathCache::ALGORITHM_DIJKSTRA, res);
+		context.findPath(0, 5, &res);
+		cache.store(0, 5, PathCache::ALGORITHM_DIJKSTRA, res);
+		assertTrue(cache.lookup(0, 3, PathCache::ALGORITHM_DIJKSTRA, &cached) && cached.totalWeight == 20 && cached.nodes.size() == 3, "Неверный результат из кэша (тест № 7)");
+		context.findPath(1, 4, &res);
+		cache.store(1, 4, PathCache::ALGORITHM_DIJKSTRA, res);
+		assertTrue(cache.size() == 2 && !cache.lookup(0, 5, PathCache::ALGORITHM_DIJKSTRA, &cached), "Вытеснен не тот результат (тест № 7)");
+		assertTrue(cache.hitCount() == 1 && cache.missCount() == 1, "Неверная статистика кэша (тест № 7)");
+
+		// Путь 0->3 идет через 0->2->3, путь 1->4 - через 1->3->4.
+		cache.edgeIncreased(S.findNode("0"), S.findNode("1"));
+		assertTrue(cache.size() == 2, "Удален результат, не проходящий через дугу (тест № 7)");
+		cache.edgeIncreased(S.findNode("2"), S.findNode("3"));
+		assertTrue(cache.size() == 1 && cache.lookup(1, 4, PathCache::ALGORITHM_DIJKSTRA, &cached), "Не удален путь через увеличенную дугу (тест № 7)");
+		cache.edgeDecreased(S.findNode("4"), S.findNode("0"), 25);
+		assertTrue(cache.size() == 1, "Удален путь, который не может стать короче (тест № 7)");
+		cache.edgeDecreased(S.findNode("1"), S.findNode("4"), 5);
+		assertTrue(cache.size() == 0, "Не удален путь, который может стать короче (тест № 7)");
+
+		// Деревья строятся для узла после двух запросов из него.
+		PathCache treeCache(16, 1, 1, 2);
+		treeCache.lookup(0, 3, PathCache::ALGORITHM_DIJKSTRA, &cached);
+		assertTrue(!treeCache.wantsTree(0, PathCache::ALGORITHM_DIJKSTRA), "Дерево запрошено слишком рано (тест № 7)");
+		treeCache.lookup(0, 4, PathCache::ALGORITHM_DIJKSTRA, &cached);
+		assertTrue(treeCache.wantsTree(0, PathCache::ALGORITHM_DIJKSTRA), "Дерево не запрошено (тест № 7)");
+		std::vector<__int64> labels;
+		std::vector<int> parents;
+		context.computeTree(0, &labels, &parents);
+		treeCache.storeTree(0, PathCache::ALGORITHM_DIJKSTRA, labels, parents);
+		bool same = true;
+		for (int target = 0; target < S.nodeCount(); target++)
+		{
+			context.findPath(0, target, &res);
+			if (!treeCache.lookup(0, target, PathCache::ALGORITHM_DIJKSTRA, &cached) || cached.totalWeight != res.totalWeight || cached.nodes != res.nodes)
+				same = false;
+		}
+		assertTrue(same, "Неверные результаты из дерева (тест № 7)");
+
+		// Дерево из 0 использует дугу 2->5, но не 1->2; дуга 3->5 веса 1 не улучшает путь до 5 (20 + 1 > 11).
+		treeCache.edgeIncreased(S.findNode("1"), S.findNode("2"));
+		treeCache.edgeDecreased(S.findNode("3"), S.findNode("5"), 1);
+		assertTrue(treeCache.treeCount() == 1, "Удалено незатронутое дерево (тест № 7)");
+		treeCache.edgeIncreased(S.findNode("2"), S.findNode("5"));
+		assertTrue(treeCache.treeCount() == 0, "Не удалено затронутое дерево (тест № 7)");
+	}
+
+	// Перенумерация узлов: каждый порядок - перестановка, имена остаются при своих узлах, длины путей не меняются.
+	void test8()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+
+		edges.push_back(FileListItem("a", "b", 7));
+		edges.push_back(FileListItem("a", "c", 9));
+		edges.push_back(FileListItem("a", "f", 14));
+		edges.push_back(FileListItem("b", "c", 10));
+		edges.push_back(FileListItem("b", "d", 15));
+		edges.push_back(FileListItem("c", "d", 11));
+		edges.push_back(FileListItem("c", "f", 2));
+		edges.push_back(FileListItem("d", "e", 6));
+		edges.push_back(FileListItem("g", "h", 1));
+		G.build(edges);
+		StaticGraph S(G);
+		StaticGraph fromList;
+		fromList.build(edges);
+		bool same = fromList.nodeCount() == S.nodeCount() && fromList.edgeCount() == S.edgeCount();
+		for (int edge = 0; same && edge < S.edgeCount(); edge++)
+			same = fromList.edgeTarget(edge) == S.edgeTarget(edge) && fromList.edgeWeight(edge) == S.edgeWeight(edge);
+		assertTrue(same, "Граф из списка дуг отличается от графа из Graph (тест № 8)");
+
+		int n = S.nodeCount();
+		std::vector<__int64> expected(n * n);
+		QueryContext context(&S);
+		PathResult res;
+		for (int i = 0; i < n * n; i++)
+		{
+			context.findPath(i / n, i % n, &res);
+			expected[i] = res.totalWeight;
+		}
+
+		// Узлы лежат на прямой в порядке, обратном порядку имен.
+		std::vector<NodePosition> positions(n);
+		for (int node = 0; node < n; node++)
+		{
+			positions[node].x = n - node;
+			positions[node].known = true;
+		}
+		std::vector<int> order;
+		VertexOrder::compute(S, VertexOrder::ORDER_HILBERT, &positions, &order);
+		assertTrue((int)order.size() == n && order[0] == n - 1 && order[n - 1] == 0, "Неверный порядок вдоль кривой Гильберта (тест № 8)");
+		assertTrue(!VertexOrder::compute(S, VertexOrder::ORDER_HILBERT, NULL, &order), "Порядок Гильберта построен без координат (тест № 8)");
+
+		const int methods[] = { VertexOrder::ORDER_BFS, VertexOrder::ORDER_RCM, VertexOrder::ORDER_HILBERT };
+		for (int m = 0; m < 3; m++)
+		{
+			StaticGraph R;
+			R.build(edges);
+			VertexOrder::compute(R, methods[m], &positions, &order);
+			std::vector<bool> seen(n, false);
+			bool permutation = (int)order.size() == n;
+			for (size_t i = 0; permutation && i < order.size(); i++)
+			{
+				permutation = order[i] >= 0 && order[i] < n && !seen[order[i]];
+				seen[order[i]] = true;
+			}
+			assertTrue(permutation, "Порядок не является перестановкой (тест № 8)");
+			R.renumber(order);
+
+			bool names = true;
+			for (int node = 0; node < n; node++)
+				names = names && R.findNode(R.nodeName(node)) == node && R.nodeName(node) == S.nodeName(order[node]);
+			assertTrue(names && R.findNode("x") == -1, "Имена не соответствуют узлам после перенумерации (тест № 8)");
+
+			QueryContext renumbered(&R);
+			bool distances = true;
+			for (int i = 0; i < n * n; i++)
+			{
+				renumbered.findPath(R.findNode(S.nodeName(i / n)), R.findNode(S.nodeName(i % n)), &res);
+				distances = distances && res.totalWeight == expected[i];
+			}
+			assertTrue(distances, "Длины путей изменились после перенумерации (тест № 8)");
+		}
+	}
+
+	// Графы с узкими типами веса и индекса: выбор самых узких типов и совпадение результатов с графом по умолчанию.
+	void test9()
+	{
+		Graph G;
+		std::vector<FileListItem> edges;
+
+		edges.push_back(FileListItem("0", "1", 7));
+		edges.push_back(FileListItem("0", "2", 9));
+		edges.push_back(FileListItem("0", "5", 14));
+		edges.push_back(FileListItem("1", "2", 10));
+		edges.push_back(FileListItem("1", "3", 15));
+		edges.push_back(FileListItem("2", "3", 11));
+		edges.push_back(FileListItem("2", "5", 2));
+		edges.push_back(FileListItem("3", "4", 6));
+		StaticGraph S;
+		S.build(edges);
+		assertTrue(QueryEngine::narrowestWeightType(S) == QueryEngine::WEIGHT_INT16 && QueryEngine::narrowestIndexType(S) == QueryEngine::INDEX_UINT16, "Неверно выбраны узкие типы (тест № 9)");
+
+		// Сумма весов больше 32767, но меньше 2^31.
+		edges.push_back(FileListItem("4", "0", 40000));
+		StaticGraph wide;
+		wide.build(edges);
+		assertTrue(QueryEngine::narrowestWeightType(wide) == QueryEngine::WEIGHT_INT32, "Не выбран тип int для большой суммы весов (тест № 9)");
+		QueryEngine * tooNarrow = QueryEngine::create(wide, QueryEngine::WEIGHT_INT16, QueryEngine::INDEX_UINT16);
+		assertTrue(tooNarrow == NULL, "Создан граф с типом, в который не помещаются длины путей (тест № 9)");
+		delete tooNarrow;
+
+		int n = wide.nodeCount();
+		QueryContext context(&wide);
+		PathResult expected, res;
+		int engines = 0;
+		bool same = true;
+		for (int weightType = QueryEngine::WEIGHT_INT16; weightType <= QueryEngine::WEIGHT_DOUBLE; weightType++)
+			for (int indexType = QueryEngine::INDEX_UINT16; indexType <= QueryEngine::INDEX_INT32; indexType++)
+			{
+				QueryEngine * engine = QueryEngine::create(wide, weightType, indexType);
+				if (engine == NULL)
+					continue;
+				engines++;
+				EngineContext * engineContext = engine->createContext();
+				for (int i = 0; i < n * n; i++)
+				{
+					context.findPath(i / n, i % n, &expected);
+					engineContext->findPath(i / n, i % n, &res);
+					same = same && res.totalWeight == expected.totalWeight && res.nodes == expected.nodes && res.edges == expected.edges;
+				}
+				std::vector<__int64> labels;
+				std::vector<int> parents;
+				engineContext->computeTree(4, &labels, &parents);
+				same = same && labels[S.findNode("3")] == 40000 + 20 && parents[S.findNode("0")] == S.findNode("4");
+				delete engineContext;
+				delete engine;
+			}
+		assertTrue(engines == 6, "Неверное количество допустимых сочетаний типов (тест № 9)");
+		assertTrue(same, "Результаты графа с узкими типами отличаются от результатов графа по умолчанию (тест № 9)");
+	}
+
+	// Векторные ядра проверки дуг: на узлах большой степени с кратными дугами результаты совпадают с обычным циклом.
+	void test10()
+	{
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		unsigned int seed = 7;
+		// Узел 0 связан со всеми, есть кратные дуги и дуги, которые не улучшают метки.
+		for (int i = 0; i < 200; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int target = 1 + (seed >> 8) % 60;
+			sprintf_s(from, sizeof(from), "%d", (i % 3 == 0) ? 0 : 1 + (int)((seed >> 4) % 60));
+			sprintf_s(to, sizeof(to), "%d", target);
+			if (std::string(from) != to)
+				edges.push_back(FileListItem(from, to, 1 + (seed >> 12) % 50));
+		}
+		StaticGraph wide;
+		wide.build(edges);
+		BasicStaticGraph<int, int> narrow;
+		narrow.build(wide);
+		BasicStaticGraph<__int64, unsigned short> wideShort;
+		wideShort.build(wide);
+		BasicStaticGraph<int, unsigned short> narrowShort;
+		narrowShort.build(wide);
+		assertTrue(RelaxKernel::available(RelaxKernel::KERNEL_SCALAR) && RelaxKernel::available(RelaxKernel::best()), "Недоступно выбранное ядро (тест № 10)");
+
+		int n = wide.nodeCount();
+		QueryContext scalarWide(&wide);
+		BasicQueryContext<int, int> scalarNarrow(&narrow);
+		scalarWide.setKernel(RelaxKernel::KERNEL_SCALAR);
+		scalarNarrow.setKernel(RelaxKernel::KERNEL_SCALAR);
+		bool same = true;
+		for (int kernel = RelaxKernel::KERNEL_SSE41; kernel <= RelaxKernel::KERNEL_AVX2; kernel++)
+		{
+			QueryContext vectorWide(&wide);
+			BasicQueryContext<int, int> vectorNarrow(&narrow);
+			BasicQueryContext<__int64, unsigned short> vectorWideShort(&wideShort);
+			BasicQueryContext<int, unsigned short> vectorNarrowShort(&narrowShort);
+			if (!vectorWide.setKernel(kernel) || !vectorNarrow.setKernel(kernel) || !vectorWideShort.setKernel(kernel) || !vectorNarrowShort.setKernel(kernel))
+				continue;
+			PathResult expected, res, resShort;
+			BasicPathResult<int> expectedNarrow, resNarrow, resNarrowShort;
+			for (int i = 0; i < n * n; i++)
+			{
+				scalarWide.findPath(i / n, i % n, &expected);
+				vectorWide.findPath(i / n, i % n, &res);
+				vectorWideShort.findPath(i / n, i % n, &resShort);
+				scalarNarrow.findPath(i / n, i % n, &expectedNarrow);
+				vectorNarrow.findPath(i / n, i % n, &resNarrow);
+				vectorNarrowShort.findPath(i / n, i % n, &resNarrowShort);
+				same = same && res.totalWeight == expected.totalWeight && res.edges == expected.edges;
+				same = same && resShort.totalWeight == expected.totalWeight && resShort.edges == expected.edges;
+				same = same && resNarrow.totalWeight == expectedNarrow.totalWeight && resNarrow.edges == expectedNarrow.edges;
+				same = same && resNarrowShort.totalWeight == expectedNarrow.totalWeight && resNarrowShort.edges == expectedNarrow.edges;
+			}
+		}
+		assertTrue(same, "Результаты векторного ядра отличаются от обычного цикла (тест № 10)");
+	}
+
+	// Обходы в ширину и 0-1 выбираются по весам и дают те же длины и пути, что и алгоритм Дейкстры.
+	void test11()
+	{
+		// Веса 0 и 1, одинаковые веса 3 и одни нулевые веса; в графах есть кратные дуги и циклы из дуг веса 0.
+		const int weightSets[3][2] = { { 0, 1 }, { 3, 3 }, { 0, 0 } };
+		const int expectedAlgorithms[3] = { SearchAlgorithm::ALGORITHM_ZERO_ONE_BFS, SearchAlgorithm::ALGORITHM_BFS, SearchAlgorithm::ALGORITHM_BFS };
+		unsigned int seed = 11;
+		bool chosen = true, same = true;
+		for (int set = 0; set < 3; set++)
+		{
+			std::vector<FileListItem> edges;
+			char from[16], to[16];
+			for (int i = 0; i < 120; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				sprintf_s(from, sizeof(from), "%d", (int)((seed >> 8) % 30));
+				sprintf_s(to, sizeof(to), "%d", (int)((seed >> 16) % 30));
+				if (std::string(from) != to)
+					edges.push_back(FileListItem(from, to, weightSets[set][(seed >> 4) % 2]));
+			}
+			StaticGraph S;
+			S.build(edges);
+			QueryContext fast(&S), general(&S);
+			chosen = chosen && fast.getAlgorithm() == expectedAlgorithms[set] && general.setAlgorithm(SearchAlgorithm::ALGORITHM_DIJKSTRA);
+			chosen = chosen && S.minWeight() == weightSets[set][0] && S.maxWeight() == weightSets[set][1] && S.distinctWeightCount() == (weightSets[set][0] == weightSets[set][1] ? 1 : 2);
+
+			int n = S.nodeCount();
+			PathResult expected, res;
+			for (int i = 0; i < n * n; i++)
+			{
+				general.findPath(i / n, i % n, &expected);
+				fast.findPath(i / n, i % n, &res);
+				same = same && res.totalWeight == expected.totalWeight && res.nodes == expected.nodes && res.edges == expected.edges;
+			}
+			std::vector<__int64> expectedLabels, labels;
+			std::vector<int> expectedParents, parents;
+			general.computeTree(0, &expectedLabels, &expectedParents);
+			fast.computeTree(0, &labels, &parents);
+			same = same && labels == expectedLabels && parents == expectedParents;
+		}
+		assertTrue(chosen, "Неверно выбран алгоритм или посчитана статистика весов (тест № 11)");
+		assertTrue(same, "Результаты обходов отличаются от алгоритма Дейкстры (тест № 11)");
+
+		StaticGraph general;
+		general.build(std::vector<FileListItem>(1, FileListItem("a", "b", 2)));
+		QueryContext context(&general);
+		assertTrue(!context.setAlgorithm(SearchAlgorithm::ALGORITHM_ZERO_ONE_BFS) && context.setAlgorithm(SearchAlgorithm::ALGORITHM_BFS), "Неверная проверка применимости алгоритмов (тест № 11)");
+	}
+
+	// Индекс достижимости: отказ без поиска только для действительно недостижимых узлов.
+	void test12()
+	{
+		// Три компоненты: цикл a-b-c, цикл d-e и отдельный узел f.
+		std::vector<FileListItem> edges;
+		edges.push_back(FileListItem("a", "b", 1));
+		edges.push_back(FileListItem("b", "c", 1));
+		edges.push_back(FileListItem("c", "a", 1));
+		edges.push_back(FileListItem("d", "e", 1));
+		edges.push_back(FileListItem("e", "d", 1));
+		edges.push_back(FileListItem("c", "d", 1));
+		edges.push_back(FileListItem("f", "a", 1));
+		StaticGraph small;
+		small.build(edges);
+		ReachabilityIndex index;
+		index.build(small);
+		int a = small.findNode("a"), d = small.findNode("d"), f = small.findNode("f");
+		assertTrue(index.componentCount() == 3 && index.component(a) == index.component(small.findNode("c")), "Неверно найдены компоненты сильной связности (тест № 12)");
+		assertTrue(!index.mayReach(d, a) && !index.mayReach(a, f) && index.mayReach(f, d), "Неверный ответ индекса достижимости (тест № 12)");
+
+		// Случайные разреженные графы: индекс не должен отклонять достижимые пары, а пути с индексом и без него совпадают.
+		unsigned int seed = 12;
+		bool sound = true, same = true;
+		int rejected = 0;
+		for (int round = 0; round < 5; round++)
+		{
+			edges.clear();
+			char from[16], to[16];
+			for (int i = 0; i < 60; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				sprintf_s(from, sizeof(from), "%d", (int)((seed >> 8) % 50));
+				sprintf_s(to, sizeof(to), "%d", (int)((seed >> 16) % 50));
+				if (std::string(from) != to)
+					edges.push_back(FileListItem(from, to, 1 + (int)((seed >> 4) % 9)));
+			}
+			StaticGraph S;
+			S.build(edges);
+			ReachabilityIndex random;
+			random.build(S);
+			QueryContext indexed(&S), plain(&S);
+			indexed.setReachability(&random);
+			int n = S.nodeCount();
+			std::vector<__int64> labels;
+			std::vector<int> parents;
+			PathResult expected, res;
+			for (int start = 0; start < n; start++)
+			{
+				plain.computeTree(start, &labels, &parents);
+				for (int end = 0; end < n; end++)
+				{
+					bool reachable = labels[end] != -1;
+					if (!random.mayReach(start, end))
+					{
+						rejected++;
+						sound = sound && !reachable;
+					}
+					plain.findPath(start, end, &expected);
+					indexed.findPath(start, end, &res);
+					same = same && res.totalWeight == expected.totalWeight && res.nodes == expected.nodes && res.edges == expected.edges;
+				}
+			}
+		}
+		assertTrue(sound && rejected > 0, "Индекс отклонил достижимую пару узлов (тест № 12)");
+		assertTrue(same, "Пути с индексом достижимости отличаются (тест № 12)");
+
+		// Длинная цепочка: построение без рекурсии не переполняет стек.
+		edges.clear();
+		char from[16], to[16];
+		for (int i = 0; i < 100000; i++)
+		{
+			sprintf_s(from, sizeof(from), "%d", i);
+			sprintf_s(to, sizeof(to), "%d", i + 1);
+			edges.push_back(FileListItem(from, to, 1));
+		}
+		StaticGraph chain;
+		chain.build(edges);
+		ReachabilityIndex chainIndex;
+		chainIndex.build(chain);
+		int first = chain.findNode("0"), last = chain.findNode("100000");
+		assertTrue(chainIndex.componentCount() == 100001 && chainIndex.mayReach(first, last) && !chainIndex.mayReach(last, first), "Неверный индекс для длинной цепочки (тест № 12)");
+	}
+
+	// Поиск от нескольких источников со смещениями совпадает с отдельными поисками от каждого источника.
+	void test13()
+	{
+		unsigned int seed = 13;
+		bool labelsMatch = true, sourcesMatch = true, pathsMatch = true, sameAlgorithms = true;
+		for (int round = 0; round < 6; round++)
+		{
+			// В нечетных раундах все веса равны 1, и без смещений используется обход в ширину.
+			std::vector<FileListItem> edges;
+			char from[16], to[16];
+			for (int i = 0; i < 150; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				sprintf_s(from, sizeof(from), "%d", (int)((seed >> 8) % 40));
+				sprintf_s(to, sizeof(to), "%d", (int)((seed >> 16) % 40));
+				if (std::string(from) != to)
+					edges.push_back(FileListItem(from, to, round % 2 == 1 ? 1 : 1 + (int)((seed >> 4) % 9)));
+			}
+			StaticGraph S;
+			S.build(edges);
+			int n = S.nodeCount();
+			std::vector<int> sources;
+			std::vector<__int64> offsets;
+			for (int i = 0; i < 5; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				sources.push_back((int)((seed >> 8) % n));
+				offsets.push_back(round < 2 ? 0 : (__int64)((seed >> 16) % 12));
+			}
+			QueryContext context(&S), general(&S);
+			general.setAlgorithm(SearchAlgorithm::ALGORITHM_DIJKSTRA);
+			const std::vector<__int64> * offsetList = (round < 2) ? NULL : &offsets;
+			std::vector<__int64> labels, generalLabels;
+			std::vector<int> nearest, parents, generalNearest, generalParents;
+			context.computeNearest(sources, offsetList, &labels, &nearest, &parents);
+			general.computeNearest(sources, offsetList, &generalLabels, &generalNearest, &generalParents);
+			sameAlgorithms = sameAlgorithms && labels == generalLabels && nearest == generalNearest && parents == generalParents;
+
+			// Расстояние до узла - наименьшая сумма смещения и длины пути по всем источникам.
+			std::vector<__int64> best(n, -1);
+			std::vector<std::vector<__int64> > trees(sources.size());
+			std::vector<int> treeParents;
+			for (size_t i = 0; i < sources.size(); i++)
+			{
+				general.computeTree(sources[i], &trees[i], &treeParents);
+				for (int node = 0; node < n; node++)
+					if (trees[i][node] != -1 && (best[node] == -1 || trees[i][node] + offsets[i] * (offsetList != NULL) < best[node]))
+						best[node] = trees[i][node] + offsets[i] * (offsetList != NULL);
+			}
+			PathResult path;
+			for (int node = 0; node < n; node++)
+			{
+				labelsMatch = labelsMatch && labels[node] == best[node];
+				int source = nearest[node];
+				sourcesMatch = sourcesMatch && (source == -1) == (best[node] == -1);
+				if (source != -1)
+					sourcesMatch = sourcesMatch && trees[source][node] != -1 && trees[source][node] + offsets[source] * (offsetList != NULL) == best[node];
+				int found = -1;
+				context.findNearest(sources, offsetList, node, &path, &found);
+				pathsMatch = pathsMatch && found == source && path.totalWeight == best[node];
+				if (found != -1)
+					pathsMatch = pathsMatch && path.nodes.front() == sources[found] && path.nodes.back() == node && path.edges.size() + 1 == path.nodes.size();
+			}
+		}
+		assertTrue(labelsMatch, "Неверные расстояния от ближайших источников (тест № 13)");
+		assertTrue(sourcesMatch, "Неверно выбраны ближайшие источники (тест № 13)");
+		assertTrue(pathsMatch, "Путь от ближайшего источника не совпадает с разбиением (тест № 13)");
+		assertTrue(sameAlgorithms, "Разбиение зависит от алгоритма поиска (тест № 13)");
+
+		// Смещение, с которым длина пути не помещается в тип веса, отклоняется.
+		StaticGraph small;
+		small.build(std::vector<FileListItem>(1, FileListItem("a", "b", 5)));
+		QueryEngine * engine = QueryEngine::create(small);
+		EngineContext * engineContext = engine->createContext();
+		std::vector<int> sources(2, 0);
+		sources[1] = 1;
+		std::vector<__int64> offsets(2, 0), labels;
+		std::vector<int> nearest, parents;
+		offsets[1] = 40000;
+		bool rejected = !engineContext->computeNearest(sources, offsets, &labels, &nearest, &parents);
+		offsets[1] = 3;
+		bool accepted = engineContext->computeNearest(sources, offsets, &labels, &nearest, &parents) && labels[1] == 3 && nearest[1] == 1 && nearest[0] == 0;
+		assertTrue(rejected && accepted, "Неверная проверка смещений источников (тест № 13)");
+		delete engineContext;
+		delete engine;
+	}
+
+	// Ограниченный поиск: радиус, число обработанных узлов и время.
+	void test14()
+	{
+		unsigned int seed = 14;
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		for (int i = 0; i < 300; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			sprintf_s(from, sizeof(from), "%d", (int)((seed >> 8) % 80));
+			sprintf_s(to, sizeof(to), "%d", (int)((seed >> 16) % 80));
+			if (std::string(from) != to)
+				edges.push_back(FileListItem(from, to, 1 + (int)((seed >> 4) % 9)));
+		}
+		StaticGraph S;
+		S.build(edges);
+		int n = S.nodeCount();
+		QueryContext context(&S), plain(&S);
+		std::vector<__int64> expected, distances, labels;
+		std::vector<int> parents, nodes;
+		plain.computeTree(0, &expected, &parents);
+		int reachable = 0;
+		for (int node = 0; node < n; node++)
+			if (expected[node] != -1)
+				reachable++;
+
+		// Радиус: ровно узлы не дальше радиуса, по возрастанию расстояния.
+		bool radiusCorrect = true;
+		for (__int64 radius = 0; radius <= 40; radius += 5)
+		{
+			bool complete = context.computeWithin(0, radius, &nodes, &distances);
+			int inside = 0;
+			for (int node = 0; node < n; node++)
+				if (expected[node] != -1 && expected[node] <= radius)
+					inside++;
+			radiusCorrect = radiusCorrect && complete && !context.budgetExceeded() && (int)nodes.size() == inside;
+			for (size_t i = 0; i < nodes.size(); i++)
+				radiusCorrect = radiusCorrect && distances[i] == expected[nodes[i]] && (i == 0 || distances[i - 1] <= distances[i]);
+		}
+		bool complete = context.computeWithin(0, -1, &nodes, &distances);
+		radiusCorrect = radiusCorrect && complete && (int)nodes.size() == reachable;
+		assertTrue(radiusCorrect, "Неверный список узлов в радиусе (тест № 14)");
+
+		// Лимит узлов: поиск останавливается, найденные пути и метки совпадают с поиском без лимита.
+		SearchBudget budget;
+		budget.maxSettled = reachable / 2;
+		context.setBudget(budget);
+		complete = context.computeWithin(0, -1, &nodes, &distances);
+		bool limitCorrect = !complete && context.budgetExceeded() && (int)nodes.size() == budget.maxSettled;
+		std::vector<bool> settled(n, false);
+		for (size_t i = 0; i < nodes.size(); i++)
+			settled[nodes[i]] = true;
+		context.computeTree(0, &labels, &parents);
+		PathResult bounded, full;
+		for (int node = 0; node < n; node++)
+		{
+			limitCorrect = limitCorrect && labels[node] == (settled[node] ? expected[node] : -1);
+			bool found = context.findPath(0, node, &bounded);
+			plain.findPath(0, node, &full);
+			limitCorrect = limitCorrect && found == settled[node] && (!found || bounded.nodes == full.nodes);
+		}
+		assertTrue(limitCorrect, "Неверный поиск с лимитом обработанных узлов (тест № 14)");
+
+		// Лимит времени проверяется раз в 256 узлов, поэтому длинная цепочка не обходится целиком.
+		edges.clear();
+		for (int i = 0; i < 5000; i++)
+		{
+			sprintf_s(from, sizeof(from), "%d", i);
+			sprintf_s(to, sizeof(to), "%d", i + 1);
+			edges.push_back(FileListItem(from, to, 1));
+		}
+		StaticGraph chain;
+		chain.build(edges);
+		QueryContext chainContext(&chain);
+		budget = SearchBudget();
+		budget.maxSeconds = 1e-9;
+		chainContext.setBudget(budget);
+		complete = chainContext.computeWithin(chain.findNode("0"), -1, &nodes, &distances);
+		assertTrue(!complete && chainContext.budgetExceeded() && nodes.size() < 5001, "Не сработал лимит времени поиска (тест № 14)");
+	}
+
+	// k кратчайших простых путей.
+	void test15()
+	{
+		// Пример из описания алгоритма Йена.
+		const char * names[9][2] = { { "C", "D" }, { "C", "E" }, { "D", "F" }, { "E", "D" }, { "E", "F" }, { "E", "G" }, { "F", "G" }, { "F", "H" }, { "G", "H" } };
+		const int weights[9] = { 3, 2, 4, 1, 2, 3, 2, 1, 2 };
+		std::vector<FileListItem> edges;
+		for (int i = 0; i < 9; i++)
+			edges.push_back(FileListItem(names[i][0], names[i][1], weights[i]));
+		StaticGraph example;
+		example.build(edges);
+		QueryEngine * engine = QueryEngine::create(example);
+		KShortestPaths yen(engine, 2);
+		std::vector<PathResult> paths;
+		yen.find(engine->findNode("C"), engine->findNode("H"), 3, &paths);
+		const char * expected[3] = { "CEFH", "CEGH", "CDFH" };
+		const __int64 expectedWeights[3] = { 5, 7, 8 };
+		bool exampleCorrect = paths.size() == 3;
+		for (size_t i = 0; i < paths.size() && exampleCorrect; i++)
+		{
+			std::string route;
+			for (size_t j = 0; j < paths[i].nodes.size(); j++)
+				route += engine->nodeName(paths[i].nodes[j]);
+			exampleCorrect = route == expected[i] && paths[i].totalWeight == expectedWeights[i];
+		}
+		assertTrue(exampleCorrect, "Неверные k кратчайших путей в примере (тест № 15)");
+		delete engine;
+
+		// Случайные маленькие графы: сравнение с полным перебором простых путей, результат не зависит от числа потоков.
+		unsigned int seed = 15;
+		bool matches = true, sameThreads = true;
+		for (int round = 0; round < 8; round++)
+		{
+			edges.clear();
+			char from[16], to[16];
+			for (int i = 0; i < 24; i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				sprintf_s(from, sizeof(from), "%d", (int)((seed >> 8) % 8));
+				sprintf_s(to, sizeof(to), "%d", (int)((seed >> 16) % 8));
+				if (std::string(from) != to)
+					edges.push_back(FileListItem(from, to, 1 + (int)((seed >> 4) % (round % 2 == 0 ? 4 : 1))));
+			}
+			StaticGraph S;
+			S.build(edges);
+			QueryEngine * randomEngine = QueryEngine::create(S);
+			KShortestPaths single(randomEngine, 1), parallel(randomEngine, 4);
+			int n = S.nodeCount();
+			for (int start = 0; start < n; start++)
+				for (int end = 0; end < n; end++)
+				{
+					std::vector<PathResult> all;
+					std::vector<bool> visited(n, false);
+					PathResult current;
+					current.totalWeight = 0;
+					current.nodes.push_back(start);
+					enumeratePaths(S, start, end, &visited, &current, &all);
+					std::sort(all.begin(), all.end(), pathLess);
+					std::vector<PathResult> found, foundParallel;
+					single.find(start, end, 10, &found);
+					parallel.find(start, end, 10, &foundParallel);
+					matches = matches && found.size() == std::min(all.size(), (size_t)10);
+					for (size_t i = 0; i < found.size() && matches; i++)
+						matches = found[i].totalWeight == all[i].totalWeight && found[i].edges == all[i].edges && found[i].nodes == all[i].nodes;
+					sameThreads = sameThreads && found.size() == foundParallel.size();
+					for (size_t i = 0; i < found.size() && sameThreads; i++)
+						sameThreads = found[i].edges == foundParallel[i].edges;
+				}
+			delete randomEngine;
+		}
+		assertTrue(matches, "k кратчайших путей не совпадают с полным перебором (тест № 15)");
+		assertTrue(sameThreads, "k кратчайших путей зависят от числа потоков (тест № 15)");
+	}
+
+	// Внешний граф: маленькие кэши и очередь заставляют вытеснять блоки и сбрасывать корзины на диск;
+	// очередь с корзиной, не помещающейся в кучу (одинаковые длины), делит ее на подкорзины и извлекает элементы по порядку.
+	void test16()
+	{
+		unsigned int seed = 16;
+		std::set<std::pair<int, int> > pairs;
+		std::vector<std::pair<std::pair<int, int>, int> > edges;
+		while (edges.size() < 300)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int from = (int)((seed >> 8) % 60), to = (int)((seed >> 16) % 60);
+			if (from != to && pairs.insert(std::make_pair(from, to)).second)
+				edges.push_back(std::make_pair(std::make_pair(from, to), 1 + (int)((seed >> 4) % 20)));
+		}
+		const char * graphFile = "test16.graph";
+		const char * externalFile = "test16.blk";
+		FILE * file;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "%d %d %d\n", (int)edges.size(), edges[0].first.first, edges[0].first.second);
+		for (size_t i = 0; i < edges.size(); i++)
+			fprintf_s(file, "%d %d %d\n", edges[i].first.first, edges[i].first.second, edges[i].second);
+		fclose(file);
+
+		std::string error;
+		bool converted = ExternalGraph::convert(graphFile, externalFile, 64 * 24, &error, 256);
+		ExternalGraph external;
+		bool opened = converted && external.open(externalFile, 1024, &error);
+		assertTrue(opened, "Не удалось построить или открыть внешний граф (тест № 16)");
+		if (opened)
+		{
+			Graph G(graphFile);
+			StaticGraph S(G);
+			QueryContext context(&S);
+			ExternalSearch search(&external, 512, 64);
+			int n = S.nodeCount();
+			bool namesMatch = external.nodeCount() == n && external.edgeCount() == S.edgeCount();
+			for (int node = 0; node < n && namesMatch; node++)
+				namesMatch = external.nodeName(node) == S.nodeName(node) && external.findNode(S.nodeName(node)) == node;
+			assertTrue(namesMatch && external.findNode("missing") == -1, "Узлы внешнего графа не совпадают с исходным (тест № 16)");
+
+			bool same = true;
+			IoStatistics io;
+			PathResult expected, res;
+			for (int i = 0; i < n * n; i++)
+			{
+				context.findPath(i / n, i % n, &expected);
+				search.findPath(i / n, i % n, &res);
+				same = same && res.totalWeight == expected.totalWeight && res.nodes == expected.nodes && res.edges == expected.edges;
+				io.add(search.lastStatistics());
+			}
+			assertTrue(same, "Пути во внешнем графе отличаются (тест № 16)");
+			assertTrue(io.bytesRead > 0 && io.bytesWritten > 0 && io.misses > 0, "Не подсчитан ввод-вывод внешнего поиска (тест № 16)");
+		}
+		_unlink(graphFile);
+		_unlink(externalFile);
+
+		ExternalQueue queue(1, 16 * sizeof(ExternalQueueItem));
+		std::multiset<ExternalQueueItem> expected;
+		ExternalQueueItem item;
+		int nextNode = 0;
+		for (; nextNode < 400; nextNode++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			item.weight = 0;
+			item.hops = (int)((seed >> 8) % 3);
+			item.node = nextNode;
+			queue.push(item);
+			expected.insert(item);
+		}
+		bool ordered = true;
+		while (ordered && queue.pop(&item))
+		{
+			ordered = !expected.empty() && !(item > *expected.begin()) && !(item < *expected.begin());
+			expected.erase(expected.begin());
+			if (nextNode < 3000)
+			{
+				seed = seed * 1103515245u + 12345u;
+				item.weight += (seed >> 8) % 2;
+				item.hops++;
+				item.node = nextNode++;
+				queue.push(item);
+				expected.insert(item);
+			}
+		}
+		assertTrue(ordered && expected.empty() && queue.getStatistics().bytesWritten > 0, "Внешняя очередь нарушила порядок элементов одной корзины (тест № 16)");
+	}
+
+	// Шарды: поиск по нескольким шардам, связанным локальными каналами, дает те же длины путей, что и Graph::findPath;
+	// шарды в дочерних процессах (ShardCoordinator::launch) находят те же пути, что и шарды в потоках.
+	void test17()
+	{
+		unsigned int seed = 17;
+		std::set<std::pair<int, int> > pairs;
+		std::map<std::pair<std::string, std::string>, int> weights;
+		std::vector<std::pair<std::pair<int, int>, int> > edges;
+		while (edges.size() < 150)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int from = (int)((seed >> 8) % 40), to = (int)((seed >> 16) % 40);
+			if (from != to && pairs.insert(std::make_pair(from, to)).second)
+				edges.push_back(std::make_pair(std::make_pair(from, to), (int)((seed >> 4) % 10)));
+		}
+		const char * graphFile = "test17.graph";
+		const std::string prefix = "test17";
+		const int shardCount = 3;
+		FILE * file;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "%d %d %d\n", (int)edges.size(), edges[0].first.first, edges[0].first.second);
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			fprintf_s(file, "%d %d %d\n", edges[i].first.first, edges[i].first.second, edges[i].second);
+			char from[16], to[16];
+			sprintf_s(from, 16, "%d", edges[i].first.first);
+			sprintf_s(to, 16, "%d", edges[i].first.second);
+			weights[std::make_pair(std::string(from), std::string(to))] = edges[i].second;
+		}
+		fclose(file);
+
+		std::string error;
+		bool partitioned = ShardPartitioner::partition(graphFile, prefix, shardCount, &error);
+		assertTrue(partitioned, "Не удалось разбить граф на шарды (тест № 17)");
+		ShardJob jobs[shardCount];
+		Thread threads[shardCount];
+		std::vector<std::string> names;
+		int running = 0;
+		bool started = partitioned;
+		std::map<std::pair<std::string, std::string>, ShardPath> threadPaths;
+		for (int shard = 0; shard < shardCount && started; shard++)
+		{
+			char tag[32];
+			sprintf_s(tag, 32, "test17-%d", shard);
+			names.push_back(LocalListener::uniqueName(tag));
+			started = jobs[shard].worker.load(ShardPartitioner::fileName(prefix, shard, "graph").c_str(), ShardPartitioner::fileName(prefix, shard, "boundary").c_str(), &error)
+				&& jobs[shard].listener.listen(names.back()) && threads[shard].start(&TestSuite::serveShard, &jobs[shard]);
+			running += started ? 1 : 0;
+		}
+		assertTrue(started, "Не удалось запустить шарды (тест № 17)");
+		if (started)
+		{
+			Graph G(graphFile);
+			const std::map<std::string, Node *> & nodes = G.getNodes();
+			bool same = true, valid = true;
+			int maxRounds = 0;
+			{
+				ShardCoordinator coordinator;
+				assertTrue(coordinator.connect(names), "Координатор не подключился к шардам (тест № 17)");
+				ShardPath path;
+				for (std::map<std::string, Node *>::const_iterator from = nodes.begin(); from != nodes.end(); from++)
+					for (std::map<std::string, Node *>::const_iterator to = nodes.begin(); to != nodes.end(); to++)
+					{
+						ExecutionState expected = G.findPath(from->second, to->second);
+						if (!coordinator.findPath(from->first, to->first, &path) || path.totalWeight != expected.totalWeight)
+						{
+							same = false;
+							continue;
+						}
+						threadPaths[std::make_pair(from->first, to->first)] = path;
+						maxRounds = std::max(maxRounds, path.rounds);
+						if (path.totalWeight == -1)
+							continue;
+						// Путь должен идти по дугам графа от начального узла к конечному и иметь найденную длину.
+						__int64 length = 0;
+						valid = valid && path.nodes.front() == from->first && path.nodes.back() == to->first;
+						for (size_t i = 0; i + 1 < path.nodes.size() && valid; i++)
+						{
+							std::map<std::pair<std::string, std::string>, int>::const_iterator edge = weights.find(std::make_pair(path.nodes[i], path.nodes[i + 1]));
+							valid = edge != weights.end();
+							if (valid)
+								length += edge->second;
+						}
+						valid = valid && length == path.totalWeight;
+					}
+			}
+			assertTrue(same, "Длины путей по шардам отличаются (тест № 17)");
+			assertTrue(valid, "Неверный путь по шардам (тест № 17)");
+			assertTrue(maxRounds > 1, "Пути не проходят через границы шардов (тест № 17)");
+		}
+		for (int shard = 0; shard < running; shard++)
+			threads[shard].join();
+
+		// Те же запросы к шардам в дочерних процессах этой же программы (qwe.exe --shard-worker).
+		std::string program = Process::currentProgram();
+		assertTrue(!program.empty(), "Не удалось определить исполняемый файл (тест № 17)");
+		if (started && !program.empty())
+		{
+			bool same = true;
+			{
+				ShardCoordinator coordinator;
+				bool launched = coordinator.launch(program, prefix, shardCount);
+				assertTrue(launched, "Не удалось запустить процессы шардов (тест № 17)");
+				ShardPath path;
+				for (std::map<std::pair<std::string, std::string>, ShardPath>::const_iterator query = threadPaths.begin(); query != threadPaths.end() && launched; query++)
+					same = same && coordinator.findPath(query->first.first, query->first.second, &path)
+						&& path.totalWeight == query->second.totalWeight && path.nodes == query->second.nodes;
+			}
+			assertTrue(same, "Пути по шардам в процессах отличаются от путей по шардам в потоках (тест № 17)");
+		}
+		_unlink(graphFile);
+		for (int shard = 0; shard < shardCount; shard++)
+		{
+			_unlink(ShardPartitioner::fileName(prefix, shard, "graph").c_str());
+			_unlink(ShardPartitioner::fileName(prefix, shard, "boundary").c_str());
+		}
+	}
+
+	// Пакеты изменений: результат совпадает с графом, построенным заново, ошибочные пакеты не меняют граф, журнал восстанавливает изменения;
+	// изменяемый сервер применяет пакеты PATCH и не отвечает из кэша путями, которые они изменили.
+	void test18()
+	{
+		unsigned int seed = 18;
+		std::vector<FileListItem> reference;
+		char from[16], to[16];
+		while (reference.size() < 60)
+		{
+			seed = seed * 1103515245u + 12345u;
+			sprintf_s(from, 16, "%d", (int)((seed >> 8) % 20));
+			sprintf_s(to, 16, "%d", (int)((seed >> 16) % 20));
+			if (strcmp(from, to) != 0)
+				reference.push_back(FileListItem(from, to, 1 + (int)((seed >> 4) % 9)));
+		}
+		const char * graphFile = "test18.graph";
+		const char * logFile = "test18.log";
+		FILE * file;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "%d %s %s\n", (int)reference.size(), reference[0].from.c_str(), reference[0].to.c_str());
+		for (size_t i = 0; i < reference.size(); i++)
+			fprintf_s(file, "%s %s " INT64_FORMAT "\n", reference[i].from.c_str(), reference[i].to.c_str(), reference[i].weight);
+		fclose(file);
+		_unlink(logFile);
+
+		// Случайные пакеты применяются к графу через журнал и повторяются на списке дуг.
+		Graph G(graphFile);
+		PatchLog log;
+		assertTrue(log.open(logFile), "Не удалось открыть журнал (тест № 18)");
+		std::vector<int> patchErrors;
+		bool applied = true;
+		int batchCount = 0;
+		for (int batch = 0; batch < 30; batch++)
+		{
+			GraphPatch patch;
+			std::vector<FileListItem> next = reference;
+			seed = seed * 1103515245u + 12345u;
+			for (int k = 0; k <= (int)((seed >> 12) % 5); k++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				int edge = (int)((seed >> 8) % next.size());
+				__int64 weight = (int)((seed >> 4) % 10);
+				switch ((seed >> 20) % 3)
+				{
+				case 0:
+					sprintf_s(from, 16, "%d", (int)((seed >> 8) % 20));
+					sprintf_s(to, 16, "%d", (int)((seed >> 24) % 20));
+					if (strcmp(from, to) == 0)
+						break;
+					patch.addEdge(from, to, weight);
+					next.push_back(FileListItem(from, to, weight));
+					break;
+				case 1:
+					patch.removeEdge(next[edge].from, next[edge].to);
+					for (size_t i = 0; i < next.size(); i++)
+						if (next[i].from == next[edge].from && next[i].to == next[edge].to)
+						{
+							next.erase(next.begin() + i);
+							break;
+						}
+					break;
+				default:
+					patch.setWeight(next[edge].from, next[edge].to, weight);
+					for (size_t i = 0; i < next.size(); i++)
+						if (next[i].from == next[edge].from && next[i].to == next[edge].to)
+						{
+							next[i].weight = weight;
+							break;
+						}
+					break;
+				}
+			}
+			applied = applied && log.commit(&G, patch, &patchErrors);
+			reference = next;
+			batchCount++;
+		}
+		Graph H;
+		H.load(reference, reference[0].from, reference[0].to);
+		assertTrue(applied && graphEdges(G) == graphEdges(H), "Граф после пакетов отличается от построенного заново (тест № 18)");
+
+		// Ошибочные пакеты откатываются целиком.
+		std::vector<FileListItem> before = graphEdges(G);
+		GraphPatch negative;
+		negative.addEdge("0", "new", 4);
+		negative.setWeight(reference[0].from, reference[0].to, -3);
+		assertTrue(!log.commit(&G, negative, &patchErrors) && patchErrors.size() == 1 && patchErrors[0] == Graph::ERROR_NEGATIVE_WEIGHT, "Не найден отрицательный вес (тест № 18)");
+		GraphPatch missing;
+		missing.removeEdge(reference[1].from, reference[1].to);
+		missing.removeEdge("0", "missing");
+		assertTrue(!G.applyPatch(missing, &patchErrors) && patchErrors.size() == 1 && patchErrors[0] == Graph::ERROR_EDGE_NOT_EXISTS, "Не найдена отсутствующая дуга (тест № 18)");
+		GraphPatch loop;
+		loop.addVertex("new");
+		loop.addEdge("new", "new", 1);
+		assertTrue(!G.applyPatch(loop, &patchErrors) && patchErrors.size() == 1 && patchErrors[0] == Graph::ERROR_LOOP_EXISTS, "Не найдена петля (тест № 18)");
+		assertTrue(graphEdges(G) == before && G.findNode("new") == NULL, "Ошибочный пакет изменил граф (тест № 18)");
+
+		// Изменения кэша: оставшиеся результаты совпадают с поиском в измененном графе.
+		StaticGraph S(G);
+		QueryContext context(&S);
+		PathCache cache(1024, 1, 0);
+		PathResult res, cached;
+		int n = S.nodeCount();
+		for (int i = 0; i < n * n; i++)
+		{
+			context.findPath(i / n, i % n, &res);
+			cache.store(i / n, i % n, PathCache::ALGORITHM_DIJKSTRA, res);
+		}
+		GraphPatch update;
+		update.setWeight(reference[2].from, reference[2].to, reference[2].weight + 5);
+		update.addEdge(reference[3].to, reference[3].from, 1);
+		update.removeEdge(reference[4].from, reference[4].to);
+		std::vector<__int64> previousWeights;
+		assertTrue(log.commit(&G, update, &patchErrors, &previousWeights) && previousWeights[0] == reference[2].weight && previousWeights[1] == -1, "Не возвращены прежние веса (тест № 18)");
+		batchCount++;
+		cache.patchApplied(update, previousWeights, S);
+		StaticGraph updated(G);
+		QueryContext updatedContext(&updated);
+		bool valid = cache.size() < (size_t)(n * n);
+		for (int i = 0; i < n * n; i++)
+			if (cache.lookup(i / n, i % n, PathCache::ALGORITHM_DIJKSTRA, &cached))
+			{
+				updatedContext.findPath(i / n, i % n, &res);
+				valid = valid && cached.totalWeight == res.totalWeight && cached.nodes == res.nodes;
+			}
+		assertTrue(valid, "Кэш не обновлен после пакета (тест № 18)");
+
+		// Дуга, дающая путь той же длины с меньшим числом дуг, меняет выбранный путь, поэтому такие пути и деревья тоже удаляются.
+		int tieStart = -1;
+		int tieEnd = -1;
+		__int64 tieLength = -1;
+		for (int i = 0; i < n * n && tieStart == -1; i++)
+		{
+			updatedContext.findPath(i / n, i % n, &res);
+			if (res.nodes.size() < 3)
+				continue;
+			const std::vector<Edge *> & edges = G.findNode(updated.nodeName(i / n))->edges;
+			bool direct = false;
+			for (size_t k = 0; k < edges.size(); k++)
+				direct = direct || edges[k]->to->name == updated.nodeName(i % n);
+			if (!direct)
+			{
+				tieStart = i / n;
+				tieEnd = i % n;
+				tieLength = res.totalWeight;
+			}
+		}
+		PathCache tieCache(1024, 1, 1);
+		for (int i = 0; i < n * n; i++)
+		{
+			updatedContext.findPath(i / n, i % n, &res);
+			tieCache.store(i / n, i % n, PathCache::ALGORITHM_DIJKSTRA, res);
+		}
+		std::vector<__int64> tieLabels;
+		std::vector<int> tieParents;
+		updatedContext.computeTree(tieStart, &tieLabels, &tieParents);
+		tieCache.storeTree(tieStart, PathCache::ALGORITHM_DIJKSTRA, tieLabels, tieParents);
+		GraphPatch tie;
+		tie.addEdge(updated.nodeName(tieStart), updated.nodeName(tieEnd), tieLength);
+		assertTrue(tieStart != -1 && log.commit(&G, tie, &patchErrors, &previousWeights), "Не найден путь для проверки равных длин (тест № 18)");
+		batchCount++;
+		tieCache.patchApplied(tie, previousWeights, updated);
+		StaticGraph tied(G);
+		QueryContext tiedContext(&tied);
+		bool canonical = tieCache.treeCount() == 0;
+		for (int i = 0; i < n * n; i++)
+			if (tieCache.lookup(i / n, i % n, PathCache::ALGORITHM_DIJKSTRA, &cached))
+			{
+				tiedContext.findPath(i / n, i % n, &res);
+				canonical = canonical && cached.totalWeight == res.totalWeight && cached.nodes == res.nodes;
+			}
+		assertTrue(canonical, "Кэш вернул путь, отличный от поиска, после дуги той же длины (тест № 18)");
+		GraphPatch vertex;
+		vertex.addVertex("isolated");
+		assertTrue(log.commit(&G, vertex, &patchErrors, &previousWeights) && G.findNode("isolated") != NULL, "Узел не добавлен (тест № 18)");
+		batchCount++;
+		cache.patchApplied(vertex, previousWeights, updated);
+		assertTrue(cache.size() == 0, "Кэш не очищен после добавления узла (тест № 18)");
+
+		// Прерванная запись в журнал: незавершенный блок пропускается, следующие за ним применяются.
+		fopen_s(&file, logFile, "a");
+		fprintf_s(file, "BEGIN 2\n+ 0 1 3\n");
+		fclose(file);
+		GraphPatch last;
+		last.addEdge("isolated", "0", 2);
+		assertTrue(log.open(logFile) && log.commit(&G, last, &patchErrors), "Пакет не записан после прерванного блока (тест № 18)");
+		batchCount++;
+
+		// Запись, оборванная посреди строки: журнал усекается при открытии, и следующий блок не склеивается с оборванной строкой.
+		fopen_s(&file, logFile, "a");
+		fprintf_s(file, "BEGIN 1\n+ isolated %s 5", reference[0].from.c_str());
+		fclose(file);
+		GraphPatch afterTorn;
+		afterTorn.addEdge("isolated", reference[0].to, 4);
+		assertTrue(log.open(logFile) && log.commit(&G, afterTorn, &patchErrors), "Пакет не записан после оборванной строки (тест № 18)");
+		batchCount++;
+		// Строка COMMIT без перевода строки тоже оборвана: такой блок не применяется.
+		fopen_s(&file, logFile, "a");
+		fprintf_s(file, "BEGIN 1\n+ isolated %s 5\nCOMMIT", reference[0].from.c_str());
+		fclose(file);
+		Graph R(graphFile);
+		int replayed = 0;
+		std::string error;
+		assertTrue(PatchLog::replay(logFile, &R, &replayed, &error) && replayed == batchCount, "Журнал не восстановлен (тест № 18)");
+		assertTrue(graphEdges(R) == graphEdges(G) && R.getNodes().size() == G.getNodes().size(), "Граф из журнала отличается (тест № 18)");
+		Graph other;
+		other.load(std::vector<FileListItem>(1, FileListItem("a", "b", 1)), "a", "b");
+		assertTrue(!PatchLog::replay(logFile, &other, &replayed, &error) && !error.empty(), "Журнал применен к другому графу (тест № 18)");
+		_unlink(graphFile);
+		_unlink(logFile);
+
+		const char * serverFile = "test18s.graph";
+		fopen_s(&file, serverFile, "w");
+		fprintf_s(file, "3 a c\na b 1\nb c 1\na c 5\n");
+		fclose(file);
+		QueryServer server(16, false, true);
+		QueryServer readOnly(16);
+		bool served = server.addGraph("g", serverFile, &error) && readOnly.addGraph("g", serverFile, &error);
+		_unlink(serverFile);
+		QueryServer::Session session;
+		bool quit = false;
+		for (int i = 0; i < 3 && served; i++)
+			served = server.handle("PATH g a c", &session, &quit) == "OK 2 2 a b c";
+		served = served && server.handle("PATCH g = a b 10", &session, &quit) == "OK 1" && server.handle("PATH g a c", &session, &quit) == "OK 5 1 a c";
+		served = served && server.handle("PATCH g - a x; = a b 1", &session, &quit) == "ERROR unknown edge" && server.handle("PATH g a c", &session, &quit) == "OK 5 1 a c";
+		served = served && server.handle("PATCH g = a b 1; + c d 1", &session, &quit) == "OK 2" && server.handle("PATH g a d", &session, &quit) == "OK 3 3 a b c d";
+		served = served && readOnly.handle("PATCH g = a b 10", &session, &quit) == "ERROR read-only graph" && server.handle("PATCH h = a b 1", &session, &quit) == "ERROR unknown graph";
+		assertTrue(served, "Сервер не применил пакет или ответил из устаревшего кэша (тест № 18)");
+	}
+
+	// Пошаговое выполнение: те же шаги, что и у Graph::run, переход к любому шагу и ограниченное число контрольных точек.
+	void test19()
+	{
+		unsigned int seed = 19;
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		while (edges.size() < 3000)
+		{
+			seed = seed * 1103515245u + 12345u;
+			sprintf_s(from, 16, "%d", (int)((seed >> 8) % 400));
+			sprintf_s(to, 16, "%d", (int)((seed >> 16) % 400));
+			if (strcmp(from, to) != 0)
+				edges.push_back(FileListItem(from, to, (int)((seed >> 4) % 50)));
+		}
+		Graph G;
+		assertTrue(G.load(edges, edges[0].from, edges[5].to), "Граф не загружен (тест № 19)");
+		std::vector<ExecutionStep> steps;
+		ExecutionState expected = G.run(&steps);
+
+		GraphStepper stepper(&G);
+		ExecutionStep step;
+		assertTrue(stepper.next(&step) && step.changedNode == G.getStartNode() && stepper.stepCount() == -1, "Первый шаг недоступен сразу (тест № 19)");
+		bool same = true;
+		for (size_t i = 1; i < steps.size() && same; i++)
+			same = stepper.next(&step) && step.currentEdge == steps[i].currentEdge && step.changedNode == steps[i].changedNode
+				&& step.totalWeight == steps[i].totalWeight && step.passedNode == steps[i].passedNode;
+		assertTrue(same && !stepper.next(&step) && stepper.stepCount() == (int)steps.size(), "Шаги отличаются от Graph::run (тест № 19)");
+		ExecutionState res = stepper.result();
+		assertTrue(res.totalWeight == expected.totalWeight && res.path == expected.path && res.node == expected.node, "Неверный результат (тест № 19)");
+		assertTrue(stepper.checkpointCount() <= GraphStepper::MAX_CHECKPOINTS, "Слишком много контрольных точек (тест № 19)");
+
+		// Переходы назад и вперед.
+		bool seeked = true;
+		for (int k = 0; k < 200 && seeked; k++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int index = (int)((seed >> 8) % steps.size());
+			seeked = stepper.seek(index) && stepper.position() == index && stepper.next(&step) && step.currentEdge == steps[index].currentEdge
+				&& step.changedNode == steps[index].changedNode && step.totalWeight == steps[index].totalWeight && step.passedNode == steps[index].passedNode;
+		}
+		assertTrue(seeked, "Неверный шаг после перехода (тест № 19)");
+		assertTrue(!stepper.seek((int)steps.size()) && !stepper.next(&step) && stepper.result().path == expected.path, "Переход за конец выполнения (тест № 19)");
+
+		GraphStepper counter(&G);
+		ExecutionControl control;
+		assertTrue(counter.runToEnd(&control) && counter.stepCount() == (int)steps.size() && control.passedCount == control.nodeCount, "Неверное выполнение до конца (тест № 19)");
+	}
+
+	// Сжатый граф: веса разной длины в коде переменной длины, кратные дуги и петли раскодируются без потерь, а пути совпадают с несжатым графом.
+	void test20()
+	{
+		unsigned int seed = 20;
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		const __int64 scales[] = { 1, 100, 100000, 10000000000LL };
+		while (edges.size() < 4000)
+		{
+			seed = seed * 1103515245u + 12345u;
+			sprintf_s(from, 16, "%d", (int)((seed >> 8) % 500));
+			sprintf_s(to, 16, "%d", (int)((seed >> 16) % 500));
+			edges.push_back(FileListItem(from, to, (__int64)((seed >> 4) % 50) * scales[(seed >> 24) % 4]));
+			if (edges.size() % 100 == 0)
+				edges.push_back(edges.back());
+		}
+		StaticGraph graph;
+		graph.build(edges);
+		std::vector<int> order;
+		VertexOrder::compute(graph, VertexOrder::ORDER_BFS, NULL, &order);
+		graph.renumber(order);
+		CompressedGraph compressed;
+		assertTrue(compressed.build(graph) && compressed.nodeCount() == graph.nodeCount() && compressed.edgeCount() == graph.edgeCount(), "Граф не сжат (тест № 20)");
+		assertTrue(compressed.edgeBytes() < graph.edgeBytes(), "Сжатый граф не меньше исходного (тест № 20)");
+
+		bool same = true;
+		std::vector<int> nodeTargets;
+		std::vector<__int64> nodeWeights;
+		for (int node = 0; node < graph.nodeCount() && same; node++)
+		{
+			same = compressed.findNode(graph.nodeName(node)) == node && compressed.edgeEnd(node) - compressed.edgeBegin(node) == graph.edgeEnd(node) - graph.edgeBegin(node);
+			std::vector<std::pair<int, __int64> > expected, actual;
+			for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+				expected.push_back(std::pair<int, __int64>(graph.edgeTarget(edge), graph.edgeWeight(edge)));
+			std::sort(expected.begin(), expected.end());
+			compressed.decode(node, &nodeTargets, &nodeWeights);
+			for (size_t i = 0; i < nodeTargets.size(); i++)
+				actual.push_back(std::pair<int, __int64>(nodeTargets[i], nodeWeights[i]));
+			same = same && actual == expected;
+		}
+		assertTrue(same && compressed.findNode("none") == -1, "Дуги раскодированы неверно (тест № 20)");
+
+		// Длина и число дуг путей совпадают с QueryContext, а дуги пути сжатого графа ведут по его узлам.
+		QueryContext context(&graph);
+		CompressedQueryContext compressedContext(&compressed);
+		PathResult expected, actual;
+		bool paths = true;
+		for (int k = 0; k < 300 && paths; k++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int start = (int)((seed >> 8) % graph.nodeCount());
+			int end = (int)((seed >> 16) % graph.nodeCount());
+			bool found = context.findPath(start, end, &expected);
+			paths = compressedContext.findPath(start, end, &actual) == found && actual.totalWeight == expected.totalWeight && actual.nodes.size() == expected.nodes.size();
+			__int64 total = 0;
+			for (size_t i = 0; i < actual.edges.size() && paths; i++)
+			{
+				int node = actual.nodes[i];
+				int index = actual.edges[i] - compressed.edgeBegin(node);
+				compressed.decode(node, &nodeTargets, &nodeWeights);
+				paths = index >= 0 && index < (int)nodeTargets.size() && nodeTargets[index] == actual.nodes[i + 1];
+				if (paths)
+					total += nodeWeights[index];
+			}
+			paths = paths && (!found || total == actual.totalWeight);
+		}
+		assertTrue(paths, "Пути сжатого графа отличаются (тест № 20)");
+
+		std::vector<FileListItem> negative;
+		negative.push_back(FileListItem("a", "b", -1));
+		StaticGraph negativeGraph;
+		negativeGraph.build(negative);
+		assertTrue(!compressed.build(negativeGraph) && compressed.nodeCount() == 0 && compressed.edgeCount() == 0, "Отрицательный вес не отклонен (тест № 20)");
+	}
+
+	// Память на огромных страницах и копии графов по узлам NUMA: при любом виде страниц и числе копий ответы те же.
+	void test21()
+	{
+		int previousPages = PageMemory::pages();
+		bool allocated = true;
+		for (int pages = PageMemory::PAGES_SMALL; pages <= PageMemory::PAGES_HUGE; pages++)
+		{
+			PageMemory::setPages(pages);
+			const size_t sizes[] = { 0, 100, PageMemory::LARGE_BLOCK, 3 * PageMemory::LARGE_BLOCK + 5 };
+			for (int k = 0; k < 4; k++)
+			{
+				size_t before = 0;
+				for (int kind = PageMemory::PAGES_SMALL; kind <= PageMemory::PAGES_HUGE; kind++)
+					before += PageMemory::allocatedBytes(kind);
+				unsigned char * block = (unsigned char *)PageMemory::allocate(sizes[k]);
+				size_t during = 0;
+				for (int kind = PageMemory::PAGES_SMALL; kind <= PageMemory::PAGES_HUGE; kind++)
+					during += PageMemory::allocatedBytes(kind);
+				allocated = allocated && block != NULL && (size_t)block % 64 == 0 && during - before == (sizes[k] >= PageMemory::LARGE_BLOCK ? sizes[k] : 0);
+				if (block != NULL && sizes[k] > 0)
+				{
+					memset(block, 0x5A, sizes[k]);
+					allocated = allocated && block[0] == 0x5A && block[sizes[k] - 1] == 0x5A;
+				}
+				PageMemory::release(block);
+				size_t after = 0;
+				for (int kind = PageMemory::PAGES_SMALL; kind <= PageMemory::PAGES_HUGE; kind++)
+					after += PageMemory::allocatedBytes(kind);
+				allocated = allocated && after == before;
+			}
+			std::vector<int, PageAllocator<int> > numbers;
+			for (int i = 0; i < 1000000; i++)
+				numbers.push_back(i);
+			allocated = allocated && numbers[999999] == 999999 && numbers[123456] == 123456;
+		}
+		assertTrue(allocated, "Неверное выделение памяти (тест № 21)");
+		int pages;
+		assertTrue(PageMemory::parse("huge", &pages) && pages == PageMemory::PAGES_HUGE && !PageMemory::parse("big", &pages) && PageMemory::nodeCount() >= 1, "Неверные параметры памяти (тест № 21)");
+
+		unsigned int seed = 21;
+		const char * graphFile = "test21.graph";
+		FILE * file;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "%d %s %s\n", 2000, "0", "1");
+		for (int i = 0; i < 2000; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			// Петли недопустимы, поэтому конечный узел отличается от начального.
+			int from = (int)((seed >> 8) % 300);
+			fprintf_s(file, "%d %d %d\n", from, (from + 1 + (int)((seed >> 16) % 299)) % 300, 1 + (int)((seed >> 4) % 20));
+		}
+		fclose(file);
+		PageMemory::setPages(PageMemory::PAGES_SMALL);
+		QueryServer plain;
+		std::string error;
+		bool loaded = plain.addGraph("g", graphFile, &error);
+		PageMemory::setPages(PageMemory::PAGES_HUGE);
+		QueryServer replicated(0, true);
+		loaded = replicated.addGraph("g", graphFile, &error) && loaded;
+		PageMemory::setPages(previousPages);
+		_unlink(graphFile);
+		assertTrue(loaded, "Граф не загружен (тест № 21)");
+
+		QueryServer::Session plainSession;
+		bool same = true;
+		for (int node = 0; node < PageMemory::nodeCount() && same; node++)
+		{
+			QueryServer::Session session(node);
+			for (int k = 0; k < 50 && same; k++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				char request[64];
+				sprintf_s(request, sizeof(request), "PATH g %d %d", (int)((seed >> 8) % 300), (int)((seed >> 16) % 300));
+				bool quit = false;
+				same = replicated.handle(request, &session, &quit) == plain.handle(request, &plainSession, &quit);
+			}
+		}
+		assertTrue(same, "Копии графа отвечают иначе (тест № 21)");
+	}
+
+	// Пакет запросов: один поиск на начальный узел, результаты в порядке запросов совпадают с findPath.
+	void test22()
+	{
+		unsigned int seed = 22;
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		while (edges.size() < 1500)
+		{
+			seed = seed * 1103515245u + 12345u;
+			sprintf_s(from, 16, "%d", (int)((seed >> 8) % 300));
+			sprintf_s(to, 16, "%d", (int)((seed >> 16) % 300));
+			edges.push_back(FileListItem(from, to, 1 + (int)((seed >> 4) % 5)));
+		}
+		// Узлы, недостижимые из остальных.
+		edges.push_back(FileListItem("x", "y", 1));
+		StaticGraph staticGraph;
+		staticGraph.build(edges);
+		QueryEngine * engine = QueryEngine::create(staticGraph);
+
+		std::vector<std::pair<int, int> > queries;
+		for (int i = 0; i < 600; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int start = (int)((seed >> 8) % 20);
+			int end = (int)((seed >> 16) % engine->nodeCount());
+			queries.push_back(std::pair<int, int>(start, (i % 50 == 0) ? start : end));
+		}
+		queries.push_back(queries[3]);
+		queries.push_back(std::pair<int, int>(engine->findNode("x"), engine->findNode("y")));
+		queries.push_back(std::pair<int, int>(engine->findNode("y"), engine->findNode("x")));
+		queries.push_back(std::pair<int, int>(-1, 0));
+		std::set<int> sources;
+		for (size_t i = 0; i < queries.size(); i++)
+			if (queries[i].first != -1)
+				sources.insert(queries[i].first);
+
+		EngineContext * context = engine->createContext();
+		const int threadCounts[] = { 1, 4 };
+		for (int t = 0; t < 2; t++)
+		{
+			BatchScheduler scheduler(engine, threadCounts[t]);
+			std::vector<PathResult> results;
+			int searchCount = scheduler.run(queries, &results);
+			bool same = searchCount == (int)sources.size() && results.size() == queries.size();
+			PathResult expected;
+			for (size_t i = 0; i < queries.size() && same; i++)
+			{
+				if (queries[i].first == -1)
+				{
+					same = !results[i].found();
+					continue;
+				}
+				context->findPath(queries[i].first, queries[i].second, &expected);
+				same = results[i].totalWeight == expected.totalWeight && results[i].nodes == expected.nodes && results[i].edges == expected.edges;
+			}
+			assertTrue(same, "Результаты пакета отличаются от findPath (тест № 22)");
+		}
+
+		// Поиск до нескольких узлов останавливается раньше полного обхода, если все узлы близко.
+		std::vector<int> ends;
+		std::vector<PathResult> paths;
+		ends.push_back(queries[0].first);
+		SearchBudget budget;
+		budget.maxSettled = 1;
+		context->setBudget(budget);
+		assertTrue(context->findPaths(queries[0].first, ends, &paths) == 1 && paths[0].totalWeight == 0 && !context->budgetExceeded(), "Поиск не остановлен на последнем узле (тест № 22)");
+		context->setBudget(SearchBudget());
+		delete context;
+		delete engine;
+	}
+
+	// Отрицательные веса: после приведения потенциалами длины совпадают с алгоритмом Флойда, а расстояние -1 не путается с отсутствием пути.
+	void test23()
+	{
+		// Веса w0 + q(u) - q(v) при неотрицательных w0 бывают отрицательными, но циклов отрицательной длины не дают.
+		const int n = 60;
+		unsigned int seed = 23;
+		std::vector<int> shifts(n);
+		for (int node = 0; node < n; node++)
+		{
+			seed = seed * 1103515245u + 12345u;
+			shifts[node] = (int)((seed >> 8) % 30);
+		}
+		std::vector<FileListItem> edges;
+		char from[16], to[16];
+		const __int64 infinity = 0x3FFFFFFFFFFFFFFFLL;
+		std::vector<std::vector<__int64> > distances(n, std::vector<__int64>(n, infinity));
+		for (int node = 0; node < n; node++)
+			distances[node][node] = 0;
+		while (edges.size() < 400)
+		{
+			seed = seed * 1103515245u + 12345u;
+			int u = (int)((seed >> 8) % n);
+			int v = (u + 1 + (int)((seed >> 16) % (n - 1))) % n;
+			__int64 weight = (int)((seed >> 4) % 10) + shifts[u] - shifts[v];
+			sprintf_s(from, 16, "%d", u);
+			sprintf_s(to, 16, "%d", v);
+			edges.push_back(FileListItem(from, to, weight));
+		}
+		StaticGraph staticGraph;
+		staticGraph.build(edges);
+		bool negative = staticGraph.minWeight() < 0;
+		assertTrue(negative && staticGraph.reweight() && staticGraph.reweighted() && staticGraph.minWeight() >= 0, "Веса не приведены (тест № 23)");
+
+		// Расстояния по исходным весам - алгоритмом Флойда.
+		for (size_t i = 0; i < edges.size(); i++)
+		{
+			int u = staticGraph.findNode(edges[i].from);
+			int v = staticGraph.findNode(edges[i].to);
+			distances[u][v] = std::min(distances[u][v], edges[i].weight);
+		}
+		for (int k = 0; k < n; k++)
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < n; j++)
+					if (distances[i][k] < infinity && distances[k][j] < infinity)
+						distances[i][j] = std::min(distances[i][j], distances[i][k] + distances[k][j]);
+
+		QueryEngine * engine = QueryEngine::create(staticGraph);
+		EngineContext * context = engine->createContext();
+		PathResult path;
+		bool same = true;
+		for (int start = 0; start < n && same; start++)
+			for (int end = 0; end < n && same; end++)
+			{
+				bool found = context->findPath(start, end, &path);
+				__int64 length = 0;
+				for (size_t i = 0; i < path.edges.size(); i++)
+					length += engine->edgeWeight(path.edges[i]);
+				same = found == (distances[start][end] < infinity) && (!found || (path.totalWeight == distances[start][end] && length == path.totalWeight));
+			}
+		assertTrue(same, "Длины путей не совпадают с алгоритмом Флойда (тест № 23)");
+
+		std::vector<__int64> labels;
+		std::vector<int> parents;
+		context->computeTree(7, &labels, &parents);
+		for (int node = 0; node < n && same; node++)
+		{
+			bool reached = node == 7 || parents[node] != -1;
+			same = reached == (distances[7][node] < infinity) && (!reached || labels[node] == distances[7][node]);
+		}
+		std::vector<int> sources;
+		std::vector<__int64> offsets;
+		sources.push_back(3);
+		sources.push_back(11);
+		offsets.push_back(5);
+		offsets.push_back(0);
+		int source;
+		for (int end = 0; end < n && same; end++)
+		{
+			__int64 expected = std::min(distances[3][end] < infinity ? 5 + distances[3][end] : infinity, distances[11][end]);
+			bool found = context->findNearest(sources, offsets, end, &path, &source);
+			same = found == (expected < infinity) && (!found || (path.totalWeight == expected && path.nodes.front() == sources[source]));
+		}
+		std::vector<int> nodes;
+		std::vector<__int64> within;
+		const __int64 radius = 10;
+		context->computeWithin(7, radius, &nodes, &within);
+		int inside = 0;
+		for (int node = 0; node < n; node++)
+			if (distances[7][node] <= radius)
+				inside++;
+		same = same && (int)nodes.size() == inside;
+		for (size_t i = 0; i < nodes.size() && same; i++)
+			same = within[i] == distances[7][nodes[i]] && (i == 0 || within[i - 1] <= within[i]);
+		assertTrue(same, "Неверные дерево путей, ближайшие источники или изохрона после приведения весов (тест № 23)");
+
+		// Узлы за радиусом, которые обрабатывает расширенный поиск, не расходуют лимит обработанных узлов изохроны.
+		SearchBudget budget;
+		budget.maxSettled = inside + 1;
+		context->setBudget(budget);
+		std::vector<int> limitedNodes;
+		std::vector<__int64> limitedWithin;
+		bool complete = context->computeWithin(7, radius, &limitedNodes, &limitedWithin);
+		budget.maxSettled = inside - 1;
+		context->setBudget(budget);
+		std::vector<int> cutNodes;
+		std::vector<__int64> cutWithin;
+		bool cut = !context->computeWithin(7, radius, &cutNodes, &cutWithin);
+		context->setBudget(SearchBudget());
+		assertTrue(complete && limitedNodes.size() == nodes.size() && limitedWithin == within && cut, "Узлы за радиусом израсходовали лимит изохроны (тест № 23)");
+
+		// Потенциалы переставляются вместе с узлами.
+		std::vector<int> order(n);
+		for (int node = 0; node < n; node++)
+			order[node] = n - 1 - node;
+		staticGraph.renumber(order);
+		QueryEngine * renumbered = QueryEngine::create(staticGraph);
+		EngineContext * renumberedContext = renumbered->createContext();
+		for (int start = 0; start < n && same; start += 5)
+			for (int end = 0; end < n && same; end++)
+			{
+				renumberedContext->findPath(renumbered->findNode(engine->nodeName(start)), renumbered->findNode(engine->nodeName(end)), &path);
+				same = path.found() == (distances[start][end] < infinity) && (!path.found() || path.totalWeight == distances[start][end]);
+			}
+		assertTrue(same, "Длины путей изменились после перенумерации (тест № 23)");
+		delete renumberedContext;
+		delete renumbered;
+		delete context;
+		delete engine;
+
+		// Цикл отрицательной длины обнаруживается при чтении, граф Graph по-прежнему отклоняет отрицательные веса.
+		const char * graphFile = "test23.graph";
+		FILE * file;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "4 a d\na b 2\nb c -3\nc a 0\nc d 1\n");
+		fclose(file);
+		StaticGraph cyclic;
+		std::vector<int> errors;
+		bool rejected = !cyclic.readFromFile(graphFile, &errors) && errors.size() == 1 && errors[0] == Graph::ERROR_NEGATIVE_CYCLE && cyclic.nodeCount() == 0;
+		Graph graph(graphFile);
+		rejected = rejected && graph.getErrors().size() == 1 && graph.getErrors()[0] == Graph::ERROR_NEGATIVE_WEIGHT;
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "4 a d\na b 2\nb c -2\nc a 0\nc d 1\n");
+		fclose(file);
+		StaticGraph acyclic;
+		bool accepted = acyclic.readFromFile(graphFile, &errors) && errors.empty() && acyclic.reweighted();
+
+		// Настоящее расстояние -1 (b->c->d) не путается с отсутствием пути ни в ответах сервера и его кэша, ни в файле результатов пакета.
+		fopen_s(&file, graphFile, "w");
+		fprintf_s(file, "4 a d\na b 4\nb c -3\nc d 2\na d 5\n");
+		fclose(file);
+		QueryServer server(16);
+		std::string error;
+		bool minusOne = server.addGraph("g", graphFile, &error);
+		QueryServer::Session session;
+		bool quit = false;
+		for (int i = 0; i < PathCache::DEFAULT_HOT_THRESHOLD && minusOne; i++)
+			minusOne = server.handle("PATH b d", &session, &quit) == "OK -1 2 b c d";
+		// Первый промах после порога строит дерево из b, и следующий ответ дает уже дерево.
+		minusOne = minusOne && server.handle("PATH b a", &session, &quit) == "NOPATH" && server.handle("PATH b d", &session, &quit) == "OK -1 2 b c d";
+		std::string stats = server.handle("STATS g", &session, &quit);
+		minusOne = minusOne && stats.size() > 2 && stats.substr(stats.size() - 2) == " 1";
+		StaticGraph batchGraph;
+		minusOne = minusOne && batchGraph.readFromFile(graphFile, &errors);
+		QueryEngine * batchEngine = QueryEngine::create(batchGraph);
+		std::vector<std::pair<int, int> > queries;
+		queries.push_back(std::make_pair(batchEngine->findNode("b"), batchEngine->findNode("d")));
+		queries.push_back(std::make_pair(batchEngine->findNode("b"), batchEngine->findNode("a")));
+		std::vector<PathResult> results;
+		BatchScheduler scheduler(batchEngine, 1);
+		scheduler.run(queries, &results);
+		const char * resultFile = "test23.results";
+		minusOne = minusOne && BatchScheduler::writeResults(resultFile, *batchEngine, queries, results);
+		char lines[2][64] = { "", "" };
+		if (!fopen_s(&file, resultFile, "r"))
+		{
+			for (int i = 0; i < 2 && fgets(lines[i], sizeof(lines[i]), file) != NULL; i++)
+				;
+			fclose(file);
+		}
+		minusOne = minusOne && strcmp(lines[0], "b d -1 b c d\n") == 0 && strcmp(lines[1], "b a NOPATH\n") == 0;
+		delete batchEngine;
+		_unlink(resultFile);
+		_unlink(graphFile);
+		assertTrue(rejected, "Цикл отрицательной длины не обнаружен (тест № 23)");
+		assertTrue(accepted, "Граф с отрицательными весами без таких циклов не загружен (тест № 23)");
+		assertTrue(minusOne, "Расстояние -1 принято за отсутствие пути (тест № 23)");
+	}
+
 	void run()
 	{
 		test0();
 		test1();
 		test2();
 		test3();
+		test4();
+		test5();
+		test6();
+		test7();
+		test8();
+		test9();
+		test10();
+		test11();
+		test12();
+		test13();
+		test14();
+		test15();
+		test16();
+		test17();
+		test18();
+		test19();
+		test20();
+		test21();
+		test22();
+		test23();
 		printf("\nTesting complete: %d passes and %d fails.", passCount, failCount);
 	}
 };
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include "vertexorder.h"
+#include <algorithm>
+
+NodePosition::NodePosition()
+{
+	x = 0;
+	y = 0;
+	known = false;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+/**
+ * Сравнение узлов по степени, при равенстве - по индексу.
+ */
+struct DegreeLess
+{
+	const std::vector<int> * offsets;
+
+	DegreeLess(const std::vector<int> * _offsets)
+	{
+		offsets = _offsets;
+	}
+
+	bool operator()(int first, int second) const
+	{
+		int firstDegree = (*offsets)[first + 1] - (*offsets)[first];
+		int secondDegree = (*offsets)[second + 1] - (*offsets)[second];
+		return (firstDegree != secondDegree) ? firstDegree < secondDegree : first < second;
+	}
+};
+
+// Индекс точки (x, y) на кривой Гильберта в квадрате side x side, side - степень двойки.
+static unsigned long long hilbertIndex(unsigned int side, unsigned int x, unsigned int y)
+{
+	unsigned long long index = 0;
+	for (unsigned int s = side / 2; s > 0; s /= 2)
+	{
+		unsigned int rx = (x & s) ? 1 : 0;
+		unsigned int ry = (y & s) ? 1 : 0;
+		index += (unsigned long long)s * s * ((3 * rx) ^ ry);
+		// Поворачиваем квадрант, чтобы кривая внутри него шла в нужном направлении.
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = side - 1 - x;
+				y = side - 1 - y;
+			}
+			unsigned int tmp = x;
+			x = y;
+			y = tmp;
+		}
+	}
+	return index;
+}
+
+bool VertexOrder::parse(const std::string & name, int * order)
+{
+	if (name == "name")
+		*order = ORDER_NAME;
+	else if (name == "bfs")
+		*order = ORDER_BFS;
+	else if (name == "rcm")
+		*order = ORDER_RCM;
+	else if (name == "hilbert")
+		*order = ORDER_HILBERT;
+	else
+		return false;
+	return true;
+}
+
+const char * VertexOrder::name(int order)
+{
+	switch (order)
+	{
+	case ORDER_NAME:
+		return "name";
+	case ORDER_BFS:
+		return "bfs";
+	case ORDER_RCM:
+		return "rcm";
+	case ORDER_HILBERT:
+		return "hilbert";
+	default:
+		return "unknown";
+	}
+}
+
+void VertexOrder::undirectedAdjacency(const StaticGraph & graph, std::vector<int> * offsets, std::vector<int> * neighbours)
+{
+	// Каждая дуга учитывается у обоих концов.
+	int n = graph.nodeCount();
+	offsets->assign(n + 1, 0);
+	for (int node = 0; node < n; node++)
+		for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+		{
+			(*offsets)[node + 1]++;
+			(*offsets)[graph.edgeTarget(edge) + 1]++;
+		}
+	for (int node = 0; node < n; node++)
+		(*offsets)[node + 1] += (*offsets)[node];
+	std::vector<int> position(offsets->begin(), offsets->end() - 1);
+	neighbours->resize((*offsets)[n]);
+	for (int node = 0; node < n; node++)
+		for (int edge = graph.edgeBegin(node); edge < graph.edgeEnd(node); edge++)
+		{
+			int target = graph.edgeTarget(edge);
+			(*neighbours)[position[node]++] = target;
+			(*neighbours)[position[target]++] = node;
+		}
+}
+
+void VertexOrder::bfsOrder(const StaticGraph & graph, std::vector<int> * order)
+{
+	std::vector<int> offsets, neighbours;
+	undirectedAdjacency(graph, &offsets, &neighbours);
+	int n = graph.nodeCount();
+	std::vector<bool> visited(n, false);
+	order->clear();
+	order->reserve(n);
+	// Каждая компонента связности обходится от ее узла с наименьшим индексом; сам order служит очередью.
+	for (int root = 0; root < n; root++)
+	{
+		if (visited[root])
+			continue;
+		visited[root] = true;
+		order->push_back(root);
+		for (size_t head = order->size() - 1; head < order->size(); head++)
+		{
+			int node = (*order)[head];
+			for (int i = offsets[node]; i < offsets[node + 1]; i++)
+				if (!visited[neighbours[i]])
+				{
+					visited[neighbours[i]] = true;
+					order->push_back(neighbours[i]);
+				}
+		}
+	}
+}
+
+void VertexOrder::cuthillMcKeeOrder(const StaticGraph & graph, std::vector<int> * order)
+{
+	std::vector<int> offsets, neighbours;
+	undirectedAdjacency(graph, &offsets, &neighbours);
+	int n = graph.nodeCount();
+	DegreeLess degreeLess(&offsets);
+
+	// Узлы перебираются по возрастанию степени, чтобы каждая компонента начиналась с узла малой степени.
+	std::vector<int> candidates(n);
+	for (int node = 0; node < n; node++)
+		candidates[node] = node;
+	std::sort(candidates.begin(), candidates.end(), degreeLess);
+
+	std::vector<int> level(n, -1);
+	std::vector<int> component;
+	std::vector<bool> visited(n, false);
+	std::vector<int> children;
+	order->clear();
+	order->reserve(n);
+	for (int c = 0; c < n; c++)
+	{
+		int root = candidates[c];
+		if (visited[root])
+			continue;
+
+		// Ищем псевдопериферийный узел: начинаем обход заново из самого дальнего узла меньшей степени, пока глубина растет.
+		int depth = -1;
+		for (;;)
+		{
+			component.clear();
+			component.push_back(root);
+			level[root] = 0;
+			for (size_t head = 0; head < component.size(); head++)
+			{
+				int node = component[head];
+				for (int i = offsets[node]; i < offsets[node + 1]; i++)
+					if (level[neighbours[i]] == -1)
+					{
+						level[neighbours[i]] = level[node] + 1;
+						component.push_back(neighbours[i]);
+					}
+			}
+			int lastLevel = level[component.back()];
+			int farthest = component.back();
+			for (size_t i = 0; i < component.size(); i++)
+				if (level[component[i]] == lastLevel && degreeLess(component[i], farthest))
+					farthest = component[i];
+			for (size_t i = 0; i < component.size(); i++)
+				level[component[i]] = -1;
+			if (lastLevel <= depth)
+				break;
+			depth = lastLevel;
+			root = farthest;
+		}
+
+		// Обход в ширину, в котором соседи добавляются по возрастанию степени.
+		size_t start = order->size();
+		visited[root] = true;
+		order->push_back(root);
+		for (size_t head = start; head < order->size(); head++)
+		{
+			int node = (*order)[head];
+			children.clear();
+			for (int i = offsets[node]; i < offsets[node + 1]; i++)
+				if (!visited[neighbours[i]])
+				{
+					visited[neighbours[i]] = true;
+					children.push_back(neighbours[i]);
+				}
+			std::sort(children.begin(), children.end(), degreeLess);
+			order->insert(order->end(), children.begin(), children.end());
+		}
+	}
+	std::reverse(order->begin(), order->end());
+}
+
+void VertexOrder::hilbertOrder(const StaticGraph & graph, const std::vector<NodePosition> & positions, std::vector<int> * order)
+{
+	const unsigned int side = 1 << 16;	// Размер сетки, на которую отображаются координаты.
+	int n = graph.nodeCount();
+	double minX = 0, maxX = 0, minY = 0, maxY = 0;
+	bool first = true;
+	for (int node = 0; node < n; node++)
+		if (positions[node].known)
+		{
+			if (first || positions[node].x < minX)
+				minX = positions[node].x;
+			if (first || positions[node].x > maxX)
+				maxX = positions[node].x;
+			if (first || positions[node].y < minY)
+				minY = positions[node].y;
+			if (first || positions[node].y > maxY)
+				maxY = positions[node].y;
+			first = false;
+		}
+	double scaleX = (maxX > minX) ? (side - 1) / (maxX - minX) : 0;
+	double scaleY = (maxY > minY) ? (side - 1) / (maxY - minY) : 0;
+
+	// Узлы сортируются по индексу на кривой; узлы без координат получают наибольший индекс и сохраняют исходный порядок.
+	std::vector<std::pair<unsigned long long, int> > keys(n);
+	for (int node = 0; node < n; node++)
+	{
+		unsigned long long key = (unsigned long long)side * side;
+		if (positions[node].known)
+			key = hilbertIndex(side, (unsigned int)((positions[node].x - minX) * scaleX), (unsigned int)((positions[node].y - minY) * scaleY));
+		keys[node] = std::pair<unsigned long long, int>(key, node);
+	}
+	std::sort(keys.begin(), keys.end());
+	order->resize(n);
+	for (int i = 0; i < n; i++)
+		(*order)[i] = keys[i].second;
+}
+
+bool VertexOrder::compute(const StaticGraph & graph, int method, const std::vector<NodePosition> * positions, std::vector<int> * order)
+{
+	switch (method)
+	{
+	case ORDER_NAME:
+		order->resize(graph.nodeCount());
+		for (int node = 0; node < graph.nodeCount(); node++)
+			(*order)[node] = node;
+		return true;
+	case ORDER_BFS:
+		bfsOrder(graph, order);
+		return true;
+	case ORDER_RCM:
+		cuthillMcKeeOrder(graph, order);
+		return true;
+	case ORDER_HILBERT:
+		if (positions == NULL || (int)positions->size() != graph.nodeCount())
+			return false;
+		hilbertOrder(graph, *positions, order);
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool VertexOrder::readPositions(const char * fileName, const StaticGraph & graph, std::vector<NodePosition> * positions)
+{
+	FILE * file;
+	if (fopen_s(&file, fileName, "r"))
+		return false;
+	positions->assign(graph.nodeCount(), NodePosition());
+	char name[256] = "";
+	double x = 0, y = 0;
+	while (fscanf_s(file, "%s", name) == 1 && fscanf_s(file, "%lf", &x) == 1 && fscanf_s(file, "%lf", &y) == 1)
+	{
+		int node = graph.findNode(name);
+		if (node == -1)
+			continue;
+		(*positions)[node].x = x;
+		(*positions)[node].y = y;
+		(*positions)[node].known = true;
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "staticgraph.h"
+
+/**
+ * Положение узла на плоскости.
+ */
+struct NodePosition
+{
+	double x;
+	double y;
+	bool known;		// Задано ли положение.
+
+	NodePosition();
+};
+
+/**
+ * Порядки нумерации узлов, улучшающие локальность обращений к памяти при поиске.
+ * Соседние по графу узлы получают близкие индексы, поэтому их метки и списки дуг оказываются в одних строках кэша.
+ */
+class VertexOrder
+{
+private:
+	static void undirectedAdjacency(const StaticGraph & graph, std::vector<int> * offsets, std::vector<int> * neighbours);
+	static void bfsOrder(const StaticGraph & graph, std::vector<int> * order);
+	static void cuthillMcKeeOrder(const StaticGraph & graph, std::vector<int> * order);
+	static void hilbertOrder(const StaticGraph & graph, const std::vector<NodePosition> & positions, std::vector<int> * order);
+
+public:
+	// Порядок имен (исходный).
+	static const int ORDER_NAME = 0;
+	// Порядок обхода в ширину.
+	static const int ORDER_BFS = 1;
+	// Обратный порядок Катхилла - Макки.
+	static const int ORDER_RCM = 2;
+	// Порядок вдоль кривой Гильберта; требует координат узлов.
+	static const int ORDER_HILBERT = 3;
+
+	/**
+	 * Разбор названия порядка (name, bfs, rcm, hilbert).
+	 * @param name - название.
+	 * @param order - указатель на переменную, в которую запишется порядок.
+	 * @return - true, если название известно, иначе false.
+	 */
+	static bool parse(const std::string & name, int * order);
+
+	/**
+	 * Название порядка.
+	 */
+	static const char * name(int order);
+
+	/**
+	 * Вычисление перестановки узлов для StaticGraph::renumber. Дуги рассматриваются как неориентированные.
+	 * @param graph - граф.
+	 * @param method - порядок.
+	 * @param positions - положения узлов (для ORDER_HILBERT; узлы без положения ставятся в конец) или NULL.
+	 * @param order - указатель на вектор, в который запишется перестановка: order[i] - узел, получающий индекс i.
+	 * @return - true, если перестановка вычислена, false, если для порядка не хватает данных.
+	 */
+	static bool compute(const StaticGraph & graph, int method, const std::vector<NodePosition> * positions, std::vector<int> * order);
+
+	/**
+	 * Чтение положений узлов из файла со строками вида "<вершина> <x> <y>".
+	 * @param fileName - имя файла.
+	 * @param graph - граф, узлы которого ищутся по именам; строки с неизвестными узлами пропускаются.
+	 * @param positions - указатель на вектор положений по индексам узлов.
+	 * @return - true, если файл прочитан, иначе false.
+	 */
+	static bool readPositions(const char * fileName, const StaticGraph & graph, std::vector<NodePosition> * positions);
+};
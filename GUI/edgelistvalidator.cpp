@@ -0,0 +1,146 @@
+#include "edgelistvalidator.h"
+
+EdgeBlockData::EdgeBlockData(EdgeListValidator * _owner)
+{
+	owner = _owner;
+	empty = true;
+	valid = true;
+}
+
+EdgeBlockData::~EdgeBlockData()
+{
+	if (owner == NULL)
+		return;
+	if (!valid)
+		owner->invalidCount--;
+	else if (!empty)
+		owner->edgeCount--;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+EdgeListValidator::EdgeListValidator()
+{
+	invalidCount = 0;
+	edgeCount = 0;
+}
+
+bool EdgeListValidator::parseLine(const QString & line, FileListItem * item, bool * empty)
+{
+	// Строка должна состоять из трех слов: двух имен вершин и целого веса.
+	QString words[3];
+	int count = 0;
+	int i = 0;
+	int length = line.length();
+	while (i < length)
+	{
+		while (i < length && line[i].isSpace())
+			i++;
+		if (i == length)
+			break;
+		int begin = i;
+		while (i < length && !line[i].isSpace())
+			i++;
+		if (count == 3)
+			return false;
+		words[count++] = line.mid(begin, i - begin);
+	}
+	*empty = (count == 0);
+	if (count == 0)
+		return true;
+	if (count != 3)
+		return false;
+
+	// Вес - необязательный минус и цифры, значение должно помещаться в __int64.
+	const QString & weight = words[2];
+	bool negative = (weight[0] == QChar('-'));
+	int first = negative ? 1 : 0;
+	if (first == weight.length())
+		return false;
+	unsigned __int64 value = 0;
+	const unsigned __int64 limit = negative ? (unsigned __int64)9223372036854775807LL + 1 : (unsigned __int64)9223372036854775807LL;
+	for (int j = first; j < weight.length(); j++)
+	{
+		if (weight[j] < QChar('0') || weight[j] > QChar('9'))
+			return false;
+		unsigned __int64 digit = (unsigned __int64)(weight[j].unicode() - '0');
+		if (value > (limit - digit) / 10)
+			return false;
+		value = value * 10 + digit;
+	}
+
+	item->from = words[0].toLocal8Bit().data();
+	item->to = words[1].toLocal8Bit().data();
+	item->weight = negative ? (__int64)(0 - value) : (__int64)value;
+	return true;
+}
+
+void EdgeListValidator::parseBlock(QTextBlock block)
+{
+	// Старые данные блока удаляются документом, их деструктор поправляет счетчики.
+	EdgeBlockData * data = new EdgeBlockData(this);
+	data->valid = parseLine(block.text(), &data->item, &data->empty);
+	block.setUserData(data);
+	if (!data->valid)
+		invalidCount++;
+	else if (!data->empty)
+		edgeCount++;
+}
+
+void EdgeListValidator::update(QTextDocument * doc, int position, int charsRemoved, int charsAdded)
+{
+	// Позиции относятся к документу после изменения, поэтому заново разбираются только блоки с добавленным текстом.
+	QTextBlock block = doc->findBlock(position);
+	QTextBlock last = doc->findBlock(position + charsAdded);
+	if (!last.isValid())
+		last = doc->lastBlock();
+	for (; block.isValid(); block = block.next())
+	{
+		parseBlock(block);
+		if (block == last)
+			break;
+	}
+}
+
+void EdgeListValidator::detach(QTextDocument * doc)
+{
+	for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next())
+	{
+		EdgeBlockData * data = static_cast<EdgeBlockData *>(block.userData());
+		if (data != NULL)
+			data->owner = NULL;
+	}
+	invalidCount = 0;
+	edgeCount = 0;
+}
+
+bool EdgeListValidator::isValid() const
+{
+	return invalidCount == 0;
+}
+
+int EdgeListValidator::count() const
+{
+	return edgeCount;
+}
+
+bool EdgeListValidator::collect(QTextDocument * doc, std::vector<FileListItem> * edges)
+{
+	if (invalidCount > 0)
+		return false;
+	edges->reserve(edgeCount);
+	for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next())
+	{
+		EdgeBlockData * data = static_cast<EdgeBlockData *>(block.userData());
+		if (data == NULL)
+		{
+			parseBlock(block);
+			data = static_cast<EdgeBlockData *>(block.userData());
+		}
+		if (!data->valid)
+			return false;
+		if (!data->empty)
+			edges->push_back(data->item);
+	}
+	return true;
+}
@@ -0,0 +1,88 @@
+#ifndef EDGELISTVALIDATOR_H
+#define EDGELISTVALIDATOR_H
+
+#include <vector>
+#include <qstring.h>
+#include <qtextdocument.h>
+#include <qtextobject.h>
+#include "graph.h"
+
+class EdgeListValidator;
+
+/**
+ * Результат разбора строки списка дуг, хранится в самом блоке документа.
+ * При удалении блока документ удаляет и эти данные, а деструктор поправляет счетчики валидатора.
+ */
+class EdgeBlockData : public QTextBlockUserData
+{
+public:
+	EdgeListValidator * owner;	// Валидатор, ведущий счетчики, или NULL.
+	bool empty;					// Пустая ли строка.
+	bool valid;					// Соответствует ли строка формату x y w.
+	FileListItem item;			// Разобранная дуга.
+
+	EdgeBlockData(EdgeListValidator * _owner);
+	~EdgeBlockData();
+};
+
+/**
+ * Инкрементальная проверка списка дуг в редакторе.
+ * Заново разбираются только блоки, затронутые изменением документа; результаты разбора передаются алгоритму без промежуточных файлов.
+ */
+class EdgeListValidator
+{
+private:
+	int invalidCount;	// Количество строк, не соответствующих формату.
+	int edgeCount;		// Количество непустых строк, соответствующих формату.
+
+	friend class EdgeBlockData;
+
+	void parseBlock(QTextBlock block);
+
+public:
+	EdgeListValidator();
+
+	/**
+	 * Разбирает строку формата x y w.
+	 * @param line - строка.
+	 * @param item - указатель на дугу, в которую запишется результат.
+	 * @param empty - указатель на признак пустой строки.
+	 * @return - true, если строка пустая или соответствует формату, иначе false.
+	 */
+	static bool parseLine(const QString & line, FileListItem * item, bool * empty);
+
+	/**
+	 * Обрабатывает изменение документа (сигнал QTextDocument::contentsChange).
+	 * @param doc - документ.
+	 * @param position - позиция изменения.
+	 * @param charsRemoved - количество удаленных символов.
+	 * @param charsAdded - количество добавленных символов.
+	 */
+	void update(QTextDocument * doc, int position, int charsRemoved, int charsAdded);
+
+	/**
+	 * Отвязывает данные блоков от валидатора. Вызывается перед уничтожением валидатора, если документ продолжает существовать.
+	 * @param doc - документ.
+	 */
+	void detach(QTextDocument * doc);
+
+	/**
+	 * Все ли строки соответствуют формату?
+	 */
+	bool isValid() const;
+
+	/**
+	 * Количество дуг в документе.
+	 */
+	int count() const;
+
+	/**
+	 * Собирает разобранные дуги документа.
+	 * @param doc - документ.
+	 * @param edges - указатель на вектор, в который запишутся дуги.
+	 * @return - true, если все строки соответствуют формату, иначе false.
+	 */
+	bool collect(QTextDocument * doc, std::vector<FileListItem> * edges);
+};
+
+#endif // EDGELISTVALIDATOR_H
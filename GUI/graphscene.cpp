@@ -0,0 +1,521 @@
+#include "graphscene.h"
+#include <qprocess.h>
+#include <qstringlist.h>
+#include <qpen.h>
+#include <qbrush.h>
+#include <qpainterpath.h>
+#include <qpolygon.h>
+#include <qpainter.h>
+#include <qfontmetrics.h>
+#include <qstyleoption.h>
+#include <qqueue.h>
+#include <qmath.h>
+
+const qreal GraphScene::LABEL_DETAIL = 0.5;
+const qreal GraphScene::EDGE_DETAIL = 0.2;
+
+StepState::StepState()
+{
+	currentEdge = NULL;
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+NodeGraphicsItem::NodeGraphicsItem(GraphScene * _owner, int _index, const QRectF & _bounds)
+{
+	owner = _owner;
+	index = _index;
+	bounds = _bounds;
+	setZValue(1);
+}
+
+QRectF NodeGraphicsItem::boundingRect() const
+{
+	return bounds;
+}
+
+void NodeGraphicsItem::paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget)
+{
+	const QRectF & rect = owner->layout.nodeRects[index];
+	qreal detail = option->levelOfDetailFromTransform(painter->worldTransform());
+
+	// Выделяем пройденное состояние пунктиром.
+	bool passed = owner->mode == GraphScene::MODE_STEP && owner->state.passed[index];
+	painter->setPen(QPen(Qt::black, 0, passed ? Qt::DotLine : Qt::SolidLine));
+	painter->setBrush(Qt::NoBrush);
+	if (detail < GraphScene::EDGE_DETAIL)
+	{
+		// При сильном уменьшении достаточно прямоугольника.
+		painter->drawRect(rect);
+		return;
+	}
+	painter->drawEllipse(rect);
+	if (detail < GraphScene::LABEL_DETAIL)
+		return;
+
+	QString text = owner->nodeNames[index];
+	if (owner->mode != GraphScene::MODE_GRAPH)
+		text += QString("\n len=") + QString::number(owner->state.labels[index]);
+	painter->drawText(bounds, Qt::AlignCenter, text);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+EdgeGraphicsItem::EdgeGraphicsItem(GraphScene * _owner, int _index, const QRectF & _bounds)
+{
+	owner = _owner;
+	index = _index;
+	bounds = _bounds;
+}
+
+QRectF EdgeGraphicsItem::boundingRect() const
+{
+	return bounds;
+}
+
+void EdgeGraphicsItem::paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget)
+{
+	const QPainterPath & path = owner->layout.edgePaths[index];
+	QColor color = owner->edgeColor(index);
+	qreal detail = option->levelOfDetailFromTransform(painter->worldTransform());
+
+	if (detail < GraphScene::EDGE_DETAIL)
+	{
+		// Невыделенные дуги при сильном уменьшении не рисуются, выделенные сворачиваются в отрезки.
+		if (color == QColor(Qt::black))
+			return;
+		painter->setPen(QPen(color, 2));
+		painter->drawLine(path.pointAtPercent(0), path.pointAtPercent(1));
+		return;
+	}
+
+	painter->setPen(QPen(color, 0));
+	painter->setBrush(Qt::NoBrush);
+	painter->drawPath(path);
+	painter->setBrush(color);
+	painter->drawPolygon(owner->layout.edgeArrows[index]);
+	if (detail < GraphScene::LABEL_DETAIL)
+		return;
+
+	QString text = QString::number(owner->edges[index]->weight);
+	QRectF textRect = painter->fontMetrics().boundingRect(text);
+	textRect.moveCenter(owner->layout.edgeLabels[index]);
+	painter->drawText(textRect, Qt::AlignCenter, text);
+}
+
+/*----------------------------------------------------------------------------------------------------*/
+
+// Разбивает строку вывода dot -Tplain на лексемы с учетом строк в кавычках.
+static QStringList splitPlainLine(const QString & line)
+{
+	QStringList tokens;
+	QString token;
+	bool quoted = false;
+	bool inToken = false;
+	for (int i = 0; i < line.length(); i++)
+	{
+		QChar c = line[i];
+		if (quoted)
+		{
+			if (c == QChar('\\') && i + 1 < line.length())
+				token += line[++i];
+			else if (c == QChar('"'))
+				quoted = false;
+			else
+				token += c;
+		}
+		else if (c == QChar('"'))
+		{
+			quoted = true;
+			inToken = true;
+		}
+		else if (c.isSpace())
+		{
+			if (inToken)
+				tokens << token;
+			token.clear();
+			inToken = false;
+		}
+		else
+		{
+			token += c;
+			inToken = true;
+		}
+	}
+	if (inToken)
+		tokens << token;
+	return tokens;
+}
+
+// Экранирует строку для использования внутри кавычек в языке dot.
+static QString escapeDotString(const QString & str)
+{
+	QString result = str;
+	result.replace(QString("\\"), QString("\\\\"));
+	result.replace(QString("\""), QString("\\\""));
+	return result;
+}
+
+GraphScene::GraphScene(QObject * parent) : QGraphicsScene(parent)
+{
+	mode = MODE_GRAPH;
+}
+
+GraphScene::~GraphScene()
+{
+}
+
+bool GraphScene::computeLayout(const Graph * graph, const QString & dotExeFileName, GraphLayout * layout, const ExecutionControl * control)
+{
+	// Для больших графов dot работает слишком долго, поэтому они раскладываются по слоям.
+	int edgeCount = 0;
+	const std::map<std::string, Node *> & nodes = graph->getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+		edgeCount += (int)iter->second->edges.size();
+	if (edgeCount > DOT_EDGE_LIMIT)
+	{
+		computeLayeredLayout(graph, layout);
+		return true;
+	}
+
+	// dot.exe запускается один раз, обмен данными идет через стандартные потоки; если он недоступен, граф раскладывается по слоям.
+	QProcess dot;
+	dot.start(dotExeFileName, QStringList() << QString("-Tplain"));
+	if (!dot.waitForStarted())
+	{
+		computeLayeredLayout(graph, layout);
+		return true;
+	}
+	dot.write(generateDotCode(graph).toLocal8Bit());
+	dot.closeWriteChannel();
+	// Ждем завершения небольшими интервалами, чтобы вовремя заметить отмену.
+	while (!dot.waitForFinished(100))
+	{
+		if (dot.state() == QProcess::NotRunning)
+			break;
+		if (control != NULL && control->cancelled)
+		{
+			dot.kill();
+			dot.waitForFinished(-1);
+			return false;
+		}
+	}
+	if (!parseLayout(graph, dot.readAllStandardOutput(), layout))
+		computeLayeredLayout(graph, layout);
+	return true;
+}
+
+void GraphScene::computeLayeredLayout(const Graph * graph, GraphLayout * layout)
+{
+	const qreal nodeWidth = 90;		// Размеры узла.
+	const qreal nodeHeight = 40;
+	const qreal layerSpacing = 160;	// Расстояние между слоями.
+	const qreal rowSpacing = 60;	// Расстояние между узлами одного слоя.
+
+	// Узлы раскладываются по слоям обхода в ширину: сначала от начальной вершины маршрута, затем от еще не достигнутых узлов.
+	QHash<const Node *, int> indices;
+	QVector<const Node *> order;
+	const std::map<std::string, Node *> & nodes = graph->getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		indices.insert(iter->second, order.size());
+		order.push_back(iter->second);
+	}
+	QVector<int> layers(order.size(), -1);
+	QVector<int> rows;
+	QQueue<int> queue;
+	layout->nodeRects.fill(QRectF(), order.size());
+	int start = graph->getStartNode() != NULL ? indices.value(graph->getStartNode()) : 0;
+	for (int i = -1; i < order.size(); i++)
+	{
+		int root = (i < 0) ? start : i;
+		if (root >= order.size() || layers[root] >= 0)
+			continue;
+		layers[root] = 0;
+		queue.enqueue(root);
+		while (!queue.isEmpty())
+		{
+			int current = queue.dequeue();
+			if (layers[current] >= rows.size())
+				rows.push_back(0);
+			// Новый слой начинается ниже всех уже размещенных узлов этого слоя.
+			int row = rows[layers[current]]++;
+			layout->nodeRects[current] = QRectF(layers[current] * layerSpacing, row * rowSpacing, nodeWidth, nodeHeight);
+			const std::vector<Edge *> & edges = order[current]->edges;
+			for (size_t j = 0; j < edges.size(); j++)
+			{
+				int next = indices.value(edges[j]->to);
+				if (layers[next] < 0)
+				{
+					layers[next] = layers[current] + 1;
+					queue.enqueue(next);
+				}
+			}
+		}
+	}
+
+	// Дуги - отрезки между границами эллипсов.
+	layout->edgePaths.clear();
+	layout->edgeArrows.clear();
+	layout->edgeLabels.clear();
+	for (int i = 0; i < order.size(); i++)
+	{
+		const std::vector<Edge *> & edges = order[i]->edges;
+		for (size_t j = 0; j < edges.size(); j++)
+		{
+			QRectF from = layout->nodeRects[i];
+			QRectF to = layout->nodeRects[indices.value(edges[j]->to)];
+			QPointF dir = to.center() - from.center();
+			double len = qSqrt(dir.x() * dir.x() + dir.y() * dir.y());
+			if (len > 0)
+				dir /= len;
+			// Расстояние от центра эллипса до его границы в направлении dir.
+			double fromScale = 1 / qSqrt(qPow(dir.x() / (from.width() / 2), 2) + qPow(dir.y() / (from.height() / 2), 2) + 1e-12);
+			double toScale = 1 / qSqrt(qPow(dir.x() / (to.width() / 2), 2) + qPow(dir.y() / (to.height() / 2), 2) + 1e-12);
+			QPointF begin = from.center() + dir * fromScale;
+			QPointF end = to.center() - dir * (toScale + 10);
+
+			QPainterPath path(begin);
+			path.lineTo(end);
+			QPointF normal(-dir.y(), dir.x());
+			QPolygonF arrow;
+			arrow << end + dir * 10 << end + normal * 4 << end - normal * 4;
+			layout->edgePaths.push_back(path);
+			layout->edgeArrows.push_back(arrow);
+			layout->edgeLabels.push_back((begin + end) / 2);
+		}
+	}
+}
+
+QString GraphScene::generateDotCode(const Graph * graph)
+{
+	QString code("digraph {\nrankdir = LR;\n");
+	QHash<const Node *, int> indices;
+	const std::map<std::string, Node *> & nodes = graph->getNodes();
+	// Узлы именуются по индексам, а подписи содержат имя и метку, чтобы размер узла не зависел от шага.
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		code += QString("n%1 [label=\"%2\\n len=-1\"];\n").arg(indices.size()).arg(escapeDotString(QString::fromLocal8Bit(iter->first.c_str())));
+		indices.insert(iter->second, indices.size());
+	}
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		const std::vector<Edge *> & edges = iter->second->edges;
+		for (size_t i = 0; i < edges.size(); i++)
+			code += QString("n%1 -> n%2 [label=\"%3\"];\n").arg(indices.value(edges[i]->from)).arg(indices.value(edges[i]->to)).arg(edges[i]->weight);
+	}
+	code += QString("}\n");
+	return code;
+}
+
+bool GraphScene::parseLayout(const Graph * graph, const QByteArray & plain, GraphLayout * layout)
+{
+	const double dpi = 72.0;	// Координаты в выводе dot заданы в дюймах.
+	double height = 0;			// Высота графа, нужна для переворота оси y.
+
+	// Дуги между одной и той же парой узлов сопоставляются в порядке их создания.
+	QHash<const Node *, int> indices;
+	QHash<QString, QList<int> > pending;
+	int edgeCount = 0;
+	const std::map<std::string, Node *> & nodes = graph->getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+		indices.insert(iter->second, indices.size());
+	for (std::map<std::string, Node *>::const_iterator iter = nodes.cbegin(); iter != nodes.cend(); iter++)
+	{
+		const std::vector<Edge *> & edges = iter->second->edges;
+		for (size_t i = 0; i < edges.size(); i++)
+			pending[QString("n%1 n%2").arg(indices.value(edges[i]->from)).arg(indices.value(edges[i]->to))].push_back(edgeCount++);
+	}
+	layout->nodeRects.fill(QRectF(), indices.size());
+	layout->edgePaths.fill(QPainterPath(), edgeCount);
+	layout->edgeArrows.fill(QPolygonF(), edgeCount);
+	layout->edgeLabels.fill(QPointF(), edgeCount);
+
+	QList<QByteArray> lines = plain.split('\n');
+	for (QList<QByteArray>::const_iterator iter = lines.constBegin(); iter != lines.constEnd(); iter++)
+	{
+		QStringList tokens = splitPlainLine(QString::fromLocal8Bit(iter->constData()));
+		if (tokens.isEmpty())
+			continue;
+
+		if (tokens[0] == QString("graph") && tokens.size() >= 4)
+			height = tokens[3].toDouble();
+		else if (tokens[0] == QString("node") && tokens.size() >= 6)
+		{
+			int index = tokens[1].mid(1).toInt();
+			if (index < 0 || index >= layout->nodeRects.size())
+				continue;
+			double x = tokens[2].toDouble() * dpi;
+			double y = (height - tokens[3].toDouble()) * dpi;
+			double w = tokens[4].toDouble() * dpi;
+			double h = tokens[5].toDouble() * dpi;
+			layout->nodeRects[index] = QRectF(x - w / 2, y - h / 2, w, h);
+		}
+		else if (tokens[0] == QString("edge") && tokens.size() >= 4)
+		{
+			QList<int> & queue = pending[tokens[1] + QString(" ") + tokens[2]];
+			if (queue.isEmpty())
+				continue;
+			int index = queue.takeFirst();
+			int n = tokens[3].toInt();
+			if (n < 2 || tokens.size() < 4 + 2 * n)
+				continue;
+
+			// Сплайн задан набором контрольных точек кубических кривых Безье.
+			QVector<QPointF> points;
+			for (int i = 0; i < n; i++)
+				points.push_back(QPointF(tokens[4 + 2 * i].toDouble() * dpi, (height - tokens[5 + 2 * i].toDouble()) * dpi));
+			QPainterPath path(points[0]);
+			for (int i = 1; i + 2 < points.size(); i += 3)
+				path.cubicTo(points[i], points[i + 1], points[i + 2]);
+			layout->edgePaths[index] = path;
+
+			// Наконечник строится от последней точки сплайна по направлению последнего отрезка.
+			QPointF end = points[n - 1];
+			QPointF dir = end - points[n - 2];
+			double len = qSqrt(dir.x() * dir.x() + dir.y() * dir.y());
+			if (len > 0)
+			{
+				dir /= len;
+				QPointF normal(-dir.y(), dir.x());
+				QPolygonF arrow;
+				arrow << end + dir * 10 << end + normal * 4 << end - normal * 4;
+				layout->edgeArrows[index] = arrow;
+			}
+
+			// Подпись дуги.
+			layout->edgeLabels[index] = path.pointAtPercent(0.5);
+			if (tokens.size() >= 4 + 2 * n + 5)
+				layout->edgeLabels[index] = QPointF(tokens[5 + 2 * n].toDouble() * dpi, (height - tokens[6 + 2 * n].toDouble()) * dpi);
+		}
+	}
+	return height > 0;
+}
+
+void GraphScene::build(const Graph * graph, const GraphLayout & _layout)
+{
+	clear();
+	nodes.clear();
+	edges.clear();
+	nodeNames.clear();
+	edgeSources.clear();
+	nodeIndices.clear();
+	edgeIndices.clear();
+	layout = _layout;
+	mode = MODE_GRAPH;
+
+	// Для быстрого поиска видимых элементов используется BSP-дерево; элементы неподвижны, поэтому оно строится один раз.
+	setItemIndexMethod(QGraphicsScene::BspTreeIndex);
+	QFontMetricsF metrics(font());
+
+	const std::map<std::string, Node *> & graphNodes = graph->getNodes();
+	for (std::map<std::string, Node *>::const_iterator iter = graphNodes.cbegin(); iter != graphNodes.cend(); iter++)
+	{
+		nodeIndices.insert(iter->second, nodes.size());
+		nodes.push_back(iter->second);
+		nodeNames.push_back(QString::fromLocal8Bit(iter->first.c_str()));
+	}
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		const std::vector<Edge *> & nodeEdges = nodes[i]->edges;
+		for (size_t j = 0; j < nodeEdges.size(); j++)
+		{
+			edgeIndices.insert(nodeEdges[j], edges.size());
+			edges.push_back(nodeEdges[j]);
+			edgeSources.push_back(i);
+		}
+	}
+
+	for (int i = 0; i < nodes.size(); i++)
+	{
+		// Подпись может быть шире узла, поэтому она учитывается в границах элемента.
+		const QRectF & rect = layout.nodeRects.value(i);
+		qreal textWidth = qMax(metrics.width(nodeNames[i]), metrics.width(QString(" len=-9223372036854775808")));
+		QRectF bounds = rect.united(QRectF(rect.center().x() - textWidth / 2, rect.center().y() - metrics.height(), textWidth, metrics.height() * 2));
+		addItem(new NodeGraphicsItem(this, i, bounds.adjusted(-1, -1, 1, 1)));
+	}
+	for (int i = 0; i < edges.size(); i++)
+	{
+		QRectF textRect = metrics.boundingRect(QString::number(edges[i]->weight));
+		textRect.moveCenter(layout.edgeLabels.value(i));
+		QRectF bounds = layout.edgePaths.value(i).boundingRect().united(layout.edgeArrows.value(i).boundingRect()).united(textRect);
+		addItem(new EdgeGraphicsItem(this, i, bounds.adjusted(-2, -2, 2, 2)));
+	}
+	setSceneRect(itemsBoundingRect());
+}
+
+QColor GraphScene::edgeColor(int index) const
+{
+	if (mode == MODE_STEP)
+	{
+		if (edges[index] == state.currentEdge)
+			return QColor(Qt::red);
+		if (state.passed[edgeSources[index]])
+			return QColor(Qt::blue);
+	}
+	else if (mode == MODE_RESULT && resultEdges[index])
+		return QColor(Qt::magenta);
+	return QColor(Qt::black);
+}
+
+int GraphScene::nodeCount() const
+{
+	return nodes.size();
+}
+
+int GraphScene::nodeIndex(const Node * node) const
+{
+	return nodeIndices.value(node, -1);
+}
+
+void GraphScene::initialState(StepState * state) const
+{
+	state->labels.fill(-1, nodes.size());
+	state->passed.fill(false, nodes.size());
+	state->currentEdge = NULL;
+}
+
+void GraphScene::applyStep(const ExecutionStep & step, StepState * state) const
+{
+	if (step.changedNode != NULL)
+		state->labels[nodeIndex(step.changedNode)] = step.totalWeight;
+	if (step.passedNode != NULL)
+		state->passed[nodeIndex(step.passedNode)] = true;
+	state->currentEdge = step.currentEdge;
+}
+
+void GraphScene::showGraph()
+{
+	mode = MODE_GRAPH;
+	update();
+}
+
+void GraphScene::showStep(const StepState & _state)
+{
+	// Перерисовываются только видимые элементы, поэтому смена шага не зависит от размера графа.
+	mode = MODE_STEP;
+	state = _state;
+	update();
+}
+
+void GraphScene::showResult(const StepState & _state, const ExecutionState & result)
+{
+	mode = MODE_RESULT;
+	state = _state;
+	resultEdges.fill(false, edges.size());
+	for (size_t i = 0; i < result.path.size(); i++)
+		resultEdges[edgeIndices.value(result.path[i])] = true;
+	update();
+}
+
+QRectF GraphScene::highlightedRect() const
+{
+	QRectF rect;
+	if (mode == MODE_STEP && state.currentEdge != NULL)
+		rect = layout.edgePaths.value(edgeIndices.value(state.currentEdge, -1)).boundingRect();
+	else if (mode == MODE_RESULT)
+		for (int i = 0; i < edges.size(); i++)
+			if (resultEdges[i])
+				rect = rect.united(layout.edgePaths[i].boundingRect());
+	return rect;
+}
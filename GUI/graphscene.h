@@ -0,0 +1,189 @@
+#ifndef GRAPHSCENE_H
+#define GRAPHSCENE_H
+
+#include <vector>
+#include <qstring.h>
+#include <qvector.h>
+#include <qhash.h>
+#include <qgraphicsscene.h>
+#include <qgraphicsitem.h>
+#include <qpainterpath.h>
+#include <qpolygon.h>
+#include "graph.h"
+
+class GraphScene;
+
+/**
+ * Состояние визуализации на некотором шаге алгоритма.
+ */
+struct StepState
+{
+	QVector<__int64> labels;	// Метки узлов, индексы совпадают с индексами узлов сцены.
+	QVector<bool> passed;		// Пройден ли узел.
+	const Edge * currentEdge;	// Текущая дуга.
+
+	StepState();
+};
+
+/**
+ * Раскладка графа: положение узлов и форма дуг.
+ * Индексы узлов и дуг соответствуют порядку обхода графа (узлы по имени, дуги в порядке Node::edges).
+ */
+struct GraphLayout
+{
+	QVector<QRectF> nodeRects;			// Контуры узлов.
+	QVector<QPainterPath> edgePaths;	// Линии дуг.
+	QVector<QPolygonF> edgeArrows;		// Наконечники дуг.
+	QVector<QPointF> edgeLabels;		// Центры подписей дуг.
+};
+
+/**
+ * Узел на сцене. Рисует себя по состоянию сцены; при уменьшении подпись скрывается.
+ */
+class NodeGraphicsItem : public QGraphicsItem
+{
+private:
+	GraphScene * owner;		// Сцена, хранящая состояние визуализации.
+	int index;				// Индекс узла на сцене.
+	QRectF bounds;			// Область, занимаемая узлом и подписью.
+
+public:
+	NodeGraphicsItem(GraphScene * _owner, int _index, const QRectF & _bounds);
+	QRectF boundingRect() const;
+	void paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget);
+};
+
+/**
+ * Дуга на сцене. Рисует себя по состоянию сцены; при сильном уменьшении невыделенные дуги не рисуются, а выделенные рисуются отрезками.
+ */
+class EdgeGraphicsItem : public QGraphicsItem
+{
+private:
+	GraphScene * owner;		// Сцена, хранящая состояние визуализации.
+	int index;				// Индекс дуги на сцене.
+	QRectF bounds;			// Область, занимаемая дугой и подписью.
+
+public:
+	EdgeGraphicsItem(GraphScene * _owner, int _index, const QRectF & _bounds);
+	QRectF boundingRect() const;
+	void paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget);
+};
+
+/**
+ * Сцена с графом.
+ * Раскладка графа вычисляется один раз при построении сцены, после чего шаги алгоритма отображаются сменой состояния сцены:
+ * элементы рисуют себя по этому состоянию, поэтому смена шага стоит перерисовки только видимой части графа.
+ */
+class GraphScene : public QGraphicsScene
+{
+private:
+	// Отображается граф без меток.
+	static const int MODE_GRAPH = 0;
+	// Отображается шаг алгоритма.
+	static const int MODE_STEP = 1;
+	// Отображается найденный путь.
+	static const int MODE_RESULT = 2;
+
+	QVector<const Node *> nodes;			// Узлы в порядке обхода графа.
+	QVector<const Edge *> edges;			// Дуги в порядке обхода графа.
+	QVector<QString> nodeNames;				// Имена узлов.
+	QVector<int> edgeSources;				// Индексы начальных узлов дуг.
+	QHash<const Node *, int> nodeIndices;	// Индексы узлов.
+	QHash<const Edge *, int> edgeIndices;	// Индексы дуг.
+	GraphLayout layout;						// Раскладка графа.
+	int mode;								// Режим отображения.
+	StepState state;						// Отображаемое состояние.
+	QVector<bool> resultEdges;				// Принадлежит ли дуга найденному пути.
+
+	friend class NodeGraphicsItem;
+	friend class EdgeGraphicsItem;
+	friend class HtmlReport;
+
+	static QString generateDotCode(const Graph * graph);
+	static bool parseLayout(const Graph * graph, const QByteArray & plain, GraphLayout * layout);
+	static void computeLayeredLayout(const Graph * graph, GraphLayout * layout);
+	QColor edgeColor(int index) const;
+
+public:
+	// Масштаб, ниже которого скрываются подписи.
+	static const qreal LABEL_DETAIL;
+	// Масштаб, ниже которого скрываются невыделенные дуги.
+	static const qreal EDGE_DETAIL;
+	// Максимальное количество дуг, для которого раскладка вычисляется dot.exe.
+	static const int DOT_EDGE_LIMIT = 3000;
+
+	GraphScene(QObject * parent = 0);
+	~GraphScene();
+
+	/**
+	 * Вычисляет раскладку графа. Не обращается к сцене, поэтому может вызываться из рабочего потока.
+	 * dot.exe запускается один раз; большие графы (больше DOT_EDGE_LIMIT дуг), а также графы, которые dot.exe не смог разложить, раскладываются по слоям обхода в ширину.
+	 * @param graph - граф.
+	 * @param dotExeFileName - абсолютный путь к dot.exe.
+	 * @param layout - указатель на раскладку, в которую запишется результат.
+	 * @param control - указатель на объект управления выполнением или NULL; при отмене процесс dot.exe завершается.
+	 * @return - true, если раскладка вычислена, false при отмене.
+	 */
+	static bool computeLayout(const Graph * graph, const QString & dotExeFileName, GraphLayout * layout, const ExecutionControl * control);
+
+	/**
+	 * Строит сцену по графу и его раскладке.
+	 * @param graph - граф, указатели на узлы и дуги которого должны оставаться корректными все время жизни сцены.
+	 * @param _layout - раскладка графа.
+	 */
+	void build(const Graph * graph, const GraphLayout & _layout);
+
+	/**
+	 * Количество узлов на сцене.
+	 */
+	int nodeCount() const;
+
+	/**
+	 * Индекс узла на сцене.
+	 * @param node - узел графа.
+	 * @return - индекс узла или -1, если узла нет на сцене.
+	 */
+	int nodeIndex(const Node * node) const;
+
+	/**
+	 * Заполняет состояние визуализации до начала выполнения алгоритма: все метки бесконечны, пройденных узлов нет.
+	 * @param state - указатель на состояние, в которое запишется результат.
+	 */
+	void initialState(StepState * state) const;
+
+	/**
+	 * Применяет шаг алгоритма к состоянию визуализации предыдущего шага.
+	 * Метод не изменяет сцену, поэтому может вызываться из рабочих потоков.
+	 * @param step - шаг алгоритма.
+	 * @param state - указатель на состояние предыдущего шага, которое станет состоянием этого шага.
+	 */
+	void applyStep(const ExecutionStep & step, StepState * state) const;
+
+	/**
+	 * Отображает граф без меток.
+	 */
+	void showGraph();
+
+	/**
+	 * Отображает шаг алгоритма.
+	 * Пройденные вершины обозначаются пунктиром, непройденные - сплошной линией.
+	 * Текущий переход выделяется красным цветом, пройденные переходы синим цветом, непройденные - черным.
+	 * @param _state - состояние визуализации на этом шаге.
+	 */
+	void showStep(const StepState & _state);
+
+	/**
+	 * Отображает результат: переходы, принадлежащие результирующему пути, выделяются фиолетовым цветом.
+	 * @param _state - состояние визуализации после завершения алгоритма.
+	 * @param result - результат работы алгоритма.
+	 */
+	void showResult(const StepState & _state, const ExecutionState & result);
+
+	/**
+	 * Область сцены, выделенная на текущем шаге: текущая дуга или найденный путь.
+	 * @return - прямоугольник на сцене или пустой прямоугольник, если ничего не выделено.
+	 */
+	QRectF highlightedRect() const;
+};
+
+#endif // GRAPHSCENE_H
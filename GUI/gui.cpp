@@ -2,6 +2,11 @@
 
 ScalableGraphicsView::ScalableGraphicsView(QWidget * parent)
 {
+	// Масштабирование относительно курсора; сцена меняется только перерисовкой, поэтому обновляется лишь затронутая область.
+	setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+	setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+	setOptimizationFlags(QGraphicsView::DontSavePainterState | QGraphicsView::DontAdjustForAntialiasing);
+	setCacheMode(QGraphicsView::CacheBackground);
 }
 
 ScalableGraphicsView::~ScalableGraphicsView()
@@ -30,6 +35,12 @@ GUI::GUI(QWidget *parent, Qt::WFlags flags)
 	enableButtons(false, false, false, false);
 
 	scene = NULL;
+	graph = NULL;
+	currentStep = 0;
+	stepper = NULL;
+	stepCache = NULL;
+	job = NULL;
+	cancelButton = NULL;
 	gvGraph = new ScalableGraphicsView(parent);
 	gvGraph->setScene(NULL);
 	gvGraph->setGeometry(10, 23, 662, 415);
@@ -54,9 +65,18 @@ GUI::GUI(QWidget *parent, Qt::WFlags flags)
 	connect(ui.btnNext, SIGNAL(clicked(bool)), this, SLOT(btnNext_clicked(bool)));
 	connect(ui.btnToTheEnd, SIGNAL(clicked(bool)), this, SLOT(btnToTheEnd_clicked(bool)));
 
+	// Список дуг проверяется по мере редактирования, заново разбираются только измененные строки.
+	QTextDocument * doc = ui.teGraph->document();
+	editorValidator.update(doc, 0, 0, doc->characterCount());
+	connect(doc, SIGNAL(contentsChange(int, int, int)), this, SLOT(teGraph_contentsChange(int, int, int)));
+
+	connect(&jobWatcher, SIGNAL(finished()), this, SLOT(jobFinished()));
+	connect(&progressTimer, SIGNAL(timeout()), this, SLOT(progressTimer_timeout()));
+
 	connect(ui.btnMenuOpen, SIGNAL(triggered(bool)), this, SLOT(btnMenuOpen_triggered(bool)));
 	connect(ui.btnMenuSave, SIGNAL(triggered(bool)), this, SLOT(btnMenuSave_triggered(bool)));
 	connect(ui.btnMenuCreateReport, SIGNAL(triggered(bool)), this, SLOT(btnMenuCreateReport_triggered(bool)));
+	connect(ui.btnMenuCreateCompactReport, SIGNAL(triggered(bool)), this, SLOT(btnMenuCreateCompactReport_triggered(bool)));
 	
 	connect(ui.btnMenuExit, SIGNAL(triggered(bool)), this, SLOT(btnMenuExit_triggered(bool)));
 	connect(ui.btnMenuHelp, SIGNAL(triggered(bool)), this, SLOT(btnMenuHelp_triggered(bool)));
@@ -67,9 +87,11 @@ GUI::GUI(QWidget *parent, Qt::WFlags flags)
 	appPath = QCoreApplication::applicationDirPath() + QDir::separator();
 	dotExeFileName = "";
 	dotPathSetManually = false;
+	cacheBudget = (qint64)DEFAULT_CACHE_BUDGET_MB << 20;
 	if (QFile::exists(appPath + QString("settings.ini")))
 	{
 		QSettings settings(appPath + QString("settings.ini"), QSettings::IniFormat);
+		cacheBudget = (qint64)settings.value("Main/cachebudget", DEFAULT_CACHE_BUDGET_MB).toInt() << 20;
 		dotExeFileName = settings.value("Main/dotpath", "").toString();
 		if (dotExeFileName.length() > 0 && dotExeFileName[1] != QChar(':'))
 			dotExeFileName = appPath + dotExeFileName;
@@ -80,14 +102,21 @@ GUI::GUI(QWidget *parent, Qt::WFlags flags)
 		dotExeFileName = QFileDialog::getOpenFileName(this, QString("Местоположение файла dot.exe"), QString(""), QString("dot.exe"), 0, 0);
 		dotPathSetManually = true;
 	}
-	qsrand((unsigned int)time(NULL));
 }
 
 GUI::~GUI()
 {
-	cleanUp();
-	if (scene != NULL)
-		delete scene;
+	// Дожидаемся прерванной фоновой задачи: она обращается к своим данным до самого завершения.
+	if (job != NULL)
+	{
+		job->control.cancelled = true;
+		jobWatcher.waitForFinished();
+		delete job;
+	}
+	resetScene();
+	// Документ редактора переживет валидатор, поэтому отвязываем от него данные строк.
+	disconnect(ui.teGraph->document(), SIGNAL(contentsChange(int, int, int)), this, SLOT(teGraph_contentsChange(int, int, int)));
+	editorValidator.detach(ui.teGraph->document());
 	layout()->removeWidget(gvGraph);
 	delete gvGraph;
 	delete gvLayout;
@@ -102,37 +131,76 @@ bool GUI::isValid()
 	return QFile::exists(dotExeFileName);
 }
 
-bool GUI::validateFormat(QList<QString> * lines)
+bool GUI::collectEdges(std::vector<FileListItem> * edges)
 {
-	QRegExp regex("\\s*([^ ]+)\\s+([^ ]+)\\s+(-?\\d+)\\s*");
-	QTextDocument * doc = ui.teGraph->document();
-	bool failed = false;
+	// Строки уже разобраны при редактировании, остается собрать дуги.
+	return editorValidator.collect(ui.teGraph->document(), edges);
+}
 
-	for (int i = 0; i < doc->lineCount(); i++)
-	{
-		QString line = doc->findBlockByLineNumber(i).text();
-		if (line != QString(""))
-		{
-			// Строка должна соответствовать шаблону \s*([^ ]+)\s+([^ ]+)\s+(-?\d)\s*
-			if (regex.exactMatch(line))
-			{
-				if (lines != NULL)
-					*lines << line;
-			}
-			else
-				failed = true;
-		}
-	}
-	return !failed;
+void GUI::teGraph_contentsChange(int position, int charsRemoved, int charsAdded)
+{
+	editorValidator.update(ui.teGraph->document(), position, charsRemoved, charsAdded);
 }
 
 void GUI::cleanUp()
 {
-	// Удаляем сгенерированные картинки.
-	for (QVector<QString>::const_iterator iter = images.constBegin(); iter != images.constEnd(); iter++)
-		_unlink((*iter).toLocal8Bit().data());
-	images.clear();
-	currentImage = 0;
+	// Забываем шаги алгоритма для предыдущего графа; кэш ссылается на шаги, поэтому удаляется первым.
+	if (stepCache != NULL)
+		delete stepCache;
+	stepCache = NULL;
+	if (stepper != NULL)
+		delete stepper;
+	stepper = NULL;
+	result = ExecutionState();
+	currentStep = 0;
+}
+
+void GUI::resetScene()
+{
+	cleanUp();
+	// Сцена ссылается на узлы и дуги графа, поэтому удаляется первой.
+	gvGraph->setScene(NULL);
+	if (scene != NULL)
+		delete scene;
+	scene = NULL;
+	if (graph != NULL)
+		delete graph;
+	graph = NULL;
+}
+
+int GUI::stepCount()
+{
+	// Последний шаг - отображение найденного пути.
+	if (stepper == NULL)
+		return 0;
+	return stepper->stepCount() + (result.path.empty() ? 0 : 1);
+}
+
+void GUI::displayStep(int index)
+{
+	// Состояние шага вычисляется только сейчас, следующие шаги готовятся заранее в рабочем потоке.
+	StepState state = stepCache->state(index);
+	if (index < stepper->stepCount())
+		scene->showStep(state);
+	else
+		scene->showResult(state, result);
+	// На больших графах текущая дуга может оказаться за пределами видимой области.
+	QRectF highlighted = scene->highlightedRect();
+	if (!highlighted.isEmpty())
+		gvGraph->ensureVisible(highlighted);
+	stepCache->prefetch(index + 1, PREFETCH_STEPS);
+}
+
+bool GUI::renderStep(int index, const QString & fileName)
+{
+	displayStep(index);
+	QImage image(scene->sceneRect().size().toSize(), QImage::Format_ARGB32);
+	image.fill(qRgb(255, 255, 255));
+	QPainter painter(&image);
+	painter.setRenderHint(QPainter::Antialiasing);
+	scene->render(&painter);
+	painter.end();
+	return image.save(fileName, "PNG");
 }
 
 void GUI::enableButtons(bool beginning, bool previous, bool next, bool end)
@@ -163,202 +231,203 @@ bool GUI::removeDir(const QString & dirName)
 	return result;
 }
 
-void GUI::btnShowGraph_clicked(bool checked)
+void GUI::startJob(SearchJob * newJob, QPushButton * button)
 {
-	QList<QString> lines;	// Непустые строки из содержимого TextEdit.
+	job = newJob;
+	job->dotExeFileName = dotExeFileName;
+
+	// Кнопка, запустившая задачу, на время выполнения становится кнопкой отмены.
+	cancelButton = button;
+	cancelButtonText = button->text();
+	button->setText(QString("Отменить"));
+	ui.btnShowGraph->setEnabled(button == ui.btnShowGraph);
+	ui.btnSearch->setEnabled(button == ui.btnSearch);
+
+	statusBar()->showMessage(job->progressMessage());
+	progressTimer.start(PROGRESS_INTERVAL);
+	jobWatcher.setFuture(QtConcurrent::run(job, &SearchJob::run));
+}
 
-	enableButtons(false, false, false, false);
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
+bool GUI::cancelJob()
+{
+	if (job == NULL)
+		return false;
+	// Поиск прерывается на ближайшей итерации, dot.exe завершается принудительно.
+	job->control.cancelled = true;
+	statusBar()->showMessage(job->progressMessage());
+	return true;
+}
 
-	// Если найдены ошибки в формате - выходим.
-	if (!validateFormat(&lines))
+void GUI::progressTimer_timeout()
+{
+	if (job != NULL)
+		statusBar()->showMessage(job->progressMessage());
+}
+
+void GUI::jobFinished()
+{
+	SearchJob * finished = job;
+	job = NULL;
+	progressTimer.stop();
+	cancelButton->setText(cancelButtonText);
+	ui.btnShowGraph->setEnabled(true);
+	ui.btnSearch->setEnabled(true);
+
+	if (finished->control.cancelled)
 	{
-		QMessageBox::warning(NULL, QString("Ошибка"), QString("Список дуг не соответствует формату x y w."));
+		statusBar()->showMessage(QString("Выполнение отменено."));
+		delete finished;
 		return;
 	}
-	if (lines.size() == 0)
+	if (finished->search && finished->graph->error_exists())
+	{
+		// Выводим сообщение об ошибках.
+		QString errors;
+		std::vector<int> codes = finished->graph->getErrors();
+		for (size_t i = 0; i < codes.size(); i++)
+		{
+			errors += QString(Graph::getErrorString(codes[i]));
+			if (i != codes.size() - 1)
+				errors += QString("\n");
+		}
+		statusBar()->showMessage(QString(""));
+		QMessageBox::warning(NULL, QString("Ошибки во входных данных."), errors);
+		delete finished;
 		return;
-
-	// Генерируем dot-файл.
-	QString tmpFileName = appPath + QString("tmp.dot");
-	FILE * file;
-	if (fopen_s(&file, tmpFileName.toLocal8Bit().data(), "w"))
+	}
+	if (!finished->layoutComputed)
+	{
+		statusBar()->showMessage(QString("Не удалось вычислить раскладку графа."));
+		delete finished;
 		return;
-	fprintf_s(file, "digraph {\nrankdir = LR;\n");
-	for (QList<QString>::const_iterator iter = lines.constBegin(); iter != lines.constEnd(); iter++)
+	}
+
+	// Забираем результаты задачи; раскладка уже вычислена, осталось создать элементы сцены.
+	graph = finished->graph;
+	finished->graph = NULL;
+	stepper = finished->stepper;
+	finished->stepper = NULL;
+	result = finished->result;
+	scene = new GraphScene(parent());
+	scene->build(graph, finished->layout);
+	gvGraph->setScene(scene);
+	if (finished->search)
+	{
+		stepCache = new StepCache(scene, stepper, cacheBudget);
+		if (result.path.empty())
+			statusBar()->showMessage(QString("Путь не найден."));
+		else
+			statusBar()->showMessage(QString("Путь найден"));
+		// Показываем начальный шаг.
+		btnToTheBeginning_clicked(false);
+	}
+	else
 	{
-		QRegExp regex("\\s*([^ ]+)\\s+([^ ]+)\\s+(-?\\d+)\\s*");
-		regex.exactMatch(*iter);
-		fprintf_s(file, "\"%s\" -> \"%s\" [label=\"%I64d\"];\n", regex.cap(1).toLocal8Bit().data(), regex.cap(2).toLocal8Bit().data(), regex.cap(3).toLongLong());
+		statusBar()->showMessage(QString(""));
+		scene->showGraph();
 	}
-	fprintf_s(file, "};");
-	fclose(file);
-
-	QStringList args;
-	args << QString("-Tpng") << QString("-o") + tmpFileName + QString(".png") << tmpFileName;
-	QProcess::execute(dotExeFileName, args);
-	scene->addPixmap(QPixmap(tmpFileName + QString(".png")));
-	_unlink(tmpFileName.toLocal8Bit().data());
-	_unlink((tmpFileName + QString(".png")).toLocal8Bit().data());
-	cleanUp();
+	delete finished;
 }
 
-void GUI::btnSearch_clicked(bool checked)
+void GUI::btnShowGraph_clicked(bool checked)
 {
-	QList<QString> lines;	// Непустые строки из содержимого TextEdit.
+	if (cancelJob())
+		return;
+
+	SearchJob * newJob = new SearchJob();	// Задача с дугами из содержимого TextEdit.
 
 	enableButtons(false, false, false, false);
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
+	resetScene();
 
 	// Если найдены ошибки в формате - выходим.
-	if (!validateFormat(&lines))
+	if (!collectEdges(&newJob->edges))
 	{
 		QMessageBox::warning(NULL, QString("Ошибка"), QString("Список дуг не соответствует формату x y w."));
+		delete newJob;
 		return;
 	}
-	if (lines.size() == 0)
-		return;
-	if (ui.leStartVertex->text() == ui.leEndVertex->text())
+	if (newJob->edges.empty())
 	{
-		QMessageBox::warning(NULL, QString("Ошибка"), QString("Начальная и конечная вершины маршрута совпадают."));
+		delete newJob;
 		return;
 	}
 
-	cleanUp();
-	lastRoute[0] = ui.leStartVertex->text();
-	lastRoute[1] = ui.leEndVertex->text();
+	// Граф строится без проверки ограничений: показать можно и граф с петлями или отрицательными весами.
+	startJob(newJob, ui.btnShowGraph);
+}
 
-	// Генерация входного файла для консольного приложения с алгоритмом.
-	QString inputFileName = appPath + QString("in.txt");
-	FILE * file;
-	if (fopen_s(&file, inputFileName.toLocal8Bit().data(), "w") != 0)
-	{
-		QMessageBox::warning(NULL, QString("Ошибка"), QString("Не удалось сгенерировать входной файл для работы алгоритма."));
+void GUI::btnSearch_clicked(bool checked)
+{
+	if (cancelJob())
 		return;
-	}
-	fprintf_s(file, "%I64d\n%s %s\n", (__int64)lines.size(), lastRoute[0].toLocal8Bit().data(), lastRoute[1].toLocal8Bit().data());
-	for (QList<QString>::const_iterator iter = lines.constBegin(); iter != lines.constEnd(); iter++)
-		fprintf_s(file, "%s\n", iter->toLocal8Bit().data());
-	fclose(file);
-
-	// Запуск алгоритма.
-	QString daExeFileName = appPath + QString("DijkstrasAlgorithm.exe");
-	QString outputFileName = appPath + QString("out.txt");
-	QString prefixFileName = appPath + QString("step");
-	QStringList args;
-	args << inputFileName << outputFileName << prefixFileName;
-	QProcess::execute(daExeFileName, args);
-	_unlink(inputFileName.toLocal8Bit().data());
-
-	// Подготовка данных для визуализации.
-	statusBar()->showMessage(QString("Выполнение алгоритма..."));
-	if (fopen_s(&file, outputFileName.toLocal8Bit().data(), "r") != 0)
+
+	SearchJob * newJob = new SearchJob();	// Задача с дугами из содержимого TextEdit.
+
+	enableButtons(false, false, false, false);
+	resetScene();
+
+	// Если найдены ошибки в формате - выходим.
+	if (!collectEdges(&newJob->edges))
 	{
-		statusBar()->showMessage(QString("Не удалось открыть файл с результатами работы алгоритма."));
+		QMessageBox::warning(NULL, QString("Ошибка"), QString("Список дуг не соответствует формату x y w."));
+		delete newJob;
 		return;
 	}
-	char buf[256] = "";
-	int linesCount = 0;
-	fgets(buf, 256, file);
-	fscanf_s(file, "%d\n", &linesCount);
-	buf[strlen(buf) - 1] = '\0';
-	if (strcmp(buf, "fail") == 0)
+	if (newJob->edges.empty())
 	{
-		// Выводим сообщение об ошибках.
-		QString errors;
-		for (int i = 0; i < linesCount; i++)
-		{
-			fgets(buf, 256, file);
-			errors += QString(buf);
-			if (i != linesCount - 1)
-				errors += QString("\n");
-		}
-		statusBar()->showMessage(QString(""));
-		QMessageBox::warning(NULL, QString("Ошибки во входных данных."), errors);
+		delete newJob;
+		return;
 	}
-	else
+	if (ui.leStartVertex->text() == ui.leEndVertex->text())
 	{
-		int pathSize = 0;
-		fscanf_s(file, "%d\n", &pathSize);
-		// Визуализируем шаги алгоритма.
-		for (int i = 0; i < linesCount; i++)
-		{
-			statusBar()->showMessage(QString("Подготовка шага алгоритма: ") + QString::number(i + 1) + QString(" из ") + QString::number(linesCount));
-			fgets(buf, 256, file);
-			buf[strlen(buf) - 1] = '\0';
-			QStringList args;
-			args << QString("-Tpng") << QString("-o") + QString(buf) + QString(".png") << QString(buf);
-			QProcess::execute(dotExeFileName, args);
-			_unlink(buf);
-			images.push_back(QString(buf) + QString(".png"));
-		}
-		if (pathSize == 0)
-			statusBar()->showMessage(QString("Путь не найден."));
-		else
-			statusBar()->showMessage(QString("Путь найден"));
-		// Показываем начальный шаг.
-		scene->addPixmap(QPixmap(images[0]));
-		btnToTheBeginning_clicked(false);
+		QMessageBox::warning(NULL, QString("Ошибка"), QString("Начальная и конечная вершины маршрута совпадают."));
+		delete newJob;
+		return;
 	}
-	fclose(file);
-	_unlink(outputFileName.toLocal8Bit().data());
+
+	lastRoute[0] = ui.leStartVertex->text();
+	lastRoute[1] = ui.leEndVertex->text();
+
+	// Поиск, сохранение шагов в памяти и вычисление раскладки выполняются в пуле потоков.
+	newJob->search = true;
+	newJob->start = lastRoute[0].toLocal8Bit().data();
+	newJob->end = lastRoute[1].toLocal8Bit().data();
+	startJob(newJob, ui.btnSearch);
 }
 
 void GUI::btnToTheBeginning_clicked(bool checked)
 {
-	if (images.empty())
+	if (stepper == NULL)
 		return;
-	currentImage = 0;
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
-	scene->addPixmap(QPixmap(images[currentImage]));
+	currentStep = 0;
+	displayStep(currentStep);
 	enableButtons(true, false, true, true);
 }
 
 void GUI::btnPrevious_clicked(bool checked)
 {
-	if (images.empty())
+	if (stepper == NULL)
 		return;
-	currentImage--;
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
-	scene->addPixmap(QPixmap(images[currentImage]));
-	enableButtons(true, currentImage > 0, true, true);
+	currentStep--;
+	displayStep(currentStep);
+	enableButtons(true, currentStep > 0, true, true);
 }
 
 void GUI::btnNext_clicked(bool checked)
 {
-	if (images.empty())
+	if (stepper == NULL)
 		return;
-	currentImage++;
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
-	scene->addPixmap(QPixmap(images[currentImage]));
-	enableButtons(true, true, currentImage < images.size() - 1, true);
+	currentStep++;
+	displayStep(currentStep);
+	enableButtons(true, true, currentStep < stepCount() - 1, true);
 }
 
 void GUI::btnToTheEnd_clicked(bool checked)
 {
-	if (images.empty())
+	if (stepper == NULL)
 		return;
-	currentImage = images.size() - 1;
-	if (scene != NULL)
-		delete scene;
-	scene = new QGraphicsScene(parent());
-	gvGraph->setScene(scene);
-	scene->addPixmap(QPixmap(images[currentImage]));
+	currentStep = stepCount() - 1;
+	displayStep(currentStep);
 	enableButtons(true, true, false, true);
 }
 
@@ -395,22 +464,21 @@ void GUI::btnMenuSave_triggered(bool checked)
 	}
 	QTextStream stream(&file);
 	QTextDocument * doc = ui.teGraph->document();	// Содержимое TextEdit.
-	QList<QString> lines;							// Непустые строки из содержимого TextEdit.
-	for (int i = 0; i < doc->lineCount(); i++)
-	{
-		QString line = doc->findBlockByLineNumber(i).text();
-		if (line != QString(""))
-			lines << line;
-	}
-	stream << QString::number(lines.size(), 10) + QString("\n");
-	for (QList<QString>::const_iterator iter = lines.constBegin(); iter != lines.constEnd(); iter++)
-		stream << *iter + QString("\n");
+	// Строки пишутся в файл по одной, без промежуточного списка.
+	int count = 0;
+	for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next())
+		if (block.text() != QString(""))
+			count++;
+	stream << QString::number(count, 10) + QString("\n");
+	for (QTextBlock block = doc->begin(); block != doc->end(); block = block.next())
+		if (block.text() != QString(""))
+			stream << block.text() + QString("\n");
 	file.close();
 }
 
 void GUI::btnMenuCreateReport_triggered(bool checked)
 {
-	if (images.size() < 2)
+	if (stepCount() < 2)
 	{
 		QMessageBox::information(NULL, QString("Нет данных для отчета"), QString("Для создания отчета необходимо сначала найти кратчайший путь."));
 		return;
@@ -425,7 +493,7 @@ void GUI::btnMenuCreateReport_triggered(bool checked)
 		return;
 	}
 	QTextStream stream(&file);
-	// Копируем сгенерированные картинки, случайным образом генерируя имена файлов.
+	// Отрисовываем шаги в картинки; каталог очищается заново, поэтому имена файлов - просто номера шагов.
 	QVector<QString> pngFileNames;
 	QFileInfo info(fileName);
 	QString basename = info.baseName();
@@ -435,24 +503,14 @@ void GUI::btnMenuCreateReport_triggered(bool checked)
 	dir += suffix;
 	removeDir(dir);
 	tmp.mkdir(suffix);
-	
-	
-	for (QVector<QString>::const_iterator iter = images.constBegin(); iter != images.constEnd(); iter++)
+
+	for (int step = 0; step < stepCount(); step++)
 	{
-		QString fileName("");
-		do
-		{
-			for (int i = 0; i < 32; i++)
-				if (qrand() % 2)
-					fileName += QChar('a' + qrand() % 26);
-				else
-					fileName += QChar('0' + qrand() % 10);
-		}
-		while (QFile::exists(dir + fileName + QString(".png")));
-		fileName = dir + fileName + QString(".png");
-		QFile::copy(*iter, fileName);
+		QString fileName = dir + QString("step%1.png").arg(step, 6, 10, QChar('0'));
+		renderStep(step, fileName);
 		pngFileNames.push_back(fileName);
 	}
+	displayStep(currentStep);
 
 	stream << QString("<html>\n	<body>\n");
 	stream << QString("		Поиск кратчайшего марштура из вершины <b>") + lastRoute[0] + QString("</b> в вершину <b>") + lastRoute[1] + QString("</b>:<br/>\n");
@@ -468,6 +526,24 @@ void GUI::btnMenuCreateReport_triggered(bool checked)
 	file.close();
 }
 
+void GUI::btnMenuCreateCompactReport_triggered(bool checked)
+{
+	if (stepCount() < 2)
+	{
+		QMessageBox::information(NULL, QString("Нет данных для отчета"), QString("Для создания отчета необходимо сначала найти кратчайший путь."));
+		return;
+	}
+	QString fileName = QFileDialog::getSaveFileName(this, QString("Сохранить отчет"), QString(""), QString("Файл html (*.html)"), 0, 0);
+	if (fileName == QString(""))
+		return;
+	// Картинки не создаются: граф сохраняется один раз, а шаги воспроизводятся в браузере.
+	// Шаги берутся из уже выполненного алгоритма; предварительная загрузка кэша не должна перематывать их одновременно с отчетом.
+	stepCache->stopPrefetch();
+	HtmlReport report(scene, stepper, &result);
+	if (!report.save(fileName, lastRoute[0], lastRoute[1]))
+		QMessageBox::warning(NULL, QString("Ошибка"), QString("Не удалось сохранить файл."));
+}
+
 void GUI::btnMenuExit_triggered(bool checked)
 {
 	close();
@@ -484,7 +560,8 @@ void GUI::btnMenuHelp_triggered(bool checked)
 																		QString("Текущая просматриваемая дуга выделяется красным цветом, просмотренные вершины выделяются пунктиром, а выходящие из них дуги - синим цветом. ") +
 																		QString("На последнем шаге дуги, принадлежащие найденному пути, выделяются фиолетовым цветом.\n") +
 																		QString("Граф можно масштабировать с помощью колеса мыши при зажатой клавише Ctrl.\n") +
-																		QString("Возможно формирование отчета в формате html. Для этого необходимо в главном меню выбрать пункт Файл->Создать отчет в формате html.\n"));
+																		QString("Возможно формирование отчета в формате html. Для этого необходимо в главном меню выбрать пункт Файл->Создать отчет в формате html.\n") +
+																		QString("Компактный отчет (Файл->Создать компактный отчет в формате html) хранит граф один раз, а шаги воспроизводятся в браузере.\n"));
 }
 
 void GUI::btnMenuAlgorithm_triggered(bool checked)
@@ -21,7 +21,18 @@
 #include <qvalidator.h>
 #include <qgraphicsview.h>
 #include <qevent.h>
+#include <qimage.h>
+#include <qpainter.h>
+#include <qtimer.h>
+#include <qfuturewatcher.h>
+#include <qtconcurrentrun.h>
 #include "ui_gui.h"
+#include "graph.h"
+#include "graphscene.h"
+#include "stepcache.h"
+#include "searchjob.h"
+#include "htmlreport.h"
+#include "edgelistvalidator.h"
 
 class ScalableGraphicsView : public QGraphicsView
 {
@@ -40,24 +51,50 @@ class GUI : public QMainWindow
 	Q_OBJECT
 
 private:
+	// Бюджет памяти кэша шагов по умолчанию, в мегабайтах.
+	static const int DEFAULT_CACHE_BUDGET_MB = 64;
+	// Количество шагов, вычисляемых заранее при просмотре.
+	static const int PREFETCH_STEPS = 8;
+	// Период обновления прогресса в строке состояния, в миллисекундах.
+	static const int PROGRESS_INTERVAL = 100;
+
 	Ui::GUIClass ui;
 	QString dotExeFileName;			// Абсолютный путь к dot.exe.
 	QString appPath;				// Абсолютный путь до исполняемого файла.
-	QVector<QString> images;		// Сгенерированные картинки для текущего введенного графа.
-	int currentImage;				// Индекс текущей картинки.
+	Graph * graph;					// Граф, построенный по введенному списку дуг.
+	GraphStepper * stepper;			// Шаги алгоритма для текущего введенного графа или NULL.
+	ExecutionState result;			// Результат работы алгоритма.
+	int currentStep;				// Индекс текущего шага.
+	StepCache * stepCache;			// Кэш состояний шагов, вычисляемых по мере просмотра.
+	qint64 cacheBudget;				// Бюджет памяти кэша шагов в байтах.
+	SearchJob * job;				// Выполняемая в фоне задача или NULL.
+	QFutureWatcher<void> jobWatcher;	// Сообщает о завершении фоновой задачи.
+	QTimer progressTimer;			// Таймер обновления прогресса в строке состояния.
+	QPushButton * cancelButton;		// Кнопка, запустившая фоновую задачу; на время выполнения она отменяет задачу.
+	QString cancelButtonText;		// Исходная надпись на этой кнопке.
+	EdgeListValidator editorValidator;	// Инкрементальная проверка списка дуг в редакторе.
 	ScalableGraphicsView * gvGraph;	// Масштабируемый QGraphicsView.
-	QGraphicsScene * scene;			// Для показа картинок.
+	GraphScene * scene;				// Сцена с размещенным графом.
 	QGridLayout * gvLayout;			// Компоновщик для gvGraph.
 	bool dotPathSetManually;		// Указан ли путь до dot.exe вручную.
 	QRegExpValidator validator;		// Валидатор на вершины.
 	QString lastRoute[2];			// Начало и конец найденного маршрута.
 
-	bool validateFormat(QList<QString> * lines);
+	bool collectEdges(std::vector<FileListItem> * edges);
 	void cleanUp();
+	void resetScene();
+	int stepCount();
+	void displayStep(int index);
+	bool renderStep(int index, const QString & fileName);
+	void startJob(SearchJob * newJob, QPushButton * button);
+	bool cancelJob();
 	void enableButtons(bool beginning, bool previous, bool next, bool end);
 	bool removeDir(const QString & dirName);
 
 private slots:
+	void jobFinished();
+	void progressTimer_timeout();
+	void teGraph_contentsChange(int position, int charsRemoved, int charsAdded);
 	void btnShowGraph_clicked(bool checked);
 	void btnSearch_clicked(bool checked);
 	void btnToTheBeginning_clicked(bool checked);
@@ -67,6 +104,7 @@ private slots:
 	void btnMenuOpen_triggered(bool checked);
 	void btnMenuSave_triggered(bool checked);
 	void btnMenuCreateReport_triggered(bool checked);
+	void btnMenuCreateCompactReport_triggered(bool checked);
 	void btnMenuExit_triggered(bool checked);
 	void btnMenuHelp_triggered(bool checked);
 	void btnMenuAlgorithm_triggered(bool checked);
@@ -0,0 +1,196 @@
+#include "htmlreport.h"
+#include <qfile.h>
+#include <qtextdocument.h>
+
+// Количество чисел в одной строке списка событий.
+static const int NUMBERS_PER_LINE = 64;
+
+HtmlReport::HtmlReport(const GraphScene * _scene, GraphStepper * _stepper, const ExecutionState * _result)
+{
+	scene = _scene;
+	stepper = _stepper;
+	result = _result;
+}
+
+QString HtmlReport::pathToSvg(const QPainterPath & path)
+{
+	QString d;
+	for (int i = 0; i < path.elementCount(); i++)
+	{
+		const QPainterPath::Element & element = path.elementAt(i);
+		if (element.isMoveTo())
+			d += QString("M%1 %2 ").arg(element.x).arg(element.y);
+		else if (element.isLineTo())
+			d += QString("L%1 %2 ").arg(element.x).arg(element.y);
+		else if (element.isCurveTo() && i + 2 < path.elementCount())
+		{
+			// За началом кривой Безье следуют еще две точки.
+			const QPainterPath::Element & c2 = path.elementAt(i + 1);
+			const QPainterPath::Element & end = path.elementAt(i + 2);
+			d += QString("C%1 %2 %3 %4 %5 %6 ").arg(element.x).arg(element.y).arg(c2.x).arg(c2.y).arg(end.x).arg(end.y);
+			i += 2;
+		}
+	}
+	return d.trimmed();
+}
+
+QString HtmlReport::polygonToSvg(const QPolygonF & polygon)
+{
+	QString points;
+	for (int i = 0; i < polygon.size(); i++)
+		points += QString("%1,%2 ").arg(polygon[i].x()).arg(polygon[i].y());
+	return points.trimmed();
+}
+
+void HtmlReport::writeSvg(QTextStream & stream) const
+{
+	const GraphLayout & layout = scene->layout;
+	QRectF rect = scene->sceneRect().adjusted(-10, -10, 10, 10);
+	stream << QString("		<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%1\" height=\"%2\" viewBox=\"%3 %4 %1 %2\" font-family=\"Times New Roman\" font-size=\"14\">\n")
+		.arg(rect.width()).arg(rect.height()).arg(rect.x()).arg(rect.y());
+
+	// Дуги рисуются под узлами; цвет задается группе и наследуется линией, наконечником и подписью.
+	for (int i = 0; i < scene->edges.size(); i++)
+	{
+		stream << QString("			<g id=\"e%1\" stroke=\"black\" fill=\"black\">").arg(i);
+		stream << QString("<path fill=\"none\" d=\"%1\"/>").arg(pathToSvg(layout.edgePaths.value(i)));
+		stream << QString("<polygon points=\"%1\"/>").arg(polygonToSvg(layout.edgeArrows.value(i)));
+		QPointF label = layout.edgeLabels.value(i);
+		stream << QString("<text stroke=\"none\" x=\"%1\" y=\"%2\" text-anchor=\"middle\" dominant-baseline=\"middle\">%3</text></g>\n")
+			.arg(label.x()).arg(label.y()).arg(scene->edges[i]->weight);
+	}
+	for (int i = 0; i < scene->nodes.size(); i++)
+	{
+		QRectF node = layout.nodeRects.value(i);
+		QPointF center = node.center();
+		stream << QString("			<g id=\"n%1\"><ellipse fill=\"white\" stroke=\"black\" cx=\"%2\" cy=\"%3\" rx=\"%4\" ry=\"%5\"/>")
+			.arg(i).arg(center.x()).arg(center.y()).arg(node.width() / 2).arg(node.height() / 2);
+		stream << QString("<text x=\"%1\" y=\"%2\" text-anchor=\"middle\"><tspan x=\"%1\">%3</tspan><tspan id=\"l%4\" x=\"%1\" dy=\"1.2em\"> len=-1</tspan></text></g>\n")
+			.arg(center.x()).arg(center.y()).arg(Qt::escape(scene->nodeNames[i])).arg(i);
+	}
+	stream << QString("		</svg>\n");
+}
+
+void HtmlReport::writeData(QTextStream & stream) const
+{
+	// Начальные узлы дуг нужны, чтобы выделять дуги, выходящие из пройденных узлов.
+	stream << QString("var nodeCount = ") << scene->nodes.size() << QString(";\nvar edgeFrom = [");
+	for (int i = 0; i < scene->edgeSources.size(); i++)
+		stream << (i > 0 ? QString(",") : QString("")) << (i % NUMBERS_PER_LINE == 0 ? QString("\n") : QString("")) << scene->edgeSources[i];
+
+	// Каждый шаг - четверка чисел: текущая дуга, узел с измененной меткой, новая метка, пройденный узел; -1 означает отсутствие.
+	stream << QString("];\nvar steps = [");
+	ExecutionStep step;
+	stepper->seek(0);
+	for (int i = 0; stepper->next(&step); i++)
+	{
+		stream << (i > 0 ? QString(",") : QString("")) << (i % (NUMBERS_PER_LINE / 4) == 0 ? QString("\n") : QString(""));
+		stream << (step.currentEdge != NULL ? scene->edgeIndices.value(step.currentEdge, -1) : -1) << QString(",");
+		stream << (step.changedNode != NULL ? scene->nodeIndex(step.changedNode) : -1) << QString(",");
+		stream << QString::number(step.totalWeight) << QString(",");
+		stream << (step.passedNode != NULL ? scene->nodeIndex(step.passedNode) : -1);
+	}
+	stream << QString("];\nvar path = [");
+	for (size_t i = 0; i < result->path.size(); i++)
+		stream << (i > 0 ? QString(",") : QString("")) << scene->edgeIndices.value(result->path[i], -1);
+	stream << QString("];\n");
+}
+
+void HtmlReport::writeScript(QTextStream & stream) const
+{
+	// Состояние шага вычисляется применением событий к состоянию предыдущего шага; при переходе назад воспроизведение начинается сначала.
+	// Изменяются только затронутые событием элементы, поэтому переход на следующий шаг не зависит от размера графа.
+	stream << QString(
+		"var stepTotal = steps.length / 4 + (path.length > 0 ? 1 : 0);\n"
+		"var labels = [], passed = [], onPath = [], outgoing = [];\n"
+		"var applied = -1, view = -1, current = -1, showPath = false;\n"
+		"for (var i = 0; i < nodeCount; i++) outgoing.push([]);\n"
+		"for (var i = 0; i < edgeFrom.length; i++) { outgoing[edgeFrom[i]].push(i); onPath.push(false); }\n"
+		"for (var i = 0; i < path.length; i++) onPath[path[i]] = true;\n"
+		"function edgeColor(e) {\n"
+		"	if (showPath) return onPath[e] ? 'magenta' : 'black';\n"
+		"	if (e == current) return 'red';\n"
+		"	return passed[edgeFrom[e]] ? 'blue' : 'black';\n"
+		"}\n"
+		"function paintEdge(e) {\n"
+		"	var g = document.getElementById('e' + e);\n"
+		"	var color = edgeColor(e);\n"
+		"	g.setAttribute('stroke', color);\n"
+		"	g.setAttribute('fill', color);\n"
+		"}\n"
+		"function paintNode(n) {\n"
+		"	var ellipse = document.getElementById('n' + n).firstChild;\n"
+		"	ellipse.setAttribute('stroke-dasharray', passed[n] && !showPath ? '2,2' : 'none');\n"
+		"	document.getElementById('l' + n).textContent = ' len=' + labels[n];\n"
+		"}\n"
+		"function reset() {\n"
+		"	applied = -1; current = -1; showPath = false;\n"
+		"	for (var i = 0; i < nodeCount; i++) { labels[i] = -1; passed[i] = false; paintNode(i); }\n"
+		"	for (var i = 0; i < edgeFrom.length; i++) paintEdge(i);\n"
+		"}\n"
+		"function apply(k) {\n"
+		"	var previous = current;\n"
+		"	current = steps[4 * k];\n"
+		"	if (previous >= 0) paintEdge(previous);\n"
+		"	if (current >= 0) paintEdge(current);\n"
+		"	var changed = steps[4 * k + 1], settled = steps[4 * k + 3];\n"
+		"	if (changed >= 0) { labels[changed] = steps[4 * k + 2]; paintNode(changed); }\n"
+		"	if (settled >= 0) {\n"
+		"		passed[settled] = true;\n"
+		"		paintNode(settled);\n"
+		"		for (var i = 0; i < outgoing[settled].length; i++) paintEdge(outgoing[settled][i]);\n"
+		"	}\n"
+		"}\n"
+		"function setShowPath(value) {\n"
+		"	showPath = value;\n"
+		"	for (var i = 0; i < nodeCount; i++) paintNode(i);\n"
+		"	for (var i = 0; i < edgeFrom.length; i++) paintEdge(i);\n"
+		"}\n"
+		"function show(k) {\n"
+		"	k = Math.max(0, Math.min(stepTotal - 1, k));\n"
+		"	var last = Math.min(k, steps.length / 4 - 1);\n"
+		"	if (last < applied) reset();\n"
+		"	else if (showPath) setShowPath(false);\n"
+		"	while (applied < last) apply(++applied);\n"
+		"	if (k >= steps.length / 4) setShowPath(true);\n"
+		"	view = k;\n"
+		"	document.getElementById('slider').value = k;\n"
+		"	var caption = (k == 0) ? 'Начальное состояние' : (showPath ? 'Результат' : 'Шаг ' + k);\n"
+		"	document.getElementById('caption').textContent = caption + ' (' + (k + 1) + '/' + stepTotal + ')';\n"
+		"}\n"
+		"document.onkeydown = function(event) {\n"
+		"	if (event.keyCode == 37) show(view - 1);\n"
+		"	else if (event.keyCode == 39) show(view + 1);\n"
+		"};\n"
+		"reset();\n"
+		"show(0);\n");
+}
+
+bool HtmlReport::save(const QString & fileName, const QString & start, const QString & end) const
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	QTextStream stream(&file);
+	stream.setCodec("UTF-8");
+
+	stream << QString("<!DOCTYPE html>\n<html>\n	<head>\n		<meta charset=\"utf-8\"/>\n		<title>") << Qt::escape(start) << QString(" - ") << Qt::escape(end) << QString("</title>\n	</head>\n	<body>\n");
+	stream << QString("		Поиск кратчайшего маршрута из вершины <b>") << Qt::escape(start) << QString("</b> в вершину <b>") << Qt::escape(end) << QString("</b>:<br/>\n");
+	stream << QString("		<div>\n");
+	stream << QString("			<button onclick=\"show(0)\">В начало</button>\n");
+	stream << QString("			<button onclick=\"show(view - 1)\">Предыдущий шаг</button>\n");
+	stream << QString("			<button onclick=\"show(view + 1)\">Следующий шаг</button>\n");
+	stream << QString("			<button onclick=\"show(stepTotal - 1)\">В конец</button>\n");
+	stream << QString("			<input id=\"slider\" type=\"range\" min=\"0\" max=\"%1\" value=\"0\" oninput=\"show(+this.value)\" onchange=\"show(+this.value)\"/>\n")
+		.arg(stepper->stepCount() - (result->path.empty() ? 1 : 0));
+	stream << QString("			<span id=\"caption\"></span>\n");
+	stream << QString("		</div>\n");
+	writeSvg(stream);
+	stream << QString("		<script>\n");
+	writeData(stream);
+	writeScript(stream);
+	stream << QString("		</script>\n	</body>\n</html>\n");
+	stream.flush();
+	file.close();
+	return stream.status() == QTextStream::Ok && file.error() == QFile::NoError;
+}
@@ -0,0 +1,50 @@
+#ifndef HTMLREPORT_H
+#define HTMLREPORT_H
+
+#include <vector>
+#include <qstring.h>
+#include <qtextstream.h>
+#include "graph.h"
+#include "graphscene.h"
+#include "graphstepper.h"
+
+/**
+ * Компактный отчет в формате html.
+ * Граф сохраняется один раз в виде SVG, шаги алгоритма - списком событий, которые воспроизводятся в браузере сценарием на JavaScript.
+ * Поэтому размер отчета пропорционален количеству шагов, а не произведению количества шагов на размер картинки.
+ * Шаги не хранятся в памяти: их выдает GraphStepper, по которому уже выполнен алгоритм, и они сразу записываются в файл.
+ */
+class HtmlReport
+{
+private:
+	const GraphScene * scene;					// Сцена с раскладкой графа.
+	GraphStepper * stepper;						// Шаги алгоритма.
+	const ExecutionState * result;				// Результат работы алгоритма.
+
+	static QString pathToSvg(const QPainterPath & path);
+	static QString polygonToSvg(const QPolygonF & polygon);
+	void writeSvg(QTextStream & stream) const;
+	void writeData(QTextStream & stream) const;
+	void writeScript(QTextStream & stream) const;
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _scene - сцена с раскладкой графа.
+	 * @param _stepper - шаги алгоритма, выполненного до конца (GraphStepper::runToEnd) по графу сцены;
+	 *                   при сохранении отчета он перематывается, поэтому другие потоки не должны читать его в это время.
+	 * @param _result - результат работы алгоритма.
+	 */
+	HtmlReport(const GraphScene * _scene, GraphStepper * _stepper, const ExecutionState * _result);
+
+	/**
+	 * Сохранение отчета в файл.
+	 * @param fileName - имя файла отчета.
+	 * @param start - начальная вершина маршрута.
+	 * @param end - конечная вершина маршрута.
+	 * @return - true, если отчет сохранен, иначе false.
+	 */
+	bool save(const QString & fileName, const QString & start, const QString & end) const;
+};
+
+#endif // HTMLREPORT_H
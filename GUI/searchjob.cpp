@@ -0,0 +1,53 @@
+#include "searchjob.h"
+
+SearchJob::SearchJob()
+{
+	search = false;
+	stage = STAGE_ALGORITHM;
+	graph = NULL;
+	stepper = NULL;
+	layoutComputed = false;
+}
+
+SearchJob::~SearchJob()
+{
+	// Объект шагов ссылается на граф, поэтому удаляется первым.
+	if (stepper != NULL)
+		delete stepper;
+	if (graph != NULL)
+		delete graph;
+}
+
+void SearchJob::run()
+{
+	graph = new Graph();
+	stage = STAGE_ALGORITHM;
+	if (search)
+	{
+		// При ошибках во входных данных раскладка не нужна.
+		if (!graph->load(edges, start, end))
+			return;
+		// Шаги не сохраняются: выполнение до конца дает количество шагов, результат и контрольные точки для просмотра.
+		stepper = new GraphStepper(graph);
+		if (stepper->runToEnd(&control))
+			result = stepper->result();
+	}
+	else
+		graph->build(edges);
+	if (control.cancelled)
+		return;
+
+	stage = STAGE_LAYOUT;
+	layoutComputed = GraphScene::computeLayout(graph, dotExeFileName, &layout, &control);
+}
+
+QString SearchJob::progressMessage() const
+{
+	if (control.cancelled)
+		return QString("Отмена...");
+	if (stage == STAGE_LAYOUT)
+		return QString("Вычисление раскладки графа...");
+	if (!search)
+		return QString("Построение графа...");
+	return QString("Выполнение алгоритма: пройдено вершин ") + QString::number(control.passedCount) + QString(" из ") + QString::number(control.nodeCount);
+}
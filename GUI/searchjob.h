@@ -0,0 +1,52 @@
+#ifndef SEARCHJOB_H
+#define SEARCHJOB_H
+
+#include <vector>
+#include <string>
+#include <qstring.h>
+#include "graph.h"
+#include "graphstepper.h"
+#include "graphscene.h"
+
+/**
+ * Фоновая задача: построение графа, выполнение алгоритма и вычисление раскладки.
+ * Выполняется в пуле потоков, главный поток только опрашивает прогресс и забирает результаты после завершения.
+ */
+struct SearchJob
+{
+	// Задача выполняет алгоритм.
+	static const int STAGE_ALGORITHM = 0;
+	// Задача вычисляет раскладку графа.
+	static const int STAGE_LAYOUT = 1;
+
+	std::vector<FileListItem> edges;	// Дуги графа.
+	bool search;						// Выполнять ли поиск пути; иначе вычисляется только раскладка.
+	std::string start;					// Начальная вершина маршрута.
+	std::string end;					// Конечная вершина маршрута.
+	QString dotExeFileName;				// Абсолютный путь к dot.exe.
+
+	ExecutionControl control;			// Отмена и прогресс выполнения.
+	volatile int stage;					// Текущий этап выполнения.
+
+	Graph * graph;						// Построенный граф; удаляется вместе с задачей, если его не забрали.
+	GraphStepper * stepper;				// Пошаговое выполнение алгоритма по графу; удаляется вместе с задачей, если его не забрали.
+	ExecutionState result;				// Результат работы алгоритма.
+	GraphLayout layout;					// Раскладка графа.
+	bool layoutComputed;				// Удалось ли вычислить раскладку.
+
+	SearchJob();
+	~SearchJob();
+
+	/**
+	 * Выполняет задачу. Вызывается в рабочем потоке.
+	 */
+	void run();
+
+	/**
+	 * Сообщение о ходе выполнения для строки состояния.
+	 * @return - строка с описанием текущего этапа.
+	 */
+	QString progressMessage() const;
+};
+
+#endif // SEARCHJOB_H
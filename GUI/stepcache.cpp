@@ -0,0 +1,150 @@
+#include "stepcache.h"
+#include <qtconcurrentrun.h>
+
+StepCache::StepCache(const GraphScene * _scene, GraphStepper * _stepper, qint64 _memoryBudget)
+{
+	scene = _scene;
+	stepper = _stepper;
+	memoryBudget = _memoryBudget;
+	memoryUsed = 0;
+	generation = 0;
+}
+
+StepCache::~StepCache()
+{
+	stopPrefetch();
+}
+
+qint64 StepCache::stateSize(const StepState & state) const
+{
+	return state.labels.size() * sizeof(__int64) + state.passed.size() * sizeof(bool) + sizeof(Entry) + sizeof(int) * 4;
+}
+
+bool StepCache::lookup(int index, StepState * state)
+{
+	QMutexLocker locker(&mutex);
+	std::map<int, Entry>::iterator iter = entries.find(index);
+	if (iter == entries.end())
+		return false;
+	// Помечаем состояние как недавно использованное.
+	usage.splice(usage.begin(), usage, iter->second.usage);
+	*state = iter->second.state;
+	return true;
+}
+
+int StepCache::nearest(int index, StepState * state)
+{
+	QMutexLocker locker(&mutex);
+	std::map<int, Entry>::iterator iter = entries.upper_bound(index);
+	if (iter == entries.begin())
+		return -1;
+	--iter;
+	*state = iter->second.state;
+	return iter->first;
+}
+
+void StepCache::insert(int index, const StepState & state)
+{
+	qint64 size = stateSize(state);
+	if (size > memoryBudget)
+		return;
+
+	QMutexLocker locker(&mutex);
+	if (entries.find(index) != entries.end())
+		return;
+	// Вытесняем давно не использованные состояния, пока новое не поместится в бюджет.
+	while (memoryUsed + size > memoryBudget && !usage.empty())
+	{
+		std::map<int, Entry>::iterator victim = entries.find(usage.back());
+		memoryUsed -= stateSize(victim->second.state);
+		entries.erase(victim);
+		usage.pop_back();
+	}
+	usage.push_front(index);
+	Entry & entry = entries[index];
+	entry.state = state;
+	entry.usage = usage.begin();
+	memoryUsed += size;
+}
+
+bool StepCache::compute(int index, StepState * state, int prefetchGeneration)
+{
+	// Начинаем с ближайшего закэшированного шага или с начала выполнения алгоритма.
+	int from = nearest(index, state);
+	if (from < 0)
+		scene->initialState(state);
+	QMutexLocker locker(&stepperMutex);
+	ExecutionStep step;
+	if (!stepper->seek(from + 1))
+		return false;
+	for (int i = from + 1; i <= index; i++)
+	{
+		if (prefetchGeneration >= 0 && generation != prefetchGeneration)
+			return false;
+		stepper->next(&step);
+		scene->applyStep(step, state);
+	}
+	return true;
+}
+
+StepState StepCache::state(int index)
+{
+	// Шаг с результатом отображает метки после последнего шага алгоритма.
+	if (index >= stepper->stepCount())
+		index = stepper->stepCount() - 1;
+
+	StepState result;
+	if (lookup(index, &result))
+		return result;
+	// Предварительная загрузка занимает источник шагов, а ее шаги уже не нужны - прерываем ее.
+	generation.fetchAndAddOrdered(1);
+	compute(index, &result);
+	insert(index, result);
+	return result;
+}
+
+void StepCache::prefetch(int from, int count)
+{
+	// Прерываем предыдущую загрузку; она проверяет номер на каждом шаге, поэтому завершается быстро.
+	int prefetchGeneration = generation.fetchAndAddOrdered(1) + 1;
+	prefetchFuture.waitForFinished();
+	prefetchFuture = QtConcurrent::run(this, &StepCache::prefetchSteps, from, count, prefetchGeneration);
+}
+
+void StepCache::stopPrefetch()
+{
+	generation.fetchAndAddOrdered(1);
+	prefetchFuture.waitForFinished();
+}
+
+void StepCache::prefetchSteps(int from, int count, int prefetchGeneration)
+{
+	StepState current;
+	bool computed = false;
+	for (int i = from; i < from + count && i < stepper->stepCount(); i++)
+	{
+		// Пользователь перешел к другому шагу - эта загрузка больше не нужна.
+		if (generation != prefetchGeneration)
+			return;
+		StepState cached;
+		if (lookup(i, &cached))
+		{
+			current = cached;
+			computed = true;
+			continue;
+		}
+		if (computed)
+		{
+			// Основной поток мог сдвинуть источник шагов - тогда seek вернется к нужному шагу от контрольной точки.
+			QMutexLocker locker(&stepperMutex);
+			ExecutionStep step;
+			if (!stepper->seek(i) || !stepper->next(&step))
+				return;
+			scene->applyStep(step, &current);
+		}
+		else if (!compute(i, &current, prefetchGeneration))
+			return;
+		computed = true;
+		insert(i, current);
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef STEPCACHE_H
+#define STEPCACHE_H
+
+#include <map>
+#include <list>
+#include <vector>
+#include <qmutex.h>
+#include <qatomic.h>
+#include <qfuture.h>
+#include "graphscene.h"
+#include "graphstepper.h"
+
+/**
+ * Кэш состояний визуализации шагов алгоритма.
+ * Состояние шага вычисляется только при обращении к нему: от ближайшего закэшированного шага с меньшим номером применяются оставшиеся шаги,
+ * которые выдает GraphStepper; сами шаги не хранятся.
+ * Вытесняются давно не использованные состояния (LRU) так, чтобы суммарный объем не превышал заданного бюджета памяти.
+ * Следующие несколько шагов могут вычисляться заранее в рабочем потоке.
+ */
+class StepCache
+{
+private:
+	/**
+	 * Элемент кэша.
+	 */
+	struct Entry
+	{
+		StepState state;					// Состояние визуализации.
+		std::list<int>::iterator usage;		// Положение в списке использования.
+	};
+
+	const GraphScene * scene;				// Сцена, задающая индексы узлов.
+	GraphStepper * stepper;					// Источник шагов алгоритма.
+	QMutex stepperMutex;					// Шаги читают основной и рабочий потоки по очереди.
+	qint64 memoryBudget;					// Бюджет памяти в байтах.
+	qint64 memoryUsed;						// Занятая память в байтах.
+	std::map<int, Entry> entries;			// Закэшированные состояния по номерам шагов.
+	std::list<int> usage;					// Номера шагов, от недавно использованных к давно использованным.
+	QMutex mutex;							// Защищает entries, usage и memoryUsed.
+	QFuture<void> prefetchFuture;			// Текущая предварительная загрузка.
+	QAtomicInt generation;					// Номер актуальной предварительной загрузки; устаревшие загрузки прерываются.
+
+	qint64 stateSize(const StepState & state) const;
+	bool lookup(int index, StepState * state);
+	int nearest(int index, StepState * state);
+	void insert(int index, const StepState & state);
+	bool compute(int index, StepState * state, int prefetchGeneration = -1);
+	void prefetchSteps(int from, int count, int prefetchGeneration);
+
+public:
+	/**
+	 * Конструктор.
+	 * @param _scene - сцена, по которой определяются индексы узлов.
+	 * @param _stepper - шаги алгоритма, выполненного до конца (GraphStepper::runToEnd); должен существовать, пока существует кэш.
+	 * @param _memoryBudget - максимальный объем закэшированных состояний в байтах.
+	 */
+	StepCache(const GraphScene * _scene, GraphStepper * _stepper, qint64 _memoryBudget);
+
+	/**
+	 * Деструктор. Дожидается завершения предварительной загрузки.
+	 */
+	~StepCache();
+
+	/**
+	 * Получение состояния визуализации на заданном шаге.
+	 * @param index - номер шага.
+	 * @return - состояние визуализации.
+	 */
+	StepState state(int index);
+
+	/**
+	 * Запускает вычисление состояний следующих шагов в рабочем потоке. Предыдущая предварительная загрузка прерывается.
+	 * @param from - номер первого шага.
+	 * @param count - количество шагов.
+	 */
+	void prefetch(int from, int count);
+
+	/**
+	 * Прерывает предварительную загрузку и дожидается ее завершения; после этого источник шагов можно читать в основном потоке.
+	 */
+	void stopPrefetch();
+};
+
+#endif // STEPCACHE_H